@@ -0,0 +1,418 @@
+#include "AcquisitionJournal.h"
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QHash>
+#include <QPointer>
+#include <QSet>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QThread>
+#include <QtConcurrent/QtConcurrentRun>
+#include <array>
+#include <cstring>
+#include <functional>
+
+#if defined(Q_OS_WIN)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#elif defined(Q_OS_UNIX)
+#include <sys/mman.h>
+#endif
+
+namespace {
+
+const char kSegmentMagic[8] = {'T', 'E', 'M', 'J', 'R', 'N', 'L', '1'};
+const quint32 kRecordMagic = 0x524D4554; // "TEMR"
+const qint64 kSegmentSize = 32 * 1024 * 1024;
+const char *kSegmentSuffix = ".temj";
+const char *kLockSuffix = ".lock";
+
+struct SegmentHeader {
+  char magic[8];
+  quint32 version;
+  quint32 segmentIndex;
+  qint64 sessionStartMs;
+  quint64 reserved;
+};
+static_assert(sizeof(SegmentHeader) == 32, "segment header layout");
+
+struct RecordHeader {
+  quint32 magic;
+  quint32 type;
+  quint32 length;
+  quint32 crc;
+  qint64 seq;
+  qint64 timestampMs;
+};
+static_assert(sizeof(RecordHeader) == 32, "record header layout");
+
+qint64 alignUp8(qint64 v) { return (v + 7) & ~qint64(7); }
+
+// Table-driven CRC-32 (IEEE 802.3), the same polynomial zlib uses
+quint32 crc32Update(quint32 crc, const uchar *data, qint64 len) {
+  static const auto table = [] {
+    std::array<quint32, 256> t{};
+    for (quint32 i = 0; i < 256; ++i) {
+      quint32 c = i;
+      for (int k = 0; k < 8; ++k)
+        c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+      t[i] = c;
+    }
+    return t;
+  }();
+  crc = ~crc;
+  for (qint64 i = 0; i < len; ++i)
+    crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+  return ~crc;
+}
+
+quint32 recordCrc(const RecordHeader &h, const uchar *payload) {
+  quint32 crc = crc32Update(0, payload, h.length);
+  crc = crc32Update(crc, reinterpret_cast<const uchar *>(&h.seq),
+                    sizeof(h.seq) + sizeof(h.timestampMs));
+  return crc32Update(crc, reinterpret_cast<const uchar *>(&h.type),
+                     sizeof(h.type));
+}
+
+// Walk every valid record of a segment; stops at the first torn record
+bool scanSegment(
+    const QString &path, qint64 *sessionStartMs,
+    const std::function<void(const RecordHeader &, const uchar *)> &visit) {
+  QFile file(path);
+  if (!file.open(QIODevice::ReadOnly) ||
+      file.size() < qint64(sizeof(SegmentHeader)))
+    return false;
+
+  uchar *base = file.map(0, file.size());
+  if (!base)
+    return false;
+
+  SegmentHeader sh;
+  memcpy(&sh, base, sizeof(sh));
+  if (memcmp(sh.magic, kSegmentMagic, sizeof(kSegmentMagic)) != 0) {
+    file.unmap(base);
+    return false;
+  }
+  *sessionStartMs = sh.sessionStartMs;
+
+  qint64 pos = sizeof(SegmentHeader);
+  while (pos + qint64(sizeof(RecordHeader)) <= file.size()) {
+    RecordHeader h;
+    memcpy(&h, base + pos, sizeof(h));
+    if (h.magic != kRecordMagic)
+      break;
+    const qint64 payloadPos = pos + sizeof(RecordHeader);
+    if (payloadPos + h.length > file.size())
+      break;
+    if (recordCrc(h, base + payloadPos) != h.crc)
+      break;
+    visit(h, base + payloadPos);
+    pos = alignUp8(payloadPos + h.length);
+  }
+
+  file.unmap(base);
+  return true;
+}
+
+} // namespace
+
+AcquisitionJournal::AcquisitionJournal(const QString &journalDir,
+                                       QObject *parent)
+    : QObject(parent), m_dir(journalDir) {
+  QDir().mkpath(m_dir);
+
+  m_syncTimer = new QTimer(this);
+  m_syncTimer->setInterval(1000);
+  connect(m_syncTimer, &QTimer::timeout, this, &AcquisitionJournal::syncToDisk);
+}
+
+AcquisitionJournal::~AcquisitionJournal() { closeSession(); }
+
+bool AcquisitionJournal::startSession() {
+  closeSession();
+  // The PID keeps two processes starting in the same millisecond apart
+  m_sessionTag = QString("session_%1_%2")
+                     .arg(QDateTime::currentDateTime().toString(
+                              "yyyyMMdd_HHmmss_zzz"))
+                     .arg(QCoreApplication::applicationPid());
+  m_sessionStartMs = QDateTime::currentMSecsSinceEpoch();
+  // Held until closeSession(); a crashed process's lock counts as free
+  m_sessionLock = std::make_unique<QLockFile>(
+      QDir(m_dir).filePath(m_sessionTag + kLockSuffix));
+  m_sessionLock->setStaleLockTime(0);
+  if (!m_sessionLock->tryLock(0)) {
+    emit journalError("Cannot lock journal session " + m_sessionTag);
+    m_sessionLock.reset();
+    return false;
+  }
+  m_segmentIndex = 0;
+  m_nextSeq = 1;
+  if (!openSegment())
+    return false;
+  m_syncTimer->start();
+  return true;
+}
+
+void AcquisitionJournal::closeSession() {
+  m_syncTimer->stop();
+  finishSegment();
+  m_sessionLock.reset();
+}
+
+bool AcquisitionJournal::openSegment() {
+  QString name = QString("%1_%2%3")
+                     .arg(m_sessionTag)
+                     .arg(m_segmentIndex, 4, 10, QChar('0'))
+                     .arg(kSegmentSuffix);
+  m_file.setFileName(QDir(m_dir).filePath(name));
+  if (!m_file.open(QIODevice::ReadWrite) || !m_file.resize(kSegmentSize)) {
+    emit journalError("Cannot create journal segment: " +
+                      m_file.errorString());
+    m_file.close();
+    return false;
+  }
+
+  m_map = m_file.map(0, kSegmentSize);
+  if (!m_map) {
+    emit journalError("Cannot map journal segment: " + m_file.errorString());
+    m_file.close();
+    return false;
+  }
+  m_capacity = kSegmentSize;
+
+  SegmentHeader sh{};
+  memcpy(sh.magic, kSegmentMagic, sizeof(kSegmentMagic));
+  sh.version = 1;
+  sh.segmentIndex = m_segmentIndex;
+  sh.sessionStartMs = m_sessionStartMs;
+  memcpy(m_map, &sh, sizeof(sh));
+  m_used = sizeof(SegmentHeader);
+  return true;
+}
+
+void AcquisitionJournal::finishSegment() {
+  if (!m_map)
+    return;
+  syncToDisk();
+  m_file.unmap(m_map);
+  m_map = nullptr;
+  // Drop the unused preallocated tail
+  m_file.resize(m_used);
+  m_file.close();
+  m_capacity = 0;
+  m_used = 0;
+}
+
+bool AcquisitionJournal::appendRecord(RecordType type, const char *data,
+                                      quint32 len) {
+  const qint64 needed = alignUp8(sizeof(RecordHeader) + len);
+  if (m_map && m_used + needed > m_capacity) {
+    finishSegment();
+    ++m_segmentIndex;
+    if (!openSegment())
+      return false;
+  }
+  if (!m_map || m_used + needed > m_capacity)
+    return false;
+
+  RecordHeader h;
+  h.magic = 0; // written last
+  h.type = type;
+  h.length = len;
+  h.seq = type == FrameRecord ? m_nextSeq++ : 0;
+  h.timestampMs = QDateTime::currentMSecsSinceEpoch();
+
+  uchar *dst = m_map + m_used;
+  memcpy(dst + sizeof(RecordHeader), data, len);
+  h.crc = recordCrc(h, dst + sizeof(RecordHeader));
+  memcpy(dst, &h, sizeof(h));
+  // Publish the record only once the payload and header are in place
+  memcpy(dst, &kRecordMagic, sizeof(kRecordMagic));
+
+  m_used += needed;
+  m_dirty = true;
+  return true;
+}
+
+qint64 AcquisitionJournal::appendFrame(const QByteArray &frame) {
+  const qint64 seq = m_nextSeq;
+  if (!appendRecord(FrameRecord, frame.constData(), frame.size()))
+    return -1;
+  return seq;
+}
+
+void AcquisitionJournal::markSaved(qint64 seq) {
+  if (seq <= 0)
+    return;
+  appendRecord(SavedRecord, reinterpret_cast<const char *>(&seq),
+               sizeof(seq));
+}
+
+void AcquisitionJournal::syncToDisk() {
+  if (!m_map || !m_dirty)
+    return;
+#if defined(Q_OS_WIN)
+  FlushViewOfFile(m_map, static_cast<SIZE_T>(m_used));
+#elif defined(Q_OS_UNIX)
+  msync(m_map, static_cast<size_t>(m_used), MS_ASYNC);
+#endif
+  m_dirty = false;
+}
+
+QStringList AcquisitionJournal::staleSegments() const {
+  QStringList result;
+  const QFileInfoList files =
+      QDir(m_dir).entryInfoList({QString("*") + kSegmentSuffix}, QDir::Files,
+                                QDir::Name);
+  QHash<QString, bool> live; // session tag -> its lock is held
+  for (const QFileInfo &fi : files) {
+    // <session tag>_<segment index>.temj
+    const QString name = fi.fileName();
+    const QString tag = name.left(name.lastIndexOf('_'));
+    if (tag == m_sessionTag)
+      continue;
+    auto it = live.find(tag);
+    if (it == live.end()) {
+      // Taking the lock (and dropping it again) only works if no running
+      // process holds it; a dead process's lock is removed as stale
+      QLockFile lock(QDir(m_dir).filePath(tag + kLockSuffix));
+      lock.setStaleLockTime(0);
+      it = live.insert(tag, !lock.tryLock(0));
+    }
+    if (!it.value())
+      result.append(fi.absoluteFilePath());
+  }
+  return result;
+}
+
+QList<AcquisitionJournal::RecoveredFrame>
+AcquisitionJournal::scanUnsaved(const QStringList &segments) {
+  QList<RecoveredFrame> frames;
+  // Sequence numbers are per session, and a frame's SavedRecord may land
+  // in a later segment of the same session.
+  QSet<QPair<qint64, qint64>> saved;
+
+  for (const QString &path : segments) {
+    qint64 session = 0;
+    scanSegment(path, &session,
+                [&](const RecordHeader &h, const uchar *payload) {
+                  if (h.type == FrameRecord) {
+                    RecoveredFrame f;
+                    f.segment = path;
+                    f.sessionStartMs = session;
+                    f.seq = h.seq;
+                    f.receivedMs = h.timestampMs;
+                    f.frame = QByteArray(
+                        reinterpret_cast<const char *>(payload), h.length);
+                    frames.append(f);
+                  } else if (h.type == SavedRecord &&
+                             h.length == sizeof(qint64)) {
+                    qint64 seq;
+                    memcpy(&seq, payload, sizeof(seq));
+                    saved.insert(qMakePair(session, seq));
+                  }
+                });
+  }
+
+  QList<RecoveredFrame> unsaved;
+  for (const RecoveredFrame &f : std::as_const(frames)) {
+    if (!saved.contains(qMakePair(f.sessionStartMs, f.seq)))
+      unsaved.append(f);
+  }
+  return unsaved;
+}
+
+void AcquisitionJournal::compactInBackground(const QStringList &segments) {
+  if (segments.isEmpty())
+    return;
+
+  const QString archivePath = QDir(m_dir).filePath("journal_archive.db");
+  QPointer<AcquisitionJournal> self(this);
+
+  (void)QtConcurrent::run([segments, archivePath, self]() {
+    const QString conn =
+        QString("journalCompact_%1")
+            .arg(reinterpret_cast<quintptr>(QThread::currentThreadId()));
+
+    // First pass: which frames made it into a project DB
+    QSet<QPair<qint64, qint64>> saved;
+    for (const QString &path : segments) {
+      qint64 session = 0;
+      scanSegment(path, &session,
+                  [&](const RecordHeader &h, const uchar *payload) {
+                    if (h.type == SavedRecord && h.length == sizeof(qint64)) {
+                      qint64 seq;
+                      memcpy(&seq, payload, sizeof(seq));
+                      saved.insert(qMakePair(session, seq));
+                    }
+                  });
+    }
+
+    bool ok = true;
+    {
+      QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", conn);
+      db.setDatabaseName(archivePath);
+      ok = db.open();
+      QSqlQuery q(db);
+      if (ok) {
+        q.exec("PRAGMA journal_mode = WAL");
+        ok = q.exec("CREATE TABLE IF NOT EXISTS Journal_Frame ("
+                    "ID INTEGER PRIMARY KEY AUTOINCREMENT, "
+                    "SessionStart INTEGER, "
+                    "Seq INTEGER, "
+                    "ReceivedTime INTEGER, "
+                    "Saved INTEGER, "
+                    "Frame BLOB"
+                    ")");
+        ok = ok && q.prepare("INSERT INTO Journal_Frame (SessionStart, Seq, "
+                             "ReceivedTime, Saved, Frame) "
+                             "VALUES (?, ?, ?, ?, ?)");
+      }
+
+      // Second pass: one transaction per segment, delete once committed
+      for (const QString &path : segments) {
+        if (!ok)
+          break;
+        db.transaction();
+        qint64 session = 0;
+        scanSegment(path, &session,
+                    [&](const RecordHeader &h, const uchar *payload) {
+                      if (!ok || h.type != FrameRecord)
+                        return;
+                      q.addBindValue(session);
+                      q.addBindValue(h.seq);
+                      q.addBindValue(h.timestampMs);
+                      q.addBindValue(
+                          saved.contains(qMakePair(session, h.seq)) ? 1 : 0);
+                      q.addBindValue(QByteArray(
+                          reinterpret_cast<const char *>(payload), h.length));
+                      ok = q.exec();
+                    });
+        if (ok && db.commit()) {
+          QFile::remove(path);
+        } else {
+          qDebug() << "Journal compaction failed:" << q.lastError();
+          db.rollback();
+          ok = false;
+        }
+      }
+      db.close();
+    }
+    QSqlDatabase::removeDatabase(conn);
+
+    const int count = segments.size();
+    QMetaObject::invokeMethod(
+        qApp,
+        [self, count, ok]() {
+          if (self)
+            emit self->compactionFinished(count, ok);
+        },
+        Qt::QueuedConnection);
+  });
+}
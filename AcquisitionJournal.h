@@ -0,0 +1,83 @@
+#ifndef ACQUISITIONJOURNAL_H
+#define ACQUISITIONJOURNAL_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QList>
+#include <QLockFile>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QTimer>
+#include <memory>
+
+// Append-only, memory-mapped journal of every raw frame received from the
+// device. One session writes a series of fixed-size segment files; each
+// record is CRC-checked so a crash leaves at worst a torn tail record.
+// A running session holds a lock file, so other processes sharing the
+// journal directory leave its segments alone.
+class AcquisitionJournal : public QObject {
+  Q_OBJECT
+public:
+  enum RecordType : quint32 { FrameRecord = 1, SavedRecord = 2 };
+
+  struct RecoveredFrame {
+    QString segment;
+    qint64 sessionStartMs = 0;
+    qint64 seq = 0;
+    qint64 receivedMs = 0;
+    QByteArray frame;
+  };
+
+  explicit AcquisitionJournal(const QString &journalDir,
+                              QObject *parent = nullptr);
+  ~AcquisitionJournal();
+
+  QString journalDir() const { return m_dir; }
+
+  // Opens the first segment of a new session. Segments left over from
+  // earlier sessions are untouched until recovered or compacted.
+  bool startSession();
+  void closeSession();
+
+  // Returns the frame's sequence number, or -1 if the journal is not open
+  qint64 appendFrame(const QByteArray &frame);
+  // Marks a frame as persisted in the project DB
+  void markSaved(qint64 seq);
+
+  // Segments of sessions no process is running (their lock is free)
+  QStringList staleSegments() const;
+
+  // Scan segments and return frames with no matching SavedRecord
+  static QList<RecoveredFrame> scanUnsaved(const QStringList &segments);
+
+  // Move segments into the SQLite archive next to the journal, then delete
+  // them. Runs on a worker thread; emits compactionFinished when done.
+  void compactInBackground(const QStringList &segments);
+
+signals:
+  void compactionFinished(int segmentCount, bool ok);
+  void journalError(const QString &errorStr);
+
+private:
+  bool openSegment();
+  void finishSegment();
+  bool appendRecord(RecordType type, const char *data, quint32 len);
+  void syncToDisk();
+
+  QString m_dir;
+  QString m_sessionTag;
+  std::unique_ptr<QLockFile> m_sessionLock;
+  qint64 m_sessionStartMs = 0;
+  int m_segmentIndex = 0;
+
+  QFile m_file;
+  uchar *m_map = nullptr;
+  qint64 m_capacity = 0;
+  qint64 m_used = 0;
+  qint64 m_nextSeq = 1;
+  bool m_dirty = false;
+  QTimer *m_syncTimer;
+};
+
+#endif // ACQUISITIONJOURNAL_H
@@ -0,0 +1,344 @@
+#include "AcquisitionPipeline.h"
+#include "DatabaseManager.h"
+#include "Metrics.h"
+#include "WaveformCodec.h"
+#include <QDateTime>
+#include <QDebug>
+#include <QJsonDocument>
+#include <cctype>
+
+namespace {
+
+Metrics::Counter &framesMetric = Metrics::counter(
+    "tem_acq_frames_total", "Non-empty lines received from the device");
+Metrics::Counter &samplesMetric = Metrics::counter(
+    "tem_acq_samples_total", "Frames carrying waveforms");
+Metrics::Counter &previewsMetric = Metrics::counter(
+    "tem_acq_previews_total", "Sample frames that were decimated previews");
+Metrics::Counter &rejectedMetric = Metrics::counter(
+    "tem_acq_rejected_total", "Lines that were not JSON objects");
+Metrics::Gauge &bufferBytes = Metrics::gauge(
+    "tem_acq_buffer_bytes", "Received bytes waiting for a newline");
+Metrics::Histogram &parseLatency = Metrics::histogram(
+    "tem_acq_parse_seconds", "JSON scan or parse time per frame", 1e-9);
+Metrics::Histogram &decodeLatency = Metrics::histogram(
+    "tem_acq_decode_seconds",
+    "base64 and big-endian decode time per sample frame", 1e-9);
+Metrics::Histogram &journalLatency = Metrics::histogram(
+    "tem_acq_journal_seconds", "Journal append time per sample frame", 1e-9);
+Metrics::Counter &sampleSlotMisses = Metrics::counter(
+    "tem_pool_sample_allocations_total",
+    "Pooled samples added because every one was still referenced");
+Metrics::Counter &columnBufferMisses = Metrics::counter(
+    "tem_pool_column_allocations_total",
+    "Pooled column buffers added because every one was still queued");
+
+// A sample frame is one that carries the primary (gated receive) channel
+const char *sampleKey() {
+  return ChannelRegistry::channel(ChannelRegistry::Recv).wireField;
+}
+
+} // namespace
+
+AcquisitionPipeline::AcquisitionPipeline(const QString &journalDir,
+                                         QObject *parent)
+    : QObject(parent), m_tcp(new TcpClient(this)),
+      m_statusTimer(new QTimer(this)),
+      m_journal(new AcquisitionJournal(journalDir, this)),
+      m_samples(&sampleSlotMisses), m_columnBuffers(&columnBufferMisses) {
+  connect(m_tcp, &TcpClient::stateChanged, this,
+          [this](TcpClient::ConnectionState s) {
+            if (s == TcpClient::Connected)
+              resetBuffer();
+            emit stateChanged(s);
+          });
+  connect(m_tcp, &TcpClient::dataReceived, this, &AcquisitionPipeline::ingest);
+  connect(m_tcp, &TcpClient::errorOccurred, this,
+          &AcquisitionPipeline::errorOccurred);
+  connect(m_statusTimer, &QTimer::timeout, this,
+          &AcquisitionPipeline::requestStatus);
+  // A frame counts as saved once its row is committed, not when queued
+  connect(&DatabaseManager::instance(),
+          &DatabaseManager::journalFramesSaved, this,
+          [this](const QList<qint64> &seqs) {
+            for (qint64 seq : seqs) {
+              if (seq >= 0)
+                m_journal->markSaved(seq);
+            }
+          });
+
+  // Journal every raw frame of this session; remember what earlier sessions
+  // left behind before the new one adds its own segments
+  m_staleSegments = m_journal->staleSegments();
+  m_journal->startSession();
+}
+
+void AcquisitionPipeline::connectDevice(const QString &host, quint16 port) {
+  m_tcp->connectToServer(host, port);
+}
+
+void AcquisitionPipeline::disconnectDevice() {
+  m_tcp->disconnectFromServer();
+}
+
+void AcquisitionPipeline::setStatusInterval(int intervalMs) {
+  if (intervalMs > 0)
+    m_statusTimer->start(intervalMs);
+  else
+    m_statusTimer->stop();
+}
+
+void AcquisitionPipeline::setRecordLength(int values) {
+  m_recordLength = qMax(0, values);
+  m_floatScratch.reserve(m_recordLength);
+}
+
+bool AcquisitionPipeline::startCollect() {
+  // A partial frame from an aborted collect must not prefix the next one
+  resetBuffer();
+  return m_tcp->sendData("START_COLLECT\n");
+}
+
+bool AcquisitionPipeline::nextPoint() {
+  return m_tcp->sendData("NEXT_POINT\n");
+}
+
+bool AcquisitionPipeline::requestStatus() {
+  return m_tcp->sendData("GET_STATUS\n");
+}
+
+bool AcquisitionPipeline::sendParams(const QVariantMap &params) {
+  if (params.contains("sample_time"))
+    setRecordLength(params.value("sample_time").toInt());
+  if (params.contains("transfer")) {
+    const QString mode = params.value("transfer").toString();
+    m_transferMode = mode == "preview"     ? PreviewTransfer
+                     : mode == "on_demand" ? OnDemandTransfer
+                                           : FullTransfer;
+  }
+  const QByteArray json =
+      QJsonDocument::fromVariant(params).toJson(QJsonDocument::Compact);
+  return m_tcp->sendData("SET_PARAMS:" + json + "\n");
+}
+
+bool AcquisitionPipeline::requestFullFrame(int frameId) {
+  return m_tcp->sendData("GET_FRAME:" + QByteArray::number(frameId) + "\n");
+}
+
+void AcquisitionPipeline::resetBuffer() {
+  // resize() rather than clear(): the capacity stays for the next stream
+  m_buffer.resize(0);
+  ++m_bufferGeneration;
+}
+
+void AcquisitionPipeline::ingest(const QByteArray &data) {
+  m_counters.bytes += data.size();
+  m_buffer.append(data);
+
+  // Frames are views into m_buffer; the consumed prefix goes in one step
+  const quint64 generation = m_bufferGeneration;
+  const char *base = m_buffer.constData();
+  qsizetype start = 0;
+  qsizetype newlineIdx;
+  while ((newlineIdx = m_buffer.indexOf('\n', start)) != -1) {
+    qsizetype begin = start;
+    qsizetype end = newlineIdx;
+    start = newlineIdx + 1;
+    while (begin < end && isspace(uchar(base[begin])))
+      ++begin;
+    while (end > begin && isspace(uchar(base[end - 1])))
+      --end;
+    if (begin == end)
+      continue;
+    onFrame(QByteArray::fromRawData(base + begin, end - begin));
+    // A handler restarted the collect; what is left belongs to the old one
+    if (generation != m_bufferGeneration) {
+      bufferBytes.set(0);
+      return;
+    }
+  }
+  m_buffer.remove(0, start);
+  bufferBytes.set(m_buffer.size());
+}
+
+void AcquisitionPipeline::onFrame(const QByteArray &frame) {
+  ++m_counters.frames;
+  framesMetric.add();
+  bool scanned;
+  {
+    Metrics::ScopedTimer t(parseLatency);
+    scanned = m_scanner.scan(frame);
+  }
+  if (scanned && m_scanner.contains(sampleKey())) {
+    onSampleFrame(frame);
+    return;
+  }
+
+  // Status, acks, and anything the scanner does not take
+  QJsonDocument doc;
+  {
+    Metrics::ScopedTimer t(parseLatency);
+    doc = QJsonDocument::fromJson(frame);
+  }
+  if (!doc.isObject()) {
+    ++m_counters.rejected;
+    rejectedMetric.add();
+    return;
+  }
+  const QJsonObject obj = doc.object();
+
+  // GET_STATUS response
+  if (obj.contains("status") && obj["status"].toString() == "connected") {
+    emit statusReceived(obj["battery_voltage"].toDouble(),
+                        obj["temperature"].toDouble());
+    return;
+  }
+  if (!obj.contains(QLatin1String(sampleKey()))) {
+    emit replyReceived(obj);
+    return;
+  }
+
+  // Journal first: the raw frame survives even if we crash below. A
+  // preview is not worth recovering; its full frame is.
+  Sample &sample = m_samples.acquire();
+  const bool preview = obj.value("PREVIEW").toVariant().toBool();
+  {
+    Metrics::ScopedTimer t(journalLatency);
+    sample.journalSeq = preview ? -1 : m_journal->appendFrame(frame);
+  }
+  {
+    Metrics::ScopedTimer t(decodeLatency);
+    parseChannels(obj, sample);
+  }
+  countSample(sample);
+  emit sampleReceived(sample);
+}
+
+void AcquisitionPipeline::onSampleFrame(const QByteArray &frame) {
+  const Sample &last = m_samples.current();
+  // A frame without a rate keeps the one the device sent before; a
+  // preview's rates are those of its decimated values
+  ChannelArray<int> lastRates;
+  if (!last.preview)
+    lastRates = last.rates;
+  const bool preview = m_scanner.toVariant("PREVIEW").toBool();
+  Sample &s = m_samples.acquire();
+  {
+    Metrics::ScopedTimer t(journalLatency);
+    s.journalSeq = preview ? -1 : m_journal->appendFrame(frame);
+  }
+  {
+    Metrics::ScopedTimer t(decodeLatency);
+    const FrameScanner &f = m_scanner;
+    const QVector<ChannelRegistry::Channel> &registry =
+        ChannelRegistry::channels();
+    s.channels.resize(registry.size());
+    s.rates.resize(registry.size());
+    s.pointId = f.toInt("Data_PointID", 0);
+    s.frameId = f.toInt("ID", -1);
+    s.preview = preview;
+    for (int i = 0; i < registry.size(); ++i) {
+      const ChannelRegistry::Channel &c = registry[i];
+      // Slots are sized once, when they first join the pool
+      if (s.channels[i].capacity() < m_recordLength)
+        s.channels[i].reserve(m_recordLength);
+      FrameScanner::decodeChannel(f.value(c.wireField), c, s.channels[i]);
+      const int fallback =
+          i < lastRates.size() && lastRates[i] > 0 ? lastRates[i]
+                                                   : c.defaultRate;
+      s.rates[i] = c.rateField ? qMax(1, f.toInt(c.rateField, fallback)) : 0;
+    }
+    s.sendFs = qMax(1, f.toInt("SendFs", 25));
+
+    // Same values as frameMeta(); existing keys are overwritten in place
+    s.meta.insert(QStringLiteral("DeviceType"), f.toInt("DeviceType", 1));
+    s.meta.insert(QStringLiteral("PERIOD"), f.toInt("PERIOD", 500));
+    s.meta.insert(QStringLiteral("RecvFs"), f.toDouble("RecvFs", 625000.0));
+    s.meta.insert(QStringLiteral("SendFs"), f.toDouble("SendFs", 25.0));
+    s.meta.insert(QStringLiteral("StartTime"),
+                  f.contains("StartTime")
+                      ? f.toVariant("StartTime")
+                      : QVariant(QDateTime::currentMSecsSinceEpoch()));
+  }
+  countSample(s);
+  emit sampleReceived(s);
+}
+
+void AcquisitionPipeline::countSample(const Sample &sample) {
+  ++m_counters.samples;
+  samplesMetric.add();
+  if (sample.preview) {
+    ++m_counters.previews;
+    previewsMetric.add();
+  }
+}
+
+bool AcquisitionPipeline::persist(const Sample &sample,
+                                  const QVariantMap &meta) {
+  return persist(sample, meta, sample.pointId);
+}
+
+bool AcquisitionPipeline::persist(const Sample &sample, const QVariantMap &meta,
+                                  int pointId) {
+  if (sample.preview) {
+    qWarning() << "AcquisitionPipeline: not saving preview of frame"
+               << sample.frameId;
+    return false;
+  }
+  const QStringList &names = ChannelRegistry::columns();
+  ChannelArray<QVariant> columns(names.size());
+  for (int i = 0; i < names.size(); ++i)
+    columns[i] = encodeColumn(sample.channel(i), names[i]);
+  const bool ok = DatabaseManager::instance().saveSample(
+      pointId, meta, columns, sample.rates, sample.journalSeq);
+  if (ok)
+    ++m_counters.saved;
+  return ok;
+}
+
+QVariant AcquisitionPipeline::encodeColumn(const QVector<double> &data,
+                                          const QString &column) {
+  // Storage format: float32, in the codec configured for the column. The
+  // encoded bytes stay shared with the writer until it has committed them.
+  m_floatScratch.resize(data.size());
+  float *f = m_floatScratch.data();
+  for (int i = 0; i < data.size(); ++i)
+    f[i] = static_cast<float>(data[i]);
+  return WaveformCodec::encode(f, data.size(),
+                               DatabaseManager::instance().columnCodec(column),
+                               m_columnBuffers.acquire());
+}
+
+void AcquisitionPipeline::parseChannels(const QJsonObject &obj, Sample &out) {
+  const QVector<ChannelRegistry::Channel> &registry =
+      ChannelRegistry::channels();
+  out.pointId = obj["Data_PointID"].toInt();
+  out.frameId = obj.value("ID").toInt(-1);
+  out.preview = obj.value("PREVIEW").toVariant().toBool();
+  out.channels.resize(registry.size());
+  out.rates.resize(registry.size());
+  for (int i = 0; i < registry.size(); ++i) {
+    const ChannelRegistry::Channel &c = registry[i];
+    FrameScanner::decodeChannel(
+        obj.value(QLatin1String(c.wireField)).toString().toLatin1(), c,
+        out.channels[i]);
+    out.rates[i] = c.rateField ? qMax(1, obj.value(QLatin1String(c.rateField))
+                                             .toInt(c.defaultRate))
+                               : 0;
+  }
+  out.sendFs = qMax(1, obj.value("SendFs").toInt(25));
+  out.meta = frameMeta(obj, QDateTime::currentMSecsSinceEpoch());
+}
+
+QVariantMap AcquisitionPipeline::frameMeta(const QJsonObject &obj,
+                                           qint64 fallbackStartMs) {
+  QVariantMap meta;
+  meta["DeviceType"] = obj.value("DeviceType").toInt(1);
+  meta["PERIOD"] = obj.value("PERIOD").toInt(500);
+  meta["RecvFs"] = obj.value("RecvFs").toDouble(625000.0);
+  meta["SendFs"] = obj.value("SendFs").toDouble(25.0);
+  meta["StartTime"] = obj.contains("StartTime")
+                          ? obj.value("StartTime").toVariant()
+                          : QVariant(fallbackStartMs);
+  return meta;
+}
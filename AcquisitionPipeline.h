@@ -0,0 +1,176 @@
+#ifndef ACQUISITIONPIPELINE_H
+#define ACQUISITIONPIPELINE_H
+
+#include "AcquisitionJournal.h"
+#include "BufferRing.h"
+#include "ChannelRegistry.h"
+#include "FrameScanner.h"
+#include "TcpClient.h"
+#include <QJsonObject>
+#include <QObject>
+#include <QStringList>
+#include <QTimer>
+#include <QVariantMap>
+#include <QVector>
+
+// Device link, frame parsing and persistence, free of any UI.
+//
+// Owns the TCP connection to the receiver, splits the byte stream into
+// newline-delimited JSON frames, journals every sample frame before
+// decoding it, and queues samples on DatabaseManager's writer. Backend
+// puts the QML surface on top; the headless runner drives it directly.
+//
+// Steady-state ingest allocates nothing: frames are cut and scanned in the
+// receive buffer, channels decode into pooled Samples, and columns encode
+// into pooled buffers. Pooled storage is shared with whoever keeps a copy
+// and reused once they let go (see BufferRing).
+//
+// With "transfer" set to "preview" or "on_demand" in SET_PARAMS, the
+// device sends each frame first as a preview ("PREVIEW":1): gated channels
+// whole, evenly sampled ones min/max-decimated, with their rate fields
+// scaled to match. The full frame, with the same ID, follows once the
+// previews are out ("preview"), or on GET_FRAME:<id> ("on_demand").
+// Previews are shown but never journaled or saved.
+class AcquisitionPipeline : public QObject {
+  Q_OBJECT
+public:
+  struct Sample {
+    int pointId = 0; // Data_PointID as sent by the device
+    // Values of each ChannelRegistry row, in registry order; empty when
+    // the frame did not carry the channel
+    ChannelArray<QVector<double>> channels;
+    // Values per second of each channel; 0 for per-gate channels
+    ChannelArray<int> rates;
+    int sendFs = 25; // base frequency (SendFs)
+    QVariantMap meta; // Data_Sample columns carried by the frame
+    qint64 journalSeq = -1;
+    int frameId = -1;     // device's ID; a preview and its full frame share it
+    bool preview = false; // decimated; see requestFullFrame()
+
+    const QVector<double> &channel(int index) const {
+      static const QVector<double> empty;
+      return index >= 0 && index < channels.size() ? channels[index] : empty;
+    }
+    int rate(int index) const {
+      return index >= 0 && index < rates.size() ? rates[index] : 0;
+    }
+
+    // For BufferRing: no copy of this sample is alive anywhere else
+    qsizetype capacity() const {
+      qsizetype total = 0;
+      for (const QVector<double> &c : channels)
+        total += c.capacity();
+      return total;
+    }
+    bool isDetached() const {
+      for (const QVector<double> &c : channels) {
+        if (!BufferRing<QVector<double>>::isFree(c))
+          return false;
+      }
+      return meta.isEmpty() || meta.isDetached();
+    }
+  };
+
+  enum TransferMode { FullTransfer, PreviewTransfer, OnDemandTransfer };
+
+  struct Counters {
+    qint64 bytes = 0;
+    qint64 frames = 0;   // non-empty lines
+    qint64 samples = 0;  // frames carrying waveforms
+    qint64 rejected = 0; // lines that were not JSON objects
+    qint64 previews = 0; // samples that were previews
+    qint64 saved = 0;
+  };
+
+  explicit AcquisitionPipeline(const QString &journalDir,
+                               QObject *parent = nullptr);
+
+  TcpClient::ConnectionState state() const { return m_tcp->state(); }
+  AcquisitionJournal *journal() const { return m_journal; }
+  // Segments left by an earlier session, found before this one started
+  QStringList staleSegments() const { return m_staleSegments; }
+  const Sample &latestSample() const { return m_samples.current(); }
+  const Counters &counters() const { return m_counters; }
+
+  void connectDevice(const QString &host, quint16 port = 8888);
+  void disconnectDevice();
+  // Capture the raw session to a file, or play one back instead of a
+  // device (speed 0 = as fast as possible); see SessionRecording
+  bool startRecording(const QString &path, QString *error = nullptr) {
+    return m_tcp->startRecording(path, error);
+  }
+  void stopRecording() { m_tcp->stopRecording(); }
+  bool isRecording() const { return m_tcp->isRecording(); }
+  bool startReplay(const QString &path, double speed,
+                   QString *error = nullptr) {
+    return m_tcp->startReplay(path, speed, error);
+  }
+  bool isReplaying() const { return m_tcp->isReplaying(); }
+
+  // GET_STATUS every intervalMs while connected; 0 stops polling
+  void setStatusInterval(int intervalMs);
+
+  // Values per channel the device was asked for; pooled channel buffers
+  // are sized for it up front instead of growing on the first frames
+  void setRecordLength(int values);
+
+  // As last sent in SET_PARAMS ("transfer")
+  TransferMode transferMode() const { return m_transferMode; }
+
+  // Bytes as read from the device. TcpClient feeds this; tools and
+  // benchmarks may feed captured streams directly.
+  void ingest(const QByteArray &data);
+
+  // Device commands; false when not connected
+  bool startCollect();
+  bool nextPoint();
+  bool requestStatus();
+  bool sendParams(const QVariantMap &params);
+  // Full-resolution frame of a preview; the device sends it as a sample
+  // frame with the same ID, or replies {"error": "frame_unavailable"}
+  bool requestFullFrame(int frameId);
+
+  // Every registry channel as float32 in its column's codec, with its
+  // rate, queued on the writer.
+  // A journaled sample is marked saved once its row is committed. Previews
+  // are refused.
+  bool persist(const Sample &sample, const QVariantMap &meta);
+  bool persist(const Sample &sample, const QVariantMap &meta, int pointId);
+
+  // Registry channels and rates of a frame parsed by QJsonDocument
+  static void parseChannels(const QJsonObject &obj, Sample &out);
+  // DeviceType, PERIOD, RecvFs, SendFs and StartTime of a frame
+  static QVariantMap frameMeta(const QJsonObject &obj, qint64 fallbackStartMs);
+
+signals:
+  void stateChanged(TcpClient::ConnectionState newState);
+  void statusReceived(double batteryVoltage, double temperature);
+  void sampleReceived(const AcquisitionPipeline::Sample &sample);
+  // Any other JSON object from the device (acks, errors)
+  void replyReceived(const QJsonObject &reply);
+  void errorOccurred(const QString &errorMsg);
+
+private:
+  void onFrame(const QByteArray &frame);
+  void onSampleFrame(const QByteArray &frame);
+  void countSample(const Sample &sample);
+  // Drop unframed bytes; also ends an ingest() loop that is under way
+  void resetBuffer();
+  QVariant encodeColumn(const QVector<double> &data, const QString &column);
+
+  TcpClient *m_tcp;
+  QTimer *m_statusTimer;
+  AcquisitionJournal *m_journal;
+  QStringList m_staleSegments;
+  QByteArray m_buffer;
+  quint64 m_bufferGeneration = 0;
+  int m_recordLength = 0; // values per channel, from SET_PARAMS
+  TransferMode m_transferMode = FullTransfer;
+  FrameScanner m_scanner;
+  BufferRing<Sample> m_samples;
+  BufferRing<QByteArray> m_columnBuffers;
+  QVector<float> m_floatScratch;
+  Counters m_counters;
+};
+
+#endif // ACQUISITIONPIPELINE_H
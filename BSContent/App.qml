@@ -24,6 +24,33 @@ Window {
         buttons: MessageDialog.Ok
     }
     
+    // Offered when the acquisition journal holds frames a previous session
+    // never saved (crash or power loss in the field)
+    MessageDialog {
+        id: recoveryDialog
+        title: "Recover Unsaved Frames"
+        text: "Unsaved acquisition frames were found in the journal."
+        buttons: MessageDialog.Yes | MessageDialog.No
+        onButtonClicked: function (button, role) {
+            if (button === MessageDialog.Yes)
+                activeBackend.importRecoveredFrames()
+            else
+                activeBackend.discardRecoveredFrames()
+        }
+    }
+
+    Connections {
+        target: activeBackend
+        ignoreUnknownSignals: true
+        function onRecoveryChanged() {
+            if (activeBackend.recoverableFrames > 0) {
+                recoveryDialog.informativeText = activeBackend.recoverableFrames
+                        + " frame(s) can be imported into the current project database."
+                recoveryDialog.open()
+            }
+        }
+    }
+
     // Dialog for creating a new SQLite project database
     FileDialog {
         id: newProjectDialog
@@ -80,6 +107,19 @@ Window {
         }
     }
 
+    // Folder holding legacy table dumps (Data_Line.json, Data_Sample.json, ...)
+    FolderDialog {
+        id: importDumpDialog
+        title: "Import JSON Table Dumps"
+        onAccepted: {
+            if (!activeBackend.importJsonDump(selectedFolder)) {
+                msgDialog.text = "Error"
+                msgDialog.informativeText = "An import is already running."
+                msgDialog.open()
+            }
+        }
+    }
+
     ScrollView {
         anchors.fill: parent
         contentWidth: 1920
@@ -98,6 +138,12 @@ Window {
             // Bind the New/Open buttons from Screen01.ui.qml to the Dialogs
             btnNewProject.onClicked: newProjectDialog.open()
             btnOpenProject.onClicked: openProjectDialog.open()
+            btnImportDump.onClicked: {
+                if (activeBackend.isImporting)
+                    activeBackend.cancelImport()
+                else
+                    importDumpDialog.open()
+            }
             
             onOpenPlaybackWindow: {
                 var component = Qt.createComponent("PlaybackWindow.qml");
@@ -148,4 +194,18 @@ Window {
             }
         }
     }
+
+    // Throughput and latency overlay, above the scrolled screen
+    PerfHud {
+        anchors.top: parent.top
+        anchors.right: parent.right
+        anchors.margins: 12
+        z: 100
+        backend: activeBackend
+    }
+
+    Shortcut {
+        sequence: "F12"
+        onActivated: activeBackend.perfHudVisible = !activeBackend.perfHudVisible
+    }
 }
@@ -11,11 +11,25 @@ QtObject {
     property bool isAcquiring: false
     property string currentPoint: "P004"
     property int progressPercent: 0
+
+    // Survey sequencer (the real backend walks the project's points)
+    property bool autoAdvance: false
+    property bool isSurveyPaused: false
+    property var surveyStats: ({})
+
+    // Wi-Fi transfer: "full", "preview" or "on_demand"
+    property string transferMode: "full"
     
     // Mock Project Management
     property string currentProjectName: "Mock Project"
     property string currentDbPath: "C:/fake/path.sqlite"
-    property var projectTreeModel: []
+    property var projectTreeModel: null
+    property bool isImporting: false
+    property real importProgress: 0.0
+
+    // Performance HUD (the real backend fills perfStats from its metrics)
+    property bool perfHudVisible: false
+    property var perfStats: ({})
 
     // Invokable Methods
     function createProjectDB(fileUrl) {
@@ -32,6 +46,13 @@ QtObject {
         return true
     }
 
+    function importJsonDump(folderUrl) {
+        console.log("Mock import JSON dump from:", folderUrl)
+        return true
+    }
+
+    function cancelImport() {}
+
     property real batteryVoltage: 12.4
     property real internalTemp: 42.8
     property real signalStrength: -68.0
@@ -89,6 +110,12 @@ QtObject {
         console.log("Skipped to next point: P005");
     }
 
+    function retryPoint() {
+        isAcquiring = false;
+        simTimer.stop();
+        startAcquisition();
+    }
+
     // internal simulation timer
     property Timer _timer: Timer {
         id: simTimer
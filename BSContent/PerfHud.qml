@@ -0,0 +1,71 @@
+import QtQuick 6.5
+
+// Live throughput and latency overlay (toggle with F12).
+// Reads backend.perfStats, the Metrics snapshot Backend refreshes once a
+// second while perfHudVisible is set.
+Rectangle {
+    id: hud
+
+    property var backend
+    readonly property var stats: backend && backend.perfStats ? backend.perfStats : ({})
+
+    visible: backend ? backend.perfHudVisible === true : false
+    width: 300
+    height: column.implicitHeight + 16
+    radius: 4
+    color: "#cc101418"
+    border.color: "#40ffffff"
+
+    function value(name) {
+        var v = stats[name]
+        return v === undefined ? 0 : v
+    }
+    function rate(name, scale, digits) {
+        return (value(name + "_per_s") / scale).toFixed(digits)
+    }
+    // Histogram quantile, exported in seconds, shown in ms
+    function ms(name, key) {
+        var h = stats[name]
+        return h ? (h[key] * 1000).toFixed(2) : "-"
+    }
+
+    Column {
+        id: column
+        x: 8
+        y: 8
+        spacing: 2
+
+        Repeater {
+            model: [
+                "TCP      " + hud.rate("tem_tcp_received_bytes_total", 1048576, 2) + " MiB/s, "
+                          + hud.rate("tem_tcp_reads_total", 1, 0) + " reads/s",
+                "Frames   " + hud.rate("tem_acq_frames_total", 1, 1) + "/s, "
+                          + hud.value("tem_acq_rejected_total") + " rejected",
+                "Parse    p50 " + hud.ms("tem_acq_parse_seconds", "p50")
+                          + "  p99 " + hud.ms("tem_acq_parse_seconds", "p99") + " ms",
+                "Decode   p50 " + hud.ms("tem_acq_decode_seconds", "p50")
+                          + "  p99 " + hud.ms("tem_acq_decode_seconds", "p99") + " ms",
+                "Preview  " + hud.rate("tem_ui_previews_total", 1, 1) + "/s, "
+                          + hud.rate("tem_ui_previews_dropped_total", 1, 1) + "/s dropped",
+                "Queue    " + hud.value("tem_db_queue_samples") + " sample(s), "
+                          + hud.value("tem_acq_buffer_bytes") + " B unframed",
+                "Insert   p50 " + hud.ms("tem_db_insert_seconds", "p50")
+                          + "  p99 " + hud.ms("tem_db_insert_seconds", "p99") + " ms",
+                "Commit   p99 " + hud.ms("tem_db_transaction_seconds", "p99") + " ms, "
+                          + (hud.stats["tem_db_transaction_rows"]
+                             ? hud.stats["tem_db_transaction_rows"].p50 : 0) + " rows p50",
+                "Survey   " + hud.rate("tem_survey_points_total", 1 / 3600, 0) + " points/h, "
+                          + "transition p50 " + hud.ms("tem_survey_transition_seconds", "p50") + " ms",
+                "Startup  first frame " + hud.value("tem_startup_first_frame_milliseconds") + " ms, "
+                          + "interactive " + hud.value("tem_startup_interactive_milliseconds") + " ms"
+            ]
+            delegate: Text {
+                required property string modelData
+                text: modelData
+                color: "#e0e0e0"
+                font.family: "monospace"
+                font.pixelSize: 12
+            }
+        }
+    }
+}
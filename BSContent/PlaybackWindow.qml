@@ -1,6 +1,7 @@
 import QtQuick
 import QtQuick.Controls
 import QtQuick.Layouts
+import QtQuick.Dialogs
 import QtCharts
 import TEM.System 1.0
 
@@ -92,6 +93,36 @@ Window {
                                         height: 30
                                         color: "#ECEFF1"
                                         Text { anchors.verticalCenter: parent.verticalCenter; anchors.left: parent.left; anchors.leftMargin: 5; text: "📁 " + modelData.name; font.pixelSize: f9 }
+                                        Row {
+                                            anchors.verticalCenter: parent.verticalCenter; anchors.right: parent.right; anchors.rightMargin: 8
+                                            spacing: 10
+                                            // Pseudo-section of the line
+                                            Text {
+                                                text: "▦"; font.pixelSize: f11; color: lineProfileMouse.containsMouse ? cBlue : cTextLt
+                                                MouseArea {
+                                                    id: lineProfileMouse
+                                                    anchors.fill: parent
+                                                    hoverEnabled: true
+                                                    onClicked: {
+                                                        playBackend.clearOverlay()
+                                                        playBackend.showLineProfile(modelData.id)
+                                                    }
+                                                }
+                                            }
+                                            // Overlay every point of the line
+                                            Text {
+                                                text: "⧉"; font.pixelSize: f11; color: lineOverlayMouse.containsMouse ? cBlue : cTextLt
+                                                MouseArea {
+                                                    id: lineOverlayMouse
+                                                    anchors.fill: parent
+                                                    hoverEnabled: true
+                                                    onClicked: {
+                                                        playBackend.closeLineProfile()
+                                                        playBackend.overlayLine(modelData.id)
+                                                    }
+                                                }
+                                            }
+                                        }
                                     }
                                     Repeater {
                                         model: modelData.points
@@ -104,9 +135,17 @@ Window {
                                                 id: ptMouse
                                                 anchors.fill: parent
                                                 hoverEnabled: true
+                                                acceptedButtons: Qt.LeftButton | Qt.RightButton
                                                 onDoubleClicked: {
                                                     playBackend.loadPointData(modelData.id)
                                                 }
+                                                // Right click: overlay the repeated shots of this point
+                                                onClicked: function(mouse) {
+                                                    if (mouse.button === Qt.RightButton) {
+                                                        playBackend.closeLineProfile()
+                                                        playBackend.overlayPointShots(modelData.id)
+                                                    }
+                                                }
                                             }
                                         }
                                     }
@@ -136,9 +175,81 @@ Window {
                         border.color: cBorder
                         border.width: 1
 
+                        // Line pseudo-section: points across, log-time gates down
+                        Rectangle {
+                            id: profileView
+                            anchors.fill: parent
+                            visible: playBackend.profileLineId >= 0
+                            color: "#FAFAFA"
+                            // Re-read whenever a new image is published
+                            property var axes: { playBackend.profileSource; return playBackend.profileAxes() }
+
+                            Text {
+                                id: profileTitle
+                                anchors.top: parent.top; anchors.topMargin: 6; anchors.horizontalCenter: parent.horizontalCenter
+                                text: "Line Profile" + (profileView.axes.points > 0 ? " (" + profileView.axes.points + " points)" : "")
+                                      + (playBackend.profileLoading ? " — gating…" : "")
+                                font.pixelSize: f10; font.bold: true; color: cNavy
+                            }
+                            Text {
+                                anchors.left: parent.left; anchors.leftMargin: 6; anchors.top: profileImage.top
+                                text: profileView.axes.firstGateUs + " μs"; font.pixelSize: f8; color: cTextLt
+                            }
+                            Text {
+                                anchors.left: parent.left; anchors.leftMargin: 6; anchors.bottom: profileImage.bottom
+                                text: profileView.axes.lastGateUs + " μs"; font.pixelSize: f8; color: cTextLt
+                            }
+                            Image {
+                                id: profileImage
+                                anchors.fill: parent
+                                anchors.topMargin: 32; anchors.bottomMargin: 24; anchors.leftMargin: 64; anchors.rightMargin: 12
+                                source: playBackend.profileSource
+                                smooth: false
+                                cache: false
+                                fillMode: Image.Stretch
+                            }
+                            Text {
+                                anchors.left: profileImage.left; anchors.top: profileImage.bottom; anchors.topMargin: 4
+                                text: profileView.axes.firstPoint; font.pixelSize: f8; color: cTextLt
+                            }
+                            Text {
+                                anchors.right: profileImage.right; anchors.top: profileImage.bottom; anchors.topMargin: 4
+                                text: profileView.axes.lastPoint; font.pixelSize: f8; color: cTextLt
+                            }
+                            Text {
+                                anchors.right: parent.right; anchors.rightMargin: 10; anchors.top: parent.top; anchors.topMargin: 6
+                                text: "✕"; font.pixelSize: f11; color: cTextLt
+                                MouseArea { anchors.fill: parent; onClicked: playBackend.closeLineProfile() }
+                            }
+
+                            // Fold in samples acquired since the last pass
+                            Timer {
+                                interval: 3000
+                                repeat: true
+                                running: profileView.visible && !playBackend.profileLoading
+                                onTriggered: playBackend.refreshLineProfile()
+                            }
+                        }
+
+                        // Overlay of many decays, shown instead of the single-point charts
+                        ChartView {
+                            id: overlayChart
+                            anchors.fill: parent
+                            visible: !profileView.visible && (playBackend.overlayCount > 0 || playBackend.overlayLoading)
+                            title: playBackend.overlayLoading ? "Overlay (loading…)"
+                                   : "Overlay: " + playBackend.overlayCount + " decays" + (playBackend.overlayNormalized ? " (V/A)" : " (V)")
+                            titleColor: cNavy; titleFont.pixelSize: f10; titleFont.bold: true
+                            legend.visible: false
+                            antialiasing: false
+                            backgroundColor: "#FAFAFA"
+                            ValueAxis { id: overlayAxisX; min: 0; max: 20000; labelFormat: "%.0f μs" }
+                            ValueAxis { id: overlayAxisY; min: 0; max: 10.0 }
+                        }
+
                         ColumnLayout {
                             anchors.fill: parent
                             spacing: 1
+                            visible: !overlayChart.visible && !profileView.visible
 
                             // Recv
                             ChartView {
@@ -184,6 +295,59 @@ Window {
                         }
                     }
 
+                    // Survey timeline: every sample in StartTime order
+                    Rectangle {
+                        Layout.fillWidth: true
+                        height: 56
+                        color: "white"
+                        border.color: cBorder
+                        border.width: 1
+
+                        RowLayout {
+                            anchors.fill: parent
+                            anchors.margins: 10
+                            spacing: 10
+
+                            Button {
+                                text: playBackend.timelineReady ? "Close Timeline"
+                                      : (playBackend.timelineLoading ? "Indexing…" : "🕒 Timeline")
+                                font.pixelSize: f9
+                                enabled: !playBackend.timelineLoading
+                                onClicked: {
+                                    if (playBackend.timelineReady) playBackend.closeTimeline()
+                                    else playBackend.buildTimeline()
+                                }
+                            }
+                            Button {
+                                text: "◀"; font.pixelSize: f9
+                                enabled: playBackend.timelineReady
+                                onClicked: playBackend.stepFrame(-1)
+                            }
+                            Slider {
+                                Layout.fillWidth: true
+                                enabled: playBackend.timelineReady
+                                from: playBackend.timelineStartMs
+                                to: Math.max(playBackend.timelineEndMs, playBackend.timelineStartMs + 1)
+                                value: playBackend.timelineCursorMs
+                                onMoved: playBackend.seekTime(value)
+                            }
+                            Button {
+                                text: "▶"; font.pixelSize: f9
+                                enabled: playBackend.timelineReady
+                                onClicked: playBackend.stepFrame(1)
+                            }
+                            Text {
+                                Layout.preferredWidth: 210
+                                text: playBackend.timelineReady
+                                      ? Qt.formatDateTime(new Date(playBackend.timelineCursorMs), "yyyy-MM-dd hh:mm:ss.zzz")
+                                        + "  " + (playBackend.timelineIndex + 1) + "/" + playBackend.timelineCount
+                                      : ""
+                                font.pixelSize: f9
+                                color: cTextLt
+                            }
+                        }
+                    }
+
                     // Playback Controls
                     Rectangle {
                         Layout.fillWidth: true
@@ -223,6 +387,17 @@ Window {
                                 font.pixelSize: f10
                                 color: cTextLt
                             }
+
+                            // True-rate playback speed
+                            ComboBox {
+                                id: rateBox
+                                Layout.preferredWidth: 100
+                                font.pixelSize: f9
+                                model: [0.01, 0.1, 1, 10, 100, 1000]
+                                displayText: currentValue + "×"
+                                currentIndex: 2
+                                onActivated: playBackend.playbackRate = currentValue
+                            }
                         }
                     }
                 }
@@ -252,7 +427,7 @@ Window {
                         }
                     }
 
-                    Text { text: "Point: " + playBackend.currentPointName; font.pixelSize: f11; font.bold: true; color: cText }
+                    Text { text: "Point: " + playBackend.currentPointName + (playBackend.isLoading ? " (loading…)" : ""); font.pixelSize: f11; font.bold: true; color: cText }
                     
                     Rectangle {
                         Layout.fillWidth: true; height: 1; color: cBorder
@@ -273,15 +448,56 @@ Window {
                         Text { text: playBackend.signalStrength.toFixed(0) + " %"; font.pixelSize: f9; font.bold: true; color: cBlue }
                     }
 
+                    Rectangle {
+                        Layout.fillWidth: true; height: 1; color: cBorder
+                    }
+
+                    Text { text: "⧉ Overlay"; font.pixelSize: f10; color: cTextLt }
+                    CheckBox {
+                        text: "Normalize by send current"
+                        font.pixelSize: f9
+                        checked: playBackend.overlayNormalized
+                        onToggled: playBackend.overlayNormalized = checked
+                    }
+                    Button {
+                        Layout.fillWidth: true
+                        text: "Clear Overlay"
+                        font.pixelSize: f9
+                        enabled: playBackend.overlayCount > 0
+                        onClicked: playBackend.clearOverlay()
+                    }
+
                     Item { Layout.fillHeight: true }
 
+                    Text { text: "💾 Export"; font.pixelSize: f10; color: cTextLt }
+                    ComboBox {
+                        id: exportScope
+                        Layout.fillWidth: true
+                        font.pixelSize: f9
+                        model: ["Point", "Line", "Project"]
+                    }
+                    GridLayout {
+                        columns: 2
+                        CheckBox { id: fmtCsv; text: "CSV"; checked: true; font.pixelSize: f9 }
+                        CheckBox { id: fmtRaw; text: "Raw + JSON"; font.pixelSize: f9 }
+                        CheckBox { id: fmtNpy; text: "NumPy"; font.pixelSize: f9 }
+                        CheckBox { id: fmtXyz; text: "Gated XYZ"; font.pixelSize: f9 }
+                    }
+                    ProgressBar {
+                        Layout.fillWidth: true
+                        visible: playBackend.isExporting
+                        value: playBackend.exportProgress
+                    }
                     Button {
                         Layout.fillWidth: true
                         height: 40
-                        text: "Export CSV"
+                        text: playBackend.isExporting ? "Cancel Export" : "Export…"
                         font.pixelSize: f10
                         font.bold: true
-                        onClicked: playBackend.exportCsv("D:/")
+                        onClicked: {
+                            if (playBackend.isExporting) playBackend.cancelExport()
+                            else exportDialog.open()
+                        }
                     }
                 }
             }
@@ -291,9 +507,40 @@ Window {
     Connections {
         target: playBackend
         function onWaveformChanged() {
-            playBackend.updateRecvSeries(playRecvSeries)
-            playBackend.updateSendSeries(playSendSeries)
-            playBackend.updateOffSeries(playOffSeries)
+            playBackend.updateChannelSeries(playRecvSeries, "recv")
+            playBackend.updateChannelSeries(playSendSeries, "send")
+            playBackend.updateChannelSeries(playOffSeries, "off")
+        }
+        function onOverlayChanged() {
+            // Curves are pre-reduced in C++; only series objects are rebuilt here
+            overlayChart.removeAllSeries()
+            var curves = playBackend.overlayCurves()
+            for (var i = 0; i < curves.length; i++) {
+                var s = overlayChart.createSeries(ChartView.SeriesTypeLine, curves[i].label, overlayAxisX, overlayAxisY)
+                s.color = curves[i].color
+                s.width = 1
+                s.useOpenGL = true
+                playBackend.updateOverlaySeries(i, s)
+            }
+            if (curves.length > 0) {
+                var ext = playBackend.overlayExtent()
+                overlayAxisX.max = Math.max(1, ext.xMax)
+                overlayAxisY.min = ext.yMin
+                overlayAxisY.max = ext.yMax > ext.yMin ? ext.yMax : ext.yMin + 1
+            }
+        }
+    }
+
+    FolderDialog {
+        id: exportDialog
+        title: "Export To Folder"
+        onAccepted: {
+            var formats = []
+            if (fmtCsv.checked) formats.push("csv")
+            if (fmtRaw.checked) formats.push("raw")
+            if (fmtNpy.checked) formats.push("npy")
+            if (fmtXyz.checked) formats.push("xyz")
+            playBackend.exportData(exportScope.currentText.toLowerCase(), selectedFolder, formats)
         }
     }
 
@@ -1,5 +1,6 @@
 import QtQuick 6.5
 import QtQuick.Controls 6.5
+import QtQml.Models
 import QtCharts
 import BS
 
@@ -14,6 +15,7 @@ Rectangle {
     // Project Management Aliases
     property alias btnNewProject: btnNewProjectMouseArea
     property alias btnOpenProject: btnOpenProjectMouseArea
+    property alias btnImportDump: btnImportDumpMouseArea
     
     // Connection & Acquisition
     property alias btnConnectDevice: btnConnectDeviceMouseArea
@@ -194,6 +196,19 @@ Rectangle {
                                 cursorShape: Qt.PointingHandCursor
                             }
                         }
+
+                        Rectangle {
+                            width: 36; height: 22; radius: 3; color: "#2E4A6A"; border.color: "#4A90D9"; border.width: 1
+                            Text {
+                                anchors.centerIn: parent; font.pixelSize: f9; color: "#90CAF9"
+                                text: backend && backend.isImporting ? Math.round(backend.importProgress * 100) + "%" : "导入"
+                            }
+                            MouseArea {
+                                id: btnImportDumpMouseArea
+                                anchors.fill: parent
+                                cursorShape: Qt.PointingHandCursor
+                            }
+                        }
                     }
                 }
 
@@ -278,58 +293,86 @@ Rectangle {
                         }
                     }
 
-                    // Dynamic Project Tree
+                    // Dynamic Project Tree (ProjectTreeModel: lines eager, points paged on expand)
                     Repeater {
-                        model: backend ? backend.projectTreeModel : []
+                        id: lineRepeater
+                        model: backend ? backend.projectTreeModel : null
                         
                         Column {
+                            id: lineDelegate
+                            required property int index
+                            required property var model
                             width: leftPanel.width
                             
                             // Line Node
                             Rectangle {
                                 width: leftPanel.width; height: 30
-                                color: index === 0 ? cBlueLt : (index % 2 === 0 ? "#F0F3F6" : "#E8EBF0")
-                                border.color: index === 0 ? "#90CAF9" : "transparent"; border.width: 1
+                                color: lineDelegate.index === 0 ? cBlueLt : (lineDelegate.index % 2 === 0 ? "#F0F3F6" : "#E8EBF0")
+                                border.color: lineDelegate.index === 0 ? "#90CAF9" : "transparent"; border.width: 1
                                 
                                 Row {
                                     anchors.left: parent.left; anchors.leftMargin: 20; anchors.verticalCenter: parent.verticalCenter; spacing: 4
-                                    Text { text: modelData.expanded ? "▾" : "▸"; font.pixelSize: f9; color: cTextLt }
+                                    Text { text: lineDelegate.model.expanded ? "▾" : "▸"; font.pixelSize: f9; color: cTextLt }
                                     Text { text: "📏"; font.pixelSize: f9 }
-                                    Text { text: modelData.label; font.pixelSize: f10; color: index === 0 ? cBlue : cText; font.bold: index === 0 }
+                                    Text { text: lineDelegate.model.label; font.pixelSize: f10; color: lineDelegate.index === 0 ? cBlue : cText; font.bold: lineDelegate.index === 0 }
                                 }
                                 
                                 Text { 
                                     anchors.right: parent.right; anchors.rightMargin: 8; anchors.verticalCenter: parent.verticalCenter
-                                    text: modelData.children ? modelData.children.length + "点" : "0点"
+                                    text: lineDelegate.model.pointCount + "点 / " + lineDelegate.model.sampleCount + "样"
                                     font.pixelSize: f8; color: cTextLt 
                                 }
                                 
-                                Rectangle { visible: index === 0; width: 3; height: parent.height; anchors.left: parent.left; color: cBlue }
+                                Rectangle { visible: lineDelegate.index === 0; width: 3; height: parent.height; anchors.left: parent.left; color: cBlue }
+
+                                MouseArea {
+                                    anchors.fill: parent
+                                    cursorShape: Qt.PointingHandCursor
+                                    onClicked: backend.projectTreeModel.setExpanded(lineDelegate.index, !lineDelegate.model.expanded)
+                                }
                             }
                             
                             // Points under this Line
                             Column {
-                                visible: modelData.expanded !== undefined ? modelData.expanded : false
+                                visible: lineDelegate.model.expanded
                                 width: leftPanel.width
                                 
                                 Repeater {
-                                    model: modelData.children ? modelData.children : []
-                                    
-                                    Rectangle {
-                                        width: leftPanel.width; height: 26
-                                        color: "transparent" // Can be logic based on currentPoint later
+                                    model: DelegateModel {
+                                        // Collapsed lines hold no point rows, so this stays empty
+                                        model: backend.projectTreeModel
+                                        rootIndex: backend.projectTreeModel.index(lineDelegate.index, 0)
                                         
-                                        Row {
-                                            anchors.left: parent.left; anchors.leftMargin: 36; anchors.verticalCenter: parent.verticalCenter; spacing: 5
+                                        delegate: Rectangle {
+                                            id: pointDelegate
+                                            required property var model
+                                            width: leftPanel.width; height: 26
+                                            color: "transparent" // Can be logic based on currentPoint later
                                             
-                                            Rectangle {
-                                                width: 8; height: 8; radius: 4; anchors.verticalCenter: parent.verticalCenter
-                                                color: modelData.status === "done" ? cAccent : modelData.status === "active" ? cYellow : cBorder
+                                            Row {
+                                                anchors.left: parent.left; anchors.leftMargin: 36; anchors.verticalCenter: parent.verticalCenter; spacing: 5
+                                                
+                                                Rectangle {
+                                                    width: 8; height: 8; radius: 4; anchors.verticalCenter: parent.verticalCenter
+                                                    color: pointDelegate.model.status === "done" ? cAccent : pointDelegate.model.status === "active" ? cYellow : cBorder
+                                                }
+                                                Text { text: "📍 " + pointDelegate.model.label; font.pixelSize: f9; color: pointDelegate.model.status==="active"?cOrange:cText; font.bold: pointDelegate.model.status==="active" }
+                                                Text { text: pointDelegate.model.sampleCount + "样"; font.pixelSize: f8; color: cTextLt }
                                             }
-                                            Text { text: "📍 " + modelData.id; font.pixelSize: f9; color: modelData.status==="active"?cOrange:cText; font.bold: modelData.status==="active" }
-                                            Text { text: modelData.dist; font.pixelSize: f8; color: cTextLt }
+                                            Rectangle { visible: pointDelegate.model.status==="active"; width: 3; height: parent.height; anchors.left: parent.left; color: cYellow }
                                         }
-                                        Rectangle { visible: modelData.status==="active"; width: 3; height: parent.height; anchors.left: parent.left; color: cYellow }
+                                    }
+                                }
+
+                                // Next page of a large line
+                                Rectangle {
+                                    visible: lineDelegate.model.hasMore
+                                    width: leftPanel.width; height: 24; color: "transparent"
+                                    Text { anchors.left: parent.left; anchors.leftMargin: 36; anchors.verticalCenter: parent.verticalCenter; text: "… 加载更多"; font.pixelSize: f8; color: cBlue }
+                                    MouseArea {
+                                        anchors.fill: parent
+                                        cursorShape: Qt.PointingHandCursor
+                                        onClicked: backend.projectTreeModel.loadMorePoints(lineDelegate.index)
                                     }
                                 }
                             }
@@ -675,13 +718,13 @@ Rectangle {
                                         width: parent.width; height: parent.height - 24
                                         antialiasing: true; legend.visible: false
                                         margins.top: 5; margins.bottom: 5; margins.left: 5; margins.right: 5
-                                        ValueAxis { id: axisXRecv; min: 0; max: 3000; labelFormat: "%.0f"; gridLineColor: "#E0E0E0" }
+                                        ValueAxis { id: axisXRecv; min: 0; max: 10000; labelFormat: "%.0f"; gridLineColor: "#E0E0E0" }
                                         ValueAxis { id: axisYRecv; min: -2.0; max: 1000; labelFormat: "%.1f"; gridLineColor: "#E0E0E0" }
                                         LineSeries { id: recvSeries; axisX: axisXRecv; axisY: axisYRecv; color: "#1565C0"; width: 2 }
                                         Connections {
                                             target: backend
                                             function onWaveformChanged() {
-                                                if (backend) backend.updateRecvSeries(recvSeries)
+                                                if (backend) backend.updateChannelSeries(recvSeries, "recv")
                                             }
                                         }
                                     }
@@ -715,7 +758,7 @@ Rectangle {
                                         Connections {
                                             target: backend
                                             function onWaveformChanged() {
-                                                if (backend) backend.updateSendSeries(sendSeries)
+                                                if (backend) backend.updateChannelSeries(sendSeries, "send")
                                             }
                                         }
                                     }
@@ -749,7 +792,7 @@ Rectangle {
                                         Connections {
                                             target: backend
                                             function onWaveformChanged() {
-                                                if (backend) backend.updateOffSeries(offSeries)
+                                                if (backend) backend.updateChannelSeries(offSeries, "off")
                                             }
                                         }
                                     }
@@ -859,7 +902,7 @@ Rectangle {
                                         Rectangle { width: parent.width * (backend ? backend.progressPercent/100.0 : 0); height: parent.height; radius: 5; color: cAccent }
                                         Rectangle { x: parent.width*0.5 - 5; y:-3; width: 16; height: 16; radius: 8; color: cGreen; border.color: "white"; border.width: 2 }
                                     }
-                                    Text { text: "  3 / 6 测点完成   |   预计剩余 04:12"; font.pixelSize: f9; font.family: "Consolas"; color: cTextLt }
+                                    Text { text: backend && backend.surveyStats && backend.surveyStats.total > 0 ? "  " + backend.surveyStats.pointsDone + " / " + backend.surveyStats.total + " 测点完成   |   预计剩余 " + Math.ceil(backend.surveyStats.remainingS / 60) + " min   |   " + backend.surveyStats.pointsPerHour.toFixed(1) + " 点/h" : "  -- / -- 测点完成"; font.pixelSize: f9; font.family: "Consolas"; color: cTextLt }
                                 }
 
                                 // Big acquire button
@@ -894,11 +937,33 @@ Rectangle {
 
                                 Rectangle {
                                     width: 90; height: 52; radius: 5; color: "#FFF3E0"; border.color: cOrange; border.width: 1
+                                    MouseArea { anchors.fill: parent; onClicked: if(backend) backend.retryPoint() }
                                     Column { anchors.centerIn: parent; spacing: 2
                                         Text { text: "🔄  重采"; font.pixelSize: f11; font.bold: true; color: cOrange; anchors.horizontalCenter: parent.horizontalCenter }
                                         Text { text: "Re-acquire"; font.pixelSize: f8; color: "#EF6C00"; anchors.horizontalCenter: parent.horizontalCenter }
                                     }
                                 }
+
+                                // Survey sequencer: save and advance through the plan automatically
+                                Rectangle {
+                                    width: 90; height: 52; radius: 5; color: backend && backend.autoAdvance ? cGreenLt : "#ECEFF1"; border.color: backend && backend.autoAdvance ? cGreen : "#90A4AE"; border.width: 1
+                                    MouseArea { anchors.fill: parent; onClicked: if(backend) backend.autoAdvance = !backend.autoAdvance }
+                                    Column { anchors.centerIn: parent; spacing: 2
+                                        Text { text: backend && backend.isSurveyPaused ? "⚠  待确认" : (backend && backend.autoAdvance ? "⏩  自动" : "✋  手动"); font.pixelSize: f11; font.bold: true; color: backend && backend.autoAdvance ? cGreen : "#455A64"; anchors.horizontalCenter: parent.horizontalCenter }
+                                        Text { text: "Auto Advance"; font.pixelSize: f8; color: "#78909C"; anchors.horizontalCenter: parent.horizontalCenter }
+                                    }
+                                }
+
+                                // Wi-Fi transfer: full frames, decimated preview first, or full data only when saved
+                                Rectangle {
+                                    readonly property string mode: backend ? backend.transferMode : "full"
+                                    width: 90; height: 52; radius: 5; color: mode !== "full" ? cGreenLt : "#ECEFF1"; border.color: mode !== "full" ? cGreen : "#90A4AE"; border.width: 1
+                                    MouseArea { anchors.fill: parent; onClicked: if(backend) backend.transferMode = parent.mode === "full" ? "preview" : (parent.mode === "preview" ? "on_demand" : "full") }
+                                    Column { anchors.centerIn: parent; spacing: 2
+                                        Text { text: parent.parent.mode === "preview" ? "📶  预览" : (parent.parent.mode === "on_demand" ? "📶  按需" : "📶  全量"); font.pixelSize: f11; font.bold: true; color: parent.parent.mode !== "full" ? cGreen : "#455A64"; anchors.horizontalCenter: parent.horizontalCenter }
+                                        Text { text: "Transfer"; font.pixelSize: f8; color: "#78909C"; anchors.horizontalCenter: parent.horizontalCenter }
+                                    }
+                                }
                             }
                         }
                     }
@@ -1063,6 +1128,7 @@ Rectangle {
                             Text { anchors.centerIn: parent; text: "⏭ 跳过"; font.pixelSize: f9; color: cText }
                         }
                         Rectangle { width: (parent.width-12)/3; height: 32; radius: 3; color: "#FFF3E0"; border.color: cOrange; border.width: 1
+                            MouseArea { anchors.fill: parent; onClicked: if(backend) backend.retryPoint() }
                             Text { anchors.centerIn: parent; text: "🔄 重采"; font.pixelSize: f9; color: cOrange }
                         }
                     }
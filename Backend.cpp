@@ -1,6 +1,10 @@
 #include "Backend.h"
+#include "ConnectionManager.h"
 #include "DatabaseManager.h"
+#include "Metrics.h"
+#include "ProjectArchive.h"
 #include <QByteArray>
+#include <QCoreApplication>
 #include <QDateTime>
 #include <QDebug>
 #include <QDir>
@@ -14,52 +18,210 @@
 #include <QRandomGenerator>
 #include <QStandardPaths>
 #include <QUrl>
+#include <QPointer>
 #include <QVariantMap>
 #include <QVector>
+#include <QtConcurrent/QtConcurrentRun>
+
+namespace {
+
+// Values per evenly sampled channel in a preview frame (min/max pairs)
+const int kPreviewPoints = 2000;
+// Previews waiting for their full frame before the list is given up on
+const int kMaxPreviewedFrames = 256;
+
+Metrics::Counter &previewsShown = Metrics::counter(
+    "tem_ui_previews_total", "Waveform previews pushed to the charts");
+Metrics::Counter &previewsDropped = Metrics::counter(
+    "tem_ui_previews_dropped_total",
+    "Samples superseded before their preview was drawn");
+
+} // namespace
 
 Backend::Backend(QObject *parent)
     : QObject(parent), m_targetIp("192.168.1.100"), m_connectionState(0),
       m_currentProjectName("-"), m_currentDbPath("-"), m_internalTemp(35.0),
       m_signalStrength(-65.0), m_isAcquiring(false), m_progressPercent(0),
       m_currentSampleIndex(0) {
-  // Initialize DB
-  QString dbPath =
-      QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) +
-      "/tem_data.db";
-  QDir().mkpath(
-      QStandardPaths::writableLocation(QStandardPaths::AppDataLocation));
-  DatabaseManager::instance().initialize(dbPath);
+  // Nothing here touches the database: the default project opens in
+  // initializeStorage(), after the window is up
+  m_projectTreeModel = new ProjectTreeModel(this);
+  connect(&DatabaseManager::instance(), &DatabaseManager::lineCreated,
+          m_projectTreeModel, &ProjectTreeModel::onLineCreated);
+  connect(&DatabaseManager::instance(), &DatabaseManager::pointCreated,
+          m_projectTreeModel, &ProjectTreeModel::onPointCreated);
+  connect(&DatabaseManager::instance(), &DatabaseManager::sampleAdded,
+          m_projectTreeModel, &ProjectTreeModel::onSampleAdded);
+
+  // Per-frame and per-commit events are counted here and logged as one
+  // line a second, so a steady stream formats no strings
+  m_logSummaryTimer.setSingleShot(true);
+  m_logSummaryTimer.setInterval(1000);
+  connect(&m_logSummaryTimer, &QTimer::timeout, this,
+          &Backend::flushLogSummary);
+  connect(&DatabaseManager::instance(), &DatabaseManager::dataSaved, this,
+          [this](int sampleId) {
+            ++m_committedSinceLog;
+            m_lastCommittedId = sampleId;
+            if (!m_logSummaryTimer.isActive())
+              m_logSummaryTimer.start();
+          });
+  connect(&DatabaseManager::instance(), &DatabaseManager::databaseError, this,
+          [this](const QString &err) { appendLog("DB: " + err, true); });
 
   // Initialize with some default flat data
   for (int i = 0; i < 18; ++i) {
     m_recvWaveform.append(0.0);
     m_sendWaveform.append(0.0);
   }
-
-  m_statusTimer = new QTimer(this);
-  connect(m_statusTimer, &QTimer::timeout, this, [this]() {
-    if (m_connectionState == TcpClient::Connected) {
-      if (m_tcpClient) {
-        m_tcpClient->sendData("GET_STATUS\n");
-      }
+  m_channelPoints.resize(ChannelRegistry::count());
+  m_previewTimer.setSingleShot(true);
+  m_previewTimer.setInterval(0);
+  connect(&m_previewTimer, &QTimer::timeout, this, &Backend::refreshPreview);
+  m_perfTimer.setInterval(1000);
+  connect(&m_perfTimer, &QTimer::timeout, this, &Backend::updatePerfStats);
+
+  // Device link, frame journal and persistence; this class adds the QML
+  // surface on top
+  m_pipeline = new AcquisitionPipeline(
+      QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) +
+          "/journal",
+      this);
+  connect(m_pipeline, &AcquisitionPipeline::stateChanged, this,
+          &Backend::onTcpStateChanged);
+  connect(m_pipeline, &AcquisitionPipeline::sampleReceived, this,
+          &Backend::onSampleReceived);
+  connect(m_pipeline, &AcquisitionPipeline::statusReceived, this,
+          [this](double batteryVoltage, double temperature) {
+            m_batteryVoltage = batteryVoltage;
+            m_internalTemp = temperature;
+            emit monitorDataChanged();
+          });
+  connect(m_pipeline, &AcquisitionPipeline::replyReceived, this,
+          &Backend::onDeviceReply);
+  connect(m_pipeline, &AcquisitionPipeline::errorOccurred, this,
+          &Backend::onTcpError);
+  connect(m_pipeline->journal(), &AcquisitionJournal::journalError, this,
+          [this](const QString &err) { appendLog("Journal: " + err, true); });
+  // Walks the survey plan when autoAdvance is on; connected after
+  // onSampleReceived so the preview sees each frame first
+  m_sequencer = new SurveySequencer(m_pipeline, this);
+  connect(m_sequencer, &SurveySequencer::pointStarted, this,
+          &Backend::onSurveyPointStarted);
+  connect(m_sequencer, &SurveySequencer::frameCollected, this,
+          [this](int index, int frames) {
+            Q_UNUSED(index)
+            m_progressPercent = qMin(
+                100, frames * 100 / m_sequencer->options().framesPerPoint);
+            emit progressChanged();
+          });
+  connect(m_sequencer, &SurveySequencer::pointCompleted, this,
+          [this](int index, int saved, bool qualified) {
+            const SurveySequencer::PlanPoint &p = m_sequencer->plan()[index];
+            appendLog(QString("Survey: %1 %2 queued for save, %3 frame(s)%4")
+                          .arg(p.lineLabel, p.pointLabel)
+                          .arg(saved)
+                          .arg(qualified ? "" : " (accepted despite QC)"),
+                      !qualified);
+            emit surveyChanged();
+          });
+  connect(m_sequencer, &SurveySequencer::pointRejected, this,
+          [this](int index, const QString &reason, bool retrying) {
+            const QString next =
+                retrying ? "re-acquiring" : "paused (retry, skip or save)";
+            appendLog(QString("Survey: %1 rejected, %2; %3")
+                          .arg(m_sequencer->plan()[index].pointLabel, reason,
+                               next),
+                      true);
+          });
+  connect(m_sequencer, &SurveySequencer::stateChanged, this,
+          &Backend::surveyChanged);
+  connect(m_sequencer, &SurveySequencer::finished, this, [this]() {
+    const QVariantMap s = m_sequencer->stats();
+    appendLog(QString("Survey ended: %1 point(s) in %2 min, %3 points/h, "
+                      "%4 s mean transition")
+                  .arg(s["pointsDone"].toInt())
+                  .arg(s["elapsedS"].toDouble() / 60, 0, 'f', 1)
+                  .arg(s["pointsPerHour"].toDouble(), 0, 'f', 1)
+                  .arg(s["meanTransitionS"].toDouble(), 0, 'f', 2),
+              false);
+    if (m_isAcquiring) {
+      m_isAcquiring = false;
+      emit acquisitionChanged();
     }
+    emit surveyChanged();
   });
-  // Start polling status every 2 seconds
-  m_statusTimer->start(2000);
 
-  m_tcpClient = new TcpClient(this);
-  connect(m_tcpClient, &TcpClient::stateChanged, this,
-          &Backend::onTcpStateChanged);
-  connect(m_tcpClient, &TcpClient::dataReceived, this,
-          &Backend::onTcpDataReceived);
-  connect(m_tcpClient, &TcpClient::errorOccurred, this, &Backend::onTcpError);
+  // Poll device status every 2 seconds
+  m_pipeline->setStatusInterval(2000);
+  m_recoveredSegments = m_pipeline->staleSegments();
+
+  m_syncThread.setObjectName("SyncEngine");
+  m_syncEngine = new SyncEngine;
+  m_syncEngine->moveToThread(&m_syncThread);
+  connect(m_syncEngine, &SyncEngine::progress, this,
+          [this](qint64 watermark, qint64 pending) {
+            Q_UNUSED(watermark)
+            m_syncPending = pending;
+            emit syncChanged();
+          });
+  connect(m_syncEngine, &SyncEngine::batchUploaded, this,
+          [this](qint64 firstId, qint64 lastId, int rows, qint64 bytes) {
+            appendLog(QString("Sync: samples %1-%2 uploaded (%3 rows, %4 KiB)")
+                          .arg(firstId)
+                          .arg(lastId)
+                          .arg(rows)
+                          .arg(bytes / 1024),
+                      false);
+          });
+  connect(m_syncEngine, &SyncEngine::syncError, this,
+          [this](const QString &err) { appendLog(err, true); });
+  // New commits wake the engine instead of waiting for its poll
+  connect(&DatabaseManager::instance(), &DatabaseManager::dataSaved,
+          m_syncEngine, &SyncEngine::poke);
+  m_syncThread.start();
+
+  // Look for frames of a session that never got to save them (crash, power
+  // loss)
+  QPointer<Backend> self(this);
+  const QStringList stale = m_recoveredSegments;
+  (void)QtConcurrent::run([self, stale]() {
+    auto frames = AcquisitionJournal::scanUnsaved(stale);
+    QMetaObject::invokeMethod(
+        qApp,
+        [self, frames]() {
+          if (!self)
+            return;
+          self->m_recoveredFrames = frames;
+          if (frames.isEmpty()) {
+            // Everything was saved; just fold the segments into the archive
+            self->discardRecoveredFrames();
+            return;
+          }
+          self->appendLog(QString("Journal: %1 unsaved frame(s) recovered "
+                                  "from a previous session")
+                              .arg(frames.size()),
+                          true);
+          emit self->recoveryChanged();
+        },
+        Qt::QueuedConnection);
+  });
+}
 
-  // Load mock data array
-  QFile file("DB_js/Data_Sample.json");
-  if (file.open(QIODevice::ReadOnly)) {
-    QByteArray data = file.readAll();
-    m_mockDataArray = QJsonDocument::fromJson(data).array();
+void Backend::initializeStorage() {
+  // The user got to create or open a project first
+  if (m_storageReady)
+    return;
+  const QString dir =
+      QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+  QDir().mkpath(dir);
+  if (!DatabaseManager::instance().initialize(dir + "/tem_data.db")) {
+    appendLog("Default project could not be opened", true);
+    return;
   }
+  m_storageReady = true;
+  m_projectTreeModel->reload(DatabaseManager::instance().database());
+  emit projectTreeChanged();
 }
 
 // Project Expose to QML
@@ -73,18 +235,28 @@ bool Backend::createProjectDB(const QString &fileUrl) {
   qDebug() << "Creating new project database at:" << localPath;
 
   if (DatabaseManager::instance().initialize(localPath)) {
+    m_storageReady = true;
     m_currentDbPath = localPath;
     // Extract filename for project name
     QFileInfo fi(localPath);
     m_currentProjectName = fi.baseName();
+    // IDs of the previous project's points mean nothing here
+    m_currentPointId = m_currentLineId = -1;
 
     // Setup initial project in DB
     QVariantMap pData;
     pData["CreateTime"] = QDateTime::currentSecsSinceEpoch();
     DatabaseManager::instance().createProject(pData);
 
+    // New projects store waveforms compressed; old ones keep their codec
+    for (const QString &column : ChannelRegistry::columns())
+      DatabaseManager::instance().setColumnCodec(column,
+                                                 WaveformCodec::Gorilla);
+
     // Blank canvas for new project
-    m_projectTreeModel.clear();
+    m_projectTreeModel->reload(DatabaseManager::instance().database());
+    if (m_isSyncing)
+      startSync();
 
     emit projectChanged();
     emit projectTreeChanged();
@@ -104,13 +276,17 @@ bool Backend::openProjectDB(const QString &fileUrl) {
   qDebug() << "Opening existing project database at:" << localPath;
 
   if (DatabaseManager::instance().initialize(localPath)) {
+    m_storageReady = true;
     m_currentDbPath = localPath;
     QFileInfo fi(localPath);
     m_currentProjectName = fi.baseName();
+    // IDs of the previous project's points mean nothing here
+    m_currentPointId = m_currentLineId = -1;
 
-    // TODO: Load existing lines and points from Data_Line and Data_Point
-    // into m_projectTreeModel here.
-    m_projectTreeModel.clear();
+    // Lines only; points page in as lines are expanded
+    m_projectTreeModel->reload(DatabaseManager::instance().database());
+    if (m_isSyncing)
+      startSync();
 
     emit projectChanged();
     emit projectTreeChanged();
@@ -121,6 +297,17 @@ bool Backend::openProjectDB(const QString &fileUrl) {
   }
 }
 
+bool Backend::setColumnCodec(const QString &column, const QString &codecName) {
+  WaveformCodec::Codec codec =
+      WaveformCodec::codecFromName(codecName, WaveformCodec::Raw);
+  if (!DatabaseManager::instance().setColumnCodec(column, codec))
+    return false;
+  appendLog(QString("%1 now stored as %2")
+                .arg(column, WaveformCodec::codecName(codec)),
+            false);
+  return true;
+}
+
 void Backend::setTargetIp(const QString &ip) {
   if (m_targetIp != ip) {
     m_targetIp = ip;
@@ -131,19 +318,74 @@ void Backend::setTargetIp(const QString &ip) {
 void Backend::setCurrentPoint(const QString &point) {
   if (m_currentPoint != point) {
     m_currentPoint = point;
+    m_currentPointId = -1;
     emit pointChanged();
   }
 }
 
+void Backend::setCurrentPointId(int pointId) {
+  if (m_currentPointId == pointId)
+    return;
+  const int index =
+      m_sequencer->loadPlan() ? m_sequencer->indexOfPoint(pointId) : -1;
+  if (index >= 0) {
+    selectPlanPoint(m_sequencer->plan()[index]);
+    return;
+  }
+  m_currentPointId = pointId;
+  emit pointChanged();
+}
+
+int Backend::currentPlanIndex() const {
+  if (m_currentPointId >= 0)
+    return m_sequencer->indexOfPoint(m_currentPointId);
+  return m_sequencer->indexOfPoint(m_currentLineId, m_currentPoint);
+}
+
+void Backend::selectPlanPoint(const SurveySequencer::PlanPoint &point) {
+  m_currentLineId = point.lineId;
+  if (m_currentPointId == point.pointId && m_currentPoint == point.pointLabel)
+    return;
+  m_currentPointId = point.pointId;
+  m_currentPoint = point.pointLabel;
+  emit pointChanged();
+}
+
+void Backend::setAutoAdvance(bool enabled) {
+  if (m_autoAdvance == enabled)
+    return;
+  m_autoAdvance = enabled;
+  emit surveyChanged();
+}
+
 void Backend::copyPreviousPointParams() {
-  // Mock logic to copy previous point. In reality this queries the local SQLite
-  // DB. We'll simulate fetching params from the previous point.
-  setSendCurrent(12.5);
-  setSampleRate(102400);
-  setStackCount(32);
-  setSampleTimeLength(4096);
-  setCustomParams("Copied from P003");
-  appendLog("Previous parameters successfully copied.", false);
+  // From the last sample stored for the point before this one in the plan
+  QString error;
+  if (!m_sequencer->loadPlan(&error)) {
+    appendLog(error, true);
+    return;
+  }
+  const int index = currentPlanIndex();
+  if (index <= 0) {
+    appendLog("No point before " + m_currentPoint + " in the survey plan",
+              true);
+    return;
+  }
+  const SurveySequencer::PlanPoint &prev = m_sequencer->plan()[index - 1];
+  const QVariantMap params = SurveySequencer::storedParams(prev.pointId);
+  if (params.isEmpty()) {
+    appendLog(prev.pointLabel + " has no stored sample to copy from", true);
+    return;
+  }
+  if (params.contains("sample_rate"))
+    setSampleRate(params["sample_rate"].toInt());
+  if (params.contains("sample_time"))
+    setSampleTimeLength(params["sample_time"].toInt());
+  appendLog(QString("Parameters copied from %1: %2 Hz, %3 values")
+                .arg(prev.pointLabel)
+                .arg(m_sampleRate)
+                .arg(m_sampleTimeLength),
+            false);
 }
 
 void Backend::connectDevice() {
@@ -153,11 +395,11 @@ void Backend::connectDevice() {
   // Remove simulator timer since we talk to external python now
   // m_simTimer->start(50);
 
-  m_tcpClient->connectToServer(m_targetIp, 8888);
+  m_pipeline->connectDevice(m_targetIp, 8888);
 }
 
 void Backend::disconnectDevice() {
-  m_tcpClient->disconnectFromServer();
+  m_pipeline->disconnectDevice();
 
   if (m_isAcquiring) {
     m_isAcquiring = false;
@@ -165,6 +407,44 @@ void Backend::disconnectDevice() {
   }
 }
 
+bool Backend::startSessionRecording(const QString &fileUrl) {
+  QString path = QUrl(fileUrl).toLocalFile();
+  if (path.isEmpty())
+    path = fileUrl;
+  QString error;
+  if (!m_pipeline->startRecording(path, &error)) {
+    appendLog("Recording failed: " + error, true);
+    return false;
+  }
+  appendLog("Recording device session to " + path, false);
+  emit sessionRecordingChanged();
+  return true;
+}
+
+void Backend::stopSessionRecording() {
+  if (!m_pipeline->isRecording())
+    return;
+  m_pipeline->stopRecording();
+  appendLog("Session recording stopped", false);
+  emit sessionRecordingChanged();
+}
+
+bool Backend::replaySession(const QString &fileUrl, double speed) {
+  QString path = QUrl(fileUrl).toLocalFile();
+  if (path.isEmpty())
+    path = fileUrl;
+  QString error;
+  if (!m_pipeline->startReplay(path, speed, &error)) {
+    appendLog("Replay failed: " + error, true);
+    return false;
+  }
+  appendLog(QString("Replaying %1 at %2")
+                .arg(path, speed > 0 ? QString::number(speed) + "x"
+                                     : QString("full speed")),
+            false);
+  return true;
+}
+
 void Backend::startAcquisition() {
   if (m_connectionState != TcpClient::Connected) {
     appendLog("Error: Device not connected!", true);
@@ -172,14 +452,19 @@ void Backend::startAcquisition() {
   }
   if (m_isAcquiring)
     return;
+  if (m_autoAdvance) {
+    m_isAcquiring = startSurvey();
+    emit acquisitionChanged();
+    return;
+  }
 
   m_isAcquiring = true;
   m_progressPercent = 0;
   m_currentSampleIndex = 0;
-  m_tcpBuffer.clear();
+  m_previewedFrames.clear();
 
   // Send start command to Python Simulator
-  m_tcpClient->sendData("START_COLLECT\n");
+  m_pipeline->startCollect();
 
   emit acquisitionChanged();
   emit progressChanged();
@@ -191,15 +476,80 @@ void Backend::stopAcquisition() {
     return;
   m_isAcquiring = false;
   emit acquisitionChanged();
+  m_sequencer->stop();
   appendLog("Acquisition stopped manually.", true);
 }
 
+bool Backend::startSurvey() {
+  QString error;
+  if (!m_sequencer->loadPlan(&error)) {
+    appendLog(error, true);
+    return false;
+  }
+  const QVector<SurveySequencer::PlanPoint> &plan = m_sequencer->plan();
+  if (plan.isEmpty()) {
+    appendLog("Survey: the project has no points to acquire", true);
+    return false;
+  }
+  // From the selected point, else where the last survey left off
+  int from = currentPlanIndex();
+  if (from < 0)
+    from = qMax(0, m_sequencer->firstUnsurveyed());
+  m_sequencer->setParams(acquisitionParams());
+  if (!m_sequencer->start(from))
+    return false;
+  appendLog(QString("Survey started at %1, %2 point(s) to go")
+                .arg(plan[from].pointLabel)
+                .arg(plan.size() - from),
+            false);
+  return true;
+}
+
+void Backend::onSurveyPointStarted(int index) {
+  const SurveySequencer::PlanPoint &p = m_sequencer->plan()[index];
+  selectPlanPoint(p);
+  m_currentSampleIndex = 0;
+  m_progressPercent = 0;
+  emit progressChanged();
+  appendLog(QString("Survey: collecting %1 %2 (%3 of %4)")
+                .arg(p.lineLabel, p.pointLabel)
+                .arg(index + 1)
+                .arg(m_sequencer->plan().size()),
+            false);
+  emit surveyChanged();
+}
+
 void Backend::skipPoint() {
+  if (m_sequencer->isRunning()) {
+    appendLog("Survey: skipped " + m_currentPoint, true);
+    m_sequencer->skip();
+    return;
+  }
   stopAcquisition();
-  // Simulate moving to next point (P004 -> P005)
-  m_currentPoint = "P005";
-  emit pointChanged();
-  appendLog("Skipped to next measurement point: P005", false);
+  QString error;
+  if (!m_sequencer->loadPlan(&error)) {
+    appendLog(error, true);
+    return;
+  }
+  // The point after the current one in the plan (the first if unknown)
+  const int next = currentPlanIndex() + 1;
+  if (next >= m_sequencer->plan().size()) {
+    appendLog("No point after " + m_currentPoint + " in the survey plan",
+              true);
+    return;
+  }
+  selectPlanPoint(m_sequencer->plan()[next]);
+  appendLog("Skipped to next measurement point: " + m_currentPoint, false);
+}
+
+void Backend::retryPoint() {
+  if (m_sequencer->isRunning()) {
+    appendLog("Survey: re-acquiring " + m_currentPoint, false);
+    m_sequencer->retry();
+    return;
+  }
+  stopAcquisition();
+  startAcquisition();
 }
 
 void Backend::setSendCurrent(double current) {
@@ -242,20 +592,38 @@ void Backend::setCustomParams(const QString &params) {
   syncParamsToSimulator();
 }
 
-void Backend::syncParamsToSimulator() {
-  if (m_connectionState != TcpClient::Connected)
+void Backend::setTransferMode(const QString &mode) {
+  if (mode != "full" && mode != "preview" && mode != "on_demand") {
+    appendLog("Unknown transfer mode: " + mode, true);
     return;
+  }
+  if (m_transferMode == mode)
+    return;
+  m_transferMode = mode;
+  emit transferModeChanged();
+  syncParamsToSimulator();
+}
 
+QVariantMap Backend::acquisitionParams() const {
   QVariantMap params;
   params["send_current"] = m_sendCurrent;
   params["sample_rate"] = m_sampleRate;
   params["stack_count"] = m_stackCount;
   params["sample_time"] = m_sampleTimeLength;
   params["custom"] = m_customParams;
+  params["transfer"] = m_transferMode;
+  params["preview_points"] = kPreviewPoints;
+  return params;
+}
 
-  QByteArray jsonData =
-      QJsonDocument::fromVariant(params).toJson(QJsonDocument::Compact);
-  m_tcpClient->sendData("SET_PARAMS:" + jsonData + "\n");
+void Backend::syncParamsToSimulator() {
+  if (m_connectionState != TcpClient::Connected)
+    return;
+
+  const QVariantMap params = acquisitionParams();
+  // A running survey applies them from the next point on
+  m_sequencer->setParams(params);
+  m_pipeline->sendParams(params);
 }
 
 void Backend::onTcpStateChanged(TcpClient::ConnectionState newState) {
@@ -264,7 +632,7 @@ void Backend::onTcpStateChanged(TcpClient::ConnectionState newState) {
 
   if (newState == TcpClient::Connected) {
     appendLog("Connected to simulator at " + m_targetIp, false);
-    m_tcpClient->sendData("GET_STATUS\n");
+    m_pipeline->requestStatus();
   } else if (newState == TcpClient::Disconnected) {
     appendLog("Disconnected from simulator.", true);
   }
@@ -287,194 +655,192 @@ void Backend::appendLog(const QString &msg, bool isWarning) {
   emit logMessage(msg, isWarning); // Keep emitting the old signal just in case
 }
 
-void Backend::onTcpDataReceived(const QByteArray &data) {
-  m_tcpBuffer.append(data);
+void Backend::onSampleReceived(const AcquisitionPipeline::Sample &sample) {
+  // The full frame a save has been waiting for
+  if (!sample.preview && m_pendingSave.frameId >= 0 &&
+      sample.frameId == m_pendingSave.frameId) {
+    persistSample(sample, m_pendingSave.meta, m_pendingSave.point);
+    m_pendingSave = PendingSave();
+  }
+  // A full frame following its preview was counted and shown already; it
+  // only takes the preview's place if that is still on screen
+  if (sample.preview) {
+    if (m_previewedFrames.size() >= kMaxPreviewedFrames)
+      m_previewedFrames.clear(); // on_demand: fulls nobody asked for
+    m_previewedFrames.insert(sample.frameId);
+  } else if (m_previewedFrames.remove(sample.frameId)) {
+    if (m_latestSample.preview && m_latestSample.frameId == sample.frameId) {
+      m_latestSample = sample;
+      m_previewTimer.start();
+    }
+    return;
+  }
 
-  int newlineIdx;
-  while ((newlineIdx = m_tcpBuffer.indexOf('\n')) != -1) {
-    QByteArray frame = m_tcpBuffer.left(newlineIdx).trimmed();
-    m_tcpBuffer.remove(0, newlineIdx + 1);
+  m_latestSample = sample;
+  const QVector<double> &recvData =
+      m_latestSample.channel(ChannelRegistry::Recv);
 
-    if (frame.isEmpty())
-      continue;
+  // Update device monitor from sample metadata
+  static const QString recvFsKey = QStringLiteral("RecvFs");
+  const auto recvFs = sample.meta.constFind(recvFsKey);
+  if (recvFs != sample.meta.cend()) {
+    m_signalStrength = recvFs->toDouble() / 10000.0; // Scale to percentage-like
+  }
+  if (sample.rate(ChannelRegistry::Recv) > 0)
+    m_sampleRate = sample.rate(ChannelRegistry::Recv);
+  emit monitorDataChanged();
+
+  // Chart update once the rest of this read has been handled; a newer
+  // sample in the same burst replaces this one
+  if (m_previewTimer.isActive())
+    previewsDropped.add();
+  else
+    m_previewTimer.start();
+
+  m_currentSampleIndex++;
+  // A running survey tracks progress and completion itself
+  const bool manual = !m_sequencer->isRunning();
+  if (manual) {
+    m_progressPercent =
+        qMin(100, m_currentSampleIndex * 33); // Simulator sends 3 frames
+    emit progressChanged();
+  }
 
-    // Parse JSON frame from Python Simulator
-    QJsonDocument doc = QJsonDocument::fromJson(frame);
-    if (!doc.isObject())
-      continue;
+  ++m_framesSinceLog;
+  m_lastFrameBytes = int(recvData.size() * 8);
+  if (!m_logSummaryTimer.isActive())
+    m_logSummaryTimer.start();
+
+  if (manual && m_isAcquiring && m_progressPercent >= 99) {
+    m_progressPercent = 100;
+    emit progressChanged();
+    flushLogSummary();
+    appendLog("Acquisition Complete", false);
+    stopAcquisition();
+  }
+}
 
-    QJsonObject obj = doc.object();
+void Backend::flushLogSummary() {
+  m_logSummaryTimer.stop();
+  if (m_framesSinceLog > 0)
+    appendLog(QString("Received %1 frame(s), up to #%2 (%3 bytes)")
+                  .arg(m_framesSinceLog)
+                  .arg(m_currentSampleIndex)
+                  .arg(m_lastFrameBytes),
+              false);
+  if (m_committedSinceLog > 0)
+    appendLog(QString("%1 sample(s) committed to disk, last #%2")
+                  .arg(m_committedSinceLog)
+                  .arg(m_lastCommittedId),
+              false);
+  m_framesSinceLog = 0;
+  m_committedSinceLog = 0;
+}
 
-    // Check if it's a GET_STATUS response
-    if (obj.contains("status") && obj["status"].toString() == "connected") {
-      m_batteryVoltage = obj["battery_voltage"].toDouble();
-      m_internalTemp = obj["temperature"].toDouble();
-      // The simulator changes point ID, we could sync it, but usually we drive
-      // it
-      emit monitorDataChanged();
-      continue;
-    }
+void Backend::refreshPreview() {
+  const QVector<double> &recvData =
+      m_latestSample.channel(ChannelRegistry::Recv);
+  const QVector<double> &sendData =
+      m_latestSample.channel(ChannelRegistry::Send);
+
+  // Update QML charts safely (Subsample if necessary), rewriting the
+  // lists in place so a steady stream reuses their storage
+  auto subsample = [](const QVector<double> &data, QVariantList &out) {
+    const int step = qMax(1, int(data.size() / 1500));
+    out.resize((data.size() + step - 1) / step);
+    for (int i = 0, j = 0; i < data.size(); i += step, ++j)
+      out[j] = data[i];
+  };
+  subsample(recvData, m_recvWaveform);
+  subsample(sendData, m_sendWaveform);
+  previewsShown.add();
+
+  emit waveformChanged();
+}
 
-    // Otherwise it is an Acquisition Sample (has DATA_RECV)
-    if (obj.contains("DATA_RECV")) {
-      QString recvB64 = obj["DATA_RECV"].toString();
-      QString sendB64 = obj["DATA_SEND"].toString();
-      QString offB64 = obj["DATA_SOFF"].toString();
-
-      QByteArray recvRaw = QByteArray::fromBase64(recvB64.toUtf8());
-      QByteArray sendRaw = QByteArray::fromBase64(sendB64.toUtf8());
-      QByteArray offRaw = QByteArray::fromBase64(offB64.toUtf8());
-
-      // Data format: big-endian IEEE 754 doubles (8 bytes per value)
-      // This matches the DB_js/Data_Sample.json format
-      QVector<double> recvData;
-      for (int i = 0; i + 7 < recvRaw.size(); i += 8) {
-        quint64 bits = 0;
-        for (int b = 0; b < 8; ++b)
-          bits = (bits << 8) | static_cast<quint8>(recvRaw[i + b]);
-        double val;
-        memcpy(&val, &bits, sizeof(double));
-        recvData.append(val);
-      }
-
-      QVector<double> sendData;
-      for (int i = 0; i + 7 < sendRaw.size(); i += 8) {
-        quint64 bits = 0;
-        for (int b = 0; b < 8; ++b)
-          bits = (bits << 8) | static_cast<quint8>(sendRaw[i + b]);
-        double val;
-        memcpy(&val, &bits, sizeof(double));
-        sendData.append(val);
-      }
-
-      QVector<double> offData;
-      for (int i = 0; i + 7 < offRaw.size(); i += 8) {
-        quint64 bits = 0;
-        for (int b = 0; b < 8; ++b)
-          bits = (bits << 8) | static_cast<quint8>(offRaw[i + b]);
-        double val;
-        memcpy(&val, &bits, sizeof(double));
-        offData.append(val);
-      }
-
-      m_latestSample.pointId = obj["Data_PointID"].toInt();
-      m_latestSample.recvData = recvData;
-      m_latestSample.sendData = sendData;
-      m_latestSample.offData = offData;
-
-      // Update device monitor from sample metadata
-      if (obj.contains("RecvFs")) {
-        m_signalStrength =
-            obj["RecvFs"].toDouble() / 10000.0; // Scale to percentage-like
-      }
-      m_sampleRate = obj.value("RecvFs").toInt(m_sampleRate);
-      m_sendFs = qMax(1, obj.value("SendFs").toInt(25));
-      m_offFs = qMax(1, obj.value("SampleOffFs").toInt(2000000));
-      emit monitorDataChanged();
-
-      // Update QML charts safely (Subsample if necessary)
-      QVariantList newRecv;
-      QVariantList newSend;
-      int rStep = qMax(1, recvData.size() / 1500);
-      for (int i = 0; i < recvData.size(); i += rStep)
-        newRecv.append(recvData[i]);
-      int sStep = qMax(1, sendData.size() / 1500);
-      for (int i = 0; i < sendData.size(); i += sStep)
-        newSend.append(sendData[i]);
-
-      m_recvWaveform = newRecv;
-      m_sendWaveform = newSend;
-
-      emit waveformChanged();
-
-      m_currentSampleIndex++;
-      m_progressPercent =
-          qMin(100, m_currentSampleIndex * 33); // Simulator sends 3 frames
-      emit progressChanged();
-
-      appendLog(QString("Received Frame #%1 (%2 bytes)")
-                    .arg(m_currentSampleIndex)
-                    .arg(recvRaw.size()),
-                false);
-
-      if (m_progressPercent >= 99) {
-        m_progressPercent = 100;
-        emit progressChanged();
-        appendLog("Acquisition Complete", false);
-        stopAcquisition();
-      }
-    }
+void Backend::setPerfHudVisible(bool visible) {
+  if (visible == m_perfTimer.isActive())
+    return;
+  if (visible) {
+    m_perfLastCounts.clear();
+    updatePerfStats();
+    m_perfTimer.start();
+  } else {
+    m_perfTimer.stop();
   }
+  emit perfHudChanged();
 }
 
-void Backend::onTcpError(const QString &errorMsg) {
-  appendLog("TCP Exception: " + errorMsg, true);
-}
+void Backend::updatePerfStats() {
+  const double seconds = m_perfClock.isValid()
+                             ? qMax(1e-3, m_perfClock.nsecsElapsed() / 1e9)
+                             : 0.0;
+  m_perfClock.start();
 
-void Backend::updateRecvSeries(QAbstractSeries *series) {
-  if (auto *xySeries = qobject_cast<QXYSeries *>(series)) {
-    QList<QPointF> points;
-    int step = qMax(1, (int)(m_latestSample.recvData.size() / 1000));
-    for (int i = 0; i < m_latestSample.recvData.size(); i += step) {
-      // time in microsecons
-      points.append(QPointF(i * (1000000.0 / qMax(1, m_sampleRate)),
-                            m_latestSample.recvData[i]));
-    }
-    xySeries->replace(points);
+  QVariantMap stats = Metrics::snapshot();
+  for (auto it = stats.cbegin(), end = stats.cend(); it != end; ++it) {
+    if (!it.key().endsWith("_total"))
+      continue;
+    const qint64 count = it.value().toLongLong();
+    // No rate until there are two samples to difference
+    if (seconds > 0 && m_perfLastCounts.contains(it.key()))
+      stats[it.key() + "_per_s"] =
+          (count - m_perfLastCounts.value(it.key())) / seconds;
+    m_perfLastCounts[it.key()] = count;
   }
+  m_perfStats = stats;
+  emit perfStatsChanged();
 }
 
-void Backend::updateSendSeries(QAbstractSeries *series) {
-  if (auto *xySeries = qobject_cast<QXYSeries *>(series)) {
-    QList<QPointF> points;
-    int step = qMax(1, (int)(m_latestSample.sendData.size() / 1000));
-    for (int i = 0; i < m_latestSample.sendData.size(); i += step) {
-      points.append(QPointF(i * (1000000.0 / qMax(1, m_sendFs)),
-                            m_latestSample.sendData[i]));
-    }
-    xySeries->replace(points);
-  }
+void Backend::onTcpError(const QString &errorMsg) {
+  appendLog("TCP Exception: " + errorMsg, true);
 }
 
-void Backend::updateOffSeries(QAbstractSeries *series) {
-  if (auto *xySeries = qobject_cast<QXYSeries *>(series)) {
-    QList<QPointF> points;
-    int step = qMax(1, (int)(m_latestSample.offData.size() / 1000));
-    for (int i = 0; i < m_latestSample.offData.size(); i += step) {
-      points.append(QPointF(i * (1000000.0 / qMax(1, m_offFs)),
-                            m_latestSample.offData[i]));
-    }
-    xySeries->replace(points);
+void Backend::updateSeries(QAbstractSeries *series, int channel) {
+  auto *xySeries = qobject_cast<QXYSeries *>(series);
+  if (!xySeries)
+    return;
+  const QVector<double> &data = m_latestSample.channel(channel);
+  // Gated channels are drawn at their gate times (us), the rest evenly
+  // spaced at their rate
+  const QVector<double> &x =
+      m_latestSample.channel(ChannelRegistry::axisOf(channel));
+  const bool gated = !x.isEmpty() && x.size() == data.size();
+  const int fs = m_latestSample.rate(channel);
+  const double dtUs = fs > 0 ? 1000000.0 / fs : 1.0;
+
+  // The series shares the list it is given; the ring hands out one the
+  // chart has let go of, so steady updates reuse storage
+  QList<QPointF> &points = m_channelPoints[channel].acquire();
+  const int step = qMax(1, int(data.size() / 1000));
+  points.resize((data.size() + step - 1) / step);
+  for (int i = 0, j = 0; i < data.size(); i += step, ++j)
+    points[j] = QPointF(gated ? x[i] : i * dtUs, data[i]);
+  xySeries->replace(points);
+}
+
+void Backend::updateChannelSeries(QAbstractSeries *series,
+                                  const QString &channel) {
+  const int index = ChannelRegistry::indexOf(channel.toLatin1());
+  if (index < 0) {
+    qWarning() << "Backend: no channel" << channel;
+    return;
   }
+  updateSeries(series, index);
 }
 
 void Backend::savePointData(bool isQualified, const QString &remark) {
-  if (m_latestSample.recvData.isEmpty()) {
+  // A survey paused on a rejected point keeps that point's frames
+  if (m_sequencer->state() == SurveySequencer::Paused) {
+    appendLog("Survey: saving " + m_currentPoint + " as acquired", false);
+    m_sequencer->accept();
+    return;
+  }
+  if (m_latestSample.channel(ChannelRegistry::Recv).isEmpty()) {
     appendLog("WARN No data to save", true);
     return;
   }
 
-  QVector<float> rFloat, sFloat, oFloat;
-  for (double d : m_latestSample.recvData)
-    rFloat.append(static_cast<float>(d));
-  for (double d : m_latestSample.sendData)
-    sFloat.append(static_cast<float>(d));
-  for (double d : m_latestSample.offData)
-    oFloat.append(static_cast<float>(d));
-
-  QByteArray rB64 =
-      QByteArray(reinterpret_cast<const char *>(rFloat.constData()),
-                 rFloat.size() * sizeof(float))
-          .toBase64();
-  QByteArray sB64 =
-      QByteArray(reinterpret_cast<const char *>(sFloat.constData()),
-                 sFloat.size() * sizeof(float))
-          .toBase64();
-  QByteArray oB64 =
-      QByteArray(reinterpret_cast<const char *>(oFloat.constData()),
-                 oFloat.size() * sizeof(float))
-          .toBase64();
-
   QVariantMap sampleMeta;
   sampleMeta["isQualified"] = isQualified;
   sampleMeta["remark"] = remark;
@@ -482,14 +848,266 @@ void Backend::savePointData(bool isQualified, const QString &remark) {
   sampleMeta["sampleRate"] = m_sampleRate;
   sampleMeta["stackCount"] = m_stackCount;
 
-  bool ok = DatabaseManager::instance().saveSample(
-      m_latestSample.pointId, sampleMeta, rB64, sB64, oB64);
+  // Only full-resolution data is stored; onSampleReceived saves the frame
+  // when it comes in
+  if (m_latestSample.preview) {
+    m_pendingSave = {m_latestSample.frameId, sampleMeta, m_currentPoint};
+    if (m_pipeline->transferMode() == AcquisitionPipeline::OnDemandTransfer)
+      m_pipeline->requestFullFrame(m_latestSample.frameId);
+    appendLog(QString("Waiting for full-resolution frame #%1 to save %2")
+                  .arg(m_latestSample.frameId)
+                  .arg(m_currentPoint),
+              false);
+    return;
+  }
+  persistSample(m_latestSample, sampleMeta, m_currentPoint);
+}
+
+bool Backend::persistSample(const AcquisitionPipeline::Sample &sample,
+                            const QVariantMap &meta, const QString &point) {
+  // The frame's own columns (DeviceType, PERIOD, SendFs, StartTime) with
+  // the operator's additions on top; a deferred save still records when
+  // the frame arrived
+  QVariantMap merged = sample.meta;
+  for (auto it = meta.cbegin(); it != meta.cend(); ++it)
+    merged.insert(it.key(), it.value());
+  const bool ok = m_pipeline->persist(sample, merged);
   if (ok) {
-    appendLog(QString("Saved data for %1 (Qualified: %2)")
-                  .arg(m_currentPoint)
-                  .arg(isQualified ? "Yes" : "No"),
+    appendLog(QString("Queued save for %1 (Qualified: %2)")
+                  .arg(point)
+                  .arg(meta.value("isQualified").toBool() ? "Yes" : "No"),
               false);
   } else {
     appendLog("Failed to save data. No active project DB?", true);
   }
+  return ok;
+}
+
+void Backend::onDeviceReply(const QJsonObject &reply) {
+  // GET_FRAME for a frame the device no longer holds
+  if (reply.value("error").toString() != "frame_unavailable")
+    return;
+  const int frameId = reply.value("ID").toInt(-1);
+  m_previewedFrames.remove(frameId);
+  if (frameId == m_pendingSave.frameId) {
+    appendLog(QString("Device no longer has frame #%1; %2 not saved")
+                  .arg(frameId)
+                  .arg(m_pendingSave.point),
+              true);
+    m_pendingSave = PendingSave();
+  }
+}
+
+int Backend::importRecoveredFrames() {
+  int imported = 0;
+  for (const AcquisitionJournal::RecoveredFrame &f :
+       std::as_const(m_recoveredFrames)) {
+    QJsonObject obj = QJsonDocument::fromJson(f.frame).object();
+    if (!obj.contains(QLatin1String(
+            ChannelRegistry::channel(ChannelRegistry::Recv).wireField)))
+      continue;
+
+    AcquisitionPipeline::Sample sample;
+    AcquisitionPipeline::parseChannels(obj, sample);
+    if (m_pipeline->persist(
+            sample, AcquisitionPipeline::frameMeta(obj, f.receivedMs)))
+      ++imported;
+  }
+
+  appendLog(QString("Imported %1 recovered frame(s) into %2")
+                .arg(imported)
+                .arg(m_currentProjectName),
+            false);
+  discardRecoveredFrames();
+  return imported;
+}
+
+void Backend::discardRecoveredFrames() {
+  m_recoveredFrames.clear();
+  m_pipeline->journal()->compactInBackground(m_recoveredSegments);
+  m_recoveredSegments.clear();
+  emit recoveryChanged();
+}
+
+bool Backend::importJsonDump(const QString &folderUrl) {
+  if (m_importer)
+    return false;
+  QString dumpDir = QUrl(folderUrl).toLocalFile();
+  if (dumpDir.isEmpty())
+    dumpDir = folderUrl;
+
+  DatabaseManager &db = DatabaseManager::instance();
+  const QString dbPath = db.databasePath();
+  // Queued samples would otherwise race the dump for the same IDs
+  db.flushPendingSamples();
+
+  m_importer = new JsonDumpImporter;
+  QHash<QString, WaveformCodec::Codec> codecs;
+  for (const QString &column : ChannelRegistry::columns())
+    codecs.insert(column, db.columnCodec(column));
+  m_importer->setColumnCodecs(codecs);
+
+  // Emitted from the pool thread, delivered queued
+  connect(m_importer, &JsonDumpImporter::progress, this,
+          [this](qint64 done, qint64 total) {
+            m_importProgress = total > 0 ? double(done) / total : 0.0;
+            emit importChanged();
+          });
+  connect(m_importer, &JsonDumpImporter::tableImported, this,
+          [this](const QString &table, qint64 rows) {
+            appendLog(QString("Import: %1 rows into %2").arg(rows).arg(table),
+                      false);
+          });
+  connect(m_importer, &JsonDumpImporter::importError, this,
+          [this](const QString &err) { appendLog(err, true); });
+
+  m_importProgress = 0.0;
+  emit importChanged();
+  appendLog("Importing JSON dump from " + dumpDir, false);
+
+  QPointer<Backend> self(this);
+  JsonDumpImporter *importer = m_importer;
+  (void)QtConcurrent::run([self, importer, dumpDir, dbPath]() {
+    const bool ok = importer->importDirectory(dumpDir, dbPath);
+    QMetaObject::invokeMethod(
+        qApp,
+        [self, importer, ok]() {
+          const qint64 rows = importer->rowsImported();
+          const qint64 skipped = importer->rowsSkipped();
+          importer->deleteLater();
+          if (!self)
+            return;
+          self->m_importer = nullptr;
+          self->m_importProgress = ok ? 1.0 : self->m_importProgress;
+          self->appendLog(QString("Import %1: %2 rows, %3 skipped")
+                              .arg(ok ? "finished" : "stopped")
+                              .arg(rows)
+                              .arg(skipped),
+                          !ok);
+          self->m_projectTreeModel->reload(
+              DatabaseManager::instance().database());
+          emit self->importChanged();
+          emit self->projectTreeChanged();
+        },
+        Qt::QueuedConnection);
+  });
+  return true;
+}
+
+void Backend::cancelImport() {
+  if (m_importer)
+    m_importer->cancel();
+}
+
+void Backend::exportProjectArchive(const QString &fileUrl) {
+  QString path = QUrl(fileUrl).toLocalFile();
+  if (path.isEmpty())
+    path = fileUrl;
+  const QString dbPath = DatabaseManager::instance().databasePath();
+  // The archive must include what is still queued in the writer
+  DatabaseManager::instance().flushPendingSamples();
+
+  QPointer<Backend> self(this);
+  (void)QtConcurrent::run([self, dbPath, path]() {
+    QString error;
+    bool ok;
+    {
+      QSqlDatabase db =
+          ConnectionManager::connection(dbPath, ConnectionManager::ReadOnly);
+      ok = ProjectArchive::exportDatabase(db, path, &error);
+    }
+    ConnectionManager::release(dbPath);
+    QMetaObject::invokeMethod(
+        qApp,
+        [self, ok, path, error]() {
+          if (self)
+            self->appendLog(ok ? "Archive written: " + path
+                               : "Archive export failed: " + error,
+                            !ok);
+        },
+        Qt::QueuedConnection);
+  });
+}
+
+void Backend::importProjectArchive(const QString &fileUrl) {
+  QString path = QUrl(fileUrl).toLocalFile();
+  if (path.isEmpty())
+    path = fileUrl;
+  DatabaseManager &dbm = DatabaseManager::instance();
+  const QString dbPath = dbm.databasePath();
+  dbm.flushPendingSamples();
+
+  QHash<QString, WaveformCodec::Codec> codecs;
+  for (const QString &column : ChannelRegistry::columns())
+    codecs.insert(column, dbm.columnCodec(column));
+
+  QPointer<Backend> self(this);
+  (void)QtConcurrent::run([self, dbPath, path, codecs]() {
+    QString error;
+    bool ok;
+    {
+      QSqlDatabase db = ConnectionManager::connection(dbPath);
+      ok = ProjectArchive::importToDatabase(path, db, codecs, &error);
+    }
+    ConnectionManager::release(dbPath);
+    QMetaObject::invokeMethod(
+        qApp,
+        [self, ok, path, error]() {
+          if (!self)
+            return;
+          self->appendLog(ok ? "Archive imported: " + path
+                             : "Archive import failed: " + error,
+                          !ok);
+          self->m_projectTreeModel->reload(
+              DatabaseManager::instance().database());
+          emit self->projectTreeChanged();
+        },
+        Qt::QueuedConnection);
+  });
+}
+
+Backend::~Backend() {
+  if (m_syncThread.isRunning()) {
+    QMetaObject::invokeMethod(m_syncEngine, &SyncEngine::stop,
+                              Qt::BlockingQueuedConnection);
+    m_syncThread.quit();
+    m_syncThread.wait();
+  }
+  delete m_syncEngine;
+}
+
+void Backend::setSyncEndpoint(const QString &url) {
+  if (url == m_syncEndpoint)
+    return;
+  m_syncEndpoint = url;
+  emit syncChanged();
+  // A running sync follows the new endpoint from that endpoint's checkpoint
+  if (m_isSyncing)
+    startSync();
+}
+
+void Backend::startSync() {
+  const QUrl endpoint = QUrl::fromUserInput(m_syncEndpoint);
+  if (!endpoint.isValid()) {
+    appendLog("Sync: invalid endpoint " + m_syncEndpoint, true);
+    return;
+  }
+  const QString dbPath = DatabaseManager::instance().databasePath();
+  QMetaObject::invokeMethod(
+      m_syncEngine,
+      [engine = m_syncEngine, dbPath, endpoint]() {
+        engine->start(dbPath, endpoint);
+      },
+      Qt::QueuedConnection);
+  m_isSyncing = true;
+  emit syncChanged();
+  appendLog("Sync started to " + endpoint.toString(), false);
+}
+
+void Backend::stopSync() {
+  QMetaObject::invokeMethod(m_syncEngine, &SyncEngine::stop,
+                            Qt::QueuedConnection);
+  m_isSyncing = false;
+  emit syncChanged();
+  appendLog("Sync stopped", false);
 }
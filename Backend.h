@@ -1,13 +1,21 @@
 #ifndef BACKEND_H
 #define BACKEND_H
 
-#include "TcpClient.h"
+#include "AcquisitionPipeline.h"
+#include "JsonDumpImporter.h"
+#include "ProjectTreeModel.h"
+#include "SurveySequencer.h"
+#include "SyncEngine.h"
+#include <QElapsedTimer>
 #include <QFile>
+#include <QHash>
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QObject>
+#include <QSet>
 #include <QString>
+#include <QThread>
 #include <QTimer>
 #include <QVariantList>
 #include <QtCharts/QAbstractSeries>
@@ -21,20 +29,38 @@ class Backend : public QObject {
       QString targetIp READ targetIp WRITE setTargetIp NOTIFY targetIpChanged)
   Q_PROPERTY(
       int connectionState READ connectionState NOTIFY connectionStateChanged)
+  Q_PROPERTY(bool isRecordingSession READ isRecordingSession NOTIFY
+                 sessionRecordingChanged)
+
+  // Performance HUD: Metrics snapshot plus per-second rates of the
+  // counters ("<name>_per_s"), refreshed once a second while visible
+  Q_PROPERTY(bool perfHudVisible READ perfHudVisible WRITE setPerfHudVisible
+                 NOTIFY perfHudChanged)
+  Q_PROPERTY(QVariantMap perfStats READ perfStats NOTIFY perfStatsChanged)
 
   // Project Management
   Q_PROPERTY(
       QString currentProjectName READ currentProjectName NOTIFY projectChanged)
   Q_PROPERTY(QString currentDbPath READ currentDbPath NOTIFY projectChanged)
-  Q_PROPERTY(QVariantList projectTreeModel READ projectTreeModel NOTIFY
+  Q_PROPERTY(ProjectTreeModel *projectTreeModel READ projectTreeModel NOTIFY
                  projectTreeChanged)
 
   // Acquisition Status
   Q_PROPERTY(bool isAcquiring READ isAcquiring NOTIFY acquisitionChanged)
   Q_PROPERTY(QString currentPoint READ currentPoint WRITE setCurrentPoint NOTIFY
                  pointChanged)
+  // Data_Point.ID of the selected point, or -1 if only its label is known
+  Q_PROPERTY(int currentPointId READ currentPointId WRITE setCurrentPointId
+                 NOTIFY pointChanged)
   Q_PROPERTY(int progressPercent READ progressPercent NOTIFY progressChanged)
 
+  // Automatic survey: startAcquisition() walks the project's points from
+  // the current one, saving and advancing without the operator
+  Q_PROPERTY(bool autoAdvance READ autoAdvance WRITE setAutoAdvance NOTIFY
+                 surveyChanged)
+  Q_PROPERTY(bool isSurveyPaused READ isSurveyPaused NOTIFY surveyChanged)
+  Q_PROPERTY(QVariantMap surveyStats READ surveyStats NOTIFY surveyChanged)
+
   // Device Monitor Data
   Q_PROPERTY(
       double batteryVoltage READ batteryVoltage NOTIFY monitorDataChanged)
@@ -57,20 +83,57 @@ class Backend : public QObject {
                  setSampleTimeLength NOTIFY sampleTimeLengthChanged)
   Q_PROPERTY(QString customParams READ customParams WRITE setCustomParams NOTIFY
                  customParamsChanged)
+  // "full", "preview" (decimated preview first, full frame after) or
+  // "on_demand" (full frame only when saved); see AcquisitionPipeline
+  Q_PROPERTY(QString transferMode READ transferMode WRITE setTransferMode
+                 NOTIFY transferModeChanged)
+
+  // Crash recovery: frames journaled in an earlier session but never saved
+  Q_PROPERTY(int recoverableFrames READ recoverableFrames NOTIFY
+                 recoveryChanged)
+
+  // Legacy JSON dump import into the open project
+  Q_PROPERTY(bool isImporting READ isImporting NOTIFY importChanged)
+  Q_PROPERTY(double importProgress READ importProgress NOTIFY importChanged)
+
+  // Background upload to the collection server
+  Q_PROPERTY(QString syncEndpoint READ syncEndpoint WRITE setSyncEndpoint
+                 NOTIFY syncChanged)
+  Q_PROPERTY(bool isSyncing READ isSyncing NOTIFY syncChanged)
+  Q_PROPERTY(qint64 syncPending READ syncPending NOTIFY syncChanged)
 
 public:
   explicit Backend(QObject *parent = nullptr);
+  ~Backend();
+
+  // Opens the default AppData project and loads its tree. main() calls it
+  // once the window has drawn its first frame; a project the user opened
+  // before then is kept.
+  void initializeStorage();
+
+  // The device pipeline behind this backend, for tools that feed it
+  // frames directly (tem_bench)
+  AcquisitionPipeline *pipeline() const { return m_pipeline; }
 
   // Getters
   QString targetIp() const { return m_targetIp; }
   int connectionState() const { return m_connectionState; }
+  bool isRecordingSession() const { return m_pipeline->isRecording(); }
+  bool perfHudVisible() const { return m_perfTimer.isActive(); }
+  QVariantMap perfStats() const { return m_perfStats; }
   bool isAcquiring() const { return m_isAcquiring; }
   QString currentPoint() const { return m_currentPoint; }
+  int currentPointId() const { return m_currentPointId; }
   int progressPercent() const { return m_progressPercent; }
+  bool autoAdvance() const { return m_autoAdvance; }
+  bool isSurveyPaused() const {
+    return m_sequencer->state() == SurveySequencer::Paused;
+  }
+  QVariantMap surveyStats() const { return m_sequencer->stats(); }
 
   QString currentProjectName() const { return m_currentProjectName; }
   QString currentDbPath() const { return m_currentDbPath; }
-  QVariantList projectTreeModel() const { return m_projectTreeModel; }
+  ProjectTreeModel *projectTreeModel() const { return m_projectTreeModel; }
 
   double batteryVoltage() const { return m_batteryVoltage; }
   double internalTemp() const { return m_internalTemp; }
@@ -84,20 +147,35 @@ public:
   int stackCount() const { return m_stackCount; }
   int sampleTimeLength() const { return m_sampleTimeLength; }
   QString customParams() const { return m_customParams; }
+  QString transferMode() const { return m_transferMode; }
   QStringList logMessages() const { return m_logMessages; }
+  int recoverableFrames() const { return m_recoveredFrames.size(); }
+  bool isImporting() const { return m_importer != nullptr; }
+  double importProgress() const { return m_importProgress; }
+  QString syncEndpoint() const { return m_syncEndpoint; }
+  bool isSyncing() const { return m_isSyncing; }
+  qint64 syncPending() const { return m_syncPending; }
 
   // Setters
   void setTargetIp(const QString &ip);
   void setCurrentPoint(const QString &point);
+  void setCurrentPointId(int pointId);
+  void setSyncEndpoint(const QString &url);
+  void setPerfHudVisible(bool visible);
+  void setAutoAdvance(bool enabled);
   Q_INVOKABLE void setSendCurrent(double current);
   Q_INVOKABLE void setSampleRate(int rate);
   Q_INVOKABLE void setStackCount(int count);
   Q_INVOKABLE void setSampleTimeLength(int length);
   Q_INVOKABLE void setCustomParams(const QString &params);
+  Q_INVOKABLE void setTransferMode(const QString &mode);
 
   // Project Expose to QML
   Q_INVOKABLE bool createProjectDB(const QString &fileUrl);
   Q_INVOKABLE bool openProjectDB(const QString &fileUrl);
+  // Waveform codec per Data_Sample column ("raw", "gorilla", "delta-zigzag")
+  Q_INVOKABLE bool setColumnCodec(const QString &column,
+                                  const QString &codecName);
 
   // Expose methods to QML
   // Read-only properties for UI display
@@ -105,23 +183,50 @@ public:
 
   Q_INVOKABLE void connectDevice();
   Q_INVOKABLE void disconnectDevice();
+
+  // Raw session capture, and replay of a capture in place of the device
+  // (speed 1 = original timing, 0 = as fast as possible)
+  Q_INVOKABLE bool startSessionRecording(const QString &fileUrl);
+  Q_INVOKABLE void stopSessionRecording();
+  Q_INVOKABLE bool replaySession(const QString &fileUrl, double speed = 1.0);
   Q_INVOKABLE void startAcquisition();
   Q_INVOKABLE void stopAcquisition();
   Q_INVOKABLE void skipPoint();
+  Q_INVOKABLE void retryPoint();
   Q_INVOKABLE void copyPreviousPointParams();
   Q_INVOKABLE void savePointData(bool isQualified, const QString &remark);
 
-  // Waveform Series Updaters
-  Q_INVOKABLE void updateRecvSeries(QAbstractSeries *series);
-  Q_INVOKABLE void updateSendSeries(QAbstractSeries *series);
-  Q_INVOKABLE void updateOffSeries(QAbstractSeries *series);
+  // Journal recovery (offered on startup when recoverableFrames > 0)
+  Q_INVOKABLE int importRecoveredFrames();
+  Q_INVOKABLE void discardRecoveredFrames();
+
+  // Stream DB_js-style table dumps (Data_*.json) into the open project
+  Q_INVOKABLE bool importJsonDump(const QString &folderUrl);
+  Q_INVOKABLE void cancelImport();
+
+  // Columnar .tema archive of the open project, and back (both async)
+  Q_INVOKABLE void exportProjectArchive(const QString &fileUrl);
+  Q_INVOKABLE void importProjectArchive(const QString &fileUrl);
+
+  // Upload samples of the open project to syncEndpoint until stopped
+  Q_INVOKABLE void startSync();
+  Q_INVOKABLE void stopSync();
+
+  // Chart of one ChannelRegistry channel ("recv", "send", "off", ...) of
+  // the latest sample
+  Q_INVOKABLE void updateChannelSeries(QAbstractSeries *series,
+                                       const QString &channel);
 
 signals:
   void targetIpChanged();
   void connectionStateChanged();
+  void sessionRecordingChanged();
+  void perfHudChanged();
+  void perfStatsChanged();
   void acquisitionChanged();
   void pointChanged();
   void progressChanged();
+  void surveyChanged();
   void monitorDataChanged();
   void waveformChanged();
   void projectChanged();
@@ -133,6 +238,10 @@ signals:
   void stackCountChanged();
   void sampleTimeLengthChanged();
   void customParamsChanged();
+  void transferModeChanged();
+  void recoveryChanged();
+  void importChanged();
+  void syncChanged();
 
   // Signal to push log messages to QML
   void logMessage(const QString &msg, bool isWarning = false);
@@ -142,21 +251,39 @@ public slots:
 
 private slots:
   void onTcpStateChanged(TcpClient::ConnectionState newState);
-  void onTcpDataReceived(const QByteArray &data);
+  void onSampleReceived(const AcquisitionPipeline::Sample &sample);
   void onTcpError(const QString &errorMsg);
 
 private:
   void syncParamsToSimulator();
+  QVariantMap acquisitionParams() const;
+  bool startSurvey();
+  void onSurveyPointStarted(int index);
+  // Plan index of the selected point (call loadPlan() first), or -1
+  int currentPlanIndex() const;
+  void selectPlanPoint(const SurveySequencer::PlanPoint &point);
+  void onDeviceReply(const QJsonObject &reply);
+  bool persistSample(const AcquisitionPipeline::Sample &sample,
+                     const QVariantMap &meta, const QString &point);
+  void refreshPreview();
+  void flushLogSummary();
+  void updateSeries(QAbstractSeries *series, int channel);
+  void updatePerfStats();
 
 private:
   QString m_currentProjectName = "新建工程";
   QString m_currentDbPath = "";
-  QVariantList m_projectTreeModel;
+  ProjectTreeModel *m_projectTreeModel;
 
   QString m_targetIp = "192.168.1.100";
   int m_connectionState = 0; // 0: Disconnected, 1: Connecting, 2: Connected
   bool m_isAcquiring = false;
   QString m_currentPoint = "P004";
+  // The selected point's Data_Point.ID and line; a label typed in keeps
+  // the line, so it is looked up there and not on the first line that
+  // has it
+  int m_currentPointId = -1;
+  int m_currentLineId = -1;
   int m_progressPercent = 0;
 
   double m_batteryVoltage = 12.4;
@@ -165,6 +292,15 @@ private:
 
   QVariantList m_recvWaveform;
   QVariantList m_sendWaveform;
+  // Samples arriving in one read burst share a single chart preview
+  QTimer m_previewTimer;
+  // Chart points per registry channel
+  QVector<BufferRing<QList<QPointF>>> m_channelPoints;
+
+  QTimer m_perfTimer;
+  QElapsedTimer m_perfClock;
+  QVariantMap m_perfStats;
+  QHash<QString, qint64> m_perfLastCounts;
 
   // Acquisition Parameters
   double m_sendCurrent = 10.0;
@@ -172,25 +308,49 @@ private:
   int m_stackCount = 16;
   int m_sampleTimeLength = 2048;
   QString m_customParams = "";
+  QString m_transferMode = "full";
   QStringList m_logMessages;
-
-  QTimer *m_statusTimer; // Poll device status
-  QJsonArray m_mockDataArray;
-  // TCP & Data Parsing
-  TcpClient *m_tcpClient;
-  QByteArray m_tcpBuffer;
+  // Received frames and committed samples since the last summary line
+  QTimer m_logSummaryTimer;
+  int m_framesSinceLog = 0;
+  int m_lastFrameBytes = 0;
+  int m_committedSinceLog = 0;
+  int m_lastCommittedId = -1;
+
+  bool m_storageReady = false; // a project database is open
+  // Device link, framing, journal and persistence
+  AcquisitionPipeline *m_pipeline;
   int m_currentSampleIndex;
-  int m_sendFs = 25;     // Send sample rate (Hz)
-  int m_offFs = 2000000; // Off sample rate (Hz)
-
-  // Temporary storage for latest parsed structural data
-  struct ParsedSample {
-    int pointId;
-    QVector<double> recvData;
-    QVector<double> sendData;
-    QVector<double> offData;
+  SurveySequencer *m_sequencer;
+  bool m_autoAdvance = false;
+
+  // Latest parsed sample, shown and saved on request; a preview until its
+  // full frame arrives
+  AcquisitionPipeline::Sample m_latestSample;
+  // Frames shown as a preview whose full frame has not arrived yet
+  QSet<int> m_previewedFrames;
+  // A save requested while only the preview was in
+  struct PendingSave {
+    int frameId = -1;
+    QVariantMap meta;
+    QString point;
   };
-  ParsedSample m_latestSample;
+  PendingSave m_pendingSave;
+
+  // What an earlier session left in the journal
+  QList<AcquisitionJournal::RecoveredFrame> m_recoveredFrames;
+  QStringList m_recoveredSegments;
+
+  // Running dump import, if any
+  JsonDumpImporter *m_importer = nullptr;
+  double m_importProgress = 0.0;
+
+  // Sync engine on its own thread, like the sample writer
+  QThread m_syncThread;
+  SyncEngine *m_syncEngine;
+  QString m_syncEndpoint = "http://127.0.0.1:8090/samples";
+  bool m_isSyncing = false;
+  qint64 m_syncPending = 0;
 };
 
 #endif // BACKEND_H
@@ -0,0 +1,557 @@
+#include "BatchExporter.h"
+#include "ChannelRegistry.h"
+#include "ConnectionManager.h"
+#include "LineProfile.h"
+#include "WaveformCodec.h"
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMap>
+#include <QMutexLocker>
+#include <QSemaphore>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QThread>
+#include <QThreadPool>
+#include <QVector>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+static_assert(Q_BYTE_ORDER == Q_LITTLE_ENDIAN,
+              "raw and npy exports write native floats as little-endian");
+
+namespace {
+
+struct ExportJob {
+  qint64 seq = 0;
+  qint64 sampleId = 0;
+  int pointId = 0;
+  QString pointName;
+  QString lineName;
+  double sendFs = 0.0; // SendFs as stored
+  qint64 startTime = 0;
+  // Encoded column values in registry order, decoded on the worker
+  ChannelArray<QVariant> columns;
+  // Values per second of each channel; 0 for channels without a rate
+  ChannelArray<int> rates;
+};
+
+using Channels = QVector<QVector<float>>;
+
+int longest(const Channels &channels) {
+  int n = 0;
+  for (const QVector<float> &c : channels)
+    n = qMax(n, int(c.size()));
+  return n;
+}
+
+// Where a channel's values sit in time: the positions of its axis channel
+// when they line up with it, else evenly spaced at its rate
+struct TimeAxis {
+  const QVector<float> *positionsUs = nullptr;
+  double dtUs = 0.0;
+
+  bool isValid() const { return positionsUs || dtUs > 0.0; }
+  double at(int i) const { return positionsUs ? (*positionsUs)[i] : i * dtUs; }
+};
+
+TimeAxis timeAxis(const ExportJob &job, const Channels &channels, int c) {
+  TimeAxis axis;
+  const int a = ChannelRegistry::axisOf(c);
+  if (a >= 0 && !channels[a].isEmpty() &&
+      channels[a].size() == channels[c].size())
+    axis.positionsUs = &channels[a];
+  else if (job.rates[c] > 0)
+    axis.dtUs = 1000000.0 / job.rates[c];
+  return axis;
+}
+
+// Formats into one large buffer and writes it in big blocks
+class ChunkWriter {
+public:
+  explicit ChunkWriter(QFile &file, int capacity = 1 << 20)
+      : m_file(file), m_buf(capacity, Qt::Uninitialized) {}
+  ~ChunkWriter() { flush(); }
+
+  void number(float v) {
+    char *p = reserve(32);
+    m_used += int(std::to_chars(p, p + 32, v).ptr - p);
+  }
+  void number(double v) {
+    char *p = reserve(32);
+    m_used += int(std::to_chars(p, p + 32, v).ptr - p);
+  }
+  void ch(char c) {
+    *reserve(1) = c;
+    ++m_used;
+  }
+  void text(const QByteArray &s) {
+    if (s.size() > m_buf.size()) {
+      flush();
+      write(s.constData(), s.size());
+      return;
+    }
+    memcpy(reserve(s.size()), s.constData(), s.size());
+    m_used += s.size();
+  }
+  void raw(const char *data, qint64 size) {
+    flush();
+    write(data, size);
+  }
+
+  bool flush() {
+    if (m_used > 0)
+      write(m_buf.constData(), m_used);
+    m_used = 0;
+    return m_ok;
+  }
+  bool ok() const { return m_ok; }
+  qint64 written() const { return m_written; }
+
+private:
+  char *reserve(int n) {
+    if (m_used + n > m_buf.size())
+      flush();
+    return m_buf.data() + m_used;
+  }
+  void write(const char *data, qint64 size) {
+    if (m_ok && m_file.write(data, size) != size)
+      m_ok = false;
+    m_written += size;
+  }
+
+  QFile &m_file;
+  QByteArray m_buf;
+  int m_used = 0;
+  bool m_ok = true;
+  qint64 m_written = 0;
+};
+
+QString safeName(const QString &s) {
+  QString out = s;
+  for (QChar &c : out)
+    if (!c.isLetterOrNumber() && c != '.' && c != '-')
+      c = '_';
+  return out;
+}
+
+QString baseName(const ExportJob &job) {
+  return QString("L%1_P%2_S%3")
+      .arg(safeName(job.lineName), safeName(job.pointName))
+      .arg(job.sampleId);
+}
+
+qint64 writeCsv(const QString &path, const ExportJob &job,
+                const Channels &channels, QString *error) {
+  QFile f(path);
+  if (!f.open(QIODevice::WriteOnly)) {
+    *error = path + ": " + f.errorString();
+    return -1;
+  }
+  // Channels have their own rates and lengths, so each one with a time
+  // axis gets its own time column ahead of its values
+  ChunkWriter w(f);
+  ChannelArray<TimeAxis> axes(channels.size());
+  QByteArray head;
+  for (int c = 0; c < channels.size(); ++c) {
+    const ChannelRegistry::Channel &channel = ChannelRegistry::channel(c);
+    axes[c] = timeAxis(job, channels, c);
+    if (c > 0)
+      head += ',';
+    if (axes[c].isValid())
+      head += QByteArray(channel.name) + "_t(us),";
+    head += QByteArray(channel.name) + '(' + channel.unit + ')';
+  }
+  w.text(head + '\n');
+  const int n = longest(channels);
+  for (int i = 0; i < n; ++i) {
+    for (int c = 0; c < channels.size(); ++c) {
+      if (c > 0)
+        w.ch(',');
+      const bool has = i < channels[c].size();
+      if (axes[c].isValid()) {
+        if (has)
+          w.number(axes[c].at(i));
+        w.ch(',');
+      }
+      if (has)
+        w.number(channels[c][i]);
+    }
+    w.ch('\n');
+  }
+  if (!w.flush()) {
+    *error = path + ": " + f.errorString();
+    return -1;
+  }
+  return w.written();
+}
+
+qint64 writeRaw(const QString &dir, const ExportJob &job,
+                const Channels &channels, QString *error) {
+  const QString base = QDir(dir).filePath(baseName(job));
+  QFile f(base + ".f32");
+  if (!f.open(QIODevice::WriteOnly)) {
+    *error = f.fileName() + ": " + f.errorString();
+    return -1;
+  }
+  // Channels back to back; the sidecar says where each one starts
+  QJsonArray parts;
+  qint64 offset = 0;
+  ChunkWriter w(f);
+  for (int c = 0; c < channels.size(); ++c) {
+    const ChannelRegistry::Channel &channel = ChannelRegistry::channel(c);
+    const qint64 bytes = qint64(channels[c].size()) * sizeof(float);
+    w.raw(reinterpret_cast<const char *>(channels[c].constData()), bytes);
+    QJsonObject part{{"name", channel.name},
+                     {"unit", channel.unit},
+                     {"offset", offset},
+                     {"count", channels[c].size()}};
+    // How to place the values in time: by another channel's positions
+    // (us), or at a rate
+    if (const TimeAxis axis = timeAxis(job, channels, c); axis.positionsUs)
+      part.insert("axis",
+                  ChannelRegistry::channel(ChannelRegistry::axisOf(c)).name);
+    else if (axis.isValid())
+      part.insert("rate", job.rates[c]);
+    parts.append(part);
+    offset += bytes;
+  }
+  if (!w.flush()) {
+    *error = f.fileName() + ": " + f.errorString();
+    return -1;
+  }
+
+  const QJsonObject meta{{"dtype", "float32"},
+                         {"byteOrder", "little"},
+                         {"sampleId", job.sampleId},
+                         {"pointId", job.pointId},
+                         {"point", job.pointName},
+                         {"line", job.lineName},
+                         {"sendFs", job.sendFs},
+                         {"startTime", job.startTime},
+                         {"channels", parts}};
+  QFile side(base + ".json");
+  const QByteArray json = QJsonDocument(meta).toJson();
+  if (!side.open(QIODevice::WriteOnly) || side.write(json) != json.size()) {
+    *error = side.fileName() + ": " + side.errorString();
+    return -1;
+  }
+  return offset + json.size();
+}
+
+qint64 writeNpy(const QString &path, const Channels &channels,
+                QString *error) {
+  QFile f(path);
+  if (!f.open(QIODevice::WriteOnly)) {
+    *error = path + ": " + f.errorString();
+    return -1;
+  }
+  const int n = longest(channels);
+  const int width = channels.size();
+  // Format 1.0: magic, version, u16 header length, header padded so the
+  // data starts 64-byte aligned
+  QByteArray header =
+      QString("{'descr': '<f4', 'fortran_order': False, 'shape': (%1, %2), }")
+          .arg(n)
+          .arg(width)
+          .toLatin1();
+  const int prefix = 10;
+  const int total = (prefix + header.size() + 1 + 63) / 64 * 64;
+  header.append(QByteArray(total - prefix - header.size() - 1, ' '));
+  header.append('\n');
+
+  ChunkWriter w(f);
+  w.text(QByteArray("\x93NUMPY\x01\x00", 8));
+  const quint16 len = quint16(header.size());
+  w.text(QByteArray(reinterpret_cast<const char *>(&len), 2));
+  w.text(header);
+
+  // Row-major N x channels, NaN where a channel is shorter
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+  ChannelArray<float> row(width);
+  for (int i = 0; i < n; ++i) {
+    for (int c = 0; c < width; ++c)
+      row[c] = i < channels[c].size() ? channels[c][i] : nan;
+    w.text(QByteArray::fromRawData(reinterpret_cast<const char *>(row.data()),
+                                   width * qsizetype(sizeof(float))));
+  }
+  if (!w.flush()) {
+    *error = path + ": " + f.errorString();
+    return -1;
+  }
+  return w.written();
+}
+
+// Rows arrive from the workers out of order and go out in sample order;
+// only rows ahead of a slow sample are held
+class XyzSink {
+public:
+  bool open(const QString &path, QString *error) {
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::WriteOnly)) {
+      *error = path + ": " + m_file.errorString();
+      return false;
+    }
+    const QVector<double> edges = LineProfile::gateEdgesUs();
+    QByteArray head = "/ TEM gated export\n/ Gate centres (us):";
+    for (int g = 0; g < LineProfile::kGateCount; ++g)
+      head += ' ' + QByteArray::number(std::sqrt(edges[g] * edges[g + 1]), 'g',
+                                       6);
+    head += "\n/ LINE STATION SAMPLE STARTTIME";
+    for (int g = 0; g < LineProfile::kGateCount; ++g)
+      head += QString(" G%1").arg(g + 1, 2, 10, QChar('0')).toLatin1();
+    head += '\n';
+    return m_file.write(head) == head.size();
+  }
+
+  void put(qint64 seq, const QByteArray &row) {
+    QMutexLocker lock(&m_mutex);
+    m_pending.insert(seq, row);
+    while (!m_pending.isEmpty() && m_pending.firstKey() == m_next) {
+      m_file.write(m_pending.first());
+      m_pending.erase(m_pending.begin());
+      ++m_next;
+    }
+  }
+  // A failed or skipped sample must not stall the rows behind it
+  void skip(qint64 seq) { put(seq, QByteArray()); }
+
+  bool close() {
+    m_file.close();
+    return m_file.error() == QFile::NoError;
+  }
+  bool isOpen() const { return m_file.isOpen(); }
+
+private:
+  QFile m_file;
+  QMutex m_mutex;
+  QMap<qint64, QByteArray> m_pending;
+  qint64 m_next = 0;
+};
+
+QByteArray xyzRow(const ExportJob &job, const Channels &channels) {
+  // Same gating as the line profile: at DATA_RECV_POS, else at RecvFs
+  const QVector<float> gates =
+      LineProfile::gate(channels[ChannelRegistry::Recv],
+                        job.rates[ChannelRegistry::Recv],
+                        channels[ChannelRegistry::RecvPos]);
+  QByteArray row;
+  row.reserve(32 + gates.size() * 16);
+  row += safeName(job.lineName).toLatin1() + ' ' +
+         safeName(job.pointName).toLatin1() + ' ' +
+         QByteArray::number(job.sampleId) + ' ' +
+         QByteArray::number(job.startTime);
+  char buf[32];
+  for (float g : gates) {
+    row += ' ';
+    if (std::isnan(g)) {
+      row += '*'; // Geosoft dummy
+      continue;
+    }
+    row.append(buf, int(std::to_chars(buf, buf + sizeof(buf), g).ptr - buf));
+  }
+  row += '\n';
+  return row;
+}
+
+} // namespace
+
+BatchExporter::BatchExporter(QObject *parent)
+    : QObject(parent), m_threads(qMax(2, QThread::idealThreadCount())) {}
+
+BatchExporter::Formats
+BatchExporter::formatsFromNames(const QStringList &names) {
+  Formats formats;
+  for (const QString &name : names) {
+    const QString n = name.trimmed().toLower();
+    if (n == "csv")
+      formats |= Csv;
+    else if (n == "raw" || n == "f32")
+      formats |= RawBinary;
+    else if (n == "npy")
+      formats |= Npy;
+    else if (n == "xyz")
+      formats |= GatedXyz;
+  }
+  return formats;
+}
+
+bool BatchExporter::exportPoint(const QString &dbPath, int pointId,
+                                const QString &destDir) {
+  return run(dbPath, "s.Data_PointID = ?", {pointId}, destDir,
+             QString("point_%1_gated.xyz").arg(pointId));
+}
+
+bool BatchExporter::exportLine(const QString &dbPath, int lineId,
+                               const QString &destDir) {
+  return run(dbPath, "p.Data_LineID = ?", {lineId}, destDir,
+             QString("line_%1_gated.xyz").arg(lineId));
+}
+
+bool BatchExporter::exportProject(const QString &dbPath,
+                                  const QString &destDir) {
+  return run(dbPath, "1", {}, destDir, "project_gated.xyz");
+}
+
+void BatchExporter::fail(const QString &error) {
+  if (m_failed.exchange(true))
+    return; // the first error is the useful one
+  emit exportError("Export failed: " + error);
+}
+
+bool BatchExporter::run(const QString &dbPath, const QString &whereClause,
+                        const QVariantList &binds, const QString &destDir,
+                        const QString &xyzName) {
+  m_cancelled = false;
+  m_failed = false;
+  m_done = 0;
+  m_bytes = 0;
+
+  if (!QDir().mkpath(destDir)) {
+    fail("cannot create " + destDir);
+    return false;
+  }
+  QSqlDatabase db =
+      ConnectionManager::connection(dbPath, ConnectionManager::ReadOnly);
+  if (!db.isOpen()) {
+    fail("connection: " + db.lastError().text());
+    return false;
+  }
+
+  const QString from = "FROM Data_Sample s "
+                       "JOIN Data_Point p ON p.ID = s.Data_PointID "
+                       "LEFT JOIN Data_Line l ON l.ID = p.Data_LineID "
+                       "WHERE " +
+                       whereClause;
+  qint64 total = 0;
+  {
+    QSqlQuery count(db);
+    count.prepare("SELECT COUNT(*) " + from);
+    for (const QVariant &v : binds)
+      count.addBindValue(v);
+    if (count.exec() && count.next())
+      total = count.value(0).toLongLong();
+  }
+
+  QSqlQuery q(db);
+  q.setForwardOnly(true);
+  // Waveform columns, then the rate column of each channel that has one
+  const QVector<ChannelRegistry::Channel> &registry =
+      ChannelRegistry::channels();
+  const int channelCount = registry.size();
+  QString columns = "s." + ChannelRegistry::columns().join(", s.");
+  ChannelArray<int> rateField(channelCount);
+  int field = 6 + channelCount;
+  for (int c = 0; c < channelCount; ++c) {
+    rateField[c] = registry[c].rateField ? field++ : -1;
+    if (registry[c].rateField)
+      columns += QString(", s.") + registry[c].rateField;
+  }
+  q.prepare("SELECT s.ID, s.Data_PointID, p.NAME, l.NAME, s.SendFs, "
+            "s.StartTime, " +
+            columns + " " + from + " ORDER BY p.Data_LineID, p.ID, s.ID");
+  for (const QVariant &v : binds)
+    q.addBindValue(v);
+  if (!q.exec()) {
+    fail(q.lastError().text());
+    return false;
+  }
+
+  XyzSink xyz;
+  QString error;
+  if (m_formats.testFlag(GatedXyz) &&
+      !xyz.open(QDir(destDir).filePath(xyzName), &error)) {
+    fail(error);
+    return false;
+  }
+
+  QThreadPool pool;
+  pool.setMaxThreadCount(m_threads);
+  // Bounds the decoded samples alive at once
+  QSemaphore inFlight(m_threads * 2);
+  const Formats formats = m_formats;
+  emit progress(0, total);
+
+  qint64 seq = 0;
+  while (q.next() && !m_cancelled && !m_failed) {
+    ExportJob job;
+    job.seq = seq++;
+    job.sampleId = q.value(0).toLongLong();
+    job.pointId = q.value(1).toInt();
+    job.pointName = QString::number(q.value(2).toDouble());
+    job.lineName = q.isNull(3) ? QString("0")
+                               : QString::number(q.value(3).toDouble());
+    job.sendFs = q.value(4).toDouble();
+    job.startTime = q.value(5).toLongLong();
+    job.columns.resize(channelCount);
+    job.rates.resize(channelCount);
+    for (int c = 0; c < channelCount; ++c) {
+      job.columns[c] = q.value(6 + c);
+      const int rate = rateField[c] < 0 ? 0 : q.value(rateField[c]).toInt();
+      job.rates[c] = rateField[c] < 0 ? 0
+                     : rate > 0       ? rate
+                                      : registry[c].defaultRate;
+    }
+
+    inFlight.acquire();
+    pool.start([this, job, formats, destDir, total, &inFlight, &xyz]() {
+      if (m_cancelled || m_failed) {
+        if (xyz.isOpen())
+          xyz.skip(job.seq);
+        inFlight.release();
+        return;
+      }
+      Channels channels(job.columns.size());
+      for (int c = 0; c < job.columns.size(); ++c)
+        channels[c] = WaveformCodec::decode(job.columns[c]);
+      const QString base = QDir(destDir).filePath(baseName(job));
+
+      QString err;
+      qint64 bytes = 0;
+      auto add = [&](qint64 written) {
+        if (written < 0)
+          return false;
+        bytes += written;
+        return true;
+      };
+      bool ok = true;
+      if (ok && formats.testFlag(Csv))
+        ok = add(writeCsv(base + ".csv", job, channels, &err));
+      if (ok && formats.testFlag(RawBinary))
+        ok = add(writeRaw(destDir, job, channels, &err));
+      if (ok && formats.testFlag(Npy))
+        ok = add(writeNpy(base + ".npy", channels, &err));
+      if (xyz.isOpen()) {
+        if (ok)
+          xyz.put(job.seq, xyzRow(job, channels));
+        else
+          xyz.skip(job.seq);
+      }
+
+      if (!ok) {
+        fail(err);
+      } else {
+        m_bytes += bytes;
+        emit progress(++m_done, total);
+      }
+      inFlight.release();
+    });
+  }
+  pool.waitForDone();
+  q.finish();
+
+  if (xyz.isOpen() && !xyz.close() && !m_failed)
+    fail(xyzName + ": write error");
+
+  // Pool threads live on; don't leave their connection behind
+  if (QThread::currentThread() != QCoreApplication::instance()->thread())
+    ConnectionManager::release(dbPath);
+
+  return !m_failed && !m_cancelled;
+}
@@ -0,0 +1,71 @@
+#ifndef BATCHEXPORTER_H
+#define BATCHEXPORTER_H
+
+#include <QObject>
+#include <QString>
+#include <QVariantList>
+#include <atomic>
+
+// Batch export of stored samples: one point, one line or the whole project.
+//
+// The calling thread streams sample rows from the project; each sample is
+// decoded, formatted with std::to_chars into large buffers and written to
+// its own files on a worker pool. At most a few samples are in flight, so
+// memory stays bounded whatever the export size.
+//
+// Per sample, one column per ChannelRegistry row: CSV (each channel with
+// its own time column, from its axis channel's positions or its rate
+// field), little-endian float32 .f32 with a JSON sidecar, and NumPy .npy
+// (N x channels, NaN padded). Per export: a gated XYZ text file, one row
+// per sample with LineProfile's gates, for inversion software.
+class BatchExporter : public QObject {
+  Q_OBJECT
+public:
+  enum Format {
+    Csv = 0x1,
+    RawBinary = 0x2,
+    Npy = 0x4,
+    GatedXyz = 0x8
+  };
+  Q_DECLARE_FLAGS(Formats, Format)
+
+  explicit BatchExporter(QObject *parent = nullptr);
+
+  void setFormats(Formats formats) { m_formats = formats; }
+  void setThreadCount(int threads) { m_threads = qMax(1, threads); }
+
+  // Run on the calling thread (blocking) with its read-only connection
+  bool exportPoint(const QString &dbPath, int pointId, const QString &destDir);
+  bool exportLine(const QString &dbPath, int lineId, const QString &destDir);
+  bool exportProject(const QString &dbPath, const QString &destDir);
+
+  // Safe to call from any thread; samples already formatting still finish
+  void cancel() { m_cancelled = true; }
+
+  qint64 samplesExported() const { return m_done; }
+  qint64 bytesWritten() const { return m_bytes; }
+
+  // "csv,raw,npy,xyz" <-> flags
+  static Formats formatsFromNames(const QStringList &names);
+
+signals:
+  void progress(qint64 samplesDone, qint64 samplesTotal);
+  void exportError(const QString &errorStr);
+
+private:
+  bool run(const QString &dbPath, const QString &whereClause,
+           const QVariantList &binds, const QString &destDir,
+           const QString &xyzName);
+  void fail(const QString &error);
+
+  Formats m_formats = Csv;
+  int m_threads;
+  std::atomic<bool> m_cancelled{false};
+  std::atomic<qint64> m_done{0};
+  std::atomic<qint64> m_bytes{0};
+  std::atomic<bool> m_failed{false};
+};
+
+Q_DECLARE_OPERATORS_FOR_FLAGS(BatchExporter::Formats)
+
+#endif // BATCHEXPORTER_H
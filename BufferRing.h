@@ -0,0 +1,50 @@
+#ifndef BUFFERRING_H
+#define BUFFERRING_H
+
+#include "Metrics.h"
+#include <QVector>
+
+// Reusable implicitly shared buffers (QVector, QByteArray, QList).
+//
+// acquire() hands out a slot nobody else references any more. Callers fill
+// it in place, then pass copies downstream; the copies share the storage,
+// and once the last of them is dropped the slot is free again with its
+// capacity intact. After warm-up the ring stops growing and filling a
+// buffer costs no allocation.
+template <typename T> class BufferRing {
+public:
+  // misses counts slots the ring had to add because all were in use
+  explicit BufferRing(Metrics::Counter *misses = nullptr) : m_misses(misses) {}
+
+  T &acquire() {
+    for (int i = 0; i < m_slots.size(); ++i) {
+      m_next = (m_next + 1) % m_slots.size();
+      if (isFree(m_slots[m_next]))
+        return m_slots[m_next];
+    }
+    if (m_misses)
+      m_misses->add();
+    m_slots.append(T());
+    m_next = m_slots.size() - 1;
+    return m_slots[m_next];
+  }
+
+  // The slot acquire() returned last; a default value before the first
+  const T &current() const {
+    static const T empty;
+    return m_slots.isEmpty() ? empty : m_slots[m_next];
+  }
+  int size() const { return m_slots.size(); }
+
+  // Never allocated, or referenced only by the ring
+  static bool isFree(const T &buffer) {
+    return buffer.capacity() == 0 || buffer.isDetached();
+  }
+
+private:
+  QVector<T> m_slots;
+  int m_next = 0;
+  Metrics::Counter *m_misses;
+};
+
+#endif // BUFFERRING_H
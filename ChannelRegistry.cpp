@@ -0,0 +1,43 @@
+#include "ChannelRegistry.h"
+
+const QVector<ChannelRegistry::Channel> &ChannelRegistry::channels() {
+  // Wire format of DB_js/Data_Sample.json: big-endian float64. The gate
+  // widths and positions (us) of DATA_RECV travel alongside it.
+  static const QVector<Channel> table = {
+      {"recv", "DATA_RECV", Float64, BigEndian, "RecvFs", 625000,
+       "DATA_RECV", true, "recv_pos", "V"},
+      {"recv_len", "DATA_RECV_LEN", Float64, BigEndian, nullptr, 0,
+       "DATA_RECV_LEN", false, "recv_pos", "us"},
+      {"recv_pos", "DATA_RECV_POS", Float64, BigEndian, nullptr, 0,
+       "DATA_RECV_POS", false, nullptr, "us"},
+      {"send", "DATA_SEND", Float64, BigEndian, "SampleSendFs", 2000000,
+       "DATA_SEND", false, nullptr, "A"},
+      {"off", "DATA_SOFF", Float64, BigEndian, "SampleOffFs", 2000000,
+       "DATA_SOFF", true, nullptr, "V"},
+  };
+  return table;
+}
+
+const QStringList &ChannelRegistry::columns() {
+  static const QStringList names = [] {
+    QStringList out;
+    for (const Channel &c : channels())
+      out << QString::fromLatin1(c.column);
+    return out;
+  }();
+  return names;
+}
+
+int ChannelRegistry::indexOf(QByteArrayView name) {
+  const QVector<Channel> &table = channels();
+  for (int i = 0; i < table.size(); ++i) {
+    if (name == table[i].name)
+      return i;
+  }
+  return -1;
+}
+
+int ChannelRegistry::axisOf(int index) {
+  const char *axis = channel(index).axis;
+  return axis ? indexOf(axis) : -1;
+}
@@ -0,0 +1,60 @@
+#ifndef CHANNELREGISTRY_H
+#define CHANNELREGISTRY_H
+
+#include <QByteArrayView>
+#include <QStringList>
+#include <QVarLengthArray>
+#include <QVector>
+
+// The device data channels, described once.
+//
+// Decode (frame field, value type, byte order), storage (Data_Sample
+// column and the column of its sample rate) and display all iterate this
+// table, so a channel the device starts sending is a new row here and
+// nothing else. Rows are in Data_Sample column order; per-sample channel
+// arrays (ChannelArray) are indexed the same way.
+class ChannelRegistry {
+public:
+  enum DType { Float64, Float32, Int32, Int16 };
+  enum Endian { BigEndian, LittleEndian };
+
+  struct Channel {
+    const char *name;      // "recv": what QML and tools ask for
+    const char *wireField; // frame key; base64 of the raw values
+    DType dtype;
+    Endian endian;
+    // Frame key and Data_Sample column of the values per second, or
+    // nullptr for per-gate channels that follow another one
+    const char *rateField;
+    int defaultRate; // when the frame has no rate field
+    const char *column; // Data_Sample column, in its WaveformCodec
+    bool magnitude;     // plotted as |x| on a log axis
+    // Channel with the x position (us) of each value, or nullptr for
+    // evenly spaced values at the rate
+    const char *axis;
+    const char *unit; // of the values, for exports: "V", "A", "us"
+  };
+
+  // Rows every build has, for code that means one channel in particular
+  // (quality checks, the chart of gated values)
+  enum Builtin { Recv = 0, RecvLen, RecvPos, Send, Off };
+
+  // Inline capacity of ChannelArray; more rows spill to the heap
+  static constexpr int InlineCount = 8;
+
+  static const QVector<Channel> &channels();
+  static int count() { return channels().size(); }
+  static const Channel &channel(int index) { return channels()[index]; }
+  // Data_Sample column of each row, built once
+  static const QStringList &columns();
+  // Row of a channel by name, or -1
+  static int indexOf(QByteArrayView name);
+  // Row of the channel holding index's x positions, or -1
+  static int axisOf(int index);
+};
+
+// One value per channel, in registry order, without a heap allocation
+template <typename T>
+using ChannelArray = QVarLengthArray<T, ChannelRegistry::InlineCount>;
+
+#endif // CHANNELREGISTRY_H
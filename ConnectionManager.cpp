@@ -0,0 +1,127 @@
+#include "ConnectionManager.h"
+#include "StatementCache.h"
+#include <QDebug>
+#include <QFileInfo>
+#include <QHash>
+#include <QMutex>
+#include <QSet>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QStringList>
+#include <QThread>
+
+namespace {
+
+QMutex &registryMutex() {
+  static QMutex mutex;
+  return mutex;
+}
+
+// Connection names opened by each live thread
+QHash<QThread *, QStringList> &registry() {
+  static QHash<QThread *, QStringList> names;
+  return names;
+}
+
+QString canonical(const QString &dbPath) {
+  QFileInfo fi(dbPath);
+  return fi.exists() ? fi.canonicalFilePath() : fi.absoluteFilePath();
+}
+
+QString connectionName(const QString &path, ConnectionManager::Mode mode,
+                       QThread *thread) {
+  return QString("tem_%1_%2_%3")
+      .arg(mode == ConnectionManager::ReadOnly ? "ro" : "rw")
+      .arg(reinterpret_cast<quintptr>(thread), 0, 16)
+      .arg(path);
+}
+
+void closeConnection(const QString &name) {
+  StatementCache::release(name);
+  {
+    QSqlDatabase db = QSqlDatabase::database(name, false);
+    if (db.isOpen())
+      db.close();
+  }
+  QSqlDatabase::removeDatabase(name);
+}
+
+void trackForThread(QThread *thread, const QString &name) {
+  QMutexLocker lock(&registryMutex());
+  auto it = registry().find(thread);
+  if (it == registry().end()) {
+    registry().insert(thread, {name});
+    // finished is emitted on the thread itself, so its connections are
+    // still usable here
+    QObject::connect(thread, &QThread::finished, [thread]() {
+      QStringList names;
+      {
+        QMutexLocker lock(&registryMutex());
+        names = registry().take(thread);
+      }
+      for (const QString &n : std::as_const(names))
+        closeConnection(n);
+    });
+  } else if (!it->contains(name)) {
+    it->append(name);
+  }
+}
+
+} // namespace
+
+QSqlDatabase ConnectionManager::connection(const QString &dbPath, Mode mode) {
+  const QString path = canonical(dbPath);
+  QThread *thread = QThread::currentThread();
+  const QString name = connectionName(path, mode, thread);
+
+  if (QSqlDatabase::contains(name)) {
+    QSqlDatabase db = QSqlDatabase::database(name, false);
+    if (db.isOpen() || db.open())
+      return db;
+  }
+
+  QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", name);
+  db.setDatabaseName(path);
+  QString options = "QSQLITE_BUSY_TIMEOUT=5000";
+  if (mode == ReadOnly)
+    options += ";QSQLITE_OPEN_READONLY";
+  db.setConnectOptions(options);
+
+  if (!db.open()) {
+    qDebug() << "ConnectionManager: open failed" << path << db.lastError();
+    return db;
+  }
+
+  QSqlQuery pragma(db);
+  if (mode == ReadWrite) {
+    // Only takes on a file with no tables yet, and only before WAL is
+    // switched on; a no-op for existing projects
+    pragma.exec("PRAGMA page_size = 8192");
+    pragma.exec("PRAGMA journal_mode = WAL");
+    pragma.exec("PRAGMA synchronous = NORMAL");
+  } else {
+    pragma.exec("PRAGMA query_only = 1");
+  }
+
+  trackForThread(thread, name);
+  return db;
+}
+
+void ConnectionManager::release(const QString &dbPath) {
+  release(dbPath, ReadWrite);
+  release(dbPath, ReadOnly);
+}
+
+void ConnectionManager::release(const QString &dbPath, Mode mode) {
+  QThread *thread = QThread::currentThread();
+  const QString name = connectionName(canonical(dbPath), mode, thread);
+  if (!QSqlDatabase::contains(name))
+    return;
+  {
+    QMutexLocker lock(&registryMutex());
+    auto it = registry().find(thread);
+    if (it != registry().end())
+      it->removeAll(name);
+  }
+  closeConnection(name);
+}
@@ -0,0 +1,29 @@
+#ifndef CONNECTIONMANAGER_H
+#define CONNECTIONMANAGER_H
+
+#include <QSqlDatabase>
+#include <QString>
+
+// Hands out SQLite connections per (database file, thread, mode). Qt SQL
+// connections may only be used on the thread that created them, so every
+// thread that touches a project gets its own, opened on first use and
+// closed when that thread finishes. Any number of project files can be
+// open at once. Files run in WAL mode with a busy timeout, so readers never
+// wait on the writer.
+class ConnectionManager {
+public:
+  enum Mode { ReadWrite, ReadOnly };
+
+  // Connection for the calling thread; invalid if the file cannot be
+  // opened (see lastError() on the returned object).
+  static QSqlDatabase connection(const QString &dbPath,
+                                 Mode mode = ReadWrite);
+
+  // Close the calling thread's connections to dbPath (both modes)
+  static void release(const QString &dbPath);
+  // Close only the calling thread's connection of that mode; readers on a
+  // thread that also writes (the GUI thread) must not drop its writer
+  static void release(const QString &dbPath, Mode mode);
+};
+
+#endif // CONNECTIONMANAGER_H
@@ -1,35 +1,92 @@
 #include "DatabaseManager.h"
+#include "ConnectionManager.h"
+#include "Metrics.h"
+#include "SampleWriter.h"
+#include "StatementCache.h"
 #include <QDateTime>
 #include <QDebug>
 #include <QSqlError>
 #include <QSqlQuery>
+#include <QStringList>
+
+namespace {
+
+// Lowered by SampleWriter once the row is committed
+Metrics::Gauge &writerQueueDepth = Metrics::gauge(
+    "tem_db_queue_samples",
+    "Samples queued for the writer and not yet committed");
+
+} // namespace
 
 DatabaseManager &DatabaseManager::instance() {
   static DatabaseManager _instance;
   return _instance;
 }
 
-DatabaseManager::DatabaseManager(QObject *parent) : QObject(parent) {}
+DatabaseManager::DatabaseManager(QObject *parent) : QObject(parent) {
+  m_writerThread.setObjectName("SampleWriter");
+  m_writer = new SampleWriter;
+  m_writer->moveToThread(&m_writerThread);
+
+  // Writer signals arrive queued on the GUI thread
+  connect(m_writer, &SampleWriter::samplesSaved, this,
+          [this](const QList<int> &ids, const QList<int> &pointIds,
+                 const QList<qint64> &journalSeqs) {
+            for (int i = 0; i < ids.size(); ++i) {
+              emit dataSaved(ids[i]);
+              emit sampleAdded(ids[i], pointIds.value(i, -1));
+            }
+            emit journalFramesSaved(journalSeqs);
+          });
+  connect(m_writer, &SampleWriter::writeError, this,
+          &DatabaseManager::databaseError);
+
+  m_writerThread.start();
+}
 
 DatabaseManager::~DatabaseManager() {
-  if (m_db.isOpen()) {
-    m_db.close();
+  if (m_writerThread.isRunning()) {
+    QMetaObject::invokeMethod(m_writer, &SampleWriter::close,
+                              Qt::BlockingQueuedConnection);
+    m_writerThread.quit();
+    m_writerThread.wait();
   }
+  delete m_writer;
 }
 
 bool DatabaseManager::initialize(const QString &dbPath) {
+  // Switches the active project. Playback and background workers keep
+  // their own pooled connections to earlier projects; only this GUI-thread
+  // writer is closed, so the old file and its WAL are not held open.
+  const QString previous = m_dbPath;
   m_dbPath = dbPath;
-  m_db = QSqlDatabase::addDatabase("QSQLITE");
-  m_db.setDatabaseName(dbPath);
+  m_db = ConnectionManager::connection(dbPath, ConnectionManager::ReadWrite);
+  if (!previous.isEmpty() && previous != dbPath) {
+    // Queued, so models still holding the old handle reload first
+    QMetaObject::invokeMethod(
+        this,
+        [this, previous]() {
+          if (previous != m_dbPath)
+            ConnectionManager::release(previous, ConnectionManager::ReadWrite);
+        },
+        Qt::QueuedConnection);
+  }
 
-  if (!m_db.open()) {
+  if (!m_db.isOpen()) {
     qDebug() << "Error: connection with database failed" << m_db.lastError();
     emit databaseError("Connection failed: " + m_db.lastError().text());
     return false;
   }
 
   qDebug() << "Database: connection ok";
-  return createTablesIfNotExist();
+  if (!createTablesIfNotExist())
+    return false;
+
+  // Queued after any pending samples, so those still land in the old file
+  QMetaObject::invokeMethod(
+      m_writer, [w = m_writer, dbPath]() { w->open(dbPath); },
+      Qt::QueuedConnection);
+  return true;
 }
 
 bool DatabaseManager::createTablesIfNotExist() {
@@ -110,6 +167,28 @@ bool DatabaseManager::createTablesIfNotExist() {
     return false;
   }
 
+  // Channels added to ChannelRegistry after the file was created
+  QStringList existing;
+  if (query.exec("PRAGMA table_info(Data_Sample)")) {
+    while (query.next())
+      existing << query.value(1).toString();
+  }
+  for (const ChannelRegistry::Channel &c : ChannelRegistry::channels()) {
+    const QString column = QString::fromLatin1(c.column);
+    const QString rate = c.rateField ? QString::fromLatin1(c.rateField) : "";
+    for (const QString &name : {column, rate}) {
+      if (name.isEmpty() || existing.contains(name))
+        continue;
+      const char *type = name == column ? "TEXT" : "REAL";
+      if (!query.exec(QString("ALTER TABLE Data_Sample ADD COLUMN %1 %2")
+                          .arg(name, QLatin1String(type)))) {
+        qDebug() << "Data_Sample column" << name << query.lastError();
+        return false;
+      }
+      existing << name;
+    }
+  }
+
   // 5. Data_WorkSet
   if (!query.exec("CREATE TABLE IF NOT EXISTS Data_WorkSet ("
                   "ID INTEGER PRIMARY KEY AUTOINCREMENT, "
@@ -124,13 +203,100 @@ bool DatabaseManager::createTablesIfNotExist() {
     return false;
   }
 
+  // 6. Data_ColumnCodec - waveform codec per Data_Sample column
+  if (!query.exec("CREATE TABLE IF NOT EXISTS Data_ColumnCodec ("
+                  "ColumnName TEXT PRIMARY KEY, "
+                  "Codec INTEGER"
+                  ")")) {
+    qDebug() << "Data_ColumnCodec table error:" << query.lastError();
+    return false;
+  }
+
+  m_columnCodecs.clear();
+  if (query.exec("SELECT ColumnName, Codec FROM Data_ColumnCodec")) {
+    while (query.next()) {
+      m_columnCodecs.insert(
+          query.value(0).toString(),
+          static_cast<WaveformCodec::Codec>(query.value(1).toInt()));
+    }
+  }
+
   qDebug() << "All tables verified/created.";
+  return migrateSchema();
+}
+
+bool DatabaseManager::migrateSchema() {
+  QSqlQuery query(m_db);
+  int version = 0;
+  if (query.exec("PRAGMA user_version") && query.next())
+    version = query.value(0).toInt();
+
+  // v1: foreign-key indexes for the tree and per-point sample lookups
+  if (version < 1) {
+    if (!m_db.transaction())
+      return false;
+    bool ok =
+        query.exec("CREATE INDEX IF NOT EXISTS idx_Data_Point_LineID "
+                   "ON Data_Point (Data_LineID, ID)") &&
+        query.exec("CREATE INDEX IF NOT EXISTS idx_Data_Sample_PointID "
+                   "ON Data_Sample (Data_PointID, ID)") &&
+        query.exec("PRAGMA user_version = 1");
+    if (!ok || !m_db.commit()) {
+      qDebug() << "Schema migration to v1 failed:" << query.lastError();
+      m_db.rollback();
+      return false;
+    }
+    qDebug() << "Schema migrated to v1";
+  }
+
+  // v2: upload state for SyncEngine. Sync_Checkpoint keeps the per-endpoint
+  // watermark (every sample ID at or below it is acknowledged); Sync_Sample
+  // remembers what was sent so unchanged rows are never uploaded twice.
+  if (version < 2) {
+    if (!m_db.transaction())
+      return false;
+    bool ok =
+        query.exec("CREATE TABLE IF NOT EXISTS Sync_Checkpoint ("
+                   "Endpoint TEXT PRIMARY KEY, "
+                   "Watermark INTEGER NOT NULL DEFAULT 0, "
+                   "UpdatedAt INTEGER"
+                   ")") &&
+        query.exec("CREATE TABLE IF NOT EXISTS Sync_Sample ("
+                   "Endpoint TEXT NOT NULL, "
+                   "SampleID INTEGER NOT NULL, "
+                   "Hash INTEGER NOT NULL, "
+                   "PRIMARY KEY (Endpoint, SampleID)"
+                   ") WITHOUT ROWID") &&
+        query.exec("PRAGMA user_version = 2");
+    if (!ok || !m_db.commit()) {
+      qDebug() << "Schema migration to v2 failed:" << query.lastError();
+      m_db.rollback();
+      return false;
+    }
+    qDebug() << "Schema migrated to v2";
+  }
+
+  // v3: StartTime order for the playback survey timeline
+  if (version < 3) {
+    if (!m_db.transaction())
+      return false;
+    bool ok = query.exec("CREATE INDEX IF NOT EXISTS idx_Data_Sample_StartTime "
+                         "ON Data_Sample (StartTime, ID)") &&
+              query.exec("PRAGMA user_version = 3");
+    if (!ok || !m_db.commit()) {
+      qDebug() << "Schema migration to v3 failed:" << query.lastError();
+      m_db.rollback();
+      return false;
+    }
+    qDebug() << "Schema migrated to v3";
+  }
+
   return true;
 }
 
 int DatabaseManager::createProject(const QVariantMap &p) {
-  QSqlQuery q(m_db);
-  q.prepare("INSERT INTO Data_Project (CreateTime, LineNoStart, PointNoStart, "
+  QSqlQuery &q = StatementCache::prepared(
+      m_db, "INSERT INTO Data_Project (CreateTime, LineNoStart, PointNoStart, "
             "PointNoStep, SSID, SendCoil_Len, SendCoil_Turns) "
             "VALUES (:ct, :ls, :ps, :pst, :ssid, :sl, :st)");
   q.bindValue(":ct", p.value("CreateTime", QDateTime::currentSecsSinceEpoch()));
@@ -152,8 +318,8 @@ int DatabaseManager::createLine(int projectId, const QString &lineName,
                                 int type, int use) {
   (void)projectId; // As per JS schema, Line doesn't explicitly link to project,
                    // or maybe implicitly globally.
-  QSqlQuery q(m_db);
-  q.prepare(
+  QSqlQuery &q = StatementCache::prepared(
+      m_db,
       "INSERT INTO Data_Line (NAME, TYPE, USE) VALUES (:name, :type, :use)");
   q.bindValue(":name",
               lineName.toDouble()); // Assuming NAME is float like 1.0 from JS
@@ -161,7 +327,9 @@ int DatabaseManager::createLine(int projectId, const QString &lineName,
   q.bindValue(":use", use);
 
   if (q.exec()) {
-    return q.lastInsertId().toInt();
+    int id = q.lastInsertId().toInt();
+    emit lineCreated(id);
+    return id;
   }
   emit databaseError("Insert Line failed: " + q.lastError().text());
   return -1;
@@ -169,8 +337,8 @@ int DatabaseManager::createLine(int projectId, const QString &lineName,
 
 int DatabaseManager::createPoint(int lineId, const QString &pointName, int type,
                                  int use) {
-  QSqlQuery q(m_db);
-  q.prepare("INSERT INTO Data_Point (Data_LineID, NAME, TYPE, USE) VALUES "
+  QSqlQuery &q = StatementCache::prepared(
+      m_db, "INSERT INTO Data_Point (Data_LineID, NAME, TYPE, USE) VALUES "
             "(:lid, :name, :type, :use)");
   q.bindValue(":lid", lineId);
   q.bindValue(":name", pointName.toDouble()); // Assuming NAME is float
@@ -178,84 +346,146 @@ int DatabaseManager::createPoint(int lineId, const QString &pointName, int type,
   q.bindValue(":use", use);
 
   if (q.exec()) {
-    return q.lastInsertId().toInt();
+    int id = q.lastInsertId().toInt();
+    emit pointCreated(lineId, id);
+    return id;
   }
   emit databaseError("Insert Point failed: " + q.lastError().text());
   return -1;
 }
 
 bool DatabaseManager::saveSample(int pointId, const QVariantMap &s,
-                                 const QString &recvBase64,
-                                 const QString &sendBase64,
-                                 const QString &soffBase64) {
-  QSqlQuery q(m_db);
-  q.prepare("INSERT INTO Data_Sample (Data_PointID, DATA_RECV, DATA_SEND, "
-            "DATA_SOFF, DeviceType, PERIOD, RecvFs, SendFs, StartTime) "
-            "VALUES (:pid, :recv, :send, :soff, :dev, :per, :rfs, :sfs, :st)");
-
-  q.bindValue(":pid", pointId);
-  q.bindValue(":recv", recvBase64);
-  q.bindValue(":send", sendBase64);
-  q.bindValue(":soff", soffBase64);
-  q.bindValue(":dev", s.value("DeviceType", 1));
-  q.bindValue(":per", s.value("PERIOD", 500));
-  q.bindValue(":rfs", s.value("RecvFs", 625000.0));
-  q.bindValue(":sfs", s.value("SendFs", 25.0));
-  q.bindValue(":st", s.value("StartTime", QDateTime::currentMSecsSinceEpoch()));
-
-  if (q.exec()) {
-    int id = q.lastInsertId().toInt();
-    emit dataSaved(id);
-    return true;
+                                 const ChannelArray<QVariant> &channels,
+                                 const ChannelArray<int> &rates,
+                                 qint64 journalSeq) {
+  if (!m_db.isOpen()) {
+    emit databaseError("Insert Sample failed: no open database");
+    return false;
   }
 
-  emit databaseError("Insert Sample failed: " + q.lastError().text());
-  return false;
+  SampleWriter::PendingSample pending;
+  pending.pointId = pointId;
+  pending.meta = s;
+  pending.channels = channels;
+  pending.rates = rates;
+  pending.journalSeq = journalSeq;
+  // Stamp now rather than at commit time, which may be a batch later
+  if (!pending.meta.contains(QStringLiteral("StartTime")))
+    pending.meta["StartTime"] = QDateTime::currentMSecsSinceEpoch();
+
+  writerQueueDepth.add(1);
+  m_writer->post(std::move(pending));
+  return true;
+}
+
+void DatabaseManager::flushPendingSamples() {
+  QMetaObject::invokeMethod(
+      m_writer,
+      [w = m_writer]() {
+        w->drainHandoff();
+        w->flush();
+      },
+      Qt::BlockingQueuedConnection);
+}
+
+WaveformCodec::Codec
+DatabaseManager::columnCodec(const QString &column) const {
+  return m_columnCodecs.value(column, WaveformCodec::Raw);
+}
+
+bool DatabaseManager::setColumnCodec(const QString &column,
+                                     WaveformCodec::Codec codec) {
+  QSqlQuery q(m_db);
+  q.prepare("INSERT OR REPLACE INTO Data_ColumnCodec (ColumnName, Codec) "
+            "VALUES (:col, :codec)");
+  q.bindValue(":col", column);
+  q.bindValue(":codec", static_cast<int>(codec));
+  if (!q.exec()) {
+    emit databaseError("Set column codec failed: " + q.lastError().text());
+    return false;
+  }
+  m_columnCodecs.insert(column, codec);
+  return true;
 }
 
 QVariantList DatabaseManager::getProjectTree() {
   QVariantList tree;
 
-  // Fetch all lines
-  QSqlQuery qLine("SELECT ID, NAME FROM Data_Line", m_db);
-  while (qLine.next()) {
-    int lineId = qLine.value(0).toInt();
-    QString lineName = QString::number(qLine.value(1).toDouble(), 'f', 1);
-
-    QVariantMap lineNode;
-    lineNode["id"] = lineId;
-    lineNode["label"] = "L" + lineName;
-    lineNode["isLine"] = true;
-    lineNode["expanded"] = true;
-
-    // Fetch points for this line
-    QVariantList points;
-    QSqlQuery qPoint(m_db);
-    qPoint.prepare("SELECT ID, NAME FROM Data_Point WHERE Data_LineID = :lid");
-    qPoint.bindValue(":lid", lineId);
-    qPoint.exec();
-
-    while (qPoint.next()) {
-      int pointId = qPoint.value(0).toInt();
-      QString pointName = QString::number(qPoint.value(1).toDouble(), 'f', 1);
-
-      QVariantMap pointNode;
-      pointNode["id"] = pointId;
-      pointNode["label"] = "P" + pointName;
-      pointNode["isPoint"] = true;
-      points.append(pointNode);
-    }
+  // One ordered pass over lines joined with their points; the LEFT JOIN
+  // keeps empty lines (their point columns come back NULL).
+  QSqlQuery &q = StatementCache::prepared(
+      m_db, "SELECT l.ID, l.NAME, p.ID, p.NAME FROM Data_Line l "
+            "LEFT JOIN Data_Point p ON p.Data_LineID = l.ID "
+            "ORDER BY l.ID, p.ID");
+  q.setForwardOnly(true);
+  if (!q.exec()) {
+    emit databaseError("Load project tree failed: " + q.lastError().text());
+    return tree;
+  }
 
+  int currentLineId = -1;
+  QVariantMap lineNode;
+  QVariantList points;
+  auto finishLine = [&]() {
+    if (currentLineId < 0)
+      return;
     lineNode["children"] = points;
     tree.append(lineNode);
+    points.clear();
+  };
+
+  while (q.next()) {
+    int lineId = q.value(0).toInt();
+    if (lineId != currentLineId) {
+      finishLine();
+      currentLineId = lineId;
+      QString lineName = QString::number(q.value(1).toDouble(), 'f', 1);
+
+      lineNode.clear();
+      lineNode["id"] = lineId;
+      lineNode["label"] = "L" + lineName;
+      lineNode["isLine"] = true;
+      lineNode["expanded"] = true;
+    }
+
+    if (q.isNull(2))
+      continue;
+
+    int pointId = q.value(2).toInt();
+    QString pointName = QString::number(q.value(3).toDouble(), 'f', 1);
+
+    QVariantMap pointNode;
+    pointNode["id"] = pointId;
+    pointNode["label"] = "P" + pointName;
+    pointNode["isPoint"] = true;
+    points.append(pointNode);
   }
+  finishLine();
 
   return tree;
 }
 
-QVariantList DatabaseManager::getUnsyncedSamples() {
+QVariantList DatabaseManager::getUnsyncedSamples(const QString &endpoint,
+                                                 int limit) {
   QVariantList list;
-  // We could return records where USE=1 or something signifying un-synced.
-  // For now returning empty list as placeholder.
+  QSqlQuery &q = StatementCache::prepared(
+      m_db, "SELECT s.ID, s.Data_PointID, s.StartTime FROM Data_Sample s "
+            "WHERE s.ID > COALESCE((SELECT Watermark FROM Sync_Checkpoint "
+            "WHERE Endpoint = ?), 0) ORDER BY s.ID LIMIT ?");
+  q.setForwardOnly(true);
+  q.addBindValue(endpoint);
+  q.addBindValue(limit);
+  if (!q.exec()) {
+    emit databaseError("Load unsynced samples failed: " +
+                       q.lastError().text());
+    return list;
+  }
+  while (q.next()) {
+    QVariantMap row;
+    row["id"] = q.value(0).toInt();
+    row["pointId"] = q.value(1).toInt();
+    row["startTime"] = q.value(2).toLongLong();
+    list.append(row);
+  }
   return list;
 }
@@ -3,16 +3,28 @@
 
 #include <QObject>
 #include <QSqlDatabase>
+#include <QThread>
 #include <QVariantList>
+#include <QHash>
 #include <QVariantMap>
 
+#include "ChannelRegistry.h"
+#include "WaveformCodec.h"
+
+class SampleWriter;
+
 class DatabaseManager : public QObject {
   Q_OBJECT
 public:
   static DatabaseManager &instance();
 
   bool initialize(const QString &dbPath);
+  // GUI-thread connection of the open project
+  QSqlDatabase database() const { return m_db; }
+  QString databasePath() const { return m_dbPath; }
   bool createTablesIfNotExist();
+  // Versioned schema changes tracked in PRAGMA user_version
+  bool migrateSchema();
 
   // Insertion methods mapping to JSON schema
   int createProject(const QVariantMap &projectData);
@@ -21,20 +33,38 @@ public:
   int createPoint(int lineId, const QString &pointName, int type = 0,
                   int use = 1);
 
-  // Save sample - returns true if queued or saved successfully
+  // Save sample - returns true if queued or saved successfully. Rows are
+  // group-committed on the writer thread; dataSaved reports each commit.
+  // Channel values, in ChannelRegistry order, are legacy base64 text or
+  // WaveformCodec blobs; rates go to each channel's rate column.
+  // journalSeq comes back through journalFramesSaved after the commit.
   bool saveSample(int pointId, const QVariantMap &sampleData,
-                  const QString &recvBase64, const QString &sendBase64,
-                  const QString &soffBase64);
+                  const ChannelArray<QVariant> &channels,
+                  const ChannelArray<int> &rates, qint64 journalSeq = -1);
+
+  // Per-column waveform codec (DATA_RECV, DATA_SEND, ...), stored
+  // in the project so every writer of the file agrees.
+  WaveformCodec::Codec columnCodec(const QString &column) const;
+  bool setColumnCodec(const QString &column, WaveformCodec::Codec codec);
 
   // Retrieve full hierarchical tree for the UI (Lines -> Points)
   QVariantList getProjectTree();
 
-  // Retrieve unsynced records
-  QVariantList getUnsyncedSamples();
+  // Samples above the endpoint's sync watermark, oldest first
+  QVariantList getUnsyncedSamples(const QString &endpoint, int limit = 100);
+
+  // Block until every queued sample has been committed
+  void flushPendingSamples();
 
 signals:
   void databaseError(const QString &errorStr);
   void dataSaved(int sampleId);
+  // Structural changes, for incremental views of the project
+  void lineCreated(int lineId);
+  void pointCreated(int lineId, int pointId);
+  void sampleAdded(int sampleId, int pointId);
+  // Journal frames of samples now committed (see saveSample)
+  void journalFramesSaved(const QList<qint64> &journalSeqs);
 
 private:
   explicit DatabaseManager(QObject *parent = nullptr);
@@ -42,6 +72,10 @@ private:
 
   QSqlDatabase m_db;
   QString m_dbPath;
+  QHash<QString, WaveformCodec::Codec> m_columnCodecs;
+
+  QThread m_writerThread;
+  SampleWriter *m_writer;
 };
 
 #endif // DATABASEMANAGER_H
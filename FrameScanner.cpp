@@ -0,0 +1,201 @@
+#include "FrameScanner.h"
+#include <array>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <type_traits>
+
+namespace {
+
+const char *skipSpace(const char *p, const char *end) {
+  while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n'))
+    ++p;
+  return p;
+}
+
+// p is on the opening quote; returns the closing one, or end
+const char *stringEnd(const char *p, const char *end) {
+  for (++p; p < end && *p != '"'; ++p) {
+    if (*p == '\\' && p + 1 < end)
+      ++p;
+  }
+  return p;
+}
+
+const std::array<qint8, 256> &base64Table() {
+  static const std::array<qint8, 256> table = [] {
+    std::array<qint8, 256> t;
+    t.fill(-1);
+    const char *alphabet =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    for (int i = 0; i < 64; ++i)
+      t[uchar(alphabet[i])] = qint8(i);
+    return t;
+  }();
+  return table;
+}
+
+// base64 straight into values of type T, one word at a time
+template <typename T, bool BigEndian>
+void decodeWords(QByteArrayView base64, QVector<double> &out) {
+  using Word = std::conditional_t<
+      sizeof(T) == 8, quint64,
+      std::conditional_t<sizeof(T) == 4, quint32, quint16>>;
+  const std::array<qint8, 256> &table = base64Table();
+  // Upper bound; trimmed to what was decoded below
+  out.resize(int(base64.size() * 3 / 4 / sizeof(T)));
+  double *dst = out.data();
+  int count = 0;
+
+  quint32 bits = 0;
+  int bitCount = 0;
+  Word word = 0;
+  int wordBytes = 0;
+  for (char c : base64) {
+    const int v = table[uchar(c)];
+    if (v < 0)
+      continue;
+    bits = (bits << 6) | quint32(v);
+    bitCount += 6;
+    if (bitCount < 8)
+      continue;
+    bitCount -= 8;
+    const Word byte = (bits >> bitCount) & 0xff;
+    if constexpr (BigEndian)
+      word = Word(word << 8) | byte;
+    else
+      word |= Word(byte << (8 * wordBytes));
+    if (++wordBytes == int(sizeof(T))) {
+      T value;
+      memcpy(&value, &word, sizeof(T));
+      dst[count++] = double(value);
+      word = 0;
+      wordBytes = 0;
+    }
+  }
+  out.resize(count);
+}
+
+} // namespace
+
+bool FrameScanner::scan(QByteArrayView frame) {
+  m_fields.clear();
+  const char *p = frame.data();
+  const char *end = p + frame.size();
+
+  p = skipSpace(p, end);
+  if (p == end || *p != '{')
+    return false;
+  p = skipSpace(p + 1, end);
+  if (p < end && *p == '}')
+    return skipSpace(p + 1, end) == end;
+
+  for (;;) {
+    if (p == end || *p != '"')
+      return false;
+    const char *keyEnd = stringEnd(p, end);
+    if (keyEnd == end)
+      return false;
+    Field field;
+    field.key = QByteArrayView(p + 1, keyEnd - p - 1);
+
+    p = skipSpace(keyEnd + 1, end);
+    if (p == end || *p != ':')
+      return false;
+    p = skipSpace(p + 1, end);
+    if (p == end)
+      return false;
+
+    if (*p == '"') {
+      const char *valueEnd = stringEnd(p, end);
+      if (valueEnd == end)
+        return false;
+      field.value = QByteArrayView(p + 1, valueEnd - p - 1);
+      field.isString = true;
+      p = valueEnd + 1;
+    } else if (*p == '-' || (*p >= '0' && *p <= '9') || *p == 't' ||
+               *p == 'f' || *p == 'n') {
+      const char *start = p;
+      while (p < end && *p != ',' && *p != '}' && *p != ' ' && *p != '\t' &&
+             *p != '\r' && *p != '\n')
+        ++p;
+      field.value = QByteArrayView(start, p - start);
+      field.isString = false;
+    } else {
+      // Objects and arrays are not device frame fields
+      return false;
+    }
+    m_fields.append(field);
+
+    p = skipSpace(p, end);
+    if (p == end)
+      return false;
+    if (*p == '}')
+      return skipSpace(p + 1, end) == end;
+    if (*p != ',')
+      return false;
+    p = skipSpace(p + 1, end);
+  }
+}
+
+const FrameScanner::Field *FrameScanner::find(QByteArrayView key) const {
+  for (const Field &f : m_fields) {
+    if (f.key == key)
+      return &f;
+  }
+  return nullptr;
+}
+
+QByteArrayView FrameScanner::value(QByteArrayView key) const {
+  const Field *f = find(key);
+  return f ? f->value : QByteArrayView();
+}
+
+double FrameScanner::toDouble(QByteArrayView key, double fallback) const {
+  const Field *f = find(key);
+  if (!f || f->isString)
+    return fallback;
+  bool ok = false;
+  const double v = f->value.toDouble(&ok);
+  return ok ? v : fallback;
+}
+
+int FrameScanner::toInt(QByteArrayView key, int fallback) const {
+  // Like QJsonValue::toInt: only whole numbers in range count
+  const double v = toDouble(key, std::nan(""));
+  if (std::isnan(v) || v != std::floor(v) || v < INT_MIN || v > INT_MAX)
+    return fallback;
+  return int(v);
+}
+
+QVariant FrameScanner::toVariant(QByteArrayView key) const {
+  const Field *f = find(key);
+  if (!f || f->value == "null")
+    return QVariant();
+  if (f->isString)
+    return QString::fromUtf8(f->value);
+  if (f->value == "true" || f->value == "false")
+    return f->value == "true";
+  return toDouble(key, 0.0);
+}
+
+void FrameScanner::decodeValues(QByteArrayView base64,
+                                ChannelRegistry::DType dtype,
+                                ChannelRegistry::Endian endian,
+                                QVector<double> &out) {
+  const bool big = endian == ChannelRegistry::BigEndian;
+  switch (dtype) {
+  case ChannelRegistry::Float64:
+    return big ? decodeWords<double, true>(base64, out)
+               : decodeWords<double, false>(base64, out);
+  case ChannelRegistry::Float32:
+    return big ? decodeWords<float, true>(base64, out)
+               : decodeWords<float, false>(base64, out);
+  case ChannelRegistry::Int32:
+    return big ? decodeWords<qint32, true>(base64, out)
+               : decodeWords<qint32, false>(base64, out);
+  case ChannelRegistry::Int16:
+    return big ? decodeWords<qint16, true>(base64, out)
+               : decodeWords<qint16, false>(base64, out);
+  }
+}
@@ -0,0 +1,62 @@
+#ifndef FRAMESCANNER_H
+#define FRAMESCANNER_H
+
+#include "ChannelRegistry.h"
+#include <QByteArrayView>
+#include <QVarLengthArray>
+#include <QVariant>
+#include <QVector>
+
+// In-place field lookup for one device frame: a flat JSON object of
+// strings and numbers on a single line.
+//
+// scan() records where each value sits in the caller's bytes; nothing is
+// copied or unescaped, so a sample frame is read without building a
+// QJsonDocument or the QStrings for its base64 channels. Anything else
+// (nested values, syntax errors) makes scan() fail and the caller falls
+// back to QJsonDocument.
+class FrameScanner {
+public:
+  bool scan(QByteArrayView frame);
+
+  bool contains(QByteArrayView key) const { return find(key) != nullptr; }
+  // Raw bytes of a value; string values without their quotes
+  QByteArrayView value(QByteArrayView key) const;
+  double toDouble(QByteArrayView key, double fallback) const;
+  int toInt(QByteArrayView key, int fallback) const;
+  // As QJsonValue::toVariant: double, bool, QString or null
+  QVariant toVariant(QByteArrayView key) const;
+
+  // base64 text of packed values into out, reusing its capacity.
+  // Characters outside the alphabet are skipped, as QByteArray::fromBase64
+  // does. The type and byte order are resolved once per channel, not per
+  // value.
+  static void decodeValues(QByteArrayView base64,
+                           ChannelRegistry::DType dtype,
+                           ChannelRegistry::Endian endian,
+                           QVector<double> &out);
+  static void decodeChannel(QByteArrayView base64,
+                            const ChannelRegistry::Channel &channel,
+                            QVector<double> &out) {
+    decodeValues(base64, channel.dtype, channel.endian, out);
+  }
+  // The device's native format
+  static void decodeBigEndianDoubles(QByteArrayView base64,
+                                     QVector<double> &out) {
+    decodeValues(base64, ChannelRegistry::Float64,
+                 ChannelRegistry::BigEndian, out);
+  }
+
+private:
+  struct Field {
+    QByteArrayView key;
+    QByteArrayView value;
+    bool isString;
+  };
+  const Field *find(QByteArrayView key) const;
+
+  // Device frames carry about a dozen fields; more spill to the heap
+  QVarLengthArray<Field, 32> m_fields;
+};
+
+#endif // FRAMESCANNER_H
@@ -0,0 +1,299 @@
+#include "HeadlessRunner.h"
+#include "AcquisitionPipeline.h"
+#include "ChannelRegistry.h"
+#include "DatabaseManager.h"
+#include "MetricsExporter.h"
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QStandardPaths>
+#include <QTextStream>
+
+HeadlessRunner::HeadlessRunner(const Options &options, QObject *parent)
+    : QObject(parent), m_options(options) {
+  if (m_options.journalDir.isEmpty())
+    m_options.journalDir =
+        QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) +
+        "/journal";
+  m_pipeline = new AcquisitionPipeline(m_options.journalDir, this);
+
+  connect(m_pipeline, &AcquisitionPipeline::stateChanged, this,
+          [this](TcpClient::ConnectionState s) {
+            if (s == TcpClient::Connected)
+              onConnected();
+            else if (s == TcpClient::Disconnected)
+              onDisconnected();
+          });
+  connect(m_pipeline, &AcquisitionPipeline::sampleReceived, this,
+          &HeadlessRunner::onSample);
+  connect(m_pipeline, &AcquisitionPipeline::errorOccurred, this,
+          [](const QString &err) { qWarning() << "Headless: TCP" << err; });
+  connect(&DatabaseManager::instance(), &DatabaseManager::databaseError, this,
+          [](const QString &err) { qWarning() << "Headless: DB" << err; });
+
+  m_pointTimer.setSingleShot(true);
+  connect(&m_pointTimer, &QTimer::timeout, this,
+          &HeadlessRunner::onPointTimeout);
+  connect(&m_statsTimer, &QTimer::timeout, this,
+          [this]() { printStats(false); });
+}
+
+bool HeadlessRunner::start() {
+  DatabaseManager &dbm = DatabaseManager::instance();
+  const bool isNew = !QFileInfo::exists(m_options.dbPath);
+  QDir().mkpath(QFileInfo(m_options.dbPath).absolutePath());
+  if (!dbm.initialize(m_options.dbPath)) {
+    qWarning() << "Headless: cannot open project" << m_options.dbPath;
+    return false;
+  }
+  if (isNew) {
+    // Same setup as Backend::createProjectDB
+    QVariantMap pData;
+    pData["CreateTime"] = QDateTime::currentSecsSinceEpoch();
+    dbm.createProject(pData);
+    for (const QString &column : ChannelRegistry::columns())
+      dbm.setColumnCodec(column, WaveformCodec::Gorilla);
+  }
+  m_lineId = dbm.createLine(0, QString::number(m_options.lineName));
+  if (m_lineId < 0)
+    return false;
+
+  qDebug() << "Headless: project" << m_options.dbPath << "line" << m_lineId
+           << "device" << m_options.host << m_options.port;
+  if (!m_options.metricsFile.isEmpty() || m_options.metricsPort > 0) {
+    m_metrics = new MetricsExporter(this);
+    QString error;
+    if (!m_options.metricsFile.isEmpty() &&
+        !m_metrics->setTextFile(m_options.metricsFile,
+                                m_options.metricsIntervalMs, &error)) {
+      qWarning() << "Headless: metrics file:" << error;
+      return false;
+    }
+    if (m_options.metricsPort > 0 &&
+        !m_metrics->listen(m_options.metricsPort, &error)) {
+      qWarning() << "Headless: metrics port:" << error;
+      return false;
+    }
+  }
+
+  m_clock.start();
+  if (m_options.statsIntervalMs > 0)
+    m_statsTimer.start(m_options.statsIntervalMs);
+  if (!m_options.recordPath.isEmpty()) {
+    QString error;
+    if (!m_pipeline->startRecording(m_options.recordPath, &error)) {
+      qWarning() << "Headless: cannot record:" << error;
+      return false;
+    }
+  }
+  if (!m_options.replayPath.isEmpty()) {
+    QString error;
+    if (!m_pipeline->startReplay(m_options.replayPath, m_options.replaySpeed,
+                                 &error)) {
+      qWarning() << "Headless: cannot replay:" << error;
+      return false;
+    }
+    return true;
+  }
+  m_pipeline->connectDevice(m_options.host, m_options.port);
+  return true;
+}
+
+void HeadlessRunner::onConnected() {
+  qDebug() << "Headless: connected";
+  if (!m_options.params.isEmpty())
+    m_pipeline->sendParams(m_options.params);
+  // After a reconnect the interrupted point starts over
+  beginPoint();
+}
+
+void HeadlessRunner::onDisconnected() {
+  if (m_finished)
+    return;
+  m_pointTimer.stop();
+  if (!m_options.replayPath.isEmpty()) {
+    // The capture ran out; a partial last point is expected
+    finish(0);
+    return;
+  }
+  if (!m_options.reconnect) {
+    qWarning() << "Headless: device lost";
+    finish(1);
+    return;
+  }
+  qWarning() << "Headless: device lost, reconnecting";
+  QTimer::singleShot(1000, this, [this]() {
+    m_pipeline->connectDevice(m_options.host, m_options.port);
+  });
+}
+
+void HeadlessRunner::beginPoint() {
+  if (m_options.pointCount > 0 && m_pointsDone >= m_options.pointCount) {
+    finish(0);
+    return;
+  }
+  // A retried point keeps its row
+  if (m_pointId < 0) {
+    const double name =
+        m_options.firstPoint + m_pointsDone * m_options.pointStep;
+    m_pointId = DatabaseManager::instance().createPoint(
+        m_lineId, QString::number(name));
+  }
+  m_framesThisPoint = 0;
+  m_pipeline->startCollect();
+  m_pointTimer.start(m_options.pointTimeoutMs);
+}
+
+void HeadlessRunner::onSample() {
+  if (m_finished || m_pointId < 0)
+    return;
+  const AcquisitionPipeline::Sample &sample = m_pipeline->latestSample();
+  // Only full frames count; the runner never asks for previews
+  if (sample.preview)
+    return;
+  // The frame's own meta, shared rather than copied: Data_Sample keeps no
+  // qualification flag, so there is nothing to add per frame
+  if (m_options.autoSave)
+    m_pipeline->persist(sample, sample.meta, m_pointId);
+  if (++m_framesThisPoint < m_options.framesPerPoint)
+    return;
+
+  m_pointTimer.stop();
+  ++m_pointsDone;
+  m_pointId = -1;
+  m_pipeline->nextPoint();
+  // Let the rest of this read drain before the next START_COLLECT
+  QTimer::singleShot(0, this, &HeadlessRunner::beginPoint);
+}
+
+void HeadlessRunner::onPointTimeout() {
+  qWarning() << "Headless: point" << m_pointsDone + 1 << "timed out after"
+             << m_framesThisPoint << "frame(s)";
+  ++m_pointsTimedOut;
+  ++m_pointsDone;
+  m_pointId = -1;
+  m_pipeline->nextPoint();
+  beginPoint();
+}
+
+void HeadlessRunner::printStats(bool summary) {
+  const AcquisitionPipeline::Counters &c = m_pipeline->counters();
+  const double seconds = qMax(1e-3, m_clock.nsecsElapsed() / 1e9);
+  QTextStream out(stdout);
+  out << (summary ? "summary: " : "") << m_pointsDone << " point(s), "
+      << c.samples << " sample(s), " << c.saved << " saved, " << c.rejected
+      << " rejected, " << QString::number(c.bytes / 1e6, 'f', 2) << " MB in "
+      << QString::number(seconds, 'f', 1) << " s ("
+      << QString::number(c.samples / seconds, 'f', 1) << " samples/s, "
+      << QString::number(c.bytes / seconds / 1e6, 'f', 2) << " MB/s)";
+  if (m_pointsTimedOut > 0)
+    out << ", " << m_pointsTimedOut << " point(s) timed out";
+  out << Qt::endl;
+}
+
+void HeadlessRunner::finish(int exitCode) {
+  if (m_finished)
+    return;
+  m_finished = true;
+  m_pointTimer.stop();
+  m_statsTimer.stop();
+  // Everything queued must be on disk before the process goes
+  DatabaseManager::instance().flushPendingSamples();
+  printStats(true);
+  // Final figures for the scraper, not the last interval's
+  if (m_metrics && !m_options.metricsFile.isEmpty())
+    m_metrics->writeTextFile();
+  m_pipeline->disconnectDevice();
+  emit finished(exitCode);
+}
+
+int runHeadless(int argc, char *argv[]) {
+  QCoreApplication app(argc, argv);
+  app.setOrganizationName("TEM Systems");
+  app.setApplicationName("TEM_Acquisition");
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription("Headless TEM acquisition");
+  parser.addHelpOption();
+  parser.addOption({"headless", "Run without the UI (implied here)."});
+  parser.addOption({"device", "Device address host[:port].", "host[:port]",
+                    "127.0.0.1:8888"});
+  parser.addOption({"db", "Project database (created if missing).", "file"});
+  parser.addOption({"auto-save", "Save every received sample."});
+  parser.addOption({"line", "Line number for this run.", "n", "1"});
+  parser.addOption({"first-point", "First point number.", "n", "0"});
+  parser.addOption({"point-step", "Point number increment.", "n", "2"});
+  parser.addOption(
+      {"points", "Points to acquire, 0 = until stopped.", "n", "1"});
+  parser.addOption(
+      {"frames-per-point", "Frames that complete a point.", "n", "3"});
+  parser.addOption(
+      {"point-timeout", "Give up on a point after ms.", "ms", "30000"});
+  parser.addOption({"params", "SET_PARAMS JSON sent on connect.", "json"});
+  parser.addOption({"journal", "Frame journal directory.", "dir"});
+  parser.addOption({"reconnect", "Reconnect instead of exiting on loss."});
+  parser.addOption({"record", "Record the raw device session.", "file"});
+  parser.addOption(
+      {"replay", "Replay a recorded session instead of a device.", "file"});
+  parser.addOption({"replay-speed",
+                    "Replay speed factor, 0 = as fast as possible.", "x",
+                    "1"});
+  parser.addOption(
+      {"stats", "Print counters every n seconds.", "seconds", "0"});
+  parser.addOption({"metrics-file",
+                    "Write Prometheus metrics to this file periodically.",
+                    "file"});
+  parser.addOption(
+      {"metrics-interval", "Metrics file interval.", "seconds", "5"});
+  parser.addOption({"metrics-port",
+                    "Serve /metrics on 127.0.0.1:<port>.", "port"});
+  parser.process(app);
+
+  if (!parser.isSet("db")) {
+    qWarning() << "Headless: --db is required";
+    return 2;
+  }
+
+  HeadlessRunner::Options o;
+  const QStringList device = parser.value("device").split(':');
+  o.host = device.value(0);
+  o.port = quint16(device.value(1, "8888").toUInt());
+  o.dbPath = parser.value("db");
+  o.journalDir = parser.value("journal");
+  o.autoSave = parser.isSet("auto-save");
+  o.lineName = parser.value("line").toDouble();
+  o.firstPoint = parser.value("first-point").toDouble();
+  o.pointStep = parser.value("point-step").toDouble();
+  o.pointCount = parser.value("points").toInt();
+  o.framesPerPoint = qMax(1, parser.value("frames-per-point").toInt());
+  o.pointTimeoutMs = qMax(1, parser.value("point-timeout").toInt());
+  o.reconnect = parser.isSet("reconnect");
+  o.recordPath = parser.value("record");
+  o.replayPath = parser.value("replay");
+  o.replaySpeed = parser.value("replay-speed").toDouble();
+  o.statsIntervalMs = int(parser.value("stats").toDouble() * 1000);
+  o.metricsFile = parser.value("metrics-file");
+  o.metricsIntervalMs =
+      int(parser.value("metrics-interval").toDouble() * 1000);
+  o.metricsPort = quint16(parser.value("metrics-port").toUInt());
+  if (parser.isSet("params")) {
+    const QJsonDocument doc =
+        QJsonDocument::fromJson(parser.value("params").toUtf8());
+    if (!doc.isObject()) {
+      qWarning() << "Headless: --params is not a JSON object";
+      return 2;
+    }
+    o.params = doc.object().toVariantMap();
+  }
+
+  HeadlessRunner runner(o);
+  QObject::connect(&runner, &HeadlessRunner::finished, &app,
+                   &QCoreApplication::exit, Qt::QueuedConnection);
+  if (!runner.start())
+    return 1;
+  return app.exec();
+}
@@ -0,0 +1,84 @@
+#ifndef HEADLESSRUNNER_H
+#define HEADLESSRUNNER_H
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QString>
+#include <QTimer>
+#include <QVariantMap>
+
+class AcquisitionPipeline;
+class MetricsExporter;
+
+// Unattended acquisition: AcquisitionPipeline driven from the command line
+// under a QCoreApplication, with no QML, Quick or Charts.
+//
+// Opens (or creates) the project, adds a line, and walks the points in
+// sequence: START_COLLECT, wait for the point's frames, optionally save
+// each one, NEXT_POINT. Counters go to stdout; the process exits when the
+// sequence is done or the device is lost.
+class HeadlessRunner : public QObject {
+  Q_OBJECT
+public:
+  struct Options {
+    QString host = "127.0.0.1";
+    quint16 port = 8888;
+    QString dbPath;
+    QString journalDir;
+    bool autoSave = false;
+    double lineName = 1.0;
+    double firstPoint = 0.0;
+    double pointStep = 2.0;
+    int pointCount = 1;     // 0 = until stopped
+    int framesPerPoint = 3; // frames that complete a point
+    int pointTimeoutMs = 30000;
+    bool reconnect = false;
+    QString recordPath;       // capture the raw session here
+    QString replayPath;       // play this capture instead of a device
+    double replaySpeed = 1.0; // 0 = as fast as possible
+    int statsIntervalMs = 0;  // 0 = summary only
+    QVariantMap params;       // SET_PARAMS on connect, if any
+    // Prometheus text: a file rewritten every metricsIntervalMs, and/or
+    // GET /metrics on 127.0.0.1:metricsPort (0 = off)
+    QString metricsFile;
+    int metricsIntervalMs = 5000;
+    quint16 metricsPort = 0;
+  };
+
+  explicit HeadlessRunner(const Options &options, QObject *parent = nullptr);
+
+  // False if the project cannot be opened; otherwise finished() follows
+  bool start();
+
+signals:
+  void finished(int exitCode);
+
+private:
+  void onConnected();
+  void onDisconnected();
+  void beginPoint();
+  void onSample();
+  void onPointTimeout();
+  void printStats(bool summary);
+  void finish(int exitCode);
+
+  Options m_options;
+  AcquisitionPipeline *m_pipeline;
+  MetricsExporter *m_metrics = nullptr;
+  QTimer m_pointTimer;
+  QTimer m_statsTimer;
+  QElapsedTimer m_clock;
+
+  int m_lineId = -1;
+  int m_pointId = -1; // Data_Point row of the point being acquired
+  int m_pointsDone = 0;
+  int m_pointsTimedOut = 0;
+  int m_framesThisPoint = 0;
+  bool m_finished = false;
+};
+
+// Parses the headless command line and runs until the sequence ends.
+// Called from main() for --headless and by the TEM_Headless binary.
+int runHeadless(int argc, char *argv[]);
+
+#endif // HEADLESSRUNNER_H
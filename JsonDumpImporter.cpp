@@ -0,0 +1,341 @@
+#include "JsonDumpImporter.h"
+#include "ConnectionManager.h"
+#include <QCoreApplication>
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QList>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QThread>
+#include <QVector>
+#include <QtConcurrent/QtConcurrentMap>
+#include <cmath>
+
+JsonRecordReader::JsonRecordReader(const QString &path, int chunkSize)
+    : m_file(path), m_chunkSize(qMax(4096, chunkSize)) {}
+
+bool JsonRecordReader::open() {
+  if (!m_file.open(QIODevice::ReadOnly)) {
+    m_error = m_file.errorString();
+    return false;
+  }
+  return true;
+}
+
+bool JsonRecordReader::fill() {
+  m_chunk = m_file.read(m_chunkSize);
+  m_pos = 0;
+  return !m_chunk.isEmpty();
+}
+
+bool JsonRecordReader::next(QByteArray &record) {
+  record.clear();
+  bool inRecord = false;
+
+  for (;;) {
+    if (m_pos >= m_chunk.size() && !fill()) {
+      if (inRecord)
+        m_error = "Truncated record at end of " + m_file.fileName();
+      return false;
+    }
+
+    const char *p = m_chunk.constData();
+    const int n = m_chunk.size();
+    int start = m_pos;
+    while (m_pos < n) {
+      if (m_inString) {
+        // Waveform strings dominate the dump; skip them in a tight loop
+        while (m_pos < n && !m_escape && p[m_pos] != '"' && p[m_pos] != '\\')
+          ++m_pos;
+        if (m_pos >= n)
+          break;
+        const char c = p[m_pos++];
+        if (m_escape)
+          m_escape = false;
+        else if (c == '\\')
+          m_escape = true;
+        else
+          m_inString = false;
+        continue;
+      }
+
+      const char c = p[m_pos++];
+      switch (c) {
+      case '"':
+        m_inString = true;
+        break;
+      case '{':
+      case '[':
+        if (m_depth == 1 && !inRecord) {
+          inRecord = true;
+          start = m_pos - 1;
+        }
+        ++m_depth;
+        break;
+      case '}':
+      case ']':
+        --m_depth;
+        if (inRecord && m_depth == 1) {
+          record.append(p + start, m_pos - start);
+          return true;
+        }
+        if (m_depth <= 0)
+          return false; // end of the top-level array
+        break;
+      default:
+        break;
+      }
+    }
+
+    // Record continues in the next chunk
+    if (inRecord)
+      record.append(p + start, n - start);
+  }
+}
+
+namespace {
+
+struct TableSpec {
+  QStringList columns;
+  QVector<bool> integer; // declared INTEGER: store whole numbers as such
+  QVector<int> codec;    // WaveformCodec::Codec, or -1 for plain columns
+};
+
+struct DecodedRow {
+  QVector<QVariant> values;
+  bool ok = false;
+};
+
+// Runs on the thread pool
+DecodedRow decodeRecord(const QByteArray &record, const TableSpec &spec) {
+  DecodedRow row;
+  QJsonParseError err;
+  const QJsonDocument doc = QJsonDocument::fromJson(record, &err);
+  if (err.error != QJsonParseError::NoError || !doc.isObject())
+    return row;
+
+  const QJsonObject obj = doc.object();
+  row.values.resize(spec.columns.size());
+  for (int i = 0; i < spec.columns.size(); ++i) {
+    const QJsonValue v = obj.value(spec.columns[i]);
+    if (v.isNull() || v.isUndefined())
+      continue;
+
+    if (spec.codec[i] >= 0 && v.isString()) {
+      // Dump waveforms are base64 big-endian float64, as sent by the device
+      const QVector<float> samples = WaveformCodec::fromBigEndianDoubles(
+          QByteArray::fromBase64(v.toString().toLatin1()));
+      row.values[i] = WaveformCodec::encode(
+          samples, static_cast<WaveformCodec::Codec>(spec.codec[i]));
+    } else if (spec.integer[i] && v.isDouble() &&
+               std::floor(v.toDouble()) == v.toDouble()) {
+      row.values[i] = qint64(v.toDouble());
+    } else {
+      row.values[i] = v.toVariant();
+    }
+  }
+  row.ok = true;
+  return row;
+}
+
+} // namespace
+
+JsonDumpImporter::JsonDumpImporter(QObject *parent) : QObject(parent) {}
+
+QStringList JsonDumpImporter::tableOrder() {
+  // Parents first so every foreign key already resolves when its row lands
+  return {"Data_Project", "Data_WorkSet", "Data_Line", "Data_Point",
+          "Data_Sample"};
+}
+
+bool JsonDumpImporter::importDirectory(const QString &dumpDir,
+                                       const QString &dbPath) {
+  m_cancelled = false;
+  m_rowsImported = 0;
+  m_rowsSkipped = 0;
+  m_bytesBase = 0;
+  m_bytesTotal = 0;
+
+  QDir dir(dumpDir);
+  QStringList tables;
+  for (const QString &table : tableOrder()) {
+    QFileInfo fi(dir.filePath(table + ".json"));
+    if (fi.exists()) {
+      tables.append(table);
+      m_bytesTotal += fi.size();
+    }
+  }
+  if (tables.isEmpty()) {
+    emit importError("No table dumps found in " + dumpDir);
+    return false;
+  }
+
+  bool ok = true;
+  for (const QString &table : std::as_const(tables)) {
+    const QString path = dir.filePath(table + ".json");
+    ok = importOne(path, table, dbPath);
+    m_bytesBase += QFileInfo(path).size();
+    if (!ok || m_cancelled)
+      break;
+  }
+
+  // Pool threads live on; don't leave their connection behind
+  if (QThread::currentThread() != QCoreApplication::instance()->thread())
+    ConnectionManager::release(dbPath);
+  return ok && !m_cancelled;
+}
+
+bool JsonDumpImporter::importFile(const QString &jsonPath,
+                                  const QString &table,
+                                  const QString &dbPath) {
+  m_cancelled = false;
+  m_rowsImported = 0;
+  m_rowsSkipped = 0;
+  m_bytesBase = 0;
+  m_bytesTotal = QFileInfo(jsonPath).size();
+
+  const bool ok = importOne(jsonPath, table, dbPath);
+  if (QThread::currentThread() != QCoreApplication::instance()->thread())
+    ConnectionManager::release(dbPath);
+  return ok && !m_cancelled;
+}
+
+bool JsonDumpImporter::importOne(const QString &jsonPath, const QString &table,
+                                 const QString &dbPath) {
+  QSqlDatabase db = ConnectionManager::connection(dbPath);
+  if (!db.isOpen()) {
+    emit importError("Import connection failed: " + db.lastError().text());
+    return false;
+  }
+
+  // Columns come from the target schema; dump-only keys (list_*) drop out
+  TableSpec spec;
+  {
+    QSqlQuery info(db);
+    if (!info.exec(QString("PRAGMA table_info(%1)").arg(table))) {
+      emit importError("Import: " + info.lastError().text());
+      return false;
+    }
+    while (info.next()) {
+      const QString column = info.value(1).toString();
+      spec.columns.append(column);
+      spec.integer.append(
+          info.value(2).toString().compare("INTEGER", Qt::CaseInsensitive) ==
+          0);
+      spec.codec.append(table == "Data_Sample" && m_codecs.contains(column)
+                            ? int(m_codecs.value(column))
+                            : -1);
+    }
+  }
+  if (spec.columns.isEmpty()) {
+    emit importError("Import: unknown table " + table);
+    return false;
+  }
+
+  JsonRecordReader reader(jsonPath);
+  if (!reader.open()) {
+    emit importError("Import: " + jsonPath + ": " + reader.errorString());
+    return false;
+  }
+
+  QStringList marks;
+  for (int i = 0; i < spec.columns.size(); ++i)
+    marks.append("?");
+  // Dump IDs are kept; a row whose ID is already taken is skipped
+  QSqlQuery insert(db);
+  insert.prepare(QString("INSERT OR IGNORE INTO %1 (%2) VALUES (%3)")
+                     .arg(table, spec.columns.join(", "), marks.join(", ")));
+
+  qint64 tableRows = 0;
+  qint64 rowsInTxn = 0;
+  QString failure;
+  db.transaction();
+
+  auto store = [&](const QList<DecodedRow> &rows) {
+    for (const DecodedRow &row : rows) {
+      if (!row.ok) {
+        ++m_rowsSkipped;
+        continue;
+      }
+      for (int i = 0; i < row.values.size(); ++i)
+        insert.bindValue(i, row.values[i]);
+      if (!insert.exec()) {
+        failure = insert.lastError().text();
+        return false;
+      }
+      if (insert.numRowsAffected() > 0) {
+        ++m_rowsImported;
+        ++tableRows;
+      } else {
+        ++m_rowsSkipped;
+      }
+      // Large transactions, but bounded so the writer thread gets a turn
+      if (++rowsInTxn >= m_rowsPerTxn) {
+        if (!db.commit()) {
+          failure = db.lastError().text();
+          return false;
+        }
+        db.transaction();
+        rowsInTxn = 0;
+      }
+    }
+    emit progress(m_bytesBase + reader.bytesRead(), m_bytesTotal);
+    return true;
+  };
+
+  auto decode = [spec](const QByteArray &record) {
+    return decodeRecord(record, spec);
+  };
+
+  // Batch N+1 decodes on the pool while batch N is inserted here
+  QFuture<DecodedRow> inFlight;
+  bool haveInFlight = false;
+  QList<QByteArray> batch;
+  batch.reserve(m_batchSize);
+  bool more = true;
+  bool ok = true;
+  while (more && ok && !m_cancelled) {
+    QByteArray record;
+    more = reader.next(record);
+    if (more)
+      batch.append(record);
+    if (batch.size() >= m_batchSize || (!more && !batch.isEmpty())) {
+      QFuture<DecodedRow> next = QtConcurrent::mapped(std::move(batch), decode);
+      batch = QList<QByteArray>();
+      batch.reserve(m_batchSize);
+      if (haveInFlight)
+        ok = store(inFlight.results());
+      inFlight = next;
+      haveInFlight = true;
+    }
+  }
+  if (haveInFlight) {
+    if (ok)
+      ok = store(inFlight.results());
+    else
+      inFlight.waitForFinished();
+  }
+
+  if (ok && !reader.errorString().isEmpty()) {
+    failure = reader.errorString();
+    ok = false;
+  }
+  if (!ok) {
+    // Earlier transactions stay committed; rerunning skips those rows
+    db.rollback();
+    emit importError(QString("Import %1 failed: %2").arg(table, failure));
+    return false;
+  }
+  if (!db.commit()) {
+    emit importError("Import commit failed: " + db.lastError().text());
+    return false;
+  }
+
+  qDebug() << "JsonDumpImporter:" << table << tableRows << "rows";
+  emit tableImported(table, tableRows);
+  return true;
+}
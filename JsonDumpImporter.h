@@ -0,0 +1,98 @@
+#ifndef JSONDUMPIMPORTER_H
+#define JSONDUMPIMPORTER_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QHash>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <atomic>
+
+#include "WaveformCodec.h"
+
+// Splits a top-level JSON array into its element objects without parsing
+// them. Reads in fixed-size chunks, so memory is one chunk plus the record
+// being assembled regardless of the file size.
+class JsonRecordReader {
+public:
+  explicit JsonRecordReader(const QString &path, int chunkSize = 1 << 20);
+
+  bool open();
+  // Next element's raw bytes; false at the end of the array or on error
+  bool next(QByteArray &record);
+
+  qint64 bytesRead() const { return m_file.pos() - (m_chunk.size() - m_pos); }
+  qint64 size() const { return m_file.size(); }
+  QString errorString() const { return m_error; }
+
+private:
+  bool fill();
+
+  QFile m_file;
+  QByteArray m_chunk;
+  int m_pos = 0;
+  int m_chunkSize;
+  int m_depth = 0;
+  bool m_inString = false;
+  bool m_escape = false;
+  QString m_error;
+};
+
+// Imports legacy JSON table dumps (DB_js/Data_*.json) into a project DB.
+//
+// Each file is streamed record by record; batches of records are parsed and
+// their waveform columns converted to the project's codec on the global
+// thread pool while the previous batch is inserted. IDs are kept as in the
+// dump, so foreign keys stay valid; rows whose ID already exists are
+// skipped. Blocking: run it off the GUI thread.
+class JsonDumpImporter : public QObject {
+  Q_OBJECT
+public:
+  explicit JsonDumpImporter(QObject *parent = nullptr);
+
+  // Codec per waveform column (ChannelRegistry::columns()); columns
+  // without one are copied as they are in the dump
+  void setColumnCodecs(const QHash<QString, WaveformCodec::Codec> &codecs) {
+    m_codecs = codecs;
+  }
+  void setBatchSize(int records) { m_batchSize = qMax(1, records); }
+  void setRowsPerTransaction(int rows) { m_rowsPerTxn = qMax(1, rows); }
+
+  // Import every <Table>.json of dumpDir, parents before children
+  bool importDirectory(const QString &dumpDir, const QString &dbPath);
+  // Import one dump file into table
+  bool importFile(const QString &jsonPath, const QString &table,
+                  const QString &dbPath);
+
+  // Safe to call from any thread; the current batch still commits
+  void cancel() { m_cancelled = true; }
+
+  qint64 rowsImported() const { return m_rowsImported; }
+  qint64 rowsSkipped() const { return m_rowsSkipped; }
+
+  // Tables importDirectory looks for, in import order
+  static QStringList tableOrder();
+
+signals:
+  void progress(qint64 bytesDone, qint64 bytesTotal);
+  void tableImported(const QString &table, qint64 rows);
+  void importError(const QString &errorStr);
+
+private:
+  bool importOne(const QString &jsonPath, const QString &table,
+                 const QString &dbPath);
+
+  QHash<QString, WaveformCodec::Codec> m_codecs;
+  int m_batchSize = 256;
+  int m_rowsPerTxn = 4096;
+  std::atomic<bool> m_cancelled{false};
+
+  qint64 m_rowsImported = 0;
+  qint64 m_rowsSkipped = 0;
+  // Byte offsets for progress across several files
+  qint64 m_bytesBase = 0;
+  qint64 m_bytesTotal = 0;
+};
+
+#endif // JSONDUMPIMPORTER_H
@@ -0,0 +1,412 @@
+#include "LineProfile.h"
+#include "ChannelRegistry.h"
+#include "ConnectionManager.h"
+#include "ProjectArchive.h"
+#include "WaveformCodec.h"
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QStandardPaths>
+#include <QtConcurrent/QtConcurrentMap>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace {
+
+// Cache key for the gating scheme; bump the high half when gate() changes
+const int kGateSpec = (2 << 16) | LineProfile::kGateCount;
+
+const double kNaN = std::numeric_limits<double>::quiet_NaN();
+
+struct PendingSample {
+  int pointId = 0;
+  qint64 sampleId = 0;
+  int sampleRate = 0;
+  QVariant recv; // encoded column values
+  QVariant recvPos;
+};
+
+QByteArray gatesToBlob(const QVector<float> &gates) {
+  return QByteArray(reinterpret_cast<const char *>(gates.constData()),
+                    gates.size() * int(sizeof(float)));
+}
+
+bool blobToGates(const QByteArray &blob, QVector<float> &gates) {
+  if (blob.size() != LineProfile::kGateCount * int(sizeof(float)))
+    return false;
+  gates.resize(LineProfile::kGateCount);
+  memcpy(gates.data(), blob.constData(), blob.size());
+  return true;
+}
+
+// Blue -> cyan -> green -> yellow -> red
+QRgb colormap(double t) {
+  static const int stops[5][3] = {{33, 102, 172},
+                                  {67, 190, 210},
+                                  {102, 189, 99},
+                                  {253, 219, 79},
+                                  {215, 48, 39}};
+  t = qBound(0.0, t, 1.0) * 4.0;
+  const int i = qMin(3, int(t));
+  const double f = t - i;
+  auto mix = [&](int c) {
+    return int(stops[i][c] + (stops[i + 1][c] - stops[i][c]) * f);
+  };
+  return qRgb(mix(0), mix(1), mix(2));
+}
+
+} // namespace
+
+QVector<double> LineProfile::gateEdgesUs() {
+  QVector<double> edges(kGateCount + 1);
+  const double ratio = std::log(kLastGateUs / kFirstGateUs) / kGateCount;
+  for (int g = 0; g <= kGateCount; ++g)
+    edges[g] = kFirstGateUs * std::exp(ratio * g);
+  return edges;
+}
+
+QVector<float> LineProfile::gate(const QVector<float> &recv, int sampleRate,
+                                 const QVector<float> &positionsUs) {
+  static const QVector<double> edges = gateEdgesUs();
+  const int n = recv.size();
+  QVector<float> gates(kGateCount, float(kNaN));
+
+  // Values at their own gate times: each goes to the gate it falls in
+  if (!positionsUs.isEmpty() && positionsUs.size() == n) {
+    QVector<double> sum(kGateCount, 0.0);
+    QVector<int> count(kGateCount, 0);
+    for (int i = 0; i < n; ++i) {
+      const double t = positionsUs[i];
+      if (!(t >= edges.first() && t < edges.last()))
+        continue;
+      const int g = int(std::upper_bound(edges.cbegin(), edges.cend(), t) -
+                        edges.cbegin()) - 1;
+      sum[g] += qAbs(recv[i]);
+      ++count[g];
+    }
+    for (int g = 0; g < kGateCount; ++g) {
+      if (count[g] > 0)
+        gates[g] = float(sum[g] / count[g]);
+    }
+    return gates;
+  }
+
+  const int fs = sampleRate > 0
+                     ? sampleRate
+                     : ChannelRegistry::channel(ChannelRegistry::Recv)
+                           .defaultRate;
+  const double dtUs = 1000000.0 / fs;
+  for (int g = 0; g < kGateCount; ++g) {
+    const int a = int(std::ceil(edges[g] / dtUs));
+    if (a >= n)
+      break; // later gates are past the record too
+    // Early gates are narrower than a sample; they take the nearest one
+    const int b = qMin(n, qMax(a + 1, int(std::ceil(edges[g + 1] / dtUs))));
+    double sum = 0.0;
+    for (int i = a; i < b; ++i)
+      sum += qAbs(recv[i]);
+    gates[g] = float(sum / (b - a));
+  }
+  return gates;
+}
+
+double LineProfile::value(int column, int gate) const {
+  const Column &c = m_columns[column];
+  return c.count[gate] > 0 ? c.sum[gate] / c.count[gate] : kNaN;
+}
+
+bool LineProfile::ensureCacheTable(QSqlDatabase &db) {
+  QSqlQuery q(db);
+  return q.exec("CREATE TABLE IF NOT EXISTS Profile_Gate ("
+                "SampleID INTEGER NOT NULL, "
+                "Spec INTEGER NOT NULL, "
+                "Gates BLOB NOT NULL, "
+                "PRIMARY KEY (SampleID, Spec)"
+                ") WITHOUT ROWID");
+}
+
+void LineProfile::setPoints(const QVector<QPair<int, QString>> &points) {
+  // Points may have been added since the last pass; existing sums carry over
+  QVector<Column> columns;
+  QHash<int, int> columnOf;
+  columns.reserve(points.size());
+  for (const auto &p : points) {
+    Column c;
+    const auto it = m_columnOf.constFind(p.first);
+    if (it != m_columnOf.constEnd()) {
+      c = m_columns[it.value()];
+    } else {
+      c.pointId = p.first;
+      c.sum.fill(0.0, kGateCount);
+      c.count.fill(0, kGateCount);
+    }
+    c.name = p.second;
+    columnOf.insert(p.first, columns.size());
+    columns.append(c);
+  }
+  m_columns = std::move(columns);
+  m_columnOf = std::move(columnOf);
+}
+
+void LineProfile::addSample(int pointId, const QVector<float> &gates) {
+  const auto it = m_columnOf.constFind(pointId);
+  if (it == m_columnOf.constEnd())
+    return;
+  Column &c = m_columns[it.value()];
+  for (int g = 0; g < kGateCount && g < gates.size(); ++g) {
+    if (std::isnan(gates[g]))
+      continue;
+    c.sum[g] += gates[g];
+    ++c.count[g];
+  }
+}
+
+QString LineProfile::cachePath(const QString &dbPath) {
+  const QString dir =
+      QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) +
+      "/profile-cache";
+  QDir().mkpath(dir);
+  const QByteArray key = QCryptographicHash::hash(
+      QFileInfo(dbPath).absoluteFilePath().toUtf8(),
+      QCryptographicHash::Sha1);
+  return dir + "/" + QString::fromLatin1(key.toHex().left(16)) + ".db";
+}
+
+bool LineProfile::update(const QString &dbPath, int *samplesAdded,
+                         QString *error) {
+  auto fail = [error](const QString &message) {
+    if (error)
+      *error = message;
+    return false;
+  };
+  if (samplesAdded)
+    *samplesAdded = 0;
+
+  // The project is only read; gates are cached in a file of our own, and
+  // without one the profile is computed from scratch each time
+  QSqlDatabase db =
+      ConnectionManager::connection(dbPath, ConnectionManager::ReadOnly);
+  if (!db.isOpen())
+    return fail("Profile connection failed: " + db.lastError().text());
+  QSqlDatabase cache = ConnectionManager::connection(cachePath(dbPath));
+  const bool canCache = cache.isOpen() && ensureCacheTable(cache);
+
+  QSqlQuery pq(db);
+  pq.prepare("SELECT ID, NAME FROM Data_Point WHERE Data_LineID = ? "
+             "ORDER BY NAME, ID");
+  pq.addBindValue(m_lineId);
+  if (!pq.exec())
+    return fail("Profile: " + pq.lastError().text());
+  QVector<QPair<int, QString>> points;
+  while (pq.next())
+    points.append({pq.value(0).toInt(), pq.value(1).toString()});
+  setPoints(points);
+
+  // Only samples newer than the last pass. Waveforms are fetched by ID,
+  // and only for samples whose gates are not cached.
+  QSqlQuery q(db);
+  q.setForwardOnly(true);
+  q.prepare("SELECT s.ID, s.Data_PointID, s.RecvFs "
+            "FROM Data_Sample s JOIN Data_Point p ON p.ID = s.Data_PointID "
+            "WHERE p.Data_LineID = ? AND s.ID > ? ORDER BY s.ID");
+  q.addBindValue(m_lineId);
+  q.addBindValue(m_lastSampleId);
+  if (!q.exec())
+    return fail("Profile: " + q.lastError().text());
+  QSqlQuery wave(db);
+  wave.prepare("SELECT DATA_RECV, DATA_RECV_POS FROM Data_Sample "
+               "WHERE ID = ?");
+  QSqlQuery cached(cache);
+  if (canCache)
+    cached.prepare("SELECT Gates FROM Profile_Gate "
+                   "WHERE SampleID = ? AND Spec = ?");
+
+  const int chunkSize = 64;
+  QList<PendingSample> pending;
+  QVector<QPair<qint64, QByteArray>> toCache;
+  int added = 0;
+  auto flush = [&]() {
+    const QList<QVector<float>> gated = QtConcurrent::blockingMapped(
+        pending, [](const PendingSample &s) {
+          return gate(WaveformCodec::decode(s.recv), s.sampleRate,
+                      s.recvPos.isNull() ? QVector<float>()
+                                         : WaveformCodec::decode(s.recvPos));
+        });
+    for (int i = 0; i < pending.size(); ++i) {
+      addSample(pending[i].pointId, gated[i]);
+      if (canCache)
+        toCache.append({pending[i].sampleId, gatesToBlob(gated[i])});
+    }
+    added += pending.size();
+    pending.clear();
+  };
+
+  QVector<float> gates;
+  while (q.next()) {
+    const qint64 sampleId = q.value(0).toLongLong();
+    const int pointId = q.value(1).toInt();
+    m_lastSampleId = qMax(m_lastSampleId, sampleId);
+    if (canCache) {
+      cached.bindValue(0, sampleId);
+      cached.bindValue(1, kGateSpec);
+      const bool hit = cached.exec() && cached.next() &&
+                       blobToGates(cached.value(0).toByteArray(), gates);
+      cached.finish();
+      if (hit) {
+        addSample(pointId, gates);
+        ++added;
+        continue;
+      }
+    }
+    wave.bindValue(0, sampleId);
+    if (!wave.exec())
+      return fail("Profile: " + wave.lastError().text());
+    if (!wave.next())
+      continue;
+    PendingSample s;
+    s.pointId = pointId;
+    s.sampleId = sampleId;
+    s.sampleRate = q.value(2).toInt();
+    s.recv = wave.value(0);
+    s.recvPos = wave.value(1);
+    wave.finish();
+    pending.append(s);
+    if (pending.size() >= chunkSize)
+      flush();
+  }
+  if (!pending.isEmpty())
+    flush();
+  q.finish();
+
+  if (!toCache.isEmpty() && cache.transaction()) {
+    QSqlQuery insert(cache);
+    insert.prepare("INSERT OR REPLACE INTO Profile_Gate (SampleID, Spec, "
+                   "Gates) VALUES (?, ?, ?)");
+    bool ok = true;
+    for (const auto &row : std::as_const(toCache)) {
+      insert.bindValue(0, row.first);
+      insert.bindValue(1, kGateSpec);
+      insert.bindValue(2, row.second);
+      if (!(ok = insert.exec()))
+        break;
+    }
+    // A failed cache write only costs a recompute next time
+    if (!ok || !cache.commit()) {
+      qDebug() << "LineProfile: cache write failed" << insert.lastError();
+      cache.rollback();
+    }
+  }
+
+  if (samplesAdded)
+    *samplesAdded = added;
+  return true;
+}
+
+void LineProfile::buildFromArchive(const ProjectArchive &archive) {
+  QVector<QPair<int, QString>> points;
+  QList<const ProjectArchive::SampleEntry *> samples;
+  for (int i = 0; i < archive.lineCount(); ++i) {
+    const ProjectArchive::LineEntry &line = archive.line(i);
+    if (line.id != m_lineId)
+      continue;
+    QList<const ProjectArchive::PointEntry *> entries;
+    for (quint32 k = 0; k < line.pointCount; ++k)
+      entries.append(&archive.point(int(line.firstPoint + k)));
+    std::sort(entries.begin(), entries.end(),
+              [](const ProjectArchive::PointEntry *a,
+                 const ProjectArchive::PointEntry *b) {
+                return a->name < b->name || (a->name == b->name && a->id < b->id);
+              });
+    for (const ProjectArchive::PointEntry *p : std::as_const(entries)) {
+      points.append({p->id, QString::number(p->name)});
+      for (quint32 k = 0; k < p->sampleCount; ++k)
+        samples.append(&archive.sample(int(p->firstSample + k)));
+    }
+    break;
+  }
+  setPoints(points);
+
+  const QList<QVector<float>> gated = QtConcurrent::blockingMapped(
+      samples, [&archive](const ProjectArchive::SampleEntry *s) {
+        auto column = [&](int ch) {
+          int count = 0;
+          const float *data = archive.channel(*s, ch, &count);
+          return data ? QVector<float>(data, data + count) : QVector<float>();
+        };
+        return gate(column(ChannelRegistry::Recv), int(s->recvFs),
+                    column(ChannelRegistry::RecvPos));
+      });
+  for (int i = 0; i < samples.size(); ++i) {
+    addSample(samples[i]->pointId, gated[i]);
+    m_lastSampleId = qMax<qint64>(m_lastSampleId, samples[i]->id);
+  }
+}
+
+QImage LineProfile::render() const {
+  QImage image(qMax(1, int(m_columns.size())), kGateCount, QImage::Format_RGB32);
+  image.fill(qRgb(236, 239, 241));
+
+  // Colour by log amplitude over the range present on the line
+  double lo = std::numeric_limits<double>::max();
+  double hi = std::numeric_limits<double>::lowest();
+  for (int c = 0; c < m_columns.size(); ++c) {
+    for (int g = 0; g < kGateCount; ++g) {
+      const double v = value(c, g);
+      if (v > 0.0) {
+        lo = qMin(lo, std::log10(v));
+        hi = qMax(hi, std::log10(v));
+      }
+    }
+  }
+  if (lo > hi)
+    return image;
+  const double span = hi > lo ? hi - lo : 1.0;
+
+  for (int g = 0; g < kGateCount; ++g) {
+    QRgb *row = reinterpret_cast<QRgb *>(image.scanLine(g));
+    for (int c = 0; c < m_columns.size(); ++c) {
+      const double v = value(c, g);
+      if (v > 0.0)
+        row[c] = colormap((std::log10(v) - lo) / span);
+    }
+  }
+  return image;
+}
+
+QMutex LineProfileImageProvider::s_mutex;
+QHash<QString, QImage> LineProfileImageProvider::s_images;
+
+QImage LineProfileImageProvider::requestImage(const QString &id, QSize *size,
+                                              const QSize &requestedSize) {
+  // The query part is only a revision to defeat the QML image cache
+  const QString key = id.section('?', 0, 0);
+  QImage image;
+  {
+    QMutexLocker lock(&s_mutex);
+    image = s_images.value(key);
+  }
+  if (size)
+    *size = image.size();
+  // Columns stay crisp: the view scales without smoothing
+  if (requestedSize.isValid() && !image.isNull())
+    image = image.scaled(requestedSize, Qt::IgnoreAspectRatio,
+                         Qt::FastTransformation);
+  return image;
+}
+
+void LineProfileImageProvider::publish(const QString &key,
+                                       const QImage &image) {
+  QMutexLocker lock(&s_mutex);
+  s_images.insert(key, image);
+}
+
+void LineProfileImageProvider::remove(const QString &key) {
+  QMutexLocker lock(&s_mutex);
+  s_images.remove(key);
+}
@@ -0,0 +1,94 @@
+#ifndef LINEPROFILE_H
+#define LINEPROFILE_H
+
+#include <QHash>
+#include <QImage>
+#include <QMutex>
+#include <QPair>
+#include <QQuickImageProvider>
+#include <QSqlDatabase>
+#include <QString>
+#include <QVector>
+
+class ProjectArchive;
+
+// Pseudo-section of one survey line: a column per point (ordered by point
+// name, i.e. station position), a row per log-spaced time gate, coloured by
+// the log amplitude of the stacked receive signal.
+//
+// Gating every Data_Sample of the line is a parallel decode pass. Gated
+// values are cached per sample in Profile_Gate, in a cache file under
+// AppData keyed by the project's path (the project itself is only read),
+// so reopening a line only reads the cache, and update() folds in samples
+// newer than the last pass without touching the columns they don't belong
+// to.
+class LineProfile {
+public:
+  static const int kGateCount = 40;
+  // Gate edges are fixed in absolute time so columns line up
+  static constexpr double kFirstGateUs = 10.0;
+  static constexpr double kLastGateUs = 20000.0;
+
+  struct Column {
+    int pointId = 0;
+    QString name;
+    QVector<double> sum; // per gate, over the point's samples
+    QVector<int> count;
+  };
+
+  explicit LineProfile(int lineId = -1) : m_lineId(lineId) {}
+
+  int lineId() const { return m_lineId; }
+  int columnCount() const { return m_columns.size(); }
+  const Column &column(int i) const { return m_columns[i]; }
+  qint64 lastSampleId() const { return m_lastSampleId; }
+  // Mean gated amplitude, NaN where no sample reaches the gate
+  double value(int column, int gate) const;
+
+  // Bring the profile up to date from dbPath on the calling thread, with
+  // that thread's pooled connection; returns the number of samples added
+  bool update(const QString &dbPath, int *samplesAdded = nullptr,
+              QString *error = nullptr);
+  // Whole line from a mapped archive (nothing to cache)
+  void buildFromArchive(const ProjectArchive &archive);
+
+  // Columns x gates, early time at the top
+  QImage render() const;
+
+  static QVector<double> gateEdgesUs();
+  // Mean |recv| per gate; NaN for gates no value falls into. Values are
+  // placed at positionsUs (DATA_RECV_POS) when it has one per value, else
+  // evenly at sampleRate (RecvFs).
+  static QVector<float> gate(const QVector<float> &recv, int sampleRate,
+                             const QVector<float> &positionsUs = {});
+
+private:
+  static QString cachePath(const QString &dbPath);
+  static bool ensureCacheTable(QSqlDatabase &db);
+  void setPoints(const QVector<QPair<int, QString>> &points);
+  void addSample(int pointId, const QVector<float> &gates);
+
+  int m_lineId;
+  QVector<Column> m_columns;
+  QHash<int, int> m_columnOf; // point ID -> column
+  qint64 m_lastSampleId = 0;
+};
+
+// Serves rendered profiles to QML as image://lineprofile/<key>?<revision>
+class LineProfileImageProvider : public QQuickImageProvider {
+public:
+  LineProfileImageProvider() : QQuickImageProvider(QQuickImageProvider::Image) {}
+
+  QImage requestImage(const QString &id, QSize *size,
+                      const QSize &requestedSize) override;
+
+  // Called from the GUI thread; the engine may read from its loader thread
+  static void publish(const QString &key, const QImage &image);
+  static void remove(const QString &key);
+
+private:
+  static QMutex s_mutex;
+  static QHash<QString, QImage> s_images;
+};
+
+#endif // LINEPROFILE_H
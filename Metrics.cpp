@@ -0,0 +1,197 @@
+#include "Metrics.h"
+#include <QMutex>
+#include <QMutexLocker>
+#include <QtAlgorithms>
+#include <memory>
+#include <vector>
+
+namespace Metrics {
+
+namespace {
+
+enum Kind { CounterKind, GaugeKind, HistogramKind };
+
+struct Entry {
+  QByteArray name;
+  QByteArray help;
+  Kind kind;
+  double scale = 1.0;
+  std::unique_ptr<Counter> counter;
+  std::unique_ptr<Gauge> gauge;
+  std::unique_ptr<Histogram> histogram;
+};
+
+struct Registry {
+  QMutex mutex;
+  std::vector<std::unique_ptr<Entry>> entries;
+
+  // The existing entry, or a new one; whichever caller passes a help
+  // string first provides it
+  Entry *lookup(const char *name, const char *help, Kind kind) {
+    for (const auto &e : entries) {
+      if (e->name == name) {
+        Q_ASSERT(e->kind == kind);
+        if (e->help.isEmpty())
+          e->help = help;
+        return e.get();
+      }
+    }
+    auto e = std::make_unique<Entry>();
+    e->name = name;
+    e->help = help;
+    e->kind = kind;
+    entries.push_back(std::move(e));
+    return entries.back().get();
+  }
+};
+
+// Never destroyed: metrics may be recorded from threads still running
+// while static destructors run
+Registry &registry() {
+  static Registry *r = new Registry;
+  return *r;
+}
+
+QByteArray number(double v) { return QByteArray::number(v, 'g', 10); }
+
+} // namespace
+
+int Histogram::bucketOf(quint64 v) {
+  if (v < quint64(kSub))
+    return int(v);
+  const int msb = 63 - qCountLeadingZeroBits(v);
+  const int shift = msb - kSubBits;
+  return (shift + 1) * kSub + int((v >> shift) & (kSub - 1));
+}
+
+qint64 Histogram::bucketLow(int index) {
+  if (index < kSub)
+    return index;
+  const int shift = index / kSub - 1;
+  return qint64(kSub + index % kSub) << shift;
+}
+
+qint64 Histogram::bucketHigh(int index) {
+  if (index < kSub)
+    return index;
+  return bucketLow(index) + ((qint64(1) << (index / kSub - 1)) - 1);
+}
+
+Histogram::Snapshot Histogram::snapshot() const {
+  Snapshot s;
+  // Count comes from the buckets so quantiles agree with it under
+  // concurrent recording
+  for (int i = 0; i < kBuckets; ++i) {
+    s.buckets[i] = m_buckets[i].load(std::memory_order_relaxed);
+    s.count += s.buckets[i];
+  }
+  s.sum = m_sum.load(std::memory_order_relaxed);
+  s.max = m_max.load(std::memory_order_relaxed);
+  return s;
+}
+
+qint64 Histogram::Snapshot::quantile(double q) const {
+  if (count == 0)
+    return 0;
+  const qint64 rank = qMax<qint64>(1, qint64(q * count + 0.5));
+  qint64 seen = 0;
+  for (int i = 0; i < kBuckets; ++i) {
+    seen += buckets[i];
+    if (seen >= rank)
+      return qMin(max, bucketLow(i) + (bucketHigh(i) - bucketLow(i)) / 2);
+  }
+  return max;
+}
+
+Counter &counter(const char *name, const char *help) {
+  Registry &r = registry();
+  QMutexLocker lock(&r.mutex);
+  Entry *e = r.lookup(name, help, CounterKind);
+  if (!e->counter)
+    e->counter = std::make_unique<Counter>();
+  return *e->counter;
+}
+
+Gauge &gauge(const char *name, const char *help) {
+  Registry &r = registry();
+  QMutexLocker lock(&r.mutex);
+  Entry *e = r.lookup(name, help, GaugeKind);
+  if (!e->gauge)
+    e->gauge = std::make_unique<Gauge>();
+  return *e->gauge;
+}
+
+Histogram &histogram(const char *name, const char *help, double scale) {
+  Registry &r = registry();
+  QMutexLocker lock(&r.mutex);
+  Entry *e = r.lookup(name, help, HistogramKind);
+  if (!e->histogram) {
+    e->scale = scale;
+    e->histogram = std::make_unique<Histogram>();
+  }
+  return *e->histogram;
+}
+
+QByteArray prometheusText() {
+  static const double kQuantiles[] = {0.5, 0.9, 0.99, 0.999};
+  Registry &r = registry();
+  QMutexLocker lock(&r.mutex);
+  QByteArray out;
+  out.reserve(int(r.entries.size()) * 160);
+  for (const auto &e : r.entries) {
+    if (!e->help.isEmpty())
+      out += "# HELP " + e->name + ' ' + e->help + '\n';
+    switch (e->kind) {
+    case CounterKind:
+      out += "# TYPE " + e->name + " counter\n";
+      out += e->name + ' ' + QByteArray::number(e->counter->value()) + '\n';
+      break;
+    case GaugeKind:
+      out += "# TYPE " + e->name + " gauge\n";
+      out += e->name + ' ' + QByteArray::number(e->gauge->value()) + '\n';
+      break;
+    case HistogramKind: {
+      const Histogram::Snapshot s = e->histogram->snapshot();
+      out += "# TYPE " + e->name + " summary\n";
+      for (double q : kQuantiles)
+        out += e->name + "{quantile=\"" + number(q) + "\"} " +
+               number(s.quantile(q) * e->scale) + '\n';
+      out += e->name + "_sum " + number(s.sum * e->scale) + '\n';
+      out += e->name + "_count " + QByteArray::number(s.count) + '\n';
+      break;
+    }
+    }
+  }
+  return out;
+}
+
+QVariantMap snapshot() {
+  Registry &r = registry();
+  QMutexLocker lock(&r.mutex);
+  QVariantMap out;
+  for (const auto &e : r.entries) {
+    const QString name = QString::fromLatin1(e->name);
+    switch (e->kind) {
+    case CounterKind:
+      out[name] = e->counter->value();
+      break;
+    case GaugeKind:
+      out[name] = e->gauge->value();
+      break;
+    case HistogramKind: {
+      const Histogram::Snapshot s = e->histogram->snapshot();
+      QVariantMap h;
+      h["count"] = s.count;
+      h["sum"] = s.sum * e->scale;
+      h["p50"] = s.quantile(0.5) * e->scale;
+      h["p99"] = s.quantile(0.99) * e->scale;
+      h["max"] = s.max * e->scale;
+      out[name] = h;
+      break;
+    }
+    }
+  }
+  return out;
+}
+
+} // namespace Metrics
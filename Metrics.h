@@ -0,0 +1,113 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <QByteArray>
+#include <QString>
+#include <QVariantMap>
+#include <atomic>
+#include <chrono>
+
+// Process-wide counters, gauges and latency histograms.
+//
+// Metrics are registered once by name and live until exit, so hot paths
+// keep the returned reference and record with a single relaxed atomic add.
+// That is cheap enough to leave on in the field. Readers (the QML HUD,
+// MetricsExporter) take snapshots; values are never reset.
+namespace Metrics {
+
+class Counter {
+public:
+  void add(qint64 n = 1) { m_value.fetch_add(n, std::memory_order_relaxed); }
+  qint64 value() const { return m_value.load(std::memory_order_relaxed); }
+
+private:
+  std::atomic<qint64> m_value{0};
+};
+
+class Gauge {
+public:
+  void set(qint64 v) { m_value.store(v, std::memory_order_relaxed); }
+  void add(qint64 n) { m_value.fetch_add(n, std::memory_order_relaxed); }
+  qint64 value() const { return m_value.load(std::memory_order_relaxed); }
+
+private:
+  std::atomic<qint64> m_value{0};
+};
+
+// HDR-style log-linear buckets: 8 per power of two, so any recorded value
+// is reported within 12.5% over the whole non-negative qint64 range
+class Histogram {
+public:
+  static constexpr int kSubBits = 3;
+  static constexpr int kSub = 1 << kSubBits;
+  static constexpr int kBuckets = (63 - kSubBits + 1) * kSub;
+
+  struct Snapshot {
+    qint64 count = 0;
+    qint64 sum = 0;
+    qint64 max = 0;
+    qint64 buckets[kBuckets] = {};
+    // Midpoint of the bucket holding quantile q (0..1)
+    qint64 quantile(double q) const;
+  };
+
+  void record(qint64 v) {
+    if (v < 0)
+      v = 0;
+    m_buckets[bucketOf(quint64(v))].fetch_add(1, std::memory_order_relaxed);
+    m_sum.fetch_add(v, std::memory_order_relaxed);
+    qint64 prev = m_max.load(std::memory_order_relaxed);
+    while (v > prev &&
+           !m_max.compare_exchange_weak(prev, v, std::memory_order_relaxed)) {
+    }
+  }
+  Snapshot snapshot() const;
+
+  static int bucketOf(quint64 v);
+  static qint64 bucketLow(int index);
+  static qint64 bucketHigh(int index);
+
+private:
+  std::atomic<qint64> m_buckets[kBuckets] = {};
+  std::atomic<qint64> m_sum{0};
+  std::atomic<qint64> m_max{0};
+};
+
+// Registration takes a lock; call these once and keep the reference.
+// The same name always returns the same metric. Names follow Prometheus
+// conventions (tem_<area>_<what>[_total|_seconds|_rows]).
+Counter &counter(const char *name, const char *help = "");
+Gauge &gauge(const char *name, const char *help = "");
+// scale converts recorded values to the exported unit (1e-9 for ns
+// recorded into a *_seconds histogram)
+Histogram &histogram(const char *name, const char *help = "",
+                     double scale = 1.0);
+
+// Prometheus text exposition format 0.0.4; histograms are exported as
+// summaries with p50, p90, p99 and p999
+QByteArray prometheusText();
+// name -> value for counters and gauges; name -> {count, sum, p50, p99, max}
+// (exported unit) for histograms
+QVariantMap snapshot();
+
+// Records the nanoseconds between construction and destruction
+class ScopedTimer {
+public:
+  explicit ScopedTimer(Histogram &h)
+      : m_histogram(h), m_start(std::chrono::steady_clock::now()) {}
+  ~ScopedTimer() {
+    m_histogram.record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                           std::chrono::steady_clock::now() - m_start)
+                           .count());
+  }
+  ScopedTimer(const ScopedTimer &) = delete;
+  ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+private:
+  Histogram &m_histogram;
+  std::chrono::steady_clock::time_point m_start;
+};
+
+} // namespace Metrics
+
+#endif // METRICS_H
@@ -0,0 +1,102 @@
+#include "MetricsExporter.h"
+#include "Metrics.h"
+#include <QDebug>
+#include <QSaveFile>
+#include <QTcpServer>
+#include <QTcpSocket>
+
+namespace {
+
+const int kMaxRequestBytes = 8192;
+
+QByteArray httpResponse(const QByteArray &status, const QByteArray &type,
+                        const QByteArray &body) {
+  return "HTTP/1.0 " + status + "\r\nContent-Type: " + type +
+         "\r\nContent-Length: " + QByteArray::number(body.size()) +
+         "\r\nConnection: close\r\n\r\n" + body;
+}
+
+} // namespace
+
+MetricsExporter::MetricsExporter(QObject *parent) : QObject(parent) {
+  connect(&m_fileTimer, &QTimer::timeout, this,
+          [this]() { writeTextFile(); });
+}
+
+bool MetricsExporter::setTextFile(const QString &path, int intervalMs,
+                                  QString *error) {
+  m_fileTimer.stop();
+  m_path = path;
+  if (m_path.isEmpty())
+    return true;
+  if (!writeTextFile(error))
+    return false;
+  m_fileTimer.start(qMax(100, intervalMs));
+  return true;
+}
+
+bool MetricsExporter::writeTextFile(QString *error) {
+  // Scrapers must never see a half-written file
+  QSaveFile file(m_path);
+  if (!file.open(QIODevice::WriteOnly) ||
+      file.write(Metrics::prometheusText()) < 0 || !file.commit()) {
+    const QString err = "Cannot write metrics: " + file.errorString();
+    if (error)
+      *error = err;
+    qWarning() << "MetricsExporter:" << err << m_path;
+    return false;
+  }
+  return true;
+}
+
+bool MetricsExporter::listen(quint16 port, QString *error) {
+  if (!m_server) {
+    m_server = new QTcpServer(this);
+    connect(m_server, &QTcpServer::newConnection, this,
+            &MetricsExporter::onNewConnection);
+  }
+  m_server->close();
+  if (!m_server->listen(QHostAddress::LocalHost, port)) {
+    if (error)
+      *error = m_server->errorString();
+    return false;
+  }
+  qDebug() << "MetricsExporter: serving http://127.0.0.1:"
+           << m_server->serverPort() << "/metrics";
+  return true;
+}
+
+quint16 MetricsExporter::serverPort() const {
+  return m_server ? m_server->serverPort() : 0;
+}
+
+void MetricsExporter::onNewConnection() {
+  while (QTcpSocket *socket = m_server->nextPendingConnection()) {
+    connect(socket, &QTcpSocket::disconnected, socket,
+            &QObject::deleteLater);
+    connect(socket, &QTcpSocket::readyRead, socket, [socket]() {
+      // Only the request line matters; wait until it is complete
+      if (!socket->canReadLine()) {
+        if (socket->bytesAvailable() > kMaxRequestBytes)
+          socket->abort();
+        return;
+      }
+      const QList<QByteArray> request = socket->readLine().split(' ');
+      QObject::disconnect(socket, &QTcpSocket::readyRead, nullptr, nullptr);
+      const QByteArray method = request.value(0);
+      const QByteArray target = request.value(1);
+      if (method != "GET") {
+        socket->write(httpResponse("405 Method Not Allowed", "text/plain",
+                                   "GET only\n"));
+      } else if (target != "/metrics" && target != "/") {
+        socket->write(httpResponse("404 Not Found", "text/plain",
+                                   "Try /metrics\n"));
+      } else {
+        socket->write(httpResponse("200 OK",
+                                   "text/plain; version=0.0.4",
+                                   Metrics::prometheusText()));
+      }
+      socket->disconnectFromHost();
+    });
+  }
+}
@@ -0,0 +1,35 @@
+#ifndef METRICSEXPORTER_H
+#define METRICSEXPORTER_H
+
+#include <QObject>
+#include <QString>
+#include <QTimer>
+
+class QTcpServer;
+
+// Publishes Metrics::prometheusText() for a local scraper: rewritten to a
+// file on an interval (node_exporter's textfile collector picks it up), or
+// served as GET /metrics on 127.0.0.1 only. Nothing is reachable off-box.
+class MetricsExporter : public QObject {
+  Q_OBJECT
+public:
+  explicit MetricsExporter(QObject *parent = nullptr);
+
+  // Atomically replace path every intervalMs; an empty path stops
+  bool setTextFile(const QString &path, int intervalMs = 5000,
+                   QString *error = nullptr);
+  // Port 0 picks a free one; see serverPort()
+  bool listen(quint16 port, QString *error = nullptr);
+  quint16 serverPort() const;
+
+  bool writeTextFile(QString *error = nullptr);
+
+private:
+  void onNewConnection();
+
+  QString m_path;
+  QTimer m_fileTimer;
+  QTcpServer *m_server = nullptr;
+};
+
+#endif // METRICSEXPORTER_H
@@ -0,0 +1,109 @@
+#include "MinMaxDecimator.h"
+#include <QtGlobal>
+
+MinMaxDecimator::MinMaxDecimator(Mode mode, int maxBuckets)
+    : m_mode(mode), m_maxBuckets(qMax(2, maxBuckets)) {}
+
+void MinMaxDecimator::setSource(const QVector<float> &data, int offset) {
+  m_data = data;
+  m_offset = qBound(0, offset, int(data.size()));
+  m_length = 0;
+  m_width = 1;
+  m_buckets.clear();
+}
+
+void MinMaxDecimator::clear() { setSource(QVector<float>()); }
+
+float MinMaxDecimator::transform(float v) const {
+  return m_mode == Magnitude ? qMax(0.001f, qAbs(v)) : v;
+}
+
+void MinMaxDecimator::setLength(int length) {
+  length = qBound(0, length, int(m_data.size()) - m_offset);
+  if (length < m_length) {
+    const QVector<float> data = m_data;
+    setSource(data, m_offset);
+  }
+  if (length > m_length)
+    append(m_length, length);
+  m_length = length;
+}
+
+void MinMaxDecimator::append(int from, int to) {
+  const float *p = m_data.constData() + m_offset;
+  int i = from;
+  while (i < to) {
+    // Fill the open (last, partial) bucket first
+    if (!m_buckets.isEmpty() && i % m_width != 0) {
+      Bucket &b = m_buckets.last();
+      const int end = qMin(to, (i / m_width + 1) * m_width);
+      for (; i < end; ++i) {
+        const float v = transform(p[i]);
+        if (v < b.min) {
+          b.min = v;
+          b.minIndex = i;
+        }
+        if (v > b.max) {
+          b.max = v;
+          b.maxIndex = i;
+        }
+      }
+      continue;
+    }
+    if (m_buckets.size() >= m_maxBuckets)
+      mergePairs();
+    const float v = transform(p[i]);
+    m_buckets.append({v, v, i, i});
+    ++i;
+  }
+}
+
+void MinMaxDecimator::mergePairs() {
+  // Buckets are width-aligned, so pairs merge into buckets of twice the
+  // width; an odd trailing bucket simply becomes the open one
+  int out = 0;
+  for (int i = 0; i < m_buckets.size(); i += 2, ++out) {
+    Bucket merged = m_buckets[i];
+    if (i + 1 < m_buckets.size()) {
+      const Bucket &b = m_buckets[i + 1];
+      if (b.min < merged.min) {
+        merged.min = b.min;
+        merged.minIndex = b.minIndex;
+      }
+      if (b.max > merged.max) {
+        merged.max = b.max;
+        merged.maxIndex = b.maxIndex;
+      }
+    }
+    m_buckets[out] = merged;
+  }
+  m_buckets.resize(out);
+  m_width *= 2;
+}
+
+template <typename X>
+QList<QPointF> MinMaxDecimator::bucketPoints(X x) const {
+  QList<QPointF> pts;
+  pts.reserve(m_buckets.size() * 2);
+  for (const Bucket &b : m_buckets) {
+    if (b.minIndex == b.maxIndex) {
+      pts.append(QPointF(x(b.minIndex), b.min));
+    } else if (b.minIndex < b.maxIndex) {
+      pts.append(QPointF(x(b.minIndex), b.min));
+      pts.append(QPointF(x(b.maxIndex), b.max));
+    } else {
+      pts.append(QPointF(x(b.maxIndex), b.max));
+      pts.append(QPointF(x(b.minIndex), b.min));
+    }
+  }
+  return pts;
+}
+
+QList<QPointF> MinMaxDecimator::points(double dt) const {
+  return bucketPoints([dt](int i) { return i * dt; });
+}
+
+QList<QPointF> MinMaxDecimator::points(const QVector<float> &x) const {
+  const float *p = x.constData() + m_offset;
+  return bucketPoints([p](int i) { return double(p[i]); });
+}
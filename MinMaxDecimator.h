@@ -0,0 +1,62 @@
+#ifndef MINMAXDECIMATOR_H
+#define MINMAXDECIMATOR_H
+
+#include <QList>
+#include <QPointF>
+#include <QVector>
+
+// Incremental min/max decimation of a growing window over sample storage.
+//
+// The window is a view (offset, length) into an implicitly shared,
+// immutable QVector; nothing is copied. Samples are folded into fixed-width
+// buckets as the window grows, and when the bucket budget is exceeded
+// neighbouring buckets are merged pairwise, so earlier work is reused and
+// extending the window costs only the newly revealed samples.
+class MinMaxDecimator {
+public:
+  enum Mode {
+    Value,    // plain values
+    Magnitude // |x| floored for a log axis, as the receive charts plot it
+  };
+
+  explicit MinMaxDecimator(Mode mode = Value, int maxBuckets = 750);
+
+  // Shares data; the window starts empty at offset
+  void setSource(const QVector<float> &data, int offset = 0);
+  void clear();
+
+  // Grow (or shrink) the window to length samples past the offset.
+  // Shrinking rebuilds from the offset, which only happens on a seek back
+  void setLength(int length);
+  int length() const { return m_length; }
+
+  // Up to two points per bucket (min and max in sample order), with
+  // x = (index in window) * dt
+  QList<QPointF> points(double dt) const;
+  // Same, with x taken from positions (x[offset + index]), for values that
+  // are not evenly spaced; positions must cover the source
+  QList<QPointF> points(const QVector<float> &x) const;
+
+private:
+  struct Bucket {
+    float min;
+    float max;
+    int minIndex;
+    int maxIndex;
+  };
+
+  template <typename X> QList<QPointF> bucketPoints(X x) const;
+  float transform(float v) const;
+  void append(int from, int to);
+  void mergePairs();
+
+  Mode m_mode;
+  int m_maxBuckets;
+  QVector<float> m_data; // shared with the owner, never detached
+  int m_offset = 0;
+  int m_length = 0;
+  int m_width = 1; // samples per bucket
+  QVector<Bucket> m_buckets;
+};
+
+#endif // MINMAXDECIMATOR_H
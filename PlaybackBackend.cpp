@@ -1,34 +1,85 @@
 #include "PlaybackBackend.h"
+#include "ConnectionManager.h"
+#include "StatementCache.h"
+#include "WaveformCodec.h"
 #include <QDebug>
-#include <QDir>
-#include <QFile>
+#include <QCoreApplication>
+#include <QElapsedTimer>
 #include <QFileInfo>
+#include <QHash>
+#include <QMutex>
+#include <QPointer>
 #include <QRandomGenerator>
 #include <QSqlDatabase>
 #include <QSqlError>
 #include <QSqlQuery>
-#include <QTextStream>
+#include <QStringList>
 #include <QTimer>
 #include <QUrl>
+#include <QtConcurrent/QtConcurrentRun>
+#include <limits>
+
+namespace {
+
+// Waveform SELECTs per database file, built once from its schema;
+// openPlaybackDB() drops a file's entry so a reopened file is re-read
+struct WaveformSelects {
+  QString byPoint;
+  QString bySample;
+};
+
+QMutex &selectMutex() {
+  static QMutex mutex;
+  return mutex;
+}
+
+QHash<QString, WaveformSelects> &selectsByPath() {
+  static QHash<QString, WaveformSelects> selects;
+  return selects;
+}
+
+} // namespace
 
 PlaybackBackend::PlaybackBackend(QObject *parent)
     : QObject(parent), m_totalPoints(0), m_currentPointIndex(0),
       m_batteryVoltage(12.5), m_internalTemp(35.0), m_signalStrength(80.0),
-      m_isPlaying(false), m_playbackProgress(0.0), m_sampleRate(1) {
+      m_isPlaying(false), m_playbackProgress(0.0) {
+  for (const ChannelRegistry::Channel &c : ChannelRegistry::channels())
+    m_windows.append(MinMaxDecimator(c.magnitude ? MinMaxDecimator::Magnitude
+                                                 : MinMaxDecimator::Value));
+  m_channels.resize(m_windows.size());
+  m_rates.resize(m_windows.size());
 
   m_playbackTimer = new QTimer(this);
   m_playbackTimer->setInterval(100); // 10 FPS
   connect(m_playbackTimer, &QTimer::timeout, this,
           &PlaybackBackend::onPlaybackTick);
 
-  m_playbackConnectionName =
-      QString("playbackDB_%1").arg(reinterpret_cast<quintptr>(this));
+  // Two loaders: the requested point plus one neighbour at a time
+  m_loadPool.setMaxThreadCount(2);
+  setCacheBudget(64 * 1024 * 1024);
+  // Timeline frames: enough for the current and the next few
+  m_sampleCache.setMaxCost(32 * 1024);
+
+  m_profileKey = QString::number(quintptr(this), 16);
 }
 
 PlaybackBackend::~PlaybackBackend() {
-  if (QSqlDatabase::contains(m_playbackConnectionName)) {
-    QSqlDatabase::removeDatabase(m_playbackConnectionName);
-  }
+  m_loadPool.waitForDone();
+  // A running export finishes its current samples and deletes itself
+  if (m_exporter)
+    m_exporter->cancel();
+  LineProfileImageProvider::remove(m_profileKey);
+  if (!m_currentDbPath.isEmpty())
+    ConnectionManager::release(m_currentDbPath, ConnectionManager::ReadOnly);
+}
+
+QSqlDatabase PlaybackBackend::playbackDatabase() const {
+  if (m_currentDbPath.isEmpty() || m_archive.isOpen())
+    return QSqlDatabase();
+  // Read-only: playback can stay open on the project being acquired into
+  return ConnectionManager::connection(m_currentDbPath,
+                                       ConnectionManager::ReadOnly);
 }
 
 bool PlaybackBackend::openPlaybackDB(const QString &fileUrl) {
@@ -43,21 +94,49 @@ bool PlaybackBackend::openPlaybackDB(const QString &fileUrl) {
     return false;
   }
 
-  if (QSqlDatabase::contains(m_playbackConnectionName)) {
-    QSqlDatabase::removeDatabase(m_playbackConnectionName);
-  }
-
-  QSqlDatabase db =
-      QSqlDatabase::addDatabase("QSQLITE", m_playbackConnectionName);
-  db.setDatabaseName(localPath);
-
-  if (!db.open()) {
-    emit logMessage("Failed to open Playback DB: " + db.lastError().text(),
-                    true);
-    return false;
+  if (fi.suffix().compare("tema", Qt::CaseInsensitive) == 0) {
+    if (!m_archive.open(localPath)) {
+      emit logMessage("Failed to open archive: " + m_archive.errorString(),
+                      true);
+      return false;
+    }
+  } else {
+    QSqlDatabase db =
+        ConnectionManager::connection(localPath, ConnectionManager::ReadOnly);
+    if (!db.isOpen()) {
+      emit logMessage("Failed to open Playback DB: " + db.lastError().text(),
+                      true);
+      return false;
+    }
+    m_archive.close();
   }
 
+  if (!m_currentDbPath.isEmpty() && m_currentDbPath != localPath)
+    ConnectionManager::release(m_currentDbPath, ConnectionManager::ReadOnly);
   m_currentDbPath = localPath;
+  {
+    // Its schema may have changed (a migration) since it was last open
+    QMutexLocker lock(&selectMutex());
+    selectsByPath().remove(localPath);
+  }
+  // Cached points and loads still running belong to the previous file
+  ++m_dbGeneration;
+  m_pointCache.clear();
+  m_pendingLoads.clear();
+  m_pointOrder.clear();
+  m_requestedPointId = -1;
+  m_sampleCache.clear();
+  m_pendingSamples.clear();
+  closeTimeline();
+  ++m_overlayGeneration;
+  m_overlayLoading = false;
+  m_overlay.clear();
+  emit overlayChanged();
+  closeLineProfile();
+  if (m_isLoading) {
+    m_isLoading = false;
+    emit loadingChanged();
+  }
   m_currentProjectName = fi.baseName();
   emit projectChanged();
   emit logMessage("Playback database loaded: " + m_currentProjectName, false);
@@ -66,108 +145,569 @@ bool PlaybackBackend::openPlaybackDB(const QString &fileUrl) {
 
 QVariantList PlaybackBackend::getProjectTree() {
   QVariantList tree;
-  QSqlDatabase db = QSqlDatabase::database(m_playbackConnectionName);
-  if (!db.isValid() || !db.isOpen())
+  // Line order, for stepping and neighbour prefetch
+  m_pointOrder.clear();
+  m_pointLine.clear();
+  if (m_archive.isOpen()) {
+    for (int i = 0; i < m_archive.lineCount(); ++i) {
+      const ProjectArchive::LineEntry &line = m_archive.line(i);
+      QVariantList pointsList;
+      for (quint32 k = 0; k < line.pointCount; ++k) {
+        const ProjectArchive::PointEntry &p =
+            m_archive.point(int(line.firstPoint + k));
+        m_pointOrder.append(p.id);
+        m_pointLine.insert(p.id, line.id);
+        QVariantMap pt;
+        pt["id"] = p.id;
+        pt["name"] = QString::number(p.name);
+        pointsList.append(pt);
+      }
+      QVariantMap lineMap;
+      lineMap["id"] = line.id;
+      lineMap["name"] = QString::number(line.name);
+      lineMap["points"] = pointsList;
+      tree.append(lineMap);
+    }
+    return tree;
+  }
+
+  QSqlDatabase db = playbackDatabase();
+  if (!db.isOpen())
     return tree;
 
-  QSqlQuery qLine("SELECT * FROM Data_Line", db);
-  while (qLine.next()) {
-    int lineId = qLine.value("ID").toInt();
-    QString lineName = qLine.value("NAME").toString();
-
-    QVariantList pointsList;
-    QSqlQuery qPoint(db);
-    qPoint.prepare("SELECT * FROM Data_Point WHERE Data_LineID = ?");
-    qPoint.addBindValue(lineId);
-    qPoint.exec();
-
-    while (qPoint.next()) {
-      QVariantMap pt;
-      pt["id"] = qPoint.value("ID").toInt();
-      pt["name"] = qPoint.value("NAME").toString();
-      pointsList.append(pt);
+  // Single ordered JOIN instead of one point query per line
+  QSqlQuery &q = StatementCache::prepared(
+      db, "SELECT l.ID, l.NAME, p.ID, p.NAME FROM Data_Line l "
+          "LEFT JOIN Data_Point p ON p.Data_LineID = l.ID "
+          "ORDER BY l.ID, p.ID");
+  q.setForwardOnly(true);
+  if (!q.exec())
+    return tree;
+
+  int currentLineId = -1;
+  QVariantMap lineMap;
+  QVariantList pointsList;
+  while (q.next()) {
+    int lineId = q.value(0).toInt();
+    if (lineId != currentLineId) {
+      if (currentLineId >= 0) {
+        lineMap["points"] = pointsList;
+        tree.append(lineMap);
+        pointsList.clear();
+      }
+      currentLineId = lineId;
+      lineMap.clear();
+      lineMap["id"] = lineId;
+      lineMap["name"] = q.value(1).toString();
     }
 
-    QVariantMap lineMap;
-    lineMap["id"] = lineId;
-    lineMap["name"] = lineName;
+    if (q.isNull(2))
+      continue;
+    QVariantMap pt;
+    pt["id"] = q.value(2).toInt();
+    pt["name"] = q.value(3).toString();
+    m_pointOrder.append(pt["id"].toInt());
+    m_pointLine.insert(pt["id"].toInt(), lineId);
+    pointsList.append(pt);
+  }
+  if (currentLineId >= 0) {
     lineMap["points"] = pointsList;
     tree.append(lineMap);
   }
   return tree;
 }
 
-bool PlaybackBackend::loadPointData(int pointId) {
-  QSqlDatabase db = QSqlDatabase::database(m_playbackConnectionName);
-  if (!db.isValid() || !db.isOpen())
+namespace {
+
+// SendFs, point name, then every registry column and every channel's rate
+QString waveformSelect(const QString &dbPath, const QSqlDatabase &db,
+                       bool bySample) {
+  {
+    QMutexLocker lock(&selectMutex());
+    const auto it = selectsByPath().constFind(dbPath);
+    if (it != selectsByPath().constEnd())
+      return bySample ? it->bySample : it->byPoint;
+  }
+
+  QSet<QString> present;
+  QSqlQuery info(db);
+  if (!info.exec("PRAGMA table_info(Data_Sample)"))
+    return QString();
+  while (info.next())
+    present.insert(info.value(1).toString());
+  auto column = [&present](const char *name) {
+    const QString c = name ? QString::fromLatin1(name) : QString();
+    return present.contains(c) ? "s." + c : QStringLiteral("NULL");
+  };
+  QStringList fields = {"s.SendFs", "p.NAME"};
+  for (const ChannelRegistry::Channel &c : ChannelRegistry::channels())
+    fields << column(c.column);
+  for (const ChannelRegistry::Channel &c : ChannelRegistry::channels())
+    fields << column(c.rateField);
+  const QString select =
+      "SELECT " + fields.join(", ") +
+      " FROM Data_Sample s JOIN Data_Point p ON p.ID = s.Data_PointID ";
+  WaveformSelects selects;
+  selects.byPoint =
+      select + "WHERE s.Data_PointID = ? ORDER BY s.ID DESC LIMIT 1";
+  selects.bySample = select + "WHERE s.ID = ?";
+
+  QMutexLocker lock(&selectMutex());
+  selectsByPath().insert(dbPath, selects);
+  return bySample ? selects.bySample : selects.byPoint;
+}
+
+} // namespace
+
+bool PlaybackBackend::fetchWaveforms(const QString &dbPath, bool bySample,
+                                     int id, PointWaveforms &out) {
+  QSqlDatabase db =
+      ConnectionManager::connection(dbPath, ConnectionManager::ReadOnly);
+  if (!db.isOpen())
+    return false;
+
+  // Registry columns the file lacks read as NULL, so older projects load
+  const QString sql = waveformSelect(dbPath, db, bySample);
+  QSqlQuery &q = StatementCache::prepared(db, sql);
+  const StatementCache::Finish finish(q);
+  q.addBindValue(id);
+  if (!q.exec() || !q.next())
     return false;
 
-  QSqlQuery q(db);
-  q.prepare("SELECT * FROM Data_Sample WHERE Data_PointID = ? ORDER BY ID DESC "
-            "LIMIT 1");
-  q.addBindValue(pointId);
+  out.sampleRate = q.value(0).toInt();
+  out.name = q.value(1).toString();
+  const int count = ChannelRegistry::count();
+  out.channels.resize(count);
+  out.rates.resize(count);
+  for (int i = 0; i < count; ++i) {
+    // Legacy base64 text or WaveformCodec blob, depending on the column codec
+    out.channels[i] = WaveformCodec::decode(q.value(2 + i));
+    out.rates[i] = q.value(2 + count + i).toInt();
+  }
+  return true;
+}
 
-  if (!q.exec() || !q.next()) {
-    emit logMessage("No sample data found for this point.", true);
+namespace {
+
+int cacheCost(const PlaybackBackend::PointWaveforms &w) {
+  // KiB, so the budget fits QCache's int cost
+  qint64 bytes = 0;
+  for (const QVector<float> &c : w.channels)
+    bytes += c.size() * qint64(sizeof(float));
+  return int(qMax<qint64>(1, bytes / 1024));
+}
+
+} // namespace
+
+bool PlaybackBackend::readArchivedPoint(int pointId, PointWaveforms &out) {
+  const ProjectArchive::SampleEntry *sample = m_archive.latestSample(pointId);
+  if (!sample)
     return false;
+  readArchivedSample(*sample, out);
+  return true;
+}
+
+void PlaybackBackend::readArchivedSample(const ProjectArchive::SampleEntry &s,
+                                         PointWaveforms &out) {
+  out.sampleRate = int(s.sendFs);
+  const int count = ChannelRegistry::count();
+  out.channels = QVector<QVector<float>>(count);
+  out.rates = QVector<int>(count, 0);
+  out.rates[ChannelRegistry::Recv] = int(s.recvFs);
+  // The archive keeps the columns it was built with; the rest stay empty.
+  // Columns are used straight from the mapping; only the copy into the
+  // playback buffers touches the data
+  for (int row = 0; row < count; ++row) {
+    int values = 0;
+    if (const float *data = m_archive.channel(s, row, &values))
+      out.channels[row] = QVector<float>(data, data + values);
+    if (ChannelRegistry::channel(row).rateField && m_archive.rate(s, row) > 0)
+      out.rates[row] = m_archive.rate(s, row);
+  }
+
+  const ProjectArchive::PointEntry *point = m_archive.findPoint(s.pointId);
+  out.name = point ? QString::number(point->name)
+                   : QString("Point %1").arg(s.pointId);
+}
+
+void PlaybackBackend::setCacheBudget(qint64 bytes) {
+  const qint64 kib = qBound<qint64>(1, bytes / 1024,
+                                    std::numeric_limits<int>::max());
+  m_pointCache.setMaxCost(int(kib));
+}
+
+bool PlaybackBackend::loadPointData(int pointId) {
+  m_requestedPointId = pointId;
+
+  if (PointWaveforms *cached = m_pointCache.object(pointId)) {
+    applyPoint(pointId, *cached);
+    prefetchNeighbours(pointId);
+    return true;
   }
 
-  m_sampleRate =
-      q.value("SendFs").toInt(); // Assuming SendFs stores sample rate
-  if (m_sampleRate <= 0)
-    m_sampleRate = 51200;
+  if (m_archive.isOpen()) {
+    // Already an O(1) lookup into the mapping; no need for a worker
+    auto *w = new PointWaveforms;
+    if (!readArchivedPoint(pointId, *w)) {
+      delete w;
+      emit logMessage("No sample data found for this point.", true);
+      emit pointLoaded(pointId, false);
+      return false;
+    }
+    const int cost = cacheCost(*w);
+    applyPoint(pointId, *w);
+    m_pointCache.insert(pointId, w, cost);
+    prefetchNeighbours(pointId);
+    return true;
+  }
+
+  if (m_currentDbPath.isEmpty())
+    return false;
+  requestPoint(pointId);
+  if (!m_isLoading) {
+    m_isLoading = true;
+    emit loadingChanged();
+  }
+  return true;
+}
 
-  // Retrieve Base64 BLOBs directly as Strings
-  QString recvStr = q.value("DATA_RECV").toString();
-  QString sendStr = q.value("DATA_SEND").toString();
+void PlaybackBackend::requestPoint(int pointId) {
+  if (m_pointCache.contains(pointId) || m_pendingLoads.contains(pointId))
+    return;
+  m_pendingLoads.insert(pointId);
 
-  QByteArray rBytes = QByteArray::fromBase64(recvStr.toUtf8());
-  QByteArray sBytes = QByteArray::fromBase64(sendStr.toUtf8());
+  QPointer<PlaybackBackend> self(this);
+  const QString dbPath = m_currentDbPath;
+  const int generation = m_dbGeneration;
+  m_loadPool.start([self, dbPath, pointId, generation]() {
+    PointWaveforms w;
+    const bool ok = fetchWaveforms(dbPath, false, pointId, w);
+    QMetaObject::invokeMethod(
+        qApp,
+        [self, pointId, generation, ok, w = std::move(w)]() {
+          if (self)
+            self->onPointFetched(generation, pointId, ok, w);
+        },
+        Qt::QueuedConnection);
+  });
+}
 
-  int rFloats = rBytes.size() / sizeof(float);
-  int sFloats = sBytes.size() / sizeof(float);
+void PlaybackBackend::onPointFetched(int generation, int pointId, bool ok,
+                                     const PointWaveforms &w) {
+  // Results for a database that has since been closed are dropped
+  if (generation != m_dbGeneration)
+    return;
+  m_pendingLoads.remove(pointId);
+  if (ok)
+    m_pointCache.insert(pointId, new PointWaveforms(w), cacheCost(w));
 
-  const float *rFloatPtr = reinterpret_cast<const float *>(rBytes.constData());
-  const float *sFloatPtr = reinterpret_cast<const float *>(sBytes.constData());
+  if (pointId != m_requestedPointId)
+    return; // a prefetch
+  m_isLoading = false;
+  emit loadingChanged();
+  if (!ok) {
+    emit logMessage("No sample data found for this point.", true);
+    emit pointLoaded(pointId, false);
+    return;
+  }
+  applyPoint(pointId, w);
+  prefetchNeighbours(pointId);
+}
 
-  m_fullRecvData.clear();
-  m_fullSendData.clear();
-  m_fullOffData.clear();
+void PlaybackBackend::prefetchNeighbours(int pointId) {
+  if (m_archive.isOpen())
+    return; // archive loads are cheap enough on demand
+  const int idx = m_pointOrder.indexOf(pointId);
+  if (idx < 0)
+    return;
+  if (idx + 1 < m_pointOrder.size())
+    requestPoint(m_pointOrder[idx + 1]);
+  if (idx > 0)
+    requestPoint(m_pointOrder[idx - 1]);
+}
 
-  for (int i = 0; i < rFloats; i++)
-    m_fullRecvData.append(rFloatPtr[i]);
-  for (int i = 0; i < sFloats; i++)
-    m_fullSendData.append(sFloatPtr[i]);
+void PlaybackBackend::applyPoint(int pointId, const PointWaveforms &w,
+                                 bool announce) {
+  const QVector<ChannelRegistry::Channel> &registry =
+      ChannelRegistry::channels();
+  for (int i = 0; i < registry.size(); ++i) {
+    m_channels[i] = w.channels.value(i);
+    m_rates[i] = w.rates.value(i);
+    if (m_rates[i] <= 0 && registry[i].rateField)
+      m_rates[i] = registry[i].defaultRate;
+  }
+  // Real length of the record, which true-rate playback reveals over: the
+  // last gate time when there is one, else the values at their rate
+  const QVector<float> &recv = m_channels[ChannelRegistry::Recv];
+  const int axis = ChannelRegistry::axisOf(ChannelRegistry::Recv);
+  if (axis >= 0 && !recv.isEmpty() && m_channels[axis].size() == recv.size())
+    m_recordSeconds = m_channels[axis].last() / 1e6;
+  else
+    m_recordSeconds =
+        double(recv.size()) / qMax(1, m_rates[ChannelRegistry::Recv]);
+  m_currentPointName =
+      w.name.isEmpty() ? QString("Point %1").arg(pointId) : w.name;
+  m_totalPoints = m_pointOrder.size();
+  m_currentPointIndex = qMax(0, m_pointOrder.indexOf(pointId));
 
   // Mock metadata
   m_batteryVoltage =
       12.0 + (QRandomGenerator::global()->generate() % 10) / 10.0;
   m_internalTemp = 36.0 + (QRandomGenerator::global()->generate() % 50) / 10.0;
 
-  // Also get the name of the point
-  QSqlQuery qp(db);
-  qp.prepare("SELECT NAME FROM Data_Point WHERE ID = ?");
-  qp.addBindValue(pointId);
-  if (qp.exec() && qp.next()) {
-    m_currentPointName = qp.value(0).toString();
-  } else {
-    m_currentPointName = QString("Point %1").arg(pointId);
-  }
+  // A channel the sample does not have is shown empty
+  for (int i = 0; i < m_windows.size(); ++i)
+    m_windows[i].setSource(m_channels[i]);
 
   m_playbackProgress = 0.0;
-  seek(0.0); // Reset render arrays
+  seek(0.0); // Reset render windows
   emit loadedPointChanged();
-  emit logMessage("Loaded point " + m_currentPointName +
-                      QString(" (%1 bytes)").arg(rBytes.size()),
-                  false);
-  return true;
+  if (announce)
+    emit logMessage("Loaded point " + m_currentPointName +
+                        QString(" (%1 samples)").arg(recv.size()),
+                    false);
+  emit pointLoaded(pointId, true);
 }
 
-void PlaybackBackend::play() {
-  if (m_fullRecvData.isEmpty())
+void PlaybackBackend::overlayLine(int lineId) {
+  if (m_archive.isOpen()) {
+    setOverlay(PlaybackOverlay::fromArchiveLine(m_archive, lineId));
+    return;
+  }
+  startOverlay("p.Data_LineID = ? AND s.ID IN (SELECT MAX(ID) FROM "
+               "Data_Sample GROUP BY Data_PointID)",
+               {lineId}, false);
+}
+
+void PlaybackBackend::overlayPointShots(int pointId) {
+  if (m_archive.isOpen()) {
+    setOverlay(PlaybackOverlay::fromArchiveShots(m_archive, pointId));
+    return;
+  }
+  startOverlay("s.Data_PointID = ?", {pointId}, true);
+}
+
+void PlaybackBackend::overlayPoints(const QVariantList &pointIds) {
+  QList<int> ids;
+  QStringList marks;
+  QVariantList binds;
+  for (const QVariant &v : pointIds) {
+    ids.append(v.toInt());
+    marks.append("?");
+    binds.append(v.toInt());
+  }
+  if (ids.isEmpty()) {
+    clearOverlay();
+    return;
+  }
+  if (m_archive.isOpen()) {
+    setOverlay(PlaybackOverlay::fromArchivePoints(m_archive, ids));
+    return;
+  }
+  startOverlay(QString("s.Data_PointID IN (%1) AND s.ID IN (SELECT MAX(ID) "
+                       "FROM Data_Sample GROUP BY Data_PointID)")
+                   .arg(marks.join(", ")),
+               binds, false);
+}
+
+void PlaybackBackend::clearOverlay() {
+  ++m_overlayGeneration;
+  m_overlayLoading = false;
+  m_overlay.clear();
+  emit overlayChanged();
+}
+
+void PlaybackBackend::startOverlay(const QString &whereClause,
+                                   const QVariantList &binds,
+                                   bool labelShots) {
+  if (m_currentDbPath.isEmpty())
+    return;
+  const int generation = ++m_overlayGeneration;
+  m_overlayLoading = true;
+  emit overlayChanged();
+
+  QPointer<PlaybackBackend> self(this);
+  const QString dbPath = m_currentDbPath;
+  m_loadPool.start([self, dbPath, whereClause, binds, labelShots,
+                    generation]() {
+    QVector<PlaybackOverlay::Curve> curves =
+        PlaybackOverlay::fetch(dbPath, whereClause, binds, labelShots);
+    QMetaObject::invokeMethod(
+        qApp,
+        [self, generation, curves = std::move(curves)]() {
+          if (self && generation == self->m_overlayGeneration)
+            self->setOverlay(curves);
+        },
+        Qt::QueuedConnection);
+  });
+}
+
+void PlaybackBackend::setOverlay(QVector<PlaybackOverlay::Curve> curves) {
+  PlaybackOverlay::assignColors(curves);
+  m_overlay = std::move(curves);
+  m_overlayLoading = false;
+  if (m_overlay.isEmpty())
+    emit logMessage("No sample data found for the overlay.", true);
+  else
+    emit logMessage(QString("Overlaying %1 decays").arg(m_overlay.size()),
+                    false);
+  emit overlayChanged();
+}
+
+void PlaybackBackend::setOverlayNormalized(bool on) {
+  if (m_overlayNormalized == on)
     return;
-  if (m_playbackProgress >= 1.0)
-    seek(0.0); // Restart if finished
+  m_overlayNormalized = on;
+  emit overlayChanged();
+}
+
+QVariantList PlaybackBackend::overlayCurves() const {
+  QVariantList list;
+  for (const PlaybackOverlay::Curve &c : m_overlay) {
+    QVariantMap m;
+    m["label"] = c.label;
+    m["color"] = c.color;
+    m["pointId"] = c.pointId;
+    m["sampleId"] = c.sampleId;
+    list.append(m);
+  }
+  return list;
+}
+
+QVariantMap PlaybackBackend::overlayExtent() const {
+  double xMax = 0.0, yMin = 0.0, yMax = 0.0;
+  bool first = true;
+  for (const PlaybackOverlay::Curve &c : m_overlay) {
+    const double scale =
+        m_overlayNormalized && c.sendPeak > 0.0 ? 1.0 / c.sendPeak : 1.0;
+    for (const QPointF &p : c.recv) {
+      const double y = p.y() * scale;
+      xMax = qMax(xMax, p.x());
+      yMin = first ? y : qMin(yMin, y);
+      yMax = first ? y : qMax(yMax, y);
+      first = false;
+    }
+  }
+  QVariantMap m;
+  m["xMax"] = xMax;
+  m["yMin"] = yMin;
+  m["yMax"] = yMax;
+  return m;
+}
+
+void PlaybackBackend::updateOverlaySeries(int index, QAbstractSeries *series) {
+  if (index < 0 || index >= m_overlay.size())
+    return;
+  if (auto *xySeries = qobject_cast<QXYSeries *>(series))
+    xySeries->replace(
+        PlaybackOverlay::points(m_overlay[index], m_overlayNormalized));
+}
+
+void PlaybackBackend::showLineProfile(int lineId) {
+  ++m_profileGeneration;
+  m_profile = LineProfile(lineId);
+  m_profileLoading = false;
+  if (m_archive.isOpen()) {
+    m_profile.buildFromArchive(m_archive);
+    publishProfile();
+    return;
+  }
+  runProfileUpdate();
+}
+
+void PlaybackBackend::refreshLineProfile() {
+  if (m_profile.lineId() < 0 || m_archive.isOpen())
+    return;
+  runProfileUpdate();
+}
+
+void PlaybackBackend::closeLineProfile() {
+  ++m_profileGeneration;
+  m_profile = LineProfile();
+  m_profileLoading = false;
+  LineProfileImageProvider::remove(m_profileKey);
+  emit profileChanged();
+}
+
+void PlaybackBackend::runProfileUpdate() {
+  if (m_profileLoading || m_currentDbPath.isEmpty())
+    return;
+  m_profileLoading = true;
+  emit profileChanged();
+
+  // The worker brings a copy up to date; only samples past its last pass
+  // are read, and only those missing from the cache are decoded
+  QPointer<PlaybackBackend> self(this);
+  const QString dbPath = m_currentDbPath;
+  const int generation = m_profileGeneration;
+  LineProfile profile = m_profile;
+  m_loadPool.start([self, dbPath, generation, profile]() mutable {
+    int added = 0;
+    QString error;
+    const bool ok = profile.update(dbPath, &added, &error);
+    QMetaObject::invokeMethod(
+        qApp,
+        [self, generation, ok, added, error, profile = std::move(profile)]() {
+          if (!self || generation != self->m_profileGeneration)
+            return;
+          self->m_profileLoading = false;
+          if (!ok) {
+            emit self->logMessage(error, true);
+            emit self->profileChanged();
+            return;
+          }
+          const bool first = self->m_profileRevision == 0 ||
+                             self->m_profile.lastSampleId() == 0;
+          self->m_profile = profile;
+          if (added > 0 || first)
+            self->publishProfile();
+          else
+            emit self->profileChanged();
+        },
+        Qt::QueuedConnection);
+  });
+}
+
+void PlaybackBackend::publishProfile() {
+  LineProfileImageProvider::publish(m_profileKey, m_profile.render());
+  ++m_profileRevision;
+  emit profileChanged();
+}
+
+QString PlaybackBackend::profileSource() const {
+  if (m_profile.lineId() < 0 || m_profileRevision == 0 ||
+      m_profile.columnCount() == 0)
+    return QString();
+  return QString("image://lineprofile/%1?%2")
+      .arg(m_profileKey)
+      .arg(m_profileRevision);
+}
+
+QVariantMap PlaybackBackend::profileAxes() const {
+  QVariantMap m;
+  const int n = m_profile.columnCount();
+  m["points"] = n;
+  m["firstPoint"] = n > 0 ? m_profile.column(0).name : QString();
+  m["lastPoint"] = n > 0 ? m_profile.column(n - 1).name : QString();
+  m["firstGateUs"] = LineProfile::kFirstGateUs;
+  m["lastGateUs"] = LineProfile::kLastGateUs;
+  return m;
+}
+
+void PlaybackBackend::play() {
+  if (timelineActive()) {
+    // Restart from the beginning once the end of the survey was reached
+    const SurveyTimeline::Frame &last = m_timeline.frame(m_timeline.count() - 1);
+    if (m_timelineIndex == m_timeline.count() - 1 &&
+        m_cursorMs >= last.startMs + qint64(m_recordSeconds * 1000.0))
+      seekTime(double(m_timeline.startMs()));
+  } else {
+    if (m_channels[ChannelRegistry::Recv].isEmpty())
+      return;
+    if (m_playbackProgress >= 1.0)
+      seek(0.0); // Restart if finished
+  }
+  m_tickClock.start();
   m_isPlaying = true;
   m_playbackTimer->start();
   emit playbackStateChanged();
@@ -186,93 +726,328 @@ void PlaybackBackend::seek(double progressRatio) {
     progressRatio = 1.0;
   m_playbackProgress = progressRatio;
 
-  int limitR = m_fullRecvData.size() * m_playbackProgress;
-  int limitS = m_fullSendData.size() * m_playbackProgress;
-
-  m_renderRecvData = m_fullRecvData.mid(0, qMax(1, limitR));
-  m_renderSendData = m_fullSendData.mid(0, qMax(1, limitS));
+  // Only the newly revealed samples are folded in
+  for (int i = 0; i < m_windows.size(); ++i)
+    m_windows[i].setLength(
+        qMax(1, int(m_channels[i].size() * m_playbackProgress)));
 
   emit playbackProgressChanged();
   emit waveformChanged();
 }
 
 void PlaybackBackend::onPlaybackTick() {
-  double increment = 0.02; // Scrub 2% per tick
-  double nextProgress = m_playbackProgress + increment;
-  if (nextProgress >= 1.0) {
-    seek(1.0);
-    pause(); // Auto stop at end
-  } else {
-    seek(nextProgress);
+  // Acquisition time covered by this tick at the chosen rate
+  const double dt = m_tickClock.restart() / 1000.0 * m_playbackRate;
+
+  if (!timelineActive()) {
+    const double nextProgress =
+        m_playbackProgress + dt / qMax(1e-6, m_recordSeconds);
+    if (nextProgress >= 1.0) {
+      seek(1.0);
+      pause(); // Auto stop at end
+    } else {
+      seek(nextProgress);
+    }
+    return;
   }
+
+  // The cursor waits while the frame under it is still decoding
+  if (m_requestedSampleId >= 0)
+    return;
+  m_cursorMs += qint64(dt * 1000.0);
+  const int index = m_timeline.indexAt(m_cursorMs);
+  if (index != m_timelineIndex) {
+    showFrame(index, false);
+    return;
+  }
+  const qint64 recordMs = qint64(m_recordSeconds * 1000.0);
+  const SurveyTimeline::Frame &frame = m_timeline.frame(index);
+  if (index == m_timeline.count() - 1 &&
+      m_cursorMs >= frame.startMs + recordMs) {
+    m_cursorMs = frame.startMs + recordMs;
+    pause(); // end of the survey
+  }
+  revealAtCursor();
+  emit timelineChanged();
 }
 
-void PlaybackBackend::exportCsv(const QString &destFolderUrl) {
-  QString localFolder = QUrl(destFolderUrl).toLocalFile();
-  if (localFolder.isEmpty())
-    localFolder = destFolderUrl;
+void PlaybackBackend::setPlaybackRate(double rate) {
+  rate = qBound(0.001, rate, 100000.0);
+  if (qFuzzyCompare(rate, m_playbackRate))
+    return;
+  m_playbackRate = rate;
+  emit playbackStateChanged();
+}
 
-  if (m_fullRecvData.isEmpty()) {
-    emit logMessage("No point loaded to export.", true);
+bool PlaybackBackend::buildTimeline() {
+  if (m_timelineLoading || (m_currentDbPath.isEmpty() && !m_archive.isOpen()))
+    return false;
+  if (m_archive.isOpen()) {
+    m_timeline.loadFromArchive(m_archive);
+    onTimelineBuilt(m_dbGeneration, true, QString(), m_timeline);
+    return true;
+  }
+  m_timelineLoading = true;
+  emit timelineChanged();
+
+  // Metadata only; no waveform is decoded until its frame is shown
+  QPointer<PlaybackBackend> self(this);
+  const QString dbPath = m_currentDbPath;
+  const int generation = m_dbGeneration;
+  m_loadPool.start([self, dbPath, generation]() {
+    SurveyTimeline timeline;
+    QString error;
+    const bool ok = timeline.load(dbPath, &error);
+    QMetaObject::invokeMethod(
+        qApp,
+        [self, generation, ok, error, timeline = std::move(timeline)]() {
+          if (self)
+            self->onTimelineBuilt(generation, ok, error, timeline);
+        },
+        Qt::QueuedConnection);
+  });
+  return true;
+}
+
+void PlaybackBackend::onTimelineBuilt(int generation, bool ok,
+                                      const QString &error,
+                                      const SurveyTimeline &timeline) {
+  if (generation != m_dbGeneration)
+    return;
+  m_timelineLoading = false;
+  if (!ok) {
+    emit logMessage(error, true);
+    emit timelineChanged();
+    return;
+  }
+  if (&timeline != &m_timeline)
+    m_timeline = timeline;
+  if (m_timeline.isEmpty()) {
+    emit logMessage("No samples to build a timeline from.", true);
+    emit timelineChanged();
     return;
   }
+  emit logMessage(QString("Timeline: %1 samples over %2 min")
+                      .arg(m_timeline.count())
+                      .arg((m_timeline.endMs() - m_timeline.startMs()) /
+                               60000.0,
+                           0, 'f', 1),
+                  false);
+  seekTime(double(m_timeline.startMs()));
+}
 
-  QString filePath =
-      QDir(localFolder).filePath(m_currentPointName + "_export.csv");
-  QFile file(filePath);
-  if (file.open(QIODevice::WriteOnly | QIODevice::Text)) {
-    QTextStream out(&file);
-    out << "Time(us),Recv(V),Send(A)\n";
-    for (int i = 0; i < m_fullRecvData.size(); i++) {
-      double t = i * (1000000.0 / qMax(1, m_sampleRate));
-      float r = m_fullRecvData[i];
-      float s = (i < m_fullSendData.size()) ? m_fullSendData[i] : 0.0f;
-      out << t << "," << r << "," << s << "\n";
-    }
-    file.close();
-    emit logMessage("Successfully exported to: " + filePath, false);
+void PlaybackBackend::closeTimeline() {
+  if (m_isPlaying && timelineActive())
+    pause();
+  m_timeline.clear();
+  m_timelineLoading = false;
+  m_timelineIndex = -1;
+  m_requestedSampleId = -1;
+  emit timelineChanged();
+}
+
+void PlaybackBackend::seekTime(double ms) {
+  if (!timelineActive())
+    return;
+  m_cursorMs = qBound(m_timeline.startMs(), qint64(ms), m_timeline.endMs());
+  const int index = m_timeline.indexAt(m_cursorMs);
+  if (index != m_timelineIndex || m_requestedSampleId >= 0)
+    showFrame(index, false);
+  else
+    revealAtCursor();
+  emit timelineChanged();
+}
+
+void PlaybackBackend::stepFrame(int delta) {
+  if (!timelineActive())
+    return;
+  pause();
+  const int index =
+      qBound(0, qMax(0, m_timelineIndex) + delta, m_timeline.count() - 1);
+  m_cursorMs = m_timeline.frame(index).startMs;
+  showFrame(index, true);
+}
+
+void PlaybackBackend::showFrame(int index, bool fullReveal) {
+  m_timelineIndex = index;
+  m_frameFullReveal = fullReveal;
+  const SurveyTimeline::Frame &frame = m_timeline.frame(index);
+
+  if (PointWaveforms *cached = m_sampleCache.object(frame.sampleId)) {
+    m_requestedSampleId = -1;
+    applyFrame(*cached);
+  } else if (frame.archiveRow >= 0) {
+    PointWaveforms w;
+    readArchivedSample(m_archive.sample(frame.archiveRow), w);
+    m_requestedSampleId = -1;
+    applyFrame(w);
   } else {
-    emit logMessage("Failed to write CSV file.", true);
+    m_requestedSampleId = frame.sampleId;
+    requestSample(frame.sampleId);
   }
+  // Decode the next frame while this one plays
+  if (index + 1 < m_timeline.count() &&
+      m_timeline.frame(index + 1).archiveRow < 0)
+    requestSample(m_timeline.frame(index + 1).sampleId);
+  emit timelineChanged();
 }
 
-// Draw logic exactly like Backend.cpp but reading from m_renderRecvData
-void PlaybackBackend::updateRecvSeries(QAbstractSeries *series) {
-  if (auto *xySeries = qobject_cast<QXYSeries *>(series)) {
-    QList<QPointF> points;
-    int step = qMax(1, m_renderRecvData.size() / 1500); // Decimate
-    for (int i = 0; i < m_renderRecvData.size(); i += step) {
-      points.append(QPointF(i * (1000000.0 / qMax(1, m_sampleRate)),
-                            qMax(0.001f, qAbs(m_renderRecvData[i]))));
-    }
-    xySeries->replace(points);
+void PlaybackBackend::applyFrame(const PointWaveforms &w) {
+  const SurveyTimeline::Frame &frame = m_timeline.frame(m_timelineIndex);
+  m_requestedPointId = frame.pointId;
+  // Frames change quickly during playback; the log stays quiet
+  applyPoint(frame.pointId, w, false);
+  if (m_frameFullReveal)
+    seek(1.0);
+  else
+    revealAtCursor();
+}
+
+void PlaybackBackend::revealAtCursor() {
+  const SurveyTimeline::Frame &frame = m_timeline.frame(m_timelineIndex);
+  const double elapsed = (m_cursorMs - frame.startMs) / 1000.0;
+  seek(m_recordSeconds > 0.0 ? elapsed / m_recordSeconds : 1.0);
+}
+
+void PlaybackBackend::requestSample(int sampleId) {
+  if (m_sampleCache.contains(sampleId) || m_pendingSamples.contains(sampleId))
+    return;
+  m_pendingSamples.insert(sampleId);
+
+  QPointer<PlaybackBackend> self(this);
+  const QString dbPath = m_currentDbPath;
+  const int generation = m_dbGeneration;
+  m_loadPool.start([self, dbPath, sampleId, generation]() {
+    PointWaveforms w;
+    const bool ok = fetchWaveforms(dbPath, true, sampleId, w);
+    QMetaObject::invokeMethod(
+        qApp,
+        [self, sampleId, generation, ok, w = std::move(w)]() {
+          if (self)
+            self->onSampleFetched(generation, sampleId, ok, w);
+        },
+        Qt::QueuedConnection);
+  });
+}
+
+void PlaybackBackend::onSampleFetched(int generation, int sampleId, bool ok,
+                                      const PointWaveforms &w) {
+  if (generation != m_dbGeneration)
+    return;
+  m_pendingSamples.remove(sampleId);
+  if (ok)
+    m_sampleCache.insert(sampleId, new PointWaveforms(w), cacheCost(w));
+  if (sampleId != m_requestedSampleId || !timelineActive())
+    return; // a prefetch
+  m_requestedSampleId = -1;
+  if (!ok) {
+    emit logMessage(QString("Sample %1 could not be read.").arg(sampleId),
+                    true);
+    return;
   }
+  applyFrame(w);
+  // Playback time spent waiting for the decode is not counted
+  m_tickClock.restart();
 }
 
-void PlaybackBackend::updateSendSeries(QAbstractSeries *series) {
-  if (auto *xySeries = qobject_cast<QXYSeries *>(series)) {
-    QList<QPointF> points;
-    int step = qMax(1, m_renderSendData.size() / 1500);
-    for (int i = 0; i < m_renderSendData.size(); i += step) {
-      points.append(QPointF(i * (1000000.0 / qMax(1, m_sampleRate)),
-                            m_renderSendData[i]));
-    }
-    xySeries->replace(points);
+void PlaybackBackend::exportCsv(const QString &destFolderUrl) {
+  exportData("point", destFolderUrl, {"csv"});
+}
+
+bool PlaybackBackend::exportData(const QString &scope,
+                                 const QString &destFolderUrl,
+                                 const QStringList &formats) {
+  if (m_exporter) {
+    emit logMessage("An export is already running.", true);
+    return false;
+  }
+  QString destDir = QUrl(destFolderUrl).toLocalFile();
+  if (destDir.isEmpty())
+    destDir = destFolderUrl;
+  if (m_archive.isOpen() || m_currentDbPath.isEmpty()) {
+    // The exporter streams from SQLite; archives import back in first
+    emit logMessage("Export needs a project database.", true);
+    return false;
   }
+  const BatchExporter::Formats fmts = BatchExporter::formatsFromNames(formats);
+  if (!fmts) {
+    emit logMessage("No export format selected.", true);
+    return false;
+  }
+  const int pointId = m_requestedPointId;
+  const int lineId = m_pointLine.value(pointId, -1);
+  if (scope != "project" && (pointId < 0 || (scope == "line" && lineId < 0))) {
+    emit logMessage("No point loaded to export.", true);
+    return false;
+  }
+
+  m_exporter = new BatchExporter;
+  m_exporter->setFormats(fmts);
+  // Emitted from the worker threads, delivered queued
+  connect(m_exporter, &BatchExporter::progress, this,
+          [this](qint64 done, qint64 total) {
+            m_exportProgress = total > 0 ? double(done) / total : 0.0;
+            emit exportChanged();
+          });
+  connect(m_exporter, &BatchExporter::exportError, this,
+          [this](const QString &err) { emit logMessage(err, true); });
+  m_exportProgress = 0.0;
+  emit exportChanged();
+
+  QPointer<PlaybackBackend> self(this);
+  BatchExporter *exporter = m_exporter;
+  const QString dbPath = m_currentDbPath;
+  (void)QtConcurrent::run([self, exporter, dbPath, scope, pointId, lineId,
+                           destDir]() {
+    bool ok;
+    if (scope == "project")
+      ok = exporter->exportProject(dbPath, destDir);
+    else if (scope == "line")
+      ok = exporter->exportLine(dbPath, lineId, destDir);
+    else
+      ok = exporter->exportPoint(dbPath, pointId, destDir);
+    QMetaObject::invokeMethod(
+        qApp,
+        [self, exporter, ok, destDir]() {
+          const qint64 samples = exporter->samplesExported();
+          const qint64 bytes = exporter->bytesWritten();
+          exporter->deleteLater();
+          if (!self)
+            return;
+          self->m_exporter = nullptr;
+          emit self->logMessage(
+              QString("Export %1: %2 samples, %3 MB to %4")
+                  .arg(ok ? "finished" : "stopped")
+                  .arg(samples)
+                  .arg(bytes / (1024.0 * 1024.0), 0, 'f', 1)
+                  .arg(destDir),
+              !ok);
+          emit self->exportChanged();
+        },
+        Qt::QueuedConnection);
+  });
+  return true;
 }
 
-void PlaybackBackend::updateOffSeries(QAbstractSeries *series) {
-  // Mock off series out of the last half of Recv for playback
-  if (auto *xySeries = qobject_cast<QXYSeries *>(series)) {
-    QList<QPointF> points;
-    int startIdx = m_renderRecvData.size() / 2;
-    int maxP = qMax(1, m_renderRecvData.size() - startIdx);
-    int step = qMax(1, maxP / 1000);
-    for (int i = startIdx; i < m_renderRecvData.size(); i += step) {
-      points.append(
-          QPointF((i - startIdx) * (1000000.0 / qMax(1, m_sampleRate)),
-                  qMax(0.001f, qAbs(m_renderRecvData[i]))));
-    }
-    xySeries->replace(points);
+void PlaybackBackend::cancelExport() {
+  if (m_exporter)
+    m_exporter->cancel();
+}
+
+// Series are rebuilt from the window's buckets: O(buckets), not O(samples)
+void PlaybackBackend::updateChannelSeries(QAbstractSeries *series,
+                                          const QString &channel) {
+  auto *xySeries = qobject_cast<QXYSeries *>(series);
+  const int index = ChannelRegistry::indexOf(channel.toLatin1());
+  if (!xySeries || index < 0)
+    return;
+  // Gated channels are drawn at their gate times (us)
+  const int axis = ChannelRegistry::axisOf(index);
+  if (axis >= 0 && !m_channels[axis].isEmpty() &&
+      m_channels[axis].size() == m_channels[index].size()) {
+    xySeries->replace(m_windows[index].points(m_channels[axis]));
+    return;
   }
+  const int rate = m_rates[index];
+  xySeries->replace(m_windows[index].points(rate > 0 ? 1000000.0 / rate : 1.0));
 }
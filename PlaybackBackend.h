@@ -1,13 +1,25 @@
 #ifndef PLAYBACKBACKEND_H
 #define PLAYBACKBACKEND_H
 
+#include <QCache>
+#include <QElapsedTimer>
 #include <QObject>
+#include <QSet>
+#include <QSqlDatabase>
 #include <QString>
+#include <QThreadPool>
 #include <QTimer>
 #include <QVariantMap>
 #include <QVector>
 #include <QtCharts/QXYSeries>
 
+#include "BatchExporter.h"
+#include "ChannelRegistry.h"
+#include "LineProfile.h"
+#include "MinMaxDecimator.h"
+#include "PlaybackOverlay.h"
+#include "ProjectArchive.h"
+#include "SurveyTimeline.h"
 
 class PlaybackBackend : public QObject {
   Q_OBJECT
@@ -33,31 +45,117 @@ class PlaybackBackend : public QObject {
   Q_PROPERTY(bool isPlaying READ isPlaying NOTIFY playbackStateChanged)
   Q_PROPERTY(double playbackProgress READ playbackProgress NOTIFY
                  playbackProgressChanged) // 0.0 to 1.0
+  // Acquisition seconds per wall-clock second: 1 is real time
+  Q_PROPERTY(double playbackRate READ playbackRate WRITE setPlaybackRate NOTIFY
+                 playbackStateChanged)
+  // A point requested by loadPointData is still being read
+  Q_PROPERTY(bool isLoading READ isLoading NOTIFY loadingChanged)
+
+  // Overlay view: many decays drawn together
+  Q_PROPERTY(int overlayCount READ overlayCount NOTIFY overlayChanged)
+  Q_PROPERTY(bool overlayLoading READ overlayLoading NOTIFY overlayChanged)
+  Q_PROPERTY(bool overlayNormalized READ overlayNormalized WRITE
+                 setOverlayNormalized NOTIFY overlayChanged)
+
+  // Line pseudo-section, as an image://lineprofile URL ("" when closed)
+  Q_PROPERTY(QString profileSource READ profileSource NOTIFY profileChanged)
+  Q_PROPERTY(int profileLineId READ profileLineId NOTIFY profileChanged)
+  Q_PROPERTY(bool profileLoading READ profileLoading NOTIFY profileChanged)
+
+  // Survey timeline: every sample of the project in StartTime order
+  Q_PROPERTY(bool timelineReady READ timelineReady NOTIFY timelineChanged)
+  Q_PROPERTY(bool timelineLoading READ timelineLoading NOTIFY timelineChanged)
+  Q_PROPERTY(int timelineCount READ timelineCount NOTIFY timelineChanged)
+  Q_PROPERTY(int timelineIndex READ timelineIndex NOTIFY timelineChanged)
+  Q_PROPERTY(double timelineStartMs READ timelineStartMs NOTIFY timelineChanged)
+  Q_PROPERTY(double timelineEndMs READ timelineEndMs NOTIFY timelineChanged)
+  Q_PROPERTY(
+      double timelineCursorMs READ timelineCursorMs NOTIFY timelineChanged)
+
+  // Batch export
+  Q_PROPERTY(bool isExporting READ isExporting NOTIFY exportChanged)
+  Q_PROPERTY(double exportProgress READ exportProgress NOTIFY exportChanged)
 
 public:
+  // One point's newest sample, decoded; what the LRU cache holds
+  struct PointWaveforms {
+    // Per ChannelRegistry row; empty when the sample lacks the channel
+    QVector<QVector<float>> channels;
+    QVector<int> rates; // 0 when not recorded
+    int sampleRate = 0; // SendFs
+    QString name;
+  };
+
   explicit PlaybackBackend(QObject *parent = nullptr);
   ~PlaybackBackend();
 
+  // One sample's waveforms, with the calling thread's read-only connection
+  // (the load pool's, or tem_bench's). bySample: id is a sample ID;
+  // otherwise the point's newest sample.
+  static bool fetchWaveforms(const QString &dbPath, bool bySample, int id,
+                             PointWaveforms &out);
+
   // Load an existing SQLite database file independent of the main
-  // DatabaseManager
+  // DatabaseManager, or a .tema project archive (memory-mapped)
   Q_INVOKABLE bool openPlaybackDB(const QString &fileUrl);
 
   // Return the Line/Point tree for the playback database
   Q_INVOKABLE QVariantList getProjectTree();
 
-  // Load a specific point completely into memory
+  // Show a point: immediately when cached (or from an archive), otherwise
+  // read on a worker and shown when pointLoaded fires. The neighbours in
+  // line order are prefetched either way
   Q_INVOKABLE bool loadPointData(int pointId);
 
+  // Decoded points kept for stepping back and forth; 64 MiB by default
+  void setCacheBudget(qint64 bytes);
+
+  // Index every sample by StartTime (metadata only, in the background),
+  // then play through the survey: play() runs at playbackRate, seekTime()
+  // jumps to a moment in O(log n), stepFrame() moves sample by sample.
+  // Frames are decoded when shown, with the next one prefetched
+  Q_INVOKABLE bool buildTimeline();
+  Q_INVOKABLE void closeTimeline();
+  Q_INVOKABLE void seekTime(double ms);
+  Q_INVOKABLE void stepFrame(int delta);
+
+  // Overlay the latest sample of every point on a line, every shot of one
+  // point, or the latest sample of each listed point. Replaces the current
+  // overlay; overlayChanged fires once the curves are reduced
+  Q_INVOKABLE void overlayLine(int lineId);
+  Q_INVOKABLE void overlayPointShots(int pointId);
+  Q_INVOKABLE void overlayPoints(const QVariantList &pointIds);
+  Q_INVOKABLE void clearOverlay();
+  // [{label, color}] in draw order, and {xMax, yMin, yMax} for the axes
+  Q_INVOKABLE QVariantList overlayCurves() const;
+  Q_INVOKABLE QVariantMap overlayExtent() const;
+  Q_INVOKABLE void updateOverlaySeries(int index, QAbstractSeries *series);
+
+  // Pseudo-section of a line from all of its samples. Gated values are
+  // cached in the project, so refreshLineProfile() only decodes samples
+  // added since the last pass
+  Q_INVOKABLE void showLineProfile(int lineId);
+  Q_INVOKABLE void refreshLineProfile();
+  Q_INVOKABLE void closeLineProfile();
+  // {firstPoint, lastPoint, points, firstGateUs, lastGateUs}
+  Q_INVOKABLE QVariantMap profileAxes() const;
+
   // Playback Control
   Q_INVOKABLE void play();
   Q_INVOKABLE void pause();
   Q_INVOKABLE void seek(double progressRatio); // 0.0 - 1.0
+  // CSV of the loaded point; shorthand for exportData("point", ...)
   Q_INVOKABLE void exportCsv(const QString &destFolderUrl);
+  // scope "point" | "line" (of the loaded point) | "project"; formats any
+  // of "csv", "raw", "npy", "xyz". Runs in the background
+  Q_INVOKABLE bool exportData(const QString &scope,
+                              const QString &destFolderUrl,
+                              const QStringList &formats);
+  Q_INVOKABLE void cancelExport();
 
-  // Bind Series
-  Q_INVOKABLE void updateRecvSeries(QAbstractSeries *series);
-  Q_INVOKABLE void updateSendSeries(QAbstractSeries *series);
-  Q_INVOKABLE void updateOffSeries(QAbstractSeries *series);
+  // Render window of one ChannelRegistry channel ("recv", "send", ...)
+  Q_INVOKABLE void updateChannelSeries(QAbstractSeries *series,
+                                       const QString &channel);
 
 signals:
   void projectChanged();
@@ -66,13 +164,81 @@ signals:
   void playbackProgressChanged();
   void logMessage(const QString &msg, bool isWarning);
   void waveformChanged();
+  void loadingChanged();
+  void pointLoaded(int pointId, bool ok);
+  void overlayChanged();
+  void profileChanged();
+  void exportChanged();
+  void timelineChanged();
 
 private slots:
   void onPlaybackTick();
 
 private:
+  // Pooled read-only connection to m_currentDbPath for the calling thread
+  QSqlDatabase playbackDatabase() const;
+  bool readArchivedPoint(int pointId, PointWaveforms &out);
+  void readArchivedSample(const ProjectArchive::SampleEntry &s,
+                          PointWaveforms &out);
+  void requestPoint(int pointId);
+  void onPointFetched(int generation, int pointId, bool ok,
+                      const PointWaveforms &w);
+  void prefetchNeighbours(int pointId);
+  void applyPoint(int pointId, const PointWaveforms &w, bool announce = true);
+  void onTimelineBuilt(int generation, bool ok, const QString &error,
+                       const SurveyTimeline &timeline);
+  bool timelineActive() const { return !m_timeline.isEmpty(); }
+  void showFrame(int index, bool fullReveal);
+  void applyFrame(const PointWaveforms &w);
+  void revealAtCursor();
+  void requestSample(int sampleId);
+  void onSampleFetched(int generation, int sampleId, bool ok,
+                       const PointWaveforms &w);
+  void startOverlay(const QString &whereClause, const QVariantList &binds,
+                    bool labelShots);
+  void setOverlay(QVector<PlaybackOverlay::Curve> curves);
+  void runProfileUpdate();
+  void publishProfile();
+
   QString m_currentProjectName;
   QString m_currentDbPath;
+  // Open instead of a database when m_currentDbPath is a .tema archive
+  ProjectArchive m_archive;
+
+  // Cost in KiB of decoded samples
+  QCache<int, PointWaveforms> m_pointCache;
+  QThreadPool m_loadPool;
+  QSet<int> m_pendingLoads;
+  QVector<int> m_pointOrder; // point IDs in tree order
+  int m_requestedPointId = -1;
+  int m_dbGeneration = 0; // bumped on open; stale loads are dropped
+  bool m_isLoading = false;
+
+  QVector<PlaybackOverlay::Curve> m_overlay;
+  int m_overlayGeneration = 0; // bumped per request; stale results dropped
+  bool m_overlayLoading = false;
+  bool m_overlayNormalized = false;
+
+  LineProfile m_profile;
+  QString m_profileKey; // this backend's entry in the image provider
+  int m_profileRevision = 0;
+  int m_profileGeneration = 0;
+  bool m_profileLoading = false;
+
+  QHash<int, int> m_pointLine; // point ID -> line ID, from the tree
+
+  SurveyTimeline m_timeline;
+  QCache<int, PointWaveforms> m_sampleCache; // by sample ID, cost in KiB
+  QSet<int> m_pendingSamples;
+  int m_timelineIndex = -1;
+  int m_requestedSampleId = -1; // frame being decoded; the cursor waits
+  qint64 m_cursorMs = 0;
+  bool m_timelineLoading = false;
+  bool m_frameFullReveal = false;
+  double m_playbackRate = 1.0;
+  QElapsedTimer m_tickClock;
+  BatchExporter *m_exporter = nullptr;
+  double m_exportProgress = 0.0;
 
   int m_totalPoints;
   int m_currentPointIndex;
@@ -86,19 +252,15 @@ private:
   double m_playbackProgress; // Ratio
   QTimer *m_playbackTimer;
 
-  int m_sampleRate;
-
-  // Full loaded cache from DB
-  QVector<float> m_fullRecvData;
-  QVector<float> m_fullSendData;
-  QVector<float> m_fullOffData;
+  double m_recordSeconds = 0.0; // span of the receive channel
 
-  // The subset currently permitted to be rendered by playbackProgress
-  QVector<float> m_renderRecvData;
-  QVector<float> m_renderSendData;
-  QVector<float> m_renderOffData;
+  // Loaded point, per ChannelRegistry row
+  QVector<QVector<float>> m_channels;
+  QVector<int> m_rates; // registry default when not recorded
 
-  QString m_playbackConnectionName;
+  // Render windows: the first playbackProgress of each channel, kept as
+  // incremental decimations over the shared storage instead of copies
+  QVector<MinMaxDecimator> m_windows;
 
   QString currentProjectName() const { return m_currentProjectName; }
   QString currentDbPath() const { return m_currentDbPath; }
@@ -110,6 +272,25 @@ private:
   double signalStrength() const { return m_signalStrength; }
   bool isPlaying() const { return m_isPlaying; }
   double playbackProgress() const { return m_playbackProgress; }
+  bool isLoading() const { return m_isLoading; }
+  double playbackRate() const { return m_playbackRate; }
+  void setPlaybackRate(double rate);
+  bool timelineReady() const { return timelineActive(); }
+  bool timelineLoading() const { return m_timelineLoading; }
+  int timelineCount() const { return m_timeline.count(); }
+  int timelineIndex() const { return m_timelineIndex; }
+  double timelineStartMs() const { return double(m_timeline.startMs()); }
+  double timelineEndMs() const { return double(m_timeline.endMs()); }
+  double timelineCursorMs() const { return double(m_cursorMs); }
+  int overlayCount() const { return m_overlay.size(); }
+  bool overlayLoading() const { return m_overlayLoading; }
+  bool overlayNormalized() const { return m_overlayNormalized; }
+  void setOverlayNormalized(bool on);
+  QString profileSource() const;
+  int profileLineId() const { return m_profile.lineId(); }
+  bool profileLoading() const { return m_profileLoading; }
+  bool isExporting() const { return m_exporter != nullptr; }
+  double exportProgress() const { return m_exportProgress; }
 };
 
 #endif // PLAYBACKBACKEND_H
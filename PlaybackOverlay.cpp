@@ -0,0 +1,227 @@
+#include "PlaybackOverlay.h"
+#include "ChannelRegistry.h"
+#include "ConnectionManager.h"
+#include "MinMaxDecimator.h"
+#include "ProjectArchive.h"
+#include "WaveformCodec.h"
+#include <QDebug>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QtConcurrent/QtConcurrentMap>
+#include <cmath>
+
+namespace {
+
+struct RawSample {
+  int sampleId = 0;
+  int pointId = 0;
+  QString label;
+  int recvRate = 0;
+  QVariant recv; // column values, still encoded
+  QVariant recvPos;
+  QVariant send;
+};
+
+PlaybackOverlay::Curve decodeAndReduce(const RawSample &raw) {
+  PlaybackOverlay::Curve c = PlaybackOverlay::reduce(
+      WaveformCodec::decode(raw.recv), WaveformCodec::decode(raw.recvPos),
+      raw.recvRate, WaveformCodec::decode(raw.send));
+  c.sampleId = raw.sampleId;
+  c.pointId = raw.pointId;
+  c.label = raw.label;
+  return c;
+}
+
+QVector<float> archiveColumn(const ProjectArchive &archive,
+                             const ProjectArchive::SampleEntry &s, int ch) {
+  int count = 0;
+  const float *data = archive.channel(s, ch, &count);
+  return data ? QVector<float>(data, data + count) : QVector<float>();
+}
+
+QVector<PlaybackOverlay::Curve>
+reduceArchived(const ProjectArchive &archive,
+               const QList<const ProjectArchive::SampleEntry *> &samples,
+               const QStringList &labels) {
+  QList<int> rows;
+  for (int i = 0; i < samples.size(); ++i)
+    rows.append(i);
+  // The mapping is read-only, so workers read it directly
+  const QList<PlaybackOverlay::Curve> curves =
+      QtConcurrent::blockingMapped(rows, [&](int i) {
+        const ProjectArchive::SampleEntry &s = *samples[i];
+        PlaybackOverlay::Curve c = PlaybackOverlay::reduce(
+            archiveColumn(archive, s, ChannelRegistry::Recv),
+            archiveColumn(archive, s, ChannelRegistry::RecvPos),
+            int(s.recvFs), archiveColumn(archive, s, ChannelRegistry::Send));
+        c.sampleId = s.id;
+        c.pointId = s.pointId;
+        c.label = labels[i];
+        return c;
+      });
+  return QVector<PlaybackOverlay::Curve>(curves.begin(), curves.end());
+}
+
+} // namespace
+
+PlaybackOverlay::Curve PlaybackOverlay::reduce(const QVector<float> &recv,
+                                               const QVector<float> &recvPos,
+                                               int recvRate,
+                                               const QVector<float> &send) {
+  Curve c;
+  // Same min/max decimation the playback charts use, run to the end once,
+  // on the same axis: gate positions when they match, else RecvFs
+  MinMaxDecimator envelope(MinMaxDecimator::Magnitude, kBuckets);
+  envelope.setSource(recv);
+  envelope.setLength(recv.size());
+  if (!recvPos.isEmpty() && recvPos.size() == recv.size()) {
+    c.recv = envelope.points(recvPos);
+  } else {
+    const int rate =
+        recvRate > 0
+            ? recvRate
+            : ChannelRegistry::channel(ChannelRegistry::Recv).defaultRate;
+    c.recv = envelope.points(1000000.0 / rate);
+  }
+  for (float v : send)
+    c.sendPeak = qMax(c.sendPeak, double(qAbs(v)));
+  return c;
+}
+
+QVector<PlaybackOverlay::Curve>
+PlaybackOverlay::fetch(const QString &dbPath, const QString &whereClause,
+                       const QVariantList &binds, bool labelShots) {
+  QVector<Curve> curves;
+  QSqlDatabase db =
+      ConnectionManager::connection(dbPath, ConnectionManager::ReadOnly);
+  if (!db.isOpen())
+    return curves;
+
+  QSqlQuery q(db);
+  q.setForwardOnly(true);
+  const QStringList &columns = ChannelRegistry::columns();
+  q.prepare(QString("SELECT s.ID, p.ID, p.NAME, s.%1, s.%2, s.%3, s.%4 "
+                    "FROM Data_Sample s "
+                    "JOIN Data_Point p ON p.ID = s.Data_PointID "
+                    "WHERE %5 ORDER BY p.ID, s.ID LIMIT %6")
+                .arg(QLatin1String(
+                         ChannelRegistry::channel(ChannelRegistry::Recv)
+                             .rateField),
+                     columns[ChannelRegistry::Recv],
+                     columns[ChannelRegistry::RecvPos],
+                     columns[ChannelRegistry::Send], whereClause)
+                .arg(kMaxCurves));
+  for (const QVariant &v : binds)
+    q.addBindValue(v);
+  if (!q.exec()) {
+    qDebug() << "PlaybackOverlay: query failed" << q.lastError().text();
+    return curves;
+  }
+
+  // Encoded rows are gathered in chunks and decoded in parallel, so only
+  // one chunk of full-size arrays is alive at a time
+  const int chunkSize = 32;
+  QList<RawSample> chunk;
+  int shot = 0;
+  int lastPoint = -1;
+  auto flush = [&]() {
+    const QList<Curve> reduced = QtConcurrent::blockingMapped(
+        chunk, [](const RawSample &raw) { return decodeAndReduce(raw); });
+    curves.append(QVector<Curve>(reduced.begin(), reduced.end()));
+    chunk.clear();
+  };
+  while (q.next()) {
+    RawSample raw;
+    raw.sampleId = q.value(0).toInt();
+    raw.pointId = q.value(1).toInt();
+    shot = raw.pointId == lastPoint ? shot + 1 : 1;
+    lastPoint = raw.pointId;
+    raw.label = labelShots
+                    ? QString("%1 #%2").arg(q.value(2).toString()).arg(shot)
+                    : q.value(2).toString();
+    raw.recvRate = q.value(3).toInt();
+    raw.recv = q.value(4);
+    raw.recvPos = q.value(5);
+    raw.send = q.value(6);
+    chunk.append(raw);
+    if (chunk.size() >= chunkSize)
+      flush();
+  }
+  if (!chunk.isEmpty())
+    flush();
+  return curves;
+}
+
+QVector<PlaybackOverlay::Curve>
+PlaybackOverlay::fromArchiveLine(const ProjectArchive &archive, int lineId) {
+  QList<const ProjectArchive::SampleEntry *> samples;
+  QStringList labels;
+  for (int i = 0; i < archive.lineCount(); ++i) {
+    const ProjectArchive::LineEntry &line = archive.line(i);
+    if (line.id != lineId)
+      continue;
+    for (quint32 k = 0; k < line.pointCount && samples.size() < kMaxCurves;
+         ++k) {
+      const ProjectArchive::PointEntry &p =
+          archive.point(int(line.firstPoint + k));
+      if (const ProjectArchive::SampleEntry *s = archive.latestSample(p.id)) {
+        samples.append(s);
+        labels.append(QString::number(p.name));
+      }
+    }
+    break;
+  }
+  return reduceArchived(archive, samples, labels);
+}
+
+QVector<PlaybackOverlay::Curve>
+PlaybackOverlay::fromArchiveShots(const ProjectArchive &archive, int pointId) {
+  QList<const ProjectArchive::SampleEntry *> samples;
+  QStringList labels;
+  if (const ProjectArchive::PointEntry *p = archive.findPoint(pointId)) {
+    const int count = qMin(int(p->sampleCount), kMaxCurves);
+    for (int k = 0; k < count; ++k) {
+      samples.append(&archive.sample(int(p->firstSample) + k));
+      labels.append(QString("%1 #%2").arg(p->name).arg(k + 1));
+    }
+  }
+  return reduceArchived(archive, samples, labels);
+}
+
+QVector<PlaybackOverlay::Curve>
+PlaybackOverlay::fromArchivePoints(const ProjectArchive &archive,
+                                   const QList<int> &pointIds) {
+  QList<const ProjectArchive::SampleEntry *> samples;
+  QStringList labels;
+  for (int id : pointIds) {
+    if (samples.size() >= kMaxCurves)
+      break;
+    const ProjectArchive::PointEntry *p = archive.findPoint(id);
+    const ProjectArchive::SampleEntry *s = archive.latestSample(id);
+    if (p && s) {
+      samples.append(s);
+      labels.append(QString::number(p->name));
+    }
+  }
+  return reduceArchived(archive, samples, labels);
+}
+
+void PlaybackOverlay::assignColors(QVector<Curve> &curves) {
+  // Golden-ratio hue steps keep neighbours apart for any curve count
+  double hue = 0.58;
+  for (Curve &c : curves) {
+    c.color = QColor::fromHsvF(float(hue), 0.75f, 0.85f);
+    hue = std::fmod(hue + 0.618033988749895, 1.0);
+  }
+}
+
+QList<QPointF> PlaybackOverlay::points(const Curve &curve, bool normalized) {
+  if (!normalized || curve.sendPeak <= 0.0)
+    return curve.recv;
+  QList<QPointF> pts = curve.recv;
+  const double scale = 1.0 / curve.sendPeak;
+  for (QPointF &p : pts)
+    p.setY(p.y() * scale);
+  return pts;
+}
@@ -0,0 +1,60 @@
+#ifndef PLAYBACKOVERLAY_H
+#define PLAYBACKOVERLAY_H
+
+#include <QColor>
+#include <QList>
+#include <QPointF>
+#include <QString>
+#include <QVariantList>
+#include <QVector>
+
+class ProjectArchive;
+
+// Reduced decays for the playback overlay view.
+//
+// Each overlaid sample is decimated once, on load, to a small min/max
+// envelope of its receive magnitude plus its peak send current; the full
+// arrays are dropped straight away, so hundreds of curves cost a few KiB
+// each and redrawing or renormalising never touches the samples again.
+class PlaybackOverlay {
+public:
+  struct Curve {
+    int sampleId = 0;
+    int pointId = 0;
+    QString label;
+    double sendPeak = 0.0; // max |send current|, A
+    QList<QPointF> recv;   // (μs, |V|) envelope
+    QColor color;
+  };
+
+  // Buckets per curve; each gives at most two points
+  static const int kBuckets = 128;
+  // Hard cap on one overlay, which keeps memory bounded
+  static const int kMaxCurves = 500;
+
+  // Read and reduce on the calling thread, using its read-only connection.
+  // whereClause filters "Data_Sample s JOIN Data_Point p"
+  static QVector<Curve> fetch(const QString &dbPath,
+                              const QString &whereClause,
+                              const QVariantList &binds, bool labelShots);
+  // Same from a mapped archive; every point of the line, or every shot of
+  // the point, or the latest sample of each listed point
+  static QVector<Curve> fromArchiveLine(const ProjectArchive &archive,
+                                        int lineId);
+  static QVector<Curve> fromArchiveShots(const ProjectArchive &archive,
+                                         int pointId);
+  static QVector<Curve> fromArchivePoints(const ProjectArchive &archive,
+                                          const QList<int> &pointIds);
+
+  // recv is placed like the playback chart: at recvPos (us) when it
+  // matches recv, else at recvRate (RecvFs)
+  static Curve reduce(const QVector<float> &recv,
+                      const QVector<float> &recvPos, int recvRate,
+                      const QVector<float> &send);
+  // Distinct hues in load order
+  static void assignColors(QVector<Curve> &curves);
+  // Points to draw, optionally in V/A
+  static QList<QPointF> points(const Curve &curve, bool normalized);
+};
+
+#endif // PLAYBACKOVERLAY_H
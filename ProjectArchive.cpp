@@ -0,0 +1,651 @@
+#include "ProjectArchive.h"
+#include "ChannelRegistry.h"
+#include <QDebug>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QSqlRecord>
+#include <QStringList>
+#include <QVector>
+#include <cstring>
+
+namespace {
+
+const char kMagic[8] = {'T', 'E', 'M', 'A', 'R', 'C', 'H', '1'};
+// 2: channel rates, TYPE and USE per sample; NOTE text in the JSON
+// 3: channel table by column name instead of three fixed channels
+const quint32 kVersion = 3;
+const quint32 kNoRow = 0xFFFFFFFFu;
+// Ids are autoincrement, so the index is dense; refuse absurd spans
+const quint32 kMaxIdSpan = 64u * 1024 * 1024;
+const quint32 kMaxChannels = 64;
+
+struct ArchiveHeader {
+  char magic[8];
+  quint32 version;
+  quint32 lineCount;
+  quint32 pointCount;
+  quint32 sampleCount;
+  qint32 pointIdBase;
+  quint32 pointIdSpan;
+  quint64 lineTableOffset;
+  quint64 pointTableOffset;
+  quint64 sampleTableOffset;
+  quint64 pointIdIndexOffset;
+  quint64 metaOffset;
+  quint64 metaSize;
+  quint64 fileSize;
+  quint32 channelCount;
+  quint32 reserved;
+  quint64 channelTableOffset;
+  quint64 channelRefOffset; // sampleCount x channelCount, row-major
+};
+static_assert(sizeof(ArchiveHeader) == 112, "archive header layout");
+static_assert(sizeof(ProjectArchive::LineEntry) == 32, "line entry layout");
+static_assert(sizeof(ProjectArchive::PointEntry) == 32, "point entry layout");
+static_assert(sizeof(ProjectArchive::SampleEntry) == 48,
+              "sample entry layout");
+static_assert(sizeof(ProjectArchive::ChannelEntry) == 32,
+              "channel entry layout");
+static_assert(sizeof(ProjectArchive::ChannelRef) == 16, "channel ref layout");
+static_assert(Q_BYTE_ORDER == Q_LITTLE_ENDIAN,
+              "archive tables are used in place as little-endian");
+
+bool padTo(QIODevice &out, qint64 alignment) {
+  static const char zeros[64] = {};
+  const qint64 pad = (alignment - out.pos() % alignment) % alignment;
+  return pad == 0 || out.write(zeros, pad) == pad;
+}
+
+template <typename T>
+bool writeTable(QIODevice &out, const QVector<T> &rows, quint64 *offset) {
+  if (!padTo(out, 8))
+    return false;
+  *offset = quint64(out.pos());
+  const qint64 bytes = qint64(rows.size()) * qint64(sizeof(T));
+  return bytes == 0 ||
+         out.write(reinterpret_cast<const char *>(rows.constData()), bytes) ==
+             bytes;
+}
+
+QJsonArray tableRows(const QSqlDatabase &db, const QString &table) {
+  QJsonArray rows;
+  QSqlQuery q(db);
+  q.setForwardOnly(true);
+  if (!q.exec("SELECT * FROM " + table))
+    return rows;
+  while (q.next()) {
+    const QSqlRecord rec = q.record();
+    QJsonObject obj;
+    for (int i = 0; i < rec.count(); ++i)
+      obj.insert(rec.fieldName(i), QJsonValue::fromVariant(rec.value(i)));
+    rows.append(obj);
+  }
+  return rows;
+}
+
+// {"<ID>": NOTE} of the rows of table that have one
+QJsonObject tableNotes(const QSqlDatabase &db, const QString &table) {
+  QJsonObject notes;
+  QSqlQuery q(db);
+  q.setForwardOnly(true);
+  if (!q.exec("SELECT ID, NOTE FROM " + table + " WHERE NOTE IS NOT NULL"))
+    return notes;
+  while (q.next())
+    notes.insert(q.value(0).toString(), q.value(1).toString());
+  return notes;
+}
+
+bool insertRows(const QSqlDatabase &db, const QString &table,
+                const QJsonArray &rows) {
+  for (const QJsonValue &v : rows) {
+    const QJsonObject obj = v.toObject();
+    if (obj.isEmpty())
+      continue;
+    QStringList marks;
+    for (int i = 0; i < obj.size(); ++i)
+      marks.append("?");
+    QSqlQuery q(db);
+    q.prepare(QString("INSERT OR IGNORE INTO %1 (%2) VALUES (%3)")
+                  .arg(table, obj.keys().join(", "), marks.join(", ")));
+    for (const QString &key : obj.keys())
+      q.addBindValue(obj.value(key).toVariant());
+    if (!q.exec())
+      return false;
+  }
+  return true;
+}
+
+} // namespace
+
+bool ProjectArchive::fail(const QString &error) {
+  qDebug() << "ProjectArchive:" << error;
+  close();
+  m_error = error;
+  return false;
+}
+
+bool ProjectArchive::open(const QString &path) {
+  close();
+  m_file.setFileName(path);
+  if (!m_file.open(QIODevice::ReadOnly))
+    return fail(m_file.errorString());
+  m_size = m_file.size();
+  if (m_size < qint64(sizeof(ArchiveHeader)))
+    return fail("Not a project archive: " + path);
+
+  m_base = m_file.map(0, m_size);
+  if (!m_base)
+    return fail("Cannot map " + path + ": " + m_file.errorString());
+
+  ArchiveHeader h;
+  memcpy(&h, m_base, sizeof(h));
+  if (memcmp(h.magic, kMagic, sizeof(kMagic)) != 0)
+    return fail("Not a project archive: " + path);
+  if (h.version != kVersion)
+    return fail(QString("Unsupported archive version %1").arg(h.version));
+
+  // Every table must lie inside the file before it is used in place
+  auto fits = [this](quint64 offset, quint64 bytes) {
+    return offset % 8 == 0 && offset <= quint64(m_size) &&
+           bytes <= quint64(m_size) - offset;
+  };
+  if (h.channelCount > kMaxChannels)
+    return fail("Corrupt archive: channel count");
+  if (h.fileSize != quint64(m_size) ||
+      !fits(h.lineTableOffset, quint64(h.lineCount) * sizeof(LineEntry)) ||
+      !fits(h.pointTableOffset, quint64(h.pointCount) * sizeof(PointEntry)) ||
+      !fits(h.sampleTableOffset,
+            quint64(h.sampleCount) * sizeof(SampleEntry)) ||
+      !fits(h.channelTableOffset,
+            quint64(h.channelCount) * sizeof(ChannelEntry)) ||
+      !fits(h.channelRefOffset, quint64(h.sampleCount) * h.channelCount *
+                                    sizeof(ChannelRef)) ||
+      !fits(h.pointIdIndexOffset, quint64(h.pointIdSpan) * sizeof(quint32)) ||
+      h.metaOffset > quint64(m_size) ||
+      h.metaSize > quint64(m_size) - h.metaOffset)
+    return fail("Corrupt or truncated archive: " + path);
+
+  // Row ranges too: callers index the tables with them unchecked
+  const auto *lines =
+      reinterpret_cast<const LineEntry *>(m_base + h.lineTableOffset);
+  for (quint32 i = 0; i < h.lineCount; ++i) {
+    if (quint64(lines[i].firstPoint) + lines[i].pointCount > h.pointCount)
+      return fail("Corrupt archive: line table out of range");
+  }
+  const auto *points =
+      reinterpret_cast<const PointEntry *>(m_base + h.pointTableOffset);
+  for (quint32 i = 0; i < h.pointCount; ++i) {
+    if (quint64(points[i].firstSample) + points[i].sampleCount >
+        h.sampleCount)
+      return fail("Corrupt archive: point table out of range");
+  }
+  const auto *channels =
+      reinterpret_cast<const ChannelEntry *>(m_base + h.channelTableOffset);
+  for (quint32 i = 0; i < h.channelCount; ++i) {
+    if (qstrnlen(channels[i].column, sizeof(channels[i].column)) ==
+        sizeof(channels[i].column))
+      return fail("Corrupt archive: channel table");
+  }
+
+  m_lines = reinterpret_cast<const LineEntry *>(m_base + h.lineTableOffset);
+  m_points = reinterpret_cast<const PointEntry *>(m_base + h.pointTableOffset);
+  m_samples =
+      reinterpret_cast<const SampleEntry *>(m_base + h.sampleTableOffset);
+  m_channels = channels;
+  m_channelRefs =
+      reinterpret_cast<const ChannelRef *>(m_base + h.channelRefOffset);
+  m_pointIdIndex =
+      reinterpret_cast<const quint32 *>(m_base + h.pointIdIndexOffset);
+  m_lineCount = int(h.lineCount);
+  m_pointCount = int(h.pointCount);
+  m_sampleCount = int(h.sampleCount);
+  m_channelCount = int(h.channelCount);
+  m_channelOfRow.fill(-1, ChannelRegistry::count());
+  for (int row = 0; row < ChannelRegistry::count(); ++row) {
+    const char *column = ChannelRegistry::channel(row).column;
+    for (int i = 0; i < m_channelCount; ++i) {
+      if (qstrcmp(m_channels[i].column, column) == 0) {
+        m_channelOfRow[row] = i;
+        break;
+      }
+    }
+  }
+  m_pointIdBase = h.pointIdBase;
+  m_pointIdSpan = h.pointIdSpan;
+  m_meta = reinterpret_cast<const char *>(m_base + h.metaOffset);
+  m_metaSize = qint64(h.metaSize);
+  m_error.clear();
+  return true;
+}
+
+void ProjectArchive::close() {
+  if (m_base)
+    m_file.unmap(m_base);
+  m_base = nullptr;
+  if (m_file.isOpen())
+    m_file.close();
+  m_size = 0;
+  m_lines = nullptr;
+  m_points = nullptr;
+  m_samples = nullptr;
+  m_channels = nullptr;
+  m_channelRefs = nullptr;
+  m_pointIdIndex = nullptr;
+  m_lineCount = m_pointCount = m_sampleCount = m_channelCount = 0;
+  m_channelOfRow.clear();
+  m_pointIdBase = 0;
+  m_pointIdSpan = 0;
+  m_meta = nullptr;
+  m_metaSize = 0;
+}
+
+const ProjectArchive::PointEntry *ProjectArchive::findPoint(int pointId) const {
+  if (!m_base)
+    return nullptr;
+  const qint64 slot = qint64(pointId) - m_pointIdBase;
+  if (slot < 0 || slot >= qint64(m_pointIdSpan))
+    return nullptr;
+  const quint32 row = m_pointIdIndex[slot];
+  if (row >= quint32(m_pointCount))
+    return nullptr;
+  return &m_points[row];
+}
+
+const ProjectArchive::SampleEntry *
+ProjectArchive::latestSample(int pointId) const {
+  const PointEntry *p = findPoint(pointId);
+  if (!p || p->sampleCount == 0)
+    return nullptr;
+  return &m_samples[p->firstSample + p->sampleCount - 1];
+}
+
+QString ProjectArchive::channelColumn(int archiveChannel) const {
+  if (archiveChannel < 0 || archiveChannel >= m_channelCount)
+    return QString();
+  return QString::fromLatin1(m_channels[archiveChannel].column);
+}
+
+const ProjectArchive::ChannelRef *
+ProjectArchive::channelRef(const SampleEntry &sample, int channel) const {
+  if (!m_base || channel < 0 || channel >= m_channelOfRow.size())
+    return nullptr;
+  const int archived = m_channelOfRow[channel];
+  const qint64 row = &sample - m_samples;
+  if (archived < 0 || row < 0 || row >= m_sampleCount)
+    return nullptr;
+  return &m_channelRefs[row * m_channelCount + archived];
+}
+
+const float *ProjectArchive::channel(const SampleEntry &sample, int channel,
+                                     int *count) const {
+  *count = 0;
+  const ChannelRef *ref = channelRef(sample, channel);
+  if (!ref)
+    return nullptr;
+  const quint64 bytes = quint64(ref->count) * sizeof(float);
+  if (ref->offset % sizeof(float) != 0 || ref->offset > quint64(m_size) ||
+      bytes > quint64(m_size) - ref->offset)
+    return nullptr;
+  *count = int(ref->count);
+  return reinterpret_cast<const float *>(m_base + ref->offset);
+}
+
+int ProjectArchive::rate(const SampleEntry &sample, int channel) const {
+  const ChannelRef *ref = channelRef(sample, channel);
+  return ref ? int(ref->rate) : 0;
+}
+
+QByteArray ProjectArchive::metadata() const {
+  return m_meta ? QByteArray(m_meta, m_metaSize) : QByteArray();
+}
+
+bool ProjectArchive::exportDatabase(const QSqlDatabase &db,
+                                    const QString &path, QString *error) {
+  auto failWith = [error](const QString &msg) {
+    qDebug() << "ProjectArchive export:" << msg;
+    if (error)
+      *error = msg;
+    return false;
+  };
+
+  // Written to a temp file and renamed on commit, so a failed export
+  // never leaves a half archive behind
+  QSaveFile out(path);
+  if (!out.open(QIODevice::WriteOnly))
+    return failWith(out.errorString());
+
+  ArchiveHeader h{};
+  memcpy(h.magic, kMagic, sizeof(kMagic));
+  h.version = kVersion;
+  out.write(reinterpret_cast<const char *>(&h), sizeof(h));
+
+  // One archive channel per registry row, named by its column
+  const QVector<ChannelRegistry::Channel> &registry =
+      ChannelRegistry::channels();
+  const int channelCount = registry.size();
+  QVector<ChannelEntry> channels(channelCount);
+  for (int c = 0; c < channelCount; ++c) {
+    if (qstrlen(registry[c].column) >= sizeof(channels[c].column))
+      return failWith(QString("Column name too long: ") + registry[c].column);
+    qstrncpy(channels[c].column, registry[c].column,
+             sizeof(channels[c].column));
+  }
+
+  QStringList fields = {"ID",     "Data_PointID", "StartTime", "DeviceType",
+                        "PERIOD", "SendFs",       "TYPE",      "USE"};
+  const int firstColumn = fields.size();
+  fields += ChannelRegistry::columns();
+  // Field of each channel's rate column, -1 if it has none
+  QVector<int> rateField(channelCount, -1);
+  for (int c = 0; c < channelCount; ++c) {
+    if (registry[c].rateField) {
+      rateField[c] = fields.size();
+      fields << QString::fromLatin1(registry[c].rateField);
+    }
+  }
+
+  // Columns first, streamed one sample at a time; only the fixed-size
+  // table rows stay in memory
+  QVector<SampleEntry> samples;
+  QVector<ChannelRef> refs;
+  {
+    QSqlQuery q(db);
+    q.setForwardOnly(true);
+    if (!q.exec("SELECT " + fields.join(", ") +
+                " FROM Data_Sample ORDER BY Data_PointID, ID"))
+      return failWith(q.lastError().text());
+    auto rateOf = [&](int c) {
+      return rateField[c] < 0 ? 0.0
+                              : qMax(0.0, q.value(rateField[c]).toDouble());
+    };
+    while (q.next()) {
+      SampleEntry s{};
+      s.id = q.value(0).toInt();
+      s.pointId = q.value(1).toInt();
+      s.startTime = q.value(2).toLongLong();
+      s.deviceType = q.value(3).toInt();
+      s.period = q.value(4).toInt();
+      s.sendFs = q.value(5).toDouble();
+      s.type = q.value(6).toInt();
+      s.use = q.value(7).toInt();
+      s.recvFs = rateOf(ChannelRegistry::Recv);
+      for (int c = 0; c < channelCount; ++c) {
+        const QVector<float> column =
+            WaveformCodec::decode(q.value(firstColumn + c));
+        if (!padTo(out, 64))
+          return failWith(out.errorString());
+        ChannelRef ref{};
+        ref.offset = quint64(out.pos());
+        ref.count = quint32(column.size());
+        ref.rate = quint32(rateOf(c));
+        const qint64 bytes = qint64(column.size()) * qint64(sizeof(float));
+        if (out.write(reinterpret_cast<const char *>(column.constData()),
+                      bytes) != bytes)
+          return failWith(out.errorString());
+        refs.append(ref);
+      }
+      samples.append(s);
+    }
+  }
+
+  QVector<PointEntry> points;
+  {
+    QSqlQuery q(db);
+    q.setForwardOnly(true);
+    if (!q.exec("SELECT ID, Data_LineID, NAME, TYPE, USE FROM Data_Point "
+                "ORDER BY Data_LineID, ID"))
+      return failWith(q.lastError().text());
+    while (q.next()) {
+      PointEntry p{};
+      p.id = q.value(0).toInt();
+      p.lineId = q.value(1).toInt();
+      p.name = q.value(2).toDouble();
+      p.type = q.value(3).toInt();
+      p.use = q.value(4).toInt();
+      points.append(p);
+    }
+  }
+
+  // Samples are grouped by point: one pass assigns each point its range
+  QHash<int, int> pointRowById;
+  qint32 minId = 0;
+  qint32 maxId = -1;
+  for (int i = 0; i < points.size(); ++i) {
+    pointRowById.insert(points[i].id, i);
+    minId = i == 0 ? points[i].id : qMin(minId, points[i].id);
+    maxId = i == 0 ? points[i].id : qMax(maxId, points[i].id);
+  }
+  for (int i = 0; i < samples.size();) {
+    int j = i;
+    while (j < samples.size() && samples[j].pointId == samples[i].pointId)
+      ++j;
+    const int row = pointRowById.value(samples[i].pointId, -1);
+    if (row >= 0) {
+      points[row].firstSample = quint32(i);
+      points[row].sampleCount = quint32(j - i);
+    }
+    i = j;
+  }
+
+  QVector<LineEntry> lines;
+  {
+    QSqlQuery q(db);
+    q.setForwardOnly(true);
+    if (!q.exec("SELECT ID, NAME, TYPE, USE FROM Data_Line ORDER BY ID"))
+      return failWith(q.lastError().text());
+    while (q.next()) {
+      LineEntry l{};
+      l.id = q.value(0).toInt();
+      l.name = q.value(1).toDouble();
+      l.type = q.value(2).toInt();
+      l.use = q.value(3).toInt();
+      lines.append(l);
+    }
+  }
+  // Points are grouped by line in the same way
+  QHash<int, int> lineRowById;
+  for (int i = 0; i < lines.size(); ++i)
+    lineRowById.insert(lines[i].id, i);
+  for (int i = 0; i < points.size();) {
+    int j = i;
+    while (j < points.size() && points[j].lineId == points[i].lineId)
+      ++j;
+    const int row = lineRowById.value(points[i].lineId, -1);
+    if (row >= 0) {
+      lines[row].firstPoint = quint32(i);
+      lines[row].pointCount = quint32(j - i);
+    }
+    i = j;
+  }
+
+  const quint64 span = points.isEmpty() ? 0 : quint64(maxId - minId) + 1;
+  if (span > kMaxIdSpan)
+    return failWith("Point IDs too sparse for the archive index");
+  QVector<quint32> idIndex(int(span), kNoRow);
+  for (int i = 0; i < points.size(); ++i)
+    idIndex[points[i].id - minId] = quint32(i);
+
+  QJsonObject meta;
+  meta.insert("Data_Project", tableRows(db, "Data_Project"));
+  meta.insert("Data_WorkSet", tableRows(db, "Data_WorkSet"));
+  QJsonObject notes;
+  for (const char *table : {"Data_Line", "Data_Point", "Data_Sample"})
+    notes.insert(table, tableNotes(db, table));
+  meta.insert("Notes", notes);
+  const QByteArray metaJson =
+      QJsonDocument(meta).toJson(QJsonDocument::Compact);
+
+  if (!writeTable(out, lines, &h.lineTableOffset) ||
+      !writeTable(out, points, &h.pointTableOffset) ||
+      !writeTable(out, samples, &h.sampleTableOffset) ||
+      !writeTable(out, channels, &h.channelTableOffset) ||
+      !writeTable(out, refs, &h.channelRefOffset) ||
+      !writeTable(out, idIndex, &h.pointIdIndexOffset))
+    return failWith(out.errorString());
+  h.metaOffset = quint64(out.pos());
+  h.metaSize = quint64(metaJson.size());
+  if (out.write(metaJson) != metaJson.size())
+    return failWith(out.errorString());
+
+  h.lineCount = quint32(lines.size());
+  h.pointCount = quint32(points.size());
+  h.sampleCount = quint32(samples.size());
+  h.channelCount = quint32(channelCount);
+  h.pointIdBase = minId;
+  h.pointIdSpan = quint32(span);
+  h.fileSize = quint64(out.pos());
+  if (!out.seek(0) ||
+      out.write(reinterpret_cast<const char *>(&h), sizeof(h)) !=
+          qint64(sizeof(h)))
+    return failWith(out.errorString());
+  if (!out.commit())
+    return failWith(out.errorString());
+
+  qDebug() << "ProjectArchive: exported" << lines.size() << "lines,"
+           << points.size() << "points," << samples.size() << "samples to"
+           << path;
+  return true;
+}
+
+bool ProjectArchive::importToDatabase(
+    const QString &path, const QSqlDatabase &db,
+    const QHash<QString, WaveformCodec::Codec> &codecs, QString *error) {
+  ProjectArchive archive;
+  if (!archive.open(path)) {
+    if (error)
+      *error = archive.errorString();
+    return false;
+  }
+
+  QSqlDatabase conn = db;
+  auto failWith = [&conn, error](const QString &msg) {
+    qDebug() << "ProjectArchive import:" << msg;
+    conn.rollback();
+    if (error)
+      *error = msg;
+    return false;
+  };
+
+  if (!conn.transaction())
+    return failWith(conn.lastError().text());
+
+  const QJsonObject meta = QJsonDocument::fromJson(archive.metadata()).object();
+  if (!insertRows(conn, "Data_Project", meta.value("Data_Project").toArray()) ||
+      !insertRows(conn, "Data_WorkSet", meta.value("Data_WorkSet").toArray()))
+    return failWith("Project metadata: " + conn.lastError().text());
+
+  const QJsonObject notes = meta.value("Notes").toObject();
+  auto note = [&notes](const char *table, int id) {
+    const QJsonValue v =
+        notes.value(QLatin1String(table)).toObject().value(QString::number(id));
+    return v.isString() ? QVariant(v.toString()) : QVariant();
+  };
+
+  QSqlQuery lineQ(conn);
+  lineQ.prepare("INSERT OR IGNORE INTO Data_Line (ID, NAME, TYPE, USE, NOTE) "
+                "VALUES (?, ?, ?, ?, ?)");
+  for (int i = 0; i < archive.lineCount(); ++i) {
+    const LineEntry &l = archive.line(i);
+    lineQ.bindValue(0, l.id);
+    lineQ.bindValue(1, l.name);
+    lineQ.bindValue(2, l.type);
+    lineQ.bindValue(3, l.use);
+    lineQ.bindValue(4, note("Data_Line", l.id));
+    if (!lineQ.exec())
+      return failWith(lineQ.lastError().text());
+  }
+
+  QSqlQuery pointQ(conn);
+  pointQ.prepare("INSERT OR IGNORE INTO Data_Point (ID, Data_LineID, NAME, "
+                 "TYPE, USE, NOTE) VALUES (?, ?, ?, ?, ?, ?)");
+  for (int i = 0; i < archive.pointCount(); ++i) {
+    const PointEntry &p = archive.point(i);
+    pointQ.bindValue(0, p.id);
+    pointQ.bindValue(1, p.lineId);
+    pointQ.bindValue(2, p.name);
+    pointQ.bindValue(3, p.type);
+    pointQ.bindValue(4, p.use);
+    pointQ.bindValue(5, note("Data_Point", p.id));
+    if (!pointQ.exec())
+      return failWith(pointQ.lastError().text());
+  }
+
+  // Registry columns are filled from the archive channel of that name;
+  // channels this build has no column for cannot be kept
+  const QVector<ChannelRegistry::Channel> &registry =
+      ChannelRegistry::channels();
+  for (int i = 0; i < archive.channelCount(); ++i) {
+    if (!ChannelRegistry::columns().contains(archive.channelColumn(i)))
+      qWarning() << "ProjectArchive import: no column for channel"
+                 << archive.channelColumn(i) << "- skipped";
+  }
+  QStringList fields = {"ID",     "Data_PointID", "StartTime", "DeviceType",
+                        "PERIOD", "SendFs",       "TYPE",      "USE",
+                        "NOTE"};
+  const int firstColumn = fields.size();
+  fields += ChannelRegistry::columns();
+  // Each rate column once, from the first channel that names it
+  QVector<int> rateSources;
+  for (int c = 0; c < registry.size(); ++c) {
+    const char *rateField = registry[c].rateField;
+    if (rateField && !fields.contains(QLatin1String(rateField))) {
+      fields << QString::fromLatin1(rateField);
+      rateSources << c;
+    }
+  }
+  const int firstRate = firstColumn + registry.size();
+  QStringList marks;
+  for (int i = 0; i < fields.size(); ++i)
+    marks << "?";
+
+  // Every row of the sample table, including samples whose point is gone
+  QSqlQuery sampleQ(conn);
+  sampleQ.prepare(QString("INSERT OR IGNORE INTO Data_Sample (%1) "
+                          "VALUES (%2)")
+                      .arg(fields.join(", "), marks.join(", ")));
+  for (int i = 0; i < archive.sampleCount(); ++i) {
+    const SampleEntry &s = archive.sample(i);
+    sampleQ.bindValue(0, s.id);
+    sampleQ.bindValue(1, s.pointId);
+    sampleQ.bindValue(2, s.startTime);
+    sampleQ.bindValue(3, s.deviceType);
+    sampleQ.bindValue(4, s.period);
+    sampleQ.bindValue(5, s.sendFs);
+    sampleQ.bindValue(6, s.type);
+    sampleQ.bindValue(7, s.use);
+    sampleQ.bindValue(8, note("Data_Sample", s.id));
+    for (int c = 0; c < registry.size(); ++c) {
+      const ChannelRef *ref = archive.channelRef(s, c);
+      if (!ref) {
+        sampleQ.bindValue(firstColumn + c, QVariant());
+        continue;
+      }
+      int count = 0;
+      const float *data = archive.channel(s, c, &count);
+      if (!data && ref->count != 0)
+        return failWith("Corrupt channel in sample " + QString::number(s.id));
+      sampleQ.bindValue(
+          firstColumn + c,
+          WaveformCodec::encode(
+              data, count,
+              codecs.value(QLatin1String(registry[c].column),
+                           WaveformCodec::Raw)));
+    }
+    // 0 is how the archive keeps a NULL rate
+    for (int k = 0; k < rateSources.size(); ++k) {
+      const int rate = archive.rate(s, rateSources[k]);
+      sampleQ.bindValue(firstRate + k,
+                        rate > 0 ? QVariant(double(rate)) : QVariant());
+    }
+    if (!sampleQ.exec())
+      return failWith(sampleQ.lastError().text());
+  }
+
+  if (!conn.commit())
+    return failWith(conn.lastError().text());
+  return true;
+}
@@ -0,0 +1,144 @@
+#ifndef PROJECTARCHIVE_H
+#define PROJECTARCHIVE_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QHash>
+#include <QSqlDatabase>
+#include <QString>
+#include <QVector>
+
+#include "WaveformCodec.h"
+
+// Read-only columnar project archive (.tema), built for mmap playback.
+//
+// Layout: fixed header, then every sample's channels as contiguous float32
+// columns (64-byte aligned), then the line, point and sample tables, the
+// channel table, one ChannelRef per sample and channel, a dense point-ID
+// index and a JSON block with the project metadata. Tables are plain
+// little-endian structs used in place, so finding a point's waveform is an
+// index lookup into the mapping with no parsing. NOTE text of lines,
+// points and samples rides in the JSON block ("Notes").
+//
+// The channel table names the Data_Sample column of each archive channel,
+// written from ChannelRegistry; channel() takes a registry row and maps it
+// by column name, so archives from builds with other channels still open.
+//
+// open() checks every table range, so rows and channels handed out by an
+// open archive are always inside the mapping.
+class ProjectArchive {
+public:
+  struct ChannelEntry {
+    char column[32]; // Data_Sample column, NUL-terminated
+  };
+
+  struct ChannelRef {
+    quint64 offset; // from file start
+    quint32 count;  // float32 values
+    quint32 rate;   // values per second from the rate column, 0 if none
+  };
+
+  struct LineEntry {
+    qint32 id;
+    quint32 firstPoint; // row in the point table
+    quint32 pointCount;
+    qint32 type;
+    double name;
+    qint32 use;
+    qint32 reserved;
+  };
+
+  struct PointEntry {
+    qint32 id;
+    qint32 lineId;
+    quint32 firstSample; // row in the sample table, ordered by ID
+    quint32 sampleCount;
+    double name;
+    qint32 type;
+    qint32 use;
+  };
+
+  struct SampleEntry {
+    qint32 id;
+    qint32 pointId;
+    qint64 startTime;
+    qint32 deviceType;
+    qint32 period;
+    double recvFs;
+    double sendFs;
+    qint32 type;
+    qint32 use;
+  };
+
+  ProjectArchive() = default;
+  ~ProjectArchive() { close(); }
+  ProjectArchive(const ProjectArchive &) = delete;
+  ProjectArchive &operator=(const ProjectArchive &) = delete;
+
+  bool open(const QString &path);
+  void close();
+  bool isOpen() const { return m_base != nullptr; }
+  QString path() const { return m_file.fileName(); }
+  QString errorString() const { return m_error; }
+
+  int lineCount() const { return m_lineCount; }
+  const LineEntry &line(int row) const { return m_lines[row]; }
+  int pointCount() const { return m_pointCount; }
+  const PointEntry &point(int row) const { return m_points[row]; }
+  int sampleCount() const { return m_sampleCount; }
+  const SampleEntry &sample(int row) const { return m_samples[row]; }
+
+  // O(1) through the point-ID index; nullptr if absent
+  const PointEntry *findPoint(int pointId) const;
+  // What playback shows for a point: its newest sample
+  const SampleEntry *latestSample(int pointId) const;
+  // Columns the archive holds, in file order
+  int channelCount() const { return m_channelCount; }
+  QString channelColumn(int archiveChannel) const;
+  // Column of a ChannelRegistry row inside the mapping; nullptr if the
+  // archive has no such channel or the reference is out of bounds
+  const float *channel(const SampleEntry &sample, int channel,
+                       int *count) const;
+  // Values per second of a ChannelRegistry row, 0 if unknown
+  int rate(const SampleEntry &sample, int channel) const;
+
+  // {"Data_Project": [...], "Data_WorkSet": [...],
+  //  "Notes": {"Data_Line": {"<ID>": "..."}, "Data_Point": ..., ...}}
+  QByteArray metadata() const;
+
+  // Converters; both run on the calling thread with the given connection
+  static bool exportDatabase(const QSqlDatabase &db, const QString &path,
+                             QString *error = nullptr);
+  // Existing IDs in db are kept and the archive's row is skipped
+  static bool importToDatabase(const QString &path, const QSqlDatabase &db,
+                               const QHash<QString, WaveformCodec::Codec> &codecs,
+                               QString *error = nullptr);
+
+private:
+  bool fail(const QString &error);
+  const ChannelRef *channelRef(const SampleEntry &sample, int channel) const;
+
+  QFile m_file;
+  uchar *m_base = nullptr;
+  qint64 m_size = 0;
+  QString m_error;
+
+  const LineEntry *m_lines = nullptr;
+  const PointEntry *m_points = nullptr;
+  const SampleEntry *m_samples = nullptr;
+  const ChannelEntry *m_channels = nullptr;
+  const ChannelRef *m_channelRefs = nullptr;
+  const quint32 *m_pointIdIndex = nullptr;
+  int m_lineCount = 0;
+  int m_pointCount = 0;
+  int m_sampleCount = 0;
+  int m_channelCount = 0;
+  // Archive channel of each ChannelRegistry row, -1 if absent
+  QVector<int> m_channelOfRow;
+  qint32 m_pointIdBase = 0;
+  quint32 m_pointIdSpan = 0;
+  const char *m_meta = nullptr;
+  qint64 m_metaSize = 0;
+};
+
+#endif // PROJECTARCHIVE_H
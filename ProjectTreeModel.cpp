@@ -0,0 +1,332 @@
+#include "ProjectTreeModel.h"
+#include "StatementCache.h"
+#include <QDebug>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <algorithm>
+
+namespace {
+
+// internalId 0 marks a line; points carry their line row + 1
+const quintptr kLineId = 0;
+
+QString lineLabel(const QVariant &name) {
+  return "L" + QString::number(name.toDouble(), 'f', 1);
+}
+
+QString pointLabel(const QVariant &name) {
+  return "P" + QString::number(name.toDouble(), 'f', 1);
+}
+
+} // namespace
+
+ProjectTreeModel::ProjectTreeModel(QObject *parent)
+    : QAbstractItemModel(parent) {}
+
+void ProjectTreeModel::clear() {
+  beginResetModel();
+  m_lines.clear();
+  m_lineRowById.clear();
+  m_db = QSqlDatabase();
+  endResetModel();
+}
+
+void ProjectTreeModel::reload(const QSqlDatabase &db) {
+  beginResetModel();
+  m_db = db;
+  m_lines.clear();
+
+  // Counts come from the (Data_LineID, ID) and (Data_PointID, ID) indexes
+  QSqlQuery &q = StatementCache::prepared(
+      m_db, "SELECT l.ID, l.NAME, COUNT(DISTINCT p.ID), COUNT(s.ID) "
+            "FROM Data_Line l "
+            "LEFT JOIN Data_Point p ON p.Data_LineID = l.ID "
+            "LEFT JOIN Data_Sample s ON s.Data_PointID = p.ID "
+            "GROUP BY l.ID ORDER BY l.ID");
+  q.setForwardOnly(true);
+  if (q.exec()) {
+    while (q.next()) {
+      LineNode line;
+      line.id = q.value(0).toInt();
+      line.label = lineLabel(q.value(1));
+      line.pointCount = q.value(2).toInt();
+      line.sampleCount = q.value(3).toInt();
+      m_lines.append(line);
+    }
+  } else {
+    qDebug() << "ProjectTreeModel: load lines failed" << q.lastError();
+  }
+
+  rebuildLineRowIndex();
+  endResetModel();
+}
+
+void ProjectTreeModel::rebuildLineRowIndex() {
+  m_lineRowById.clear();
+  m_lineRowById.reserve(m_lines.size());
+  for (int i = 0; i < m_lines.size(); ++i)
+    m_lineRowById.insert(m_lines[i].id, i);
+}
+
+void ProjectTreeModel::setExpanded(int lineRow, bool expanded) {
+  if (lineRow < 0 || lineRow >= m_lines.size())
+    return;
+  LineNode &line = m_lines[lineRow];
+  if (line.expanded == expanded)
+    return;
+
+  line.expanded = expanded;
+  const QModelIndex lineIdx = index(lineRow, 0);
+  if (expanded) {
+    if (line.points.isEmpty())
+      loadMorePoints(lineRow);
+  } else if (!line.points.isEmpty()) {
+    // Collapsed lines give their points back
+    beginRemoveRows(lineIdx, 0, line.points.size() - 1);
+    line.points = QVector<PointNode>();
+    endRemoveRows();
+  }
+  emit dataChanged(lineIdx, lineIdx, {ExpandedRole, HasMoreRole});
+}
+
+void ProjectTreeModel::loadMorePoints(int lineRow) {
+  if (lineRow < 0 || lineRow >= m_lines.size() || !m_db.isOpen())
+    return;
+  LineNode &line = m_lines[lineRow];
+  if (line.points.size() >= line.pointCount)
+    return;
+
+  // Keyset paging: resume after the last loaded ID
+  QSqlQuery &q = StatementCache::prepared(
+      m_db, "SELECT p.ID, p.NAME, "
+            "(SELECT COUNT(*) FROM Data_Sample s WHERE s.Data_PointID = p.ID) "
+            "FROM Data_Point p WHERE p.Data_LineID = ? AND p.ID > ? "
+            "ORDER BY p.ID LIMIT ?");
+  q.setForwardOnly(true);
+  q.addBindValue(line.id);
+  q.addBindValue(line.points.isEmpty() ? -1 : line.points.last().id);
+  q.addBindValue(m_pageSize);
+  if (!q.exec()) {
+    qDebug() << "ProjectTreeModel: load points failed" << q.lastError();
+    return;
+  }
+
+  QVector<PointNode> page;
+  page.reserve(m_pageSize);
+  while (q.next()) {
+    PointNode p;
+    p.id = q.value(0).toInt();
+    p.label = pointLabel(q.value(1));
+    p.sampleCount = q.value(2).toInt();
+    page.append(p);
+  }
+  if (page.isEmpty())
+    return;
+
+  const QModelIndex lineIdx = index(lineRow, 0);
+  const int first = line.points.size();
+  beginInsertRows(lineIdx, first, first + page.size() - 1);
+  line.points += page;
+  endInsertRows();
+  emit dataChanged(lineIdx, lineIdx, {HasMoreRole});
+}
+
+QModelIndex ProjectTreeModel::index(int row, int column,
+                                    const QModelIndex &parent) const {
+  if (column != 0 || row < 0)
+    return QModelIndex();
+  if (!parent.isValid()) {
+    return row < m_lines.size() ? createIndex(row, 0, kLineId)
+                                : QModelIndex();
+  }
+  if (parent.internalId() != kLineId)
+    return QModelIndex();
+  const LineNode &line = m_lines[parent.row()];
+  return row < line.points.size()
+             ? createIndex(row, 0, quintptr(parent.row()) + 1)
+             : QModelIndex();
+}
+
+QModelIndex ProjectTreeModel::parent(const QModelIndex &child) const {
+  if (!child.isValid() || child.internalId() == kLineId)
+    return QModelIndex();
+  return createIndex(int(child.internalId() - 1), 0, kLineId);
+}
+
+int ProjectTreeModel::rowCount(const QModelIndex &parent) const {
+  if (!parent.isValid())
+    return m_lines.size();
+  if (parent.internalId() == kLineId)
+    return m_lines[parent.row()].points.size();
+  return 0;
+}
+
+int ProjectTreeModel::columnCount(const QModelIndex &parent) const {
+  Q_UNUSED(parent)
+  return 1;
+}
+
+bool ProjectTreeModel::hasChildren(const QModelIndex &parent) const {
+  if (!parent.isValid())
+    return !m_lines.isEmpty();
+  if (parent.internalId() == kLineId)
+    return m_lines[parent.row()].pointCount > 0;
+  return false;
+}
+
+bool ProjectTreeModel::canFetchMore(const QModelIndex &parent) const {
+  if (!parent.isValid() || parent.internalId() != kLineId)
+    return false;
+  const LineNode &line = m_lines[parent.row()];
+  return line.points.size() < line.pointCount;
+}
+
+void ProjectTreeModel::fetchMore(const QModelIndex &parent) {
+  if (parent.isValid() && parent.internalId() == kLineId)
+    loadMorePoints(parent.row());
+}
+
+QVariant ProjectTreeModel::data(const QModelIndex &index, int role) const {
+  if (!index.isValid())
+    return QVariant();
+
+  if (index.internalId() == kLineId) {
+    const LineNode &line = m_lines[index.row()];
+    switch (role) {
+    case Qt::DisplayRole:
+    case LabelRole:
+      return line.label;
+    case IdRole:
+      return line.id;
+    case IsLineRole:
+      return true;
+    case IsPointRole:
+      return false;
+    case ExpandedRole:
+      return line.expanded;
+    case PointCountRole:
+      return line.pointCount;
+    case SampleCountRole:
+      return line.sampleCount;
+    case HasMoreRole:
+      return line.expanded && line.points.size() < line.pointCount;
+    default:
+      return QVariant();
+    }
+  }
+
+  const LineNode &line = m_lines[int(index.internalId() - 1)];
+  const PointNode &point = line.points[index.row()];
+  switch (role) {
+  case Qt::DisplayRole:
+  case LabelRole:
+    return point.label;
+  case IdRole:
+    return point.id;
+  case IsLineRole:
+    return false;
+  case IsPointRole:
+    return true;
+  case SampleCountRole:
+    return point.sampleCount;
+  case StatusRole:
+    return point.sampleCount > 0 ? QString("done") : QString();
+  default:
+    return QVariant();
+  }
+}
+
+QHash<int, QByteArray> ProjectTreeModel::roleNames() const {
+  return {{IdRole, "id"},
+          {LabelRole, "label"},
+          {IsLineRole, "isLine"},
+          {IsPointRole, "isPoint"},
+          {ExpandedRole, "expanded"},
+          {PointCountRole, "pointCount"},
+          {SampleCountRole, "sampleCount"},
+          {HasMoreRole, "hasMore"},
+          {StatusRole, "status"}};
+}
+
+void ProjectTreeModel::onLineCreated(int lineId) {
+  if (!m_db.isOpen() || m_lineRowById.contains(lineId))
+    return;
+
+  QSqlQuery &q =
+      StatementCache::prepared(m_db, "SELECT NAME FROM Data_Line WHERE ID = ?");
+  const StatementCache::Finish finish(q);
+  q.addBindValue(lineId);
+  if (!q.exec() || !q.next())
+    return;
+
+  LineNode line;
+  line.id = lineId;
+  line.label = lineLabel(q.value(0));
+
+  // New IDs are the largest, so this is an append in ID order
+  const int row = m_lines.size();
+  beginInsertRows(QModelIndex(), row, row);
+  m_lines.append(line);
+  m_lineRowById.insert(lineId, row);
+  endInsertRows();
+}
+
+void ProjectTreeModel::onPointCreated(int lineId, int pointId) {
+  const int row = m_lineRowById.value(lineId, -1);
+  if (row < 0)
+    return;
+  LineNode &line = m_lines[row];
+  const bool fullyLoaded = line.points.size() == line.pointCount;
+  ++line.pointCount;
+  const QModelIndex lineIdx = index(row, 0);
+
+  // Only grow the visible page if the reader has already seen the tail
+  if (line.expanded && fullyLoaded) {
+    QSqlQuery &q = StatementCache::prepared(
+        m_db, "SELECT NAME FROM Data_Point WHERE ID = ?");
+    const StatementCache::Finish finish(q);
+    q.addBindValue(pointId);
+    if (q.exec() && q.next()) {
+      PointNode p;
+      p.id = pointId;
+      p.label = pointLabel(q.value(0));
+      beginInsertRows(lineIdx, line.points.size(), line.points.size());
+      line.points.append(p);
+      endInsertRows();
+    }
+  }
+  emit dataChanged(lineIdx, lineIdx, {PointCountRole, HasMoreRole});
+}
+
+void ProjectTreeModel::onSampleAdded(int sampleId, int pointId) {
+  Q_UNUSED(sampleId)
+  const int row = lineRowForPoint(pointId);
+  if (row < 0)
+    return;
+  LineNode &line = m_lines[row];
+  ++line.sampleCount;
+  const QModelIndex lineIdx = index(row, 0);
+  emit dataChanged(lineIdx, lineIdx, {SampleCountRole});
+
+  auto it = std::lower_bound(
+      line.points.begin(), line.points.end(), pointId,
+      [](const PointNode &p, int id) { return p.id < id; });
+  if (it != line.points.end() && it->id == pointId) {
+    ++it->sampleCount;
+    const QModelIndex pointIdx =
+        index(int(it - line.points.begin()), 0, lineIdx);
+    emit dataChanged(pointIdx, pointIdx, {SampleCountRole, StatusRole});
+  }
+}
+
+int ProjectTreeModel::lineRowForPoint(int pointId) const {
+  if (!m_db.isOpen())
+    return -1;
+  QSqlQuery &q = StatementCache::prepared(
+      m_db, "SELECT Data_LineID FROM Data_Point WHERE ID = ?");
+  const StatementCache::Finish finish(q);
+  q.addBindValue(pointId);
+  if (!q.exec() || !q.next())
+    return -1;
+  return m_lineRowById.value(q.value(0).toInt(), -1);
+}
@@ -0,0 +1,84 @@
+#ifndef PROJECTTREEMODEL_H
+#define PROJECTTREEMODEL_H
+
+#include <QAbstractItemModel>
+#include <QHash>
+#include <QSqlDatabase>
+#include <QString>
+#include <QVector>
+
+// Line -> Point tree read straight from a project DB. Lines (with point and
+// sample counts from one aggregate query) load eagerly; a line's points are
+// paged in only while it is expanded and dropped again on collapse, so
+// memory follows what is on screen rather than the survey size.
+class ProjectTreeModel : public QAbstractItemModel {
+  Q_OBJECT
+public:
+  enum Roles {
+    IdRole = Qt::UserRole + 1,
+    LabelRole,
+    IsLineRole,
+    IsPointRole,
+    ExpandedRole,
+    PointCountRole,
+    SampleCountRole,
+    HasMoreRole, // line has points not paged in yet
+    StatusRole   // point: "done" once it holds a sample
+  };
+  Q_ENUM(Roles)
+
+  explicit ProjectTreeModel(QObject *parent = nullptr);
+
+  // Re-read the lines of db; all lines start collapsed
+  void reload(const QSqlDatabase &db);
+  void clear();
+
+  void setPageSize(int pageSize) { m_pageSize = qMax(1, pageSize); }
+
+  Q_INVOKABLE void setExpanded(int lineRow, bool expanded);
+  Q_INVOKABLE void loadMorePoints(int lineRow);
+  Q_INVOKABLE int lineCount() const { return m_lines.size(); }
+
+  // QAbstractItemModel
+  QModelIndex index(int row, int column,
+                    const QModelIndex &parent = QModelIndex()) const override;
+  QModelIndex parent(const QModelIndex &child) const override;
+  int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+  int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+  bool hasChildren(const QModelIndex &parent = QModelIndex()) const override;
+  bool canFetchMore(const QModelIndex &parent) const override;
+  void fetchMore(const QModelIndex &parent) override;
+  QVariant data(const QModelIndex &index, int role) const override;
+  QHash<int, QByteArray> roleNames() const override;
+
+public slots:
+  // Incremental updates from DatabaseManager; no rebuild
+  void onLineCreated(int lineId);
+  void onPointCreated(int lineId, int pointId);
+  void onSampleAdded(int sampleId, int pointId);
+
+private:
+  struct PointNode {
+    int id = 0;
+    QString label;
+    int sampleCount = 0;
+  };
+  struct LineNode {
+    int id = 0;
+    QString label;
+    int pointCount = 0;
+    int sampleCount = 0;
+    bool expanded = false;
+    QVector<PointNode> points; // loaded page(s), ordered by ID
+  };
+
+  int lineRowForPoint(int pointId) const;
+  void rebuildLineRowIndex();
+
+  QSqlDatabase m_db;
+  QVector<LineNode> m_lines;
+  QHash<int, int> m_lineRowById;
+  int m_pageSize = 500;
+};
+
+#endif // PROJECTTREEMODEL_H
@@ -0,0 +1,270 @@
+#include "SampleWriter.h"
+#include "ConnectionManager.h"
+#include "Metrics.h"
+#include <QDateTime>
+#include <QDebug>
+#include <QSqlError>
+#include <QStringList>
+
+namespace {
+
+// Raised by DatabaseManager::saveSample, lowered here once committed
+Metrics::Gauge &queueDepth = Metrics::gauge("tem_db_queue_samples");
+Metrics::Histogram &insertLatency =
+    Metrics::histogram("tem_db_insert_seconds",
+                       "Data_Sample INSERT execution time", 1e-9);
+Metrics::Histogram &commitLatency = Metrics::histogram(
+    "tem_db_transaction_seconds",
+    "Group commit time, BEGIN to COMMIT", 1e-9);
+Metrics::Histogram &transactionRows = Metrics::histogram(
+    "tem_db_transaction_rows", "Samples per group commit");
+Metrics::Counter &writeErrors = Metrics::counter(
+    "tem_db_write_errors_total", "Failed inserts and commits");
+Metrics::Counter &deadLetters = Metrics::counter(
+    "tem_db_dead_letter_total", "Samples dropped after repeated failures");
+
+// Failed flushes of one batch before it is written row by row
+const int kMaxFlushAttempts = 3;
+
+} // namespace
+
+SampleWriter::SampleWriter(QObject *parent) : QObject(parent) {
+  // Parented so moveToThread() carries the timer along with the writer
+  m_flushTimer = new QTimer(this);
+  m_flushTimer->setSingleShot(true);
+  connect(m_flushTimer, &QTimer::timeout, this, &SampleWriter::flush);
+}
+
+SampleWriter::~SampleWriter() { close(); }
+
+void SampleWriter::setBatchLimits(int maxRows, int maxLatencyMs) {
+  m_maxRows = qMax(1, maxRows);
+  m_maxLatencyMs = qMax(0, maxLatencyMs);
+}
+
+void SampleWriter::open(const QString &dbPath) {
+  // Anything queued for the previous project goes to the previous project
+  close();
+
+  // The writer thread's own pooled connection; never the GUI one
+  m_dbPath = dbPath;
+  m_db = ConnectionManager::connection(dbPath, ConnectionManager::ReadWrite);
+  if (!m_db.isOpen()) {
+    emit writeError("Writer connection failed: " + m_db.lastError().text());
+    return;
+  }
+  if (!applyPragmas()) {
+    emit writeError("Writer pragmas failed: " + m_db.lastError().text());
+  }
+
+  // Fixed columns, then one per registry channel, then each distinct
+  // rate column (filled from the first channel that names it)
+  QStringList columns = {"Data_PointID", "DeviceType", "PERIOD", "SendFs",
+                         "StartTime"};
+  columns << ChannelRegistry::columns();
+  m_rateSources.clear();
+  for (int i = 0; i < ChannelRegistry::count(); ++i) {
+    const char *rate = ChannelRegistry::channel(i).rateField;
+    if (rate && !columns.contains(QLatin1String(rate))) {
+      columns << QString::fromLatin1(rate);
+      m_rateSources.append(i);
+    }
+  }
+  const QStringList placeholders(columns.size(), QStringLiteral("?"));
+  m_insertQuery = new QSqlQuery(m_db);
+  m_insertQuery->prepare(QString("INSERT INTO Data_Sample (%1) VALUES (%2)")
+                             .arg(columns.join(", "), placeholders.join(", ")));
+
+  qDebug() << "SampleWriter: connection ok" << dbPath;
+}
+
+bool SampleWriter::applyPragmas() {
+  QSqlQuery q(m_db);
+  // WAL, synchronous = NORMAL and page_size come with the pooled
+  // connection: readers keep going while the writer commits, and only
+  // checkpoints fsync the main file (a power cut loses at most the last
+  // batch).
+  return q.exec("PRAGMA temp_store = MEMORY");
+}
+
+void SampleWriter::post(PendingSample &&sample) {
+  bool wake;
+  {
+    QMutexLocker lock(&m_handoffMutex);
+    wake = m_handoff.isEmpty();
+    m_handoff.append(std::move(sample));
+  }
+  if (wake)
+    QMetaObject::invokeMethod(this, &SampleWriter::drainHandoff,
+                              Qt::QueuedConnection);
+}
+
+void SampleWriter::drainHandoff() {
+  {
+    QMutexLocker lock(&m_handoffMutex);
+    m_handoff.swap(m_draining);
+  }
+  for (const PendingSample &s : std::as_const(m_draining))
+    enqueue(s);
+  m_draining.clear();
+}
+
+void SampleWriter::enqueue(const SampleWriter::PendingSample &sample) {
+  if (!m_db.isOpen()) {
+    queueDepth.add(-1);
+    emit writeError("Insert Sample failed: no open writer connection");
+    return;
+  }
+
+  m_pending.append(sample);
+  if (m_pending.size() >= m_maxRows) {
+    flush();
+  } else if (!m_flushTimer->isActive()) {
+    m_flushTimer->start(m_maxLatencyMs);
+  }
+}
+
+bool SampleWriter::insert(const PendingSample &s) {
+  int col = 0;
+  m_insertQuery->bindValue(col++, s.pointId);
+  m_insertQuery->bindValue(col++, s.meta.value("DeviceType", 1));
+  m_insertQuery->bindValue(col++, s.meta.value("PERIOD", 500));
+  m_insertQuery->bindValue(col++, s.meta.value("SendFs", 25.0));
+  m_insertQuery->bindValue(
+      col++, s.meta.value("StartTime", QDateTime::currentMSecsSinceEpoch()));
+  // A channel the sample does not have is stored as NULL
+  for (int i = 0; i < ChannelRegistry::count(); ++i)
+    m_insertQuery->bindValue(
+        col++, i < s.channels.size() ? s.channels[i] : QVariant());
+  for (int i : std::as_const(m_rateSources)) {
+    const int rate = i < s.rates.size() ? s.rates[i] : 0;
+    m_insertQuery->bindValue(col++, rate > 0 ? QVariant(rate) : QVariant());
+  }
+
+  Metrics::ScopedTimer t(insertLatency);
+  return m_insertQuery->exec();
+}
+
+void SampleWriter::flush() {
+  m_flushTimer->stop();
+  if (m_pending.isEmpty() || !m_db.isOpen())
+    return;
+  // A batch that keeps failing goes row by row, so one bad sample cannot
+  // hold back the rest
+  if (m_failedFlushes >= kMaxFlushAttempts) {
+    flushRowByRow();
+    return;
+  }
+
+  QElapsedTimer timer;
+  timer.start();
+
+  // Keep the batch queued; the next flush retries it
+  auto retry = [this](const QString &error) {
+    writeErrors.add();
+    ++m_failedFlushes;
+    m_flushTimer->start(m_maxLatencyMs);
+    emit writeError(error);
+  };
+
+  if (!m_db.transaction()) {
+    retry("Begin transaction failed: " + m_db.lastError().text());
+    return;
+  }
+
+  QList<int> ids;
+  QList<int> pointIds;
+  QList<qint64> journalSeqs;
+  ids.reserve(m_pending.size());
+  pointIds.reserve(m_pending.size());
+  journalSeqs.reserve(m_pending.size());
+  for (const PendingSample &s : std::as_const(m_pending)) {
+    if (!insert(s)) {
+      QString err = m_insertQuery->lastError().text();
+      m_db.rollback();
+      retry("Insert Sample failed: " + err);
+      return;
+    }
+    ids.append(m_insertQuery->lastInsertId().toInt());
+    pointIds.append(s.pointId);
+    journalSeqs.append(s.journalSeq);
+  }
+
+  if (!m_db.commit()) {
+    QString err = m_db.lastError().text();
+    m_db.rollback();
+    retry("Commit Sample batch failed: " + err);
+    return;
+  }
+
+  m_pending.clear();
+  m_failedFlushes = 0;
+  commitLatency.record(timer.nsecsElapsed());
+  transactionRows.record(ids.size());
+  queueDepth.add(-ids.size());
+
+  emit samplesSaved(ids, pointIds, journalSeqs);
+}
+
+void SampleWriter::flushRowByRow() {
+  QList<int> ids;
+  QList<int> pointIds;
+  QList<qint64> journalSeqs;
+  for (const PendingSample &s : std::as_const(m_pending)) {
+    QString err;
+    if (!m_db.transaction()) {
+      err = m_db.lastError().text();
+    } else if (!insert(s)) {
+      err = m_insertQuery->lastError().text();
+      m_db.rollback();
+    } else {
+      const int id = m_insertQuery->lastInsertId().toInt();
+      if (m_db.commit()) {
+        ids.append(id);
+        pointIds.append(s.pointId);
+        journalSeqs.append(s.journalSeq);
+        continue;
+      }
+      err = m_db.lastError().text();
+      m_db.rollback();
+    }
+    deadLetter(s, QString("not saved after %1 attempts: %2")
+                      .arg(kMaxFlushAttempts)
+                      .arg(err));
+  }
+
+  queueDepth.add(-m_pending.size());
+  m_pending.clear();
+  m_failedFlushes = 0;
+  if (!ids.isEmpty())
+    emit samplesSaved(ids, pointIds, journalSeqs);
+}
+
+void SampleWriter::deadLetter(const PendingSample &s, const QString &error) {
+  // Its journal frame is never marked saved, so
+  // AcquisitionJournal::scanUnsaved still hands it back for recovery
+  writeErrors.add();
+  deadLetters.add();
+  qWarning() << "SampleWriter: dropped sample for point" << s.pointId
+             << "journal frame" << s.journalSeq << ":" << error;
+  emit writeError(QString("Sample for point %1 %2").arg(s.pointId).arg(error));
+}
+
+void SampleWriter::close() {
+  drainHandoff();
+  flush();
+  // A batch the last flush could not commit must not reach the next
+  // project's file
+  m_flushTimer->stop();
+  for (const PendingSample &s : std::as_const(m_pending))
+    deadLetter(s, "not saved before its project was closed");
+  queueDepth.add(-m_pending.size());
+  m_pending.clear();
+  m_failedFlushes = 0;
+  delete m_insertQuery;
+  m_insertQuery = nullptr;
+  if (m_db.isValid()) {
+    m_db = QSqlDatabase();
+    ConnectionManager::release(m_dbPath);
+  }
+}
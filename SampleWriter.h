@@ -0,0 +1,92 @@
+#ifndef SAMPLEWRITER_H
+#define SAMPLEWRITER_H
+
+#include "ChannelRegistry.h"
+#include <QElapsedTimer>
+#include <QList>
+#include <QMutex>
+#include <QObject>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QString>
+#include <QTimer>
+#include <QVariant>
+#include <QVariantMap>
+#include <QVector>
+
+// Write-behind persistence worker. Lives on its own thread with its own
+// SQLite connection and group-commits queued Data_Sample inserts. A batch
+// that fails to commit a few times in a row is retried one row at a time,
+// and rows that still fail are dropped and reported (writeError, the
+// tem_db_dead_letter_total counter); their journal frames stay unsaved.
+// close() does the same with whatever its final flush could not commit.
+class SampleWriter : public QObject {
+  Q_OBJECT
+public:
+  struct PendingSample {
+    int pointId = -1;
+    QVariantMap meta;
+    // Column values as produced by WaveformCodec::encode, and values per
+    // second, in ChannelRegistry order
+    ChannelArray<QVariant> channels;
+    ChannelArray<int> rates;
+    // AcquisitionJournal frame to mark saved once committed, or -1
+    qint64 journalSeq = -1;
+  };
+
+  explicit SampleWriter(QObject *parent = nullptr);
+  ~SampleWriter();
+
+  // Group commit thresholds: whichever is hit first triggers a flush
+  void setBatchLimits(int maxRows, int maxLatencyMs);
+
+  // Any thread: hand a sample to the writer thread. Only the first sample
+  // of a burst posts a wake-up; the rest ride along in the same vector, so
+  // steady-state saving allocates nothing here.
+  void post(PendingSample &&sample);
+
+public slots:
+  // All slots run on the writer thread
+  void open(const QString &dbPath);
+  void enqueue(const SampleWriter::PendingSample &sample);
+  // Moves everything post()ed so far into the batch
+  void drainHandoff();
+  void flush();
+  void close();
+
+signals:
+  // Parallel lists: sampleIds[i] was stored for pointIds[i], from journal
+  // frame journalSeqs[i] (-1 if none)
+  void samplesSaved(const QList<int> &sampleIds, const QList<int> &pointIds,
+                    const QList<qint64> &journalSeqs);
+  void writeError(const QString &errorStr);
+
+private:
+  bool applyPragmas();
+  // Binds and executes one row of the prepared INSERT
+  bool insert(const PendingSample &sample);
+  // Each row in its own transaction; rows that still fail are dropped
+  void flushRowByRow();
+  // Drops a sample and reports it; error completes "Sample for point N"
+  void deadLetter(const PendingSample &sample, const QString &error);
+
+  QSqlDatabase m_db;
+  QString m_dbPath;
+  QSqlQuery *m_insertQuery = nullptr;
+  // Registry row that supplies each rate column of the INSERT
+  QVector<int> m_rateSources;
+
+  QVector<PendingSample> m_pending;
+  // post() fills m_handoff; drainHandoff() swaps it with m_draining so
+  // both keep their capacity
+  QMutex m_handoffMutex;
+  QVector<PendingSample> m_handoff;
+  QVector<PendingSample> m_draining;
+  QTimer *m_flushTimer = nullptr;
+  int m_maxRows = 64;
+  int m_maxLatencyMs = 250;
+  // Consecutive failed flushes of the pending batch
+  int m_failedFlushes = 0;
+};
+
+#endif // SAMPLEWRITER_H
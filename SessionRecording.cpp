@@ -0,0 +1,144 @@
+#include "SessionRecording.h"
+#include <QDateTime>
+#include <QDebug>
+#include <QtEndian>
+#include <cstring>
+
+namespace {
+
+const char kMagic[8] = {'T', 'E', 'M', 'S', 'E', 'S', 'S', '1'};
+const int kRecordHeader = 8 + 1 + 4;
+const int kMaxBatchMs = 8; // as-fast replay yields to the event loop
+
+} // namespace
+
+bool SessionRecorder::open(const QString &path, QString *error) {
+  close();
+  m_file.setFileName(path);
+  if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+    if (error)
+      *error = m_file.errorString();
+    return false;
+  }
+  uchar header[16];
+  memcpy(header, kMagic, 8);
+  qToLittleEndian<qint64>(QDateTime::currentMSecsSinceEpoch(), header + 8);
+  m_file.write(reinterpret_cast<const char *>(header), sizeof(header));
+  m_clock.start();
+  qDebug() << "SessionRecorder: recording to" << path;
+  return true;
+}
+
+void SessionRecorder::close() {
+  if (!m_file.isOpen())
+    return;
+  m_file.close();
+  qDebug() << "SessionRecorder: closed" << m_file.fileName();
+}
+
+void SessionRecorder::append(SessionRecording::Direction direction,
+                             const QByteArray &bytes) {
+  if (!m_file.isOpen())
+    return;
+  uchar header[kRecordHeader];
+  qToLittleEndian<qint64>(m_clock.nsecsElapsed(), header);
+  header[8] = direction;
+  qToLittleEndian<quint32>(quint32(bytes.size()), header + 9);
+  // QFile buffers, so small chunks do not each cost a syscall
+  m_file.write(reinterpret_cast<const char *>(header), kRecordHeader);
+  m_file.write(bytes);
+}
+
+SessionReplayer::SessionReplayer(QObject *parent) : QObject(parent) {
+  m_timer.setSingleShot(true);
+  m_timer.setTimerType(Qt::PreciseTimer);
+  connect(&m_timer, &QTimer::timeout, this, &SessionReplayer::pump);
+}
+
+bool SessionReplayer::open(const QString &path, QString *error) {
+  stop();
+  m_file.close();
+  m_file.setFileName(path);
+  if (!m_file.open(QIODevice::ReadOnly)) {
+    if (error)
+      *error = m_file.errorString();
+    return false;
+  }
+  const QByteArray header = m_file.read(16);
+  if (header.size() != 16 || memcmp(header.constData(), kMagic, 8) != 0) {
+    if (error)
+      *error = "not a session recording";
+    m_file.close();
+    return false;
+  }
+  m_chunks = 0;
+  m_bytes = 0;
+  m_hasNext = readNext();
+  return true;
+}
+
+void SessionReplayer::start(double speed) {
+  if (!m_file.isOpen())
+    return;
+  m_speed = qMax(0.0, speed);
+  m_running = true;
+  m_clock.start();
+  // Time runs from the first received chunk, not from the recording start
+  m_baseNs = m_nextNs;
+  m_timer.start(0);
+}
+
+void SessionReplayer::stop() {
+  m_timer.stop();
+  m_running = false;
+}
+
+bool SessionReplayer::readNext() {
+  // Sent chunks are the commands we issued; replay only plays the device
+  for (;;) {
+    uchar header[kRecordHeader];
+    if (m_file.read(reinterpret_cast<char *>(header), kRecordHeader) !=
+        kRecordHeader)
+      return false;
+    const qint64 offsetNs = qFromLittleEndian<qint64>(header);
+    const quint32 length = qFromLittleEndian<quint32>(header + 9);
+    if (header[8] != SessionRecording::Received) {
+      if (!m_file.skip(length))
+        return false;
+      continue;
+    }
+    m_next = m_file.read(length);
+    if (m_next.size() != qsizetype(length))
+      return false; // torn tail of a recording cut short
+    m_nextNs = offsetNs;
+    return true;
+  }
+}
+
+void SessionReplayer::pump() {
+  const qint64 sliceStart = m_clock.elapsed();
+  while (m_running && m_hasNext) {
+    if (m_speed > 0.0) {
+      const qint64 dueNs = qint64((m_nextNs - m_baseNs) / m_speed);
+      const qint64 waitNs = dueNs - m_clock.nsecsElapsed();
+      if (waitNs > 1000000) {
+        m_timer.start(int(waitNs / 1000000));
+        return;
+      }
+    } else if (m_clock.elapsed() - sliceStart >= kMaxBatchMs) {
+      m_timer.start(0);
+      return;
+    }
+    const QByteArray chunk = m_next;
+    m_hasNext = readNext();
+    ++m_chunks;
+    m_bytes += chunk.size();
+    emit dataReceived(chunk);
+  }
+  if (m_running && !m_hasNext) {
+    m_running = false;
+    qDebug() << "SessionReplayer: done," << m_chunks << "chunks," << m_bytes
+             << "bytes";
+    emit finished();
+  }
+}
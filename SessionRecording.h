@@ -0,0 +1,80 @@
+#ifndef SESSIONRECORDING_H
+#define SESSIONRECORDING_H
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QObject>
+#include <QString>
+#include <QTimer>
+
+// Raw device sessions on disk, for reproducing field problems offline.
+//
+// A session file holds every chunk read from (and written to) the device
+// socket with its arrival time:
+//
+//   "TEMSESS1"  qint64 startMs
+//   { qint64 offsetNs, quint8 direction, quint32 length, bytes }*
+//
+// all little-endian. Chunks are stored exactly as the socket delivered
+// them, so replay reproduces the original fragmentation too.
+namespace SessionRecording {
+enum Direction : quint8 { Received = 0, Sent = 1 };
+}
+
+class SessionRecorder {
+public:
+  ~SessionRecorder() { close(); }
+
+  bool open(const QString &path, QString *error = nullptr);
+  void close();
+  bool isOpen() const { return m_file.isOpen(); }
+  QString path() const { return m_file.fileName(); }
+
+  void append(SessionRecording::Direction direction, const QByteArray &bytes);
+
+private:
+  QFile m_file;
+  QElapsedTimer m_clock;
+};
+
+// Feeds the received chunks of a session file back in their original
+// timing, scaled by a speed factor, or as fast as the consumer keeps up.
+class SessionReplayer : public QObject {
+  Q_OBJECT
+public:
+  explicit SessionReplayer(QObject *parent = nullptr);
+
+  bool open(const QString &path, QString *error = nullptr);
+  // speed 1 = original timing, N = N times faster, 0 = no pauses at all
+  void start(double speed);
+  void stop();
+  bool isRunning() const { return m_running; }
+
+  qint64 chunksReplayed() const { return m_chunks; }
+  qint64 bytesReplayed() const { return m_bytes; }
+
+signals:
+  void dataReceived(const QByteArray &data);
+  void finished();
+
+private:
+  bool readNext();
+  void pump();
+
+  QFile m_file;
+  QTimer m_timer;
+  QElapsedTimer m_clock;
+  double m_speed = 1.0;
+  bool m_running = false;
+
+  bool m_hasNext = false;
+  qint64 m_nextNs = 0;
+  qint64 m_baseNs = 0;
+  QByteArray m_next;
+
+  qint64 m_chunks = 0;
+  qint64 m_bytes = 0;
+};
+
+#endif // SESSIONRECORDING_H
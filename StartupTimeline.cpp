@@ -0,0 +1,63 @@
+#include "StartupTimeline.h"
+#include "Metrics.h"
+#include <QDebug>
+#include <QStringList>
+
+namespace {
+
+Metrics::Gauge &firstFrameMs = Metrics::gauge(
+    "tem_startup_first_frame_milliseconds",
+    "main() to the first frame of the main window");
+Metrics::Gauge &interactiveMs = Metrics::gauge(
+    "tem_startup_interactive_milliseconds",
+    "main() to the end of deferred initialization (project open)");
+
+} // namespace
+
+QElapsedTimer StartupTimeline::s_clock;
+QVector<StartupTimeline::Phase> StartupTimeline::s_phases;
+
+void StartupTimeline::start() {
+  s_clock.start();
+  s_phases.clear();
+  s_phases.reserve(16);
+  s_phases.append({"main", 0});
+}
+
+void StartupTimeline::mark(const char *phase) {
+  if (!s_clock.isValid())
+    return;
+  const qint64 ns = s_clock.nsecsElapsed();
+  const qint64 previous = s_phases.isEmpty() ? 0 : s_phases.last().ns;
+  s_phases.append({phase, ns});
+  qDebug().noquote() << QString("Startup: %1 ms %2 (+%3 ms)")
+                            .arg(ns / 1e6, 7, 'f', 1)
+                            .arg(phase)
+                            .arg((ns - previous) / 1e6, 0, 'f', 1);
+}
+
+void StartupTimeline::firstFrame() {
+  mark("first frame");
+  firstFrameMs.set(elapsedMs());
+}
+
+void StartupTimeline::interactive() {
+  mark("interactive");
+  interactiveMs.set(elapsedMs());
+
+  // One line for logs and bug reports
+  QStringList parts;
+  for (int i = 1; i < s_phases.size(); ++i) {
+    parts << QString("%1 %2")
+                 .arg(s_phases[i].name)
+                 .arg((s_phases[i].ns - s_phases[i - 1].ns) / 1e6, 0, 'f',
+                      1);
+  }
+  qDebug().noquote() << QString("Startup: interactive after %1 ms (%2)")
+                            .arg(elapsedMs())
+                            .arg(parts.join(", "));
+}
+
+qint64 StartupTimeline::elapsedMs() {
+  return s_clock.isValid() ? s_clock.elapsed() : 0;
+}
@@ -0,0 +1,37 @@
+#ifndef STARTUPTIMELINE_H
+#define STARTUPTIMELINE_H
+
+#include <QElapsedTimer>
+#include <QString>
+#include <QVector>
+
+// Cold-start timeline of the UI process: named phases with their time
+// since main() began, logged as they happen and summarised once the app
+// is interactive.
+//
+// The first frame and time-to-interactive are also published as gauges
+// (tem_startup_*_milliseconds), so a metrics file or the perf HUD keeps
+// track of them from run to run.
+class StartupTimeline {
+public:
+  // Call first thing in main()
+  static void start();
+  // Phase reached now; GUI thread only
+  static void mark(const char *phase);
+  // The window has shown its first frame
+  static void firstFrame();
+  // Deferred initialization is done; logs the summary
+  static void interactive();
+
+  static qint64 elapsedMs();
+
+private:
+  struct Phase {
+    const char *name;
+    qint64 ns;
+  };
+  static QElapsedTimer s_clock;
+  static QVector<Phase> s_phases;
+};
+
+#endif // STARTUPTIMELINE_H
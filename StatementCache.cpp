@@ -0,0 +1,59 @@
+#include "StatementCache.h"
+#include <QDebug>
+#include <QHash>
+#include <QMutex>
+#include <QSqlError>
+#include <memory>
+
+namespace {
+
+using QueryMap = QHash<QString, std::shared_ptr<QSqlQuery>>;
+
+struct ConnectionQueries {
+  QueryMap prepared;
+  // Last failed prepare of each SQL, kept only so the returned reference
+  // stays valid; the next call prepares again
+  QueryMap failed;
+};
+
+QMutex &cacheMutex() {
+  static QMutex mutex;
+  return mutex;
+}
+
+QHash<QString, ConnectionQueries> &cacheByConnection() {
+  static QHash<QString, ConnectionQueries> cache;
+  return cache;
+}
+
+} // namespace
+
+QSqlQuery &StatementCache::prepared(const QSqlDatabase &db,
+                                    const QString &sql) {
+  std::shared_ptr<QSqlQuery> query;
+  {
+    QMutexLocker lock(&cacheMutex());
+    ConnectionQueries &queries = cacheByConnection()[db.connectionName()];
+    query = queries.prepared.value(sql);
+    if (!query) {
+      query = std::make_shared<QSqlQuery>(db);
+      // Not cached on failure, so a table added later (a migration) is
+      // picked up by the next call
+      if (query->prepare(sql)) {
+        queries.prepared.insert(sql, query);
+        queries.failed.remove(sql);
+      } else {
+        qDebug() << "StatementCache: prepare failed" << query->lastError();
+        queries.failed.insert(sql, query);
+      }
+    }
+  }
+  // Release the previous result set; bound values are overwritten anyway
+  query->finish();
+  return *query;
+}
+
+void StatementCache::release(const QString &connectionName) {
+  QMutexLocker lock(&cacheMutex());
+  cacheByConnection().remove(connectionName);
+}
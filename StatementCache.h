@@ -0,0 +1,40 @@
+#ifndef STATEMENTCACHE_H
+#define STATEMENTCACHE_H
+
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QString>
+
+// Keeps prepared QSqlQuery objects per connection so hot statements are
+// compiled by SQLite once instead of on every call. A returned query must
+// only be used on the thread that owns the connection, and release() must
+// run before the connection is removed. A query left mid-result keeps its
+// WAL read snapshot open until the next use, so single-row reads should hold
+// a Finish guard.
+//
+// Every use of the same SQL on a connection gets the same QSqlQuery, so
+// two uses must not overlap (e.g. running it again while iterating its
+// result): the second call resets the first.
+class StatementCache {
+public:
+  // Calls finish() on a cached query when it leaves scope
+  class Finish {
+  public:
+    explicit Finish(QSqlQuery &query) : m_query(query) {}
+    ~Finish() { m_query.finish(); }
+    Finish(const Finish &) = delete;
+    Finish &operator=(const Finish &) = delete;
+
+  private:
+    QSqlQuery &m_query;
+  };
+
+  // Prepared query for sql on db, reset and ready for binding. Check
+  // lastError() if prepare failed; a failed prepare is retried next call.
+  static QSqlQuery &prepared(const QSqlDatabase &db, const QString &sql);
+
+  // Drop every cached query of a connection
+  static void release(const QString &connectionName);
+};
+
+#endif // STATEMENTCACHE_H
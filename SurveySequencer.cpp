@@ -0,0 +1,373 @@
+#include "SurveySequencer.h"
+#include "DatabaseManager.h"
+#include "Metrics.h"
+#include "WaveformCodec.h"
+#include <QDebug>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <cmath>
+
+namespace {
+
+Metrics::Counter &pointsMetric = Metrics::counter(
+    "tem_survey_points_total", "Survey points completed and saved");
+Metrics::Counter &retriesMetric = Metrics::counter(
+    "tem_survey_retries_total", "Survey points re-acquired");
+Metrics::Histogram &pointLatency = Metrics::histogram(
+    "tem_survey_point_seconds",
+    "START_COLLECT to the last frame of a survey point", 1e-9);
+Metrics::Histogram &transitionLatency = Metrics::histogram(
+    "tem_survey_transition_seconds",
+    "Last frame of one survey point to the first frame of the next", 1e-9);
+
+} // namespace
+
+SurveySequencer::SurveySequencer(AcquisitionPipeline *pipeline,
+                                 QObject *parent)
+    : QObject(parent), m_pipeline(pipeline) {
+  connect(m_pipeline, &AcquisitionPipeline::sampleReceived, this,
+          &SurveySequencer::onSample);
+  // A lost device ends the run; the interrupted point stays unsaved
+  connect(m_pipeline, &AcquisitionPipeline::stateChanged, this,
+          [this](TcpClient::ConnectionState s) {
+            if (s == TcpClient::Disconnected && isRunning())
+              stop();
+          });
+  m_pointTimer.setSingleShot(true);
+  connect(&m_pointTimer, &QTimer::timeout, this,
+          &SurveySequencer::onPointTimeout);
+}
+
+bool SurveySequencer::loadPlan(QString *error) {
+  // A running survey keeps the plan it started with
+  if (isRunning())
+    return true;
+  m_plan.clear();
+  QSqlQuery q(DatabaseManager::instance().database());
+  q.setForwardOnly(true);
+  // The sample count is served by idx_Data_Sample_PointID
+  if (!q.exec("SELECT l.ID, l.NAME, p.ID, p.NAME, "
+              "(SELECT COUNT(*) FROM Data_Sample s "
+              "WHERE s.Data_PointID = p.ID) "
+              "FROM Data_Line l JOIN Data_Point p ON p.Data_LineID = l.ID "
+              "WHERE COALESCE(l.USE, 1) <> 0 AND COALESCE(p.USE, 1) <> 0 "
+              "ORDER BY l.ID, p.ID")) {
+    if (error)
+      *error = "Survey plan: " + q.lastError().text();
+    return false;
+  }
+  while (q.next()) {
+    PlanPoint p;
+    p.lineId = q.value(0).toInt();
+    p.lineLabel = "L" + QString::number(q.value(1).toDouble(), 'f', 1);
+    p.pointId = q.value(2).toInt();
+    p.pointLabel = "P" + QString::number(q.value(3).toDouble(), 'f', 1);
+    p.storedSamples = q.value(4).toInt();
+    m_plan.append(p);
+  }
+  return true;
+}
+
+int SurveySequencer::indexOfPoint(int pointId) const {
+  for (int i = 0; i < m_plan.size(); ++i) {
+    if (m_plan[i].pointId == pointId)
+      return i;
+  }
+  return -1;
+}
+
+int SurveySequencer::indexOfPoint(int lineId,
+                                  const QString &pointLabel) const {
+  for (int i = 0; i < m_plan.size(); ++i) {
+    if ((lineId < 0 || m_plan[i].lineId == lineId) &&
+        m_plan[i].pointLabel == pointLabel)
+      return i;
+  }
+  return -1;
+}
+
+int SurveySequencer::firstUnsurveyed() const {
+  for (int i = 0; i < m_plan.size(); ++i) {
+    if (m_plan[i].storedSamples == 0)
+      return i;
+  }
+  return -1;
+}
+
+void SurveySequencer::setParams(const QVariantMap &params) {
+  m_params = params;
+  // The operator's latest word wins over what the last point recorded
+  for (auto it = params.cbegin(); it != params.cend(); ++it)
+    m_carried.remove(it.key());
+}
+
+bool SurveySequencer::start(int fromIndex) {
+  if (isRunning() || fromIndex < 0 || fromIndex >= m_plan.size())
+    return false;
+
+  m_index = fromIndex;
+  m_retries = 0;
+  m_pointsDone = m_pointsRejected = m_pointsSkipped = m_retriesTotal = 0;
+  m_transitions = 0;
+  m_transitionNs = m_pausedNs = 0;
+  m_transitionStartNs = -1;
+  // The device may have been reconfigured since the last run
+  m_sentParams.clear();
+  m_carried.clear();
+  if (m_options.carryParams && fromIndex > 0)
+    m_carried = storedParams(m_plan[fromIndex - 1].pointId);
+
+  m_clock.start();
+  beginPoint(false);
+  return true;
+}
+
+void SurveySequencer::stop() {
+  if (!isRunning())
+    return;
+  m_pointTimer.stop();
+  m_frames.clear();
+  setState(Idle);
+  emit finished();
+}
+
+void SurveySequencer::skip() {
+  if (!isRunning())
+    return;
+  m_pointTimer.stop();
+  m_frames.clear();
+  ++m_pointsSkipped;
+  m_transitionStartNs = -1;
+  if (++m_index < m_plan.size()) {
+    m_retries = 0;
+    beginPoint(true);
+  } else {
+    setState(Idle);
+    emit finished();
+  }
+}
+
+void SurveySequencer::retry() {
+  if (!isRunning())
+    return;
+  m_pointTimer.stop();
+  ++m_retriesTotal;
+  retriesMetric.add();
+  beginPoint(false);
+}
+
+void SurveySequencer::accept() {
+  if (m_state != Paused)
+    return;
+  completePoint(false);
+}
+
+void SurveySequencer::beginPoint(bool advance) {
+  setState(Collecting);
+  m_frames.clear();
+  m_frames.reserve(m_options.framesPerPoint);
+
+  // One burst, no waiting for the replies: the device works through the
+  // commands in order while we persist the point it just finished
+  if (advance)
+    m_pipeline->nextPoint();
+  const QVariantMap params = paramsFor();
+  if (!params.isEmpty() && params != m_sentParams) {
+    m_pipeline->sendParams(params);
+    m_sentParams = params;
+  }
+  m_pipeline->startCollect();
+
+  m_pointClock.start();
+  m_pointTimer.start(m_options.pointTimeoutMs);
+  emit pointStarted(m_index);
+}
+
+void SurveySequencer::onSample() {
+  if (m_state != Collecting)
+    return;
+  // Points are checked and saved at full resolution; on_demand devices
+  // send it only when asked
+  const AcquisitionPipeline::Sample &latest = m_pipeline->latestSample();
+  if (latest.preview) {
+    if (m_pipeline->transferMode() == AcquisitionPipeline::OnDemandTransfer)
+      m_pipeline->requestFullFrame(latest.frameId);
+    return;
+  }
+  if (m_frames.isEmpty() && m_transitionStartNs >= 0) {
+    const qint64 ns = m_clock.nsecsElapsed() - m_transitionStartNs;
+    transitionLatency.record(ns);
+    m_transitionNs += ns;
+    ++m_transitions;
+    m_transitionStartNs = -1;
+  }
+
+  // A shared copy: the pooled slot stays ours until the point is saved
+  m_frames.append(latest);
+  emit frameCollected(m_index, m_frames.size());
+  if (m_frames.size() < m_options.framesPerPoint)
+    return;
+
+  m_pointTimer.stop();
+  pointLatency.record(m_pointClock.nsecsElapsed());
+  const QString reason = checkQuality(m_frames);
+  if (reason.isEmpty())
+    completePoint(true);
+  else
+    reject(reason);
+}
+
+void SurveySequencer::onPointTimeout() {
+  reject(QString("timed out after %1 of %2 frame(s)")
+             .arg(m_frames.size())
+             .arg(m_options.framesPerPoint));
+}
+
+void SurveySequencer::reject(const QString &reason) {
+  const bool retrying = m_retries < m_options.maxRetries;
+  emit pointRejected(m_index, reason, retrying);
+  if (retrying) {
+    ++m_retries;
+    retry();
+    return;
+  }
+  // Up to the operator: retry(), skip() or accept()
+  m_pauseClock.start();
+  setState(Paused);
+}
+
+void SurveySequencer::completePoint(bool qualified) {
+  // Take the frames and launch the next point before saving this one
+  QVector<AcquisitionPipeline::Sample> frames;
+  frames.swap(m_frames);
+  const int doneIndex = m_index;
+  const int pointId = m_plan[doneIndex].pointId;
+  if (!frames.isEmpty() && m_options.carryParams)
+    carryFrom(frames.last());
+
+  ++m_pointsDone;
+  if (!qualified)
+    ++m_pointsRejected;
+  pointsMetric.add();
+  m_retries = 0;
+  m_transitionStartNs = m_clock.nsecsElapsed();
+
+  const bool last = ++m_index >= m_plan.size();
+  if (!last)
+    beginPoint(true);
+
+  int saved = 0;
+  for (const AcquisitionPipeline::Sample &s : std::as_const(frames)) {
+    if (m_pipeline->persist(s, s.meta, pointId))
+      ++saved;
+  }
+  m_plan[doneIndex].storedSamples += saved;
+  emit pointCompleted(doneIndex, saved, qualified);
+
+  if (last) {
+    m_transitionStartNs = -1;
+    setState(Idle);
+    emit finished();
+  }
+}
+
+void SurveySequencer::setState(State state) {
+  if (m_state == Paused && state != Paused)
+    m_pausedNs += m_pauseClock.nsecsElapsed();
+  if (m_state == state)
+    return;
+  m_state = state;
+  emit stateChanged();
+}
+
+QVariantMap SurveySequencer::paramsFor() const {
+  QVariantMap params = m_params;
+  for (auto it = m_carried.cbegin(); it != m_carried.cend(); ++it)
+    params.insert(it.key(), it.value());
+  return params;
+}
+
+void SurveySequencer::carryFrom(const AcquisitionPipeline::Sample &sample) {
+  // What the device actually recorded; the same values the writer stores
+  const int recvFs = sample.rate(ChannelRegistry::Recv);
+  const QVector<double> &recv = sample.channel(ChannelRegistry::Recv);
+  if (recvFs > 0)
+    m_carried.insert("sample_rate", recvFs);
+  if (!recv.isEmpty())
+    m_carried.insert("sample_time", int(recv.size()));
+}
+
+QVariantMap SurveySequencer::stats() const {
+  QVariantMap s;
+  const double elapsed = m_clock.isValid() ? m_clock.nsecsElapsed() / 1e9 : 0;
+  double paused = m_pausedNs / 1e9;
+  if (m_state == Paused)
+    paused += m_pauseClock.nsecsElapsed() / 1e9;
+  const double active = qMax(0.0, elapsed - paused);
+  const int remaining =
+      m_index < 0 ? m_plan.size() : qMax(0, int(m_plan.size()) - m_index);
+
+  s["index"] = m_index;
+  s["total"] = m_plan.size();
+  s["pointsDone"] = m_pointsDone;
+  s["pointsRejected"] = m_pointsRejected;
+  s["pointsSkipped"] = m_pointsSkipped;
+  s["retries"] = m_retriesTotal;
+  s["remaining"] = remaining;
+  s["elapsedS"] = elapsed;
+  s["pausedS"] = paused;
+  s["pointsPerHour"] = elapsed > 0 ? m_pointsDone * 3600.0 / elapsed : 0.0;
+  // Average cycle over the time actually spent acquiring
+  const double cycle = m_pointsDone > 0 ? active / m_pointsDone : 0.0;
+  s["meanCycleS"] = cycle;
+  s["meanTransitionS"] =
+      m_transitions > 0 ? m_transitionNs / 1e9 / m_transitions : 0.0;
+  s["remainingS"] = cycle * remaining;
+  return s;
+}
+
+QVariantMap SurveySequencer::storedParams(int pointId) {
+  QVariantMap params;
+  QSqlQuery q(DatabaseManager::instance().database());
+  q.prepare("SELECT DATA_RECV, RecvFs FROM Data_Sample "
+            "WHERE Data_PointID = ? ORDER BY ID DESC LIMIT 1");
+  q.addBindValue(pointId);
+  if (!q.exec()) {
+    qWarning() << "SurveySequencer: stored params of point" << pointId
+               << q.lastError().text();
+    return params;
+  }
+  if (!q.next())
+    return params;
+
+  const int values = WaveformCodec::decode(q.value(0)).size();
+  const double recvFs = q.value(1).toDouble();
+  if (recvFs > 0)
+    params["sample_rate"] = int(recvFs);
+  if (values > 0)
+    params["sample_time"] = values;
+  return params;
+}
+
+QString
+SurveySequencer::checkQuality(const QVector<AcquisitionPipeline::Sample> &f) {
+  if (f.isEmpty())
+    return "no frames";
+  const qsizetype length = f.first().channel(ChannelRegistry::Recv).size();
+  for (int i = 0; i < f.size(); ++i) {
+    const QVector<double> &recv = f[i].channel(ChannelRegistry::Recv);
+    if (recv.isEmpty())
+      return QString("frame %1 has no receive data").arg(i + 1);
+    // Stacked frames of one point must line up
+    if (recv.size() != length)
+      return QString("frame %1 has %2 values, frame 1 has %3")
+          .arg(i + 1)
+          .arg(recv.size())
+          .arg(length);
+    for (double v : recv) {
+      if (!std::isfinite(v))
+        return QString("frame %1 has non-finite values").arg(i + 1);
+    }
+  }
+  return QString();
+}
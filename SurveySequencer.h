@@ -0,0 +1,136 @@
+#ifndef SURVEYSEQUENCER_H
+#define SURVEYSEQUENCER_H
+
+#include "AcquisitionPipeline.h"
+#include <QElapsedTimer>
+#include <QObject>
+#include <QString>
+#include <QTimer>
+#include <QVariantMap>
+#include <QVector>
+
+// Walks the survey plan (Data_Line / Data_Point, in order) point by point:
+// START_COLLECT, wait for the point's frames, check them, save them, and
+// move on to the next point without the operator.
+//
+// Transitions are pipelined: when a point completes, NEXT_POINT, SET_PARAMS
+// (only if they changed) and START_COLLECT for the next point go out in one
+// burst first, and the finished point is persisted afterwards, so encoding
+// and the writer's commit overlap with the device's next acquisition.
+//
+// Each point is acquired with the parameters the previous point's samples
+// were recorded with (sample rate and record length), over the base
+// parameters set by the operator.
+//
+// Only full-resolution frames count towards a point. Previews are left to
+// the charts; in on_demand transfer each one is answered with GET_FRAME.
+class SurveySequencer : public QObject {
+  Q_OBJECT
+public:
+  struct PlanPoint {
+    int lineId;
+    int pointId;
+    QString lineLabel;  // "L1.0", as in the project tree
+    QString pointLabel; // "P4.0"
+    int storedSamples;  // Data_Sample rows when the plan was loaded
+  };
+
+  enum State { Idle, Collecting, Paused };
+
+  struct Options {
+    int framesPerPoint = 3; // frames that complete a point
+    int pointTimeoutMs = 30000;
+    int maxRetries = 1; // automatic re-acquisitions before pausing
+    bool carryParams = true;
+  };
+
+  explicit SurveySequencer(AcquisitionPipeline *pipeline,
+                           QObject *parent = nullptr);
+
+  // Points of the open project with USE set, lines and points in ID order.
+  // Kept as is while a survey runs.
+  bool loadPlan(QString *error = nullptr);
+  const QVector<PlanPoint> &plan() const { return m_plan; }
+  // Point labels repeat on every line, so a point is found by its
+  // Data_Point.ID, or by its label on a given line (-1: any line)
+  int indexOfPoint(int pointId) const;
+  int indexOfPoint(int lineId, const QString &pointLabel) const;
+  // First point without stored samples, or -1
+  int firstUnsurveyed() const;
+
+  void setOptions(const Options &options) { m_options = options; }
+  const Options &options() const { return m_options; }
+  // Operator parameters (send_current, stack_count, ...). Values carried
+  // from the previous point give way to a change made mid-survey.
+  void setParams(const QVariantMap &params);
+
+  State state() const { return m_state; }
+  bool isRunning() const { return m_state != Idle; }
+  int currentIndex() const { return m_index; }
+  int framesCollected() const { return m_frames.size(); }
+
+  bool start(int fromIndex = 0);
+  void stop();
+  // Leave the current point unsaved and go to the next one
+  void skip();
+  // Re-acquire the current point
+  void retry();
+  // Paused on a rejected point: save what it got and go on
+  void accept();
+
+  // Throughput of the running (or last) survey, for the UI and logs
+  QVariantMap stats() const;
+
+  // Acquisition parameters recorded with the last sample of a point:
+  // sample_rate (RecvFs) and sample_time (values per record). Empty if
+  // the point has no samples.
+  static QVariantMap storedParams(int pointId);
+
+  // Why the frames of a point are unusable, or an empty string
+  static QString checkQuality(const QVector<AcquisitionPipeline::Sample> &f);
+
+signals:
+  void pointStarted(int index);
+  void frameCollected(int index, int frames);
+  void pointCompleted(int index, int saved, bool qualified);
+  void pointRejected(int index, const QString &reason, bool retrying);
+  void stateChanged();
+  void finished();
+
+private:
+  void onSample();
+  void onPointTimeout();
+  void beginPoint(bool advance);
+  void completePoint(bool qualified);
+  void reject(const QString &reason);
+  void setState(State state);
+  QVariantMap paramsFor() const;
+  void carryFrom(const AcquisitionPipeline::Sample &sample);
+
+  AcquisitionPipeline *m_pipeline;
+  Options m_options;
+  QVector<PlanPoint> m_plan;
+  State m_state = Idle;
+  int m_index = -1;
+  int m_retries = 0; // of the current point
+
+  QVector<AcquisitionPipeline::Sample> m_frames;
+  QVariantMap m_params;
+  QVariantMap m_carried;
+  QVariantMap m_sentParams;
+
+  QTimer m_pointTimer;
+  QElapsedTimer m_clock;      // since start()
+  QElapsedTimer m_pointClock; // since this point's START_COLLECT
+  QElapsedTimer m_pauseClock;
+  qint64 m_transitionStartNs = -1; // m_clock time the last point completed
+  qint64 m_pausedNs = 0;
+  qint64 m_transitionNs = 0;
+  int m_transitions = 0;
+  int m_pointsDone = 0;
+  int m_pointsRejected = 0; // accepted although they failed the check
+  int m_pointsSkipped = 0;
+  int m_retriesTotal = 0;
+};
+
+#endif // SURVEYSEQUENCER_H
@@ -0,0 +1,78 @@
+#include "SurveyTimeline.h"
+#include "ConnectionManager.h"
+#include "ProjectArchive.h"
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <algorithm>
+
+bool SurveyTimeline::load(const QString &dbPath, QString *error) {
+  clear();
+  QSqlDatabase db =
+      ConnectionManager::connection(dbPath, ConnectionManager::ReadOnly);
+  if (!db.isOpen()) {
+    if (error)
+      *error = "Timeline connection failed: " + db.lastError().text();
+    return false;
+  }
+
+  QSqlQuery q(db);
+  q.setForwardOnly(true);
+  // Served by idx_Data_Sample_StartTime on migrated projects
+  if (!q.exec("SELECT StartTime, ID, Data_PointID FROM Data_Sample "
+              "ORDER BY StartTime, ID")) {
+    if (error)
+      *error = "Timeline: " + q.lastError().text();
+    return false;
+  }
+  while (q.next()) {
+    Frame f;
+    f.startMs = q.value(0).toLongLong();
+    f.sampleId = q.value(1).toInt();
+    f.pointId = q.value(2).toInt();
+    f.archiveRow = -1;
+    m_frames.append(f);
+  }
+  finish();
+  return true;
+}
+
+void SurveyTimeline::loadFromArchive(const ProjectArchive &archive) {
+  clear();
+  for (int p = 0; p < archive.pointCount(); ++p) {
+    const ProjectArchive::PointEntry &point = archive.point(p);
+    for (quint32 k = 0; k < point.sampleCount; ++k) {
+      const int row = int(point.firstSample + k);
+      const ProjectArchive::SampleEntry &s = archive.sample(row);
+      m_frames.append({s.startTime, s.id, s.pointId, row});
+    }
+  }
+  // The archive orders samples by point; the timeline wants time
+  std::sort(m_frames.begin(), m_frames.end(),
+            [](const Frame &a, const Frame &b) {
+              return a.startMs < b.startMs ||
+                     (a.startMs == b.startMs && a.sampleId < b.sampleId);
+            });
+  finish();
+}
+
+void SurveyTimeline::clear() {
+  m_frames.clear();
+  m_indexOfSample.clear();
+}
+
+void SurveyTimeline::finish() {
+  m_frames.squeeze();
+  m_indexOfSample.reserve(m_frames.size());
+  for (int i = 0; i < m_frames.size(); ++i)
+    m_indexOfSample.insert(m_frames[i].sampleId, i);
+}
+
+int SurveyTimeline::indexAt(qint64 ms) const {
+  if (m_frames.isEmpty())
+    return -1;
+  const auto it = std::upper_bound(
+      m_frames.cbegin(), m_frames.cend(), ms,
+      [](qint64 t, const Frame &f) { return t < f.startMs; });
+  return qMax(0, int(it - m_frames.cbegin()) - 1);
+}
@@ -0,0 +1,48 @@
+#ifndef SURVEYTIMELINE_H
+#define SURVEYTIMELINE_H
+
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+class ProjectArchive;
+
+// Every sample of a project ordered by StartTime, for survey-wide playback.
+//
+// Only row metadata is read (no waveform columns), so even a long survey
+// indexes in one quick pass; waveforms are decoded when a frame is shown.
+// Seeking to a moment is a binary search over the sorted start times.
+class SurveyTimeline {
+public:
+  struct Frame {
+    qint64 startMs; // StartTime, ms since epoch
+    qint32 sampleId;
+    qint32 pointId;
+    qint32 archiveRow; // row in the archive sample table, -1 for SQLite
+  };
+
+  // Read on the calling thread with its read-only connection
+  bool load(const QString &dbPath, QString *error = nullptr);
+  void loadFromArchive(const ProjectArchive &archive);
+  void clear();
+
+  bool isEmpty() const { return m_frames.isEmpty(); }
+  int count() const { return m_frames.size(); }
+  const Frame &frame(int index) const { return m_frames[index]; }
+  qint64 startMs() const { return isEmpty() ? 0 : m_frames.first().startMs; }
+  qint64 endMs() const { return isEmpty() ? 0 : m_frames.last().startMs; }
+
+  // Last frame starting at or before ms (the first frame before the start)
+  int indexAt(qint64 ms) const;
+  int indexOfSample(int sampleId) const {
+    return m_indexOfSample.value(sampleId, -1);
+  }
+
+private:
+  void finish();
+
+  QVector<Frame> m_frames;
+  QHash<int, int> m_indexOfSample;
+};
+
+#endif // SURVEYTIMELINE_H
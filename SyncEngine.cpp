@@ -0,0 +1,339 @@
+#include "SyncEngine.h"
+#include "ChannelRegistry.h"
+#include "ConnectionManager.h"
+#include "StatementCache.h"
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDebug>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QtEndian>
+
+namespace {
+
+// 2: every ChannelRegistry column per sample, not only recv/send/off
+const int kBatchFormat = 2;
+
+const char *kFields[] = {"ID",           "Data_PointID", "Data_LineID",
+                         "StartTime",    "DeviceType",   "PERIOD",
+                         "RecvFs",       "SendFs",       "SampleOffFs",
+                         "SampleSendFs", "TYPE",         "USE",
+                         "NOTE"};
+const int kFieldCount = int(sizeof(kFields) / sizeof(kFields[0]));
+
+// Fields, then the registry's waveform columns, then the stored hash
+QString batchSelect() {
+  QStringList cols;
+  for (const char *field : kFields)
+    cols << (qstrcmp(field, "Data_LineID") == 0 ? "p." : "s.") +
+                QString::fromLatin1(field);
+  for (const QString &column : ChannelRegistry::columns())
+    cols << "s." + column;
+  cols << "ss.Hash";
+  return "SELECT " + cols.join(", ") +
+         " FROM Data_Sample s "
+         "LEFT JOIN Data_Point p ON p.ID = s.Data_PointID "
+         "LEFT JOIN Sync_Sample ss "
+         "ON ss.Endpoint = ? AND ss.SampleID = s.ID "
+         "WHERE s.ID > ? ORDER BY s.ID LIMIT ?";
+}
+
+// Stable across runs (qHash is seeded per process)
+qint64 contentHash(const QByteArray &canonical) {
+  const QByteArray digest =
+      QCryptographicHash::hash(canonical, QCryptographicHash::Sha1);
+  return qFromBigEndian<qint64>(digest.constData());
+}
+
+} // namespace
+
+SyncEngine::SyncEngine(QObject *parent) : QObject(parent) {
+  // Parented so moveToThread() carries the timer along with the engine
+  m_pollTimer = new QTimer(this);
+  m_pollTimer->setInterval(5000);
+  connect(m_pollTimer, &QTimer::timeout, this, &SyncEngine::pump);
+
+  m_pokeTimer = new QTimer(this);
+  m_pokeTimer->setSingleShot(true);
+  m_pokeTimer->setInterval(500);
+  connect(m_pokeTimer, &QTimer::timeout, this, &SyncEngine::pump);
+}
+
+SyncEngine::~SyncEngine() { stop(); }
+
+void SyncEngine::start(const QString &dbPath, const QUrl &endpoint) {
+  stop();
+
+  m_dbPath = dbPath;
+  m_db = ConnectionManager::connection(dbPath);
+  if (!m_db.isOpen()) {
+    emit syncError("Sync connection failed: " + m_db.lastError().text());
+    return;
+  }
+  m_endpoint = endpoint;
+  m_endpointKey = endpoint.toString(QUrl::RemoveUserInfo);
+
+  // Resume from the last checkpoint for this endpoint
+  QSqlQuery q(m_db);
+  q.prepare("INSERT OR IGNORE INTO Sync_Checkpoint (Endpoint, Watermark, "
+            "UpdatedAt) VALUES (?, 0, ?)");
+  q.addBindValue(m_endpointKey);
+  q.addBindValue(QDateTime::currentMSecsSinceEpoch());
+  q.exec();
+  q.prepare("SELECT Watermark FROM Sync_Checkpoint WHERE Endpoint = ?");
+  q.addBindValue(m_endpointKey);
+  m_watermark = q.exec() && q.next() ? q.value(0).toLongLong() : 0;
+  m_readCursor = m_watermark;
+
+  if (!m_nam)
+    m_nam = new QNetworkAccessManager(this);
+
+  m_running = true;
+  m_pollTimer->start();
+  qDebug() << "SyncEngine: syncing to" << m_endpointKey << "from sample"
+           << m_watermark;
+  pump();
+}
+
+void SyncEngine::stop() {
+  const bool wasRunning = m_running;
+  m_running = false;
+  m_pollTimer->stop();
+  m_pokeTimer->stop();
+  if (m_nam) {
+    const auto replies = m_nam->findChildren<QNetworkReply *>();
+    for (QNetworkReply *reply : replies) {
+      reply->disconnect(this);
+      reply->abort();
+      reply->deleteLater();
+    }
+  }
+  // Unacknowledged batches are simply re-read after the next start
+  m_batches.clear();
+  if (m_db.isValid()) {
+    m_db = QSqlDatabase();
+    ConnectionManager::release(m_dbPath);
+  }
+  if (wasRunning)
+    emit stopped();
+}
+
+void SyncEngine::poke() {
+  // Coalesce the per-sample notifications of one writer commit
+  if (m_running && !m_pokeTimer->isActive())
+    m_pokeTimer->start();
+}
+
+void SyncEngine::pump() {
+  if (!m_running)
+    return;
+  // A checkpoint that failed to commit
+  if (!m_batches.isEmpty() && m_batches.first().acked)
+    commitAcked();
+
+  // Batches waiting for an ack or a retry all count toward the window, so
+  // an unreachable server never makes the backlog grow in memory
+  while (m_batches.size() < m_maxInFlight) {
+    Batch batch;
+    if (!buildBatch(batch))
+      break;
+    const qint64 firstId = batch.firstId;
+    const bool unchanged = batch.body.isEmpty();
+    batch.acked = unchanged;
+    m_batches.insert(firstId, batch);
+    if (unchanged)
+      commitAcked();
+    else
+      send(firstId);
+  }
+  emit progress(m_watermark, pendingCount());
+}
+
+bool SyncEngine::buildBatch(Batch &batch) {
+  static const QString sql = batchSelect();
+  QSqlQuery &q = StatementCache::prepared(m_db, sql);
+  q.setForwardOnly(true);
+  q.addBindValue(m_endpointKey);
+  q.addBindValue(m_readCursor);
+  q.addBindValue(m_batchSize);
+  if (!q.exec()) {
+    emit syncError("Sync read failed: " + q.lastError().text());
+    return false;
+  }
+
+  const QStringList &columns = ChannelRegistry::columns();
+  const int hashField = kFieldCount + columns.size();
+  QJsonArray samples;
+  bool any = false;
+  while (q.next()) {
+    const qint64 id = q.value(0).toLongLong();
+    if (!any)
+      batch.firstId = id;
+    any = true;
+    batch.lastId = id;
+
+    QJsonObject obj;
+    for (int i = 0; i < kFieldCount; ++i)
+      obj.insert(kFields[i], QJsonValue::fromVariant(q.value(i)));
+    // Sent as stored: legacy base64 text, or a codec BLOB wrapped as base64
+    for (int c = 0; c < columns.size(); ++c) {
+      const QVariant v = q.value(kFieldCount + c);
+      if (v.typeId() == QMetaType::QByteArray)
+        obj.insert(columns[c],
+                   QJsonObject{{"blob", QString::fromLatin1(
+                                            v.toByteArray().toBase64())}});
+      else
+        obj.insert(columns[c], v.toString());
+    }
+
+    const qint64 hash =
+        contentHash(QJsonDocument(obj).toJson(QJsonDocument::Compact));
+    if (!q.isNull(hashField) && q.value(hashField).toLongLong() == hash)
+      continue; // the server already has exactly this row
+    batch.hashes.append({id, hash});
+    samples.append(obj);
+    ++batch.rows;
+  }
+  if (!any)
+    return false; // nothing above the cursor
+
+  m_readCursor = batch.lastId;
+  if (!samples.isEmpty()) {
+    QJsonObject doc{{"format", kBatchFormat},
+                    {"endpoint", m_endpointKey},
+                    {"firstId", batch.firstId},
+                    {"lastId", batch.lastId},
+                    {"samples", samples}};
+    batch.body = qCompress(QJsonDocument(doc).toJson(QJsonDocument::Compact));
+  }
+  return true;
+}
+
+void SyncEngine::send(qint64 firstId) {
+  auto it = m_batches.find(firstId);
+  if (it == m_batches.end())
+    return;
+
+  QNetworkRequest req(m_endpoint);
+  req.setHeader(QNetworkRequest::ContentTypeHeader,
+                "application/octet-stream");
+  // qCompress framing: 4-byte big-endian length, then a zlib stream
+  req.setRawHeader("X-TEM-Encoding", "qcompress");
+  req.setRawHeader("X-TEM-Batch",
+                   QByteArray::number(it->firstId) + "-" +
+                       QByteArray::number(it->lastId));
+  req.setTransferTimeout(30000);
+
+  ++it->attempts;
+  QNetworkReply *reply = m_nam->post(req, it->body);
+  connect(reply, &QNetworkReply::finished, this,
+          [this, firstId, reply]() { onReply(firstId, reply); });
+}
+
+void SyncEngine::onReply(qint64 firstId, QNetworkReply *reply) {
+  reply->deleteLater();
+  auto it = m_batches.find(firstId);
+  if (!m_running || it == m_batches.end())
+    return;
+
+  const int status =
+      reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+  if (reply->error() != QNetworkReply::NoError || status < 200 ||
+      status >= 300) {
+    emit syncError(QString("Sync batch %1-%2 failed: %3")
+                       .arg(it->firstId)
+                       .arg(it->lastId)
+                       .arg(reply->errorString()));
+    scheduleRetry(firstId);
+    return;
+  }
+
+  it->acked = true;
+  emit batchUploaded(it->firstId, it->lastId, it->rows, it->body.size());
+  it->body.clear();
+  commitAcked();
+  pump();
+}
+
+void SyncEngine::commitAcked() {
+  if (!m_db.transaction()) {
+    emit syncError("Sync checkpoint failed: " + m_db.lastError().text());
+    return;
+  }
+
+  bool ok = true;
+  QSqlQuery &mark = StatementCache::prepared(
+      m_db, "INSERT OR REPLACE INTO Sync_Sample (Endpoint, SampleID, Hash) "
+            "VALUES (?, ?, ?)");
+  // Hashes of every acknowledged batch, even one ahead of a gap: after a
+  // restart those rows are re-read above the watermark and skipped
+  for (auto it = m_batches.begin(); it != m_batches.end() && ok; ++it) {
+    if (!it->acked)
+      continue;
+    for (const auto &h : std::as_const(it->hashes)) {
+      mark.bindValue(0, m_endpointKey);
+      mark.bindValue(1, h.first);
+      mark.bindValue(2, h.second);
+      ok = mark.exec();
+      if (!ok)
+        break;
+    }
+  }
+
+  // The watermark only moves over a contiguous run of acknowledged batches
+  qint64 watermark = m_watermark;
+  int contiguous = 0;
+  for (auto it = m_batches.cbegin(); it != m_batches.cend() && it->acked;
+       ++it, ++contiguous)
+    watermark = it->lastId;
+  if (ok && watermark != m_watermark) {
+    QSqlQuery &cp = StatementCache::prepared(
+        m_db, "UPDATE Sync_Checkpoint SET Watermark = ?, UpdatedAt = ? "
+              "WHERE Endpoint = ?");
+    cp.addBindValue(watermark);
+    cp.addBindValue(QDateTime::currentMSecsSinceEpoch());
+    cp.addBindValue(m_endpointKey);
+    ok = cp.exec();
+  }
+
+  // Batches are only dropped once committed: the read cursor is already
+  // past their rows, so pump() retries the checkpoint instead
+  if (!ok || !m_db.commit()) {
+    emit syncError("Sync checkpoint failed: " + m_db.lastError().text());
+    m_db.rollback();
+    return;
+  }
+  for (Batch &b : m_batches) {
+    if (b.acked)
+      b.hashes.clear();
+  }
+  while (contiguous-- > 0)
+    m_batches.erase(m_batches.begin());
+  m_watermark = watermark;
+}
+
+void SyncEngine::scheduleRetry(qint64 firstId) {
+  auto it = m_batches.find(firstId);
+  if (it == m_batches.end())
+    return;
+  // Exponential backoff, capped at a minute
+  const int delayMs = qMin(60000, 1000 << qMin(it->attempts, 6));
+  QTimer::singleShot(delayMs, this, [this, firstId]() {
+    if (m_running)
+      send(firstId);
+  });
+}
+
+qint64 SyncEngine::pendingCount() {
+  QSqlQuery &q = StatementCache::prepared(
+      m_db, "SELECT COUNT(*) FROM Data_Sample WHERE ID > ?");
+  const StatementCache::Finish finish(q);
+  q.addBindValue(m_watermark);
+  return q.exec() && q.next() ? q.value(0).toLongLong() : 0;
+}
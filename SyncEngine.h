@@ -0,0 +1,83 @@
+#ifndef SYNCENGINE_H
+#define SYNCENGINE_H
+
+#include <QByteArray>
+#include <QList>
+#include <QMap>
+#include <QObject>
+#include <QPair>
+#include <QSqlDatabase>
+#include <QString>
+#include <QTimer>
+#include <QUrl>
+
+class QNetworkAccessManager;
+class QNetworkReply;
+
+// Background uploader of Data_Sample rows to a collection server.
+//
+// Lives on its own thread with its own connection and network manager.
+// Rows above the endpoint's watermark are read in ID order, packed into
+// qCompress'ed JSON batches and POSTed with several batches in flight.
+// Acknowledged batches advance the watermark in order, so an interrupted
+// sync resumes from the last checkpoint; rows whose content hash matches
+// what was last sent are skipped.
+class SyncEngine : public QObject {
+  Q_OBJECT
+public:
+  explicit SyncEngine(QObject *parent = nullptr);
+  ~SyncEngine();
+
+  void setBatchSize(int rows) { m_batchSize = qMax(1, rows); }
+  void setMaxInFlight(int batches) { m_maxInFlight = qMax(1, batches); }
+
+public slots:
+  // All slots run on the sync thread
+  void start(const QString &dbPath, const QUrl &endpoint);
+  void stop();
+  // New rows were committed; upload soon rather than at the next poll
+  void poke();
+
+signals:
+  void progress(qint64 watermark, qint64 pending);
+  void batchUploaded(qint64 firstId, qint64 lastId, int rows, qint64 bytes);
+  void syncError(const QString &errorStr);
+  void stopped();
+
+private:
+  struct Batch {
+    qint64 firstId = 0;
+    qint64 lastId = 0;
+    QByteArray body; // compressed; empty when every row was unchanged
+    QList<QPair<qint64, qint64>> hashes; // (sample ID, hash) sent
+    int rows = 0;
+    int attempts = 0;
+    bool acked = false;
+  };
+
+  void pump();
+  bool buildBatch(Batch &batch);
+  void send(qint64 firstId);
+  void onReply(qint64 firstId, QNetworkReply *reply);
+  void commitAcked();
+  void scheduleRetry(qint64 firstId);
+  qint64 pendingCount();
+
+  QSqlDatabase m_db;
+  QString m_dbPath;
+  QUrl m_endpoint;
+  QString m_endpointKey;
+  QNetworkAccessManager *m_nam = nullptr;
+  QTimer *m_pollTimer = nullptr;
+  QTimer *m_pokeTimer = nullptr;
+
+  // Keyed by first sample ID; ordered so the watermark advances in order
+  QMap<qint64, Batch> m_batches;
+  qint64 m_watermark = 0; // everything <= is acknowledged
+  qint64 m_readCursor = 0; // highest ID handed to a batch
+  int m_batchSize = 200;
+  int m_maxInFlight = 4;
+  bool m_running = false;
+};
+
+#endif // SYNCENGINE_H
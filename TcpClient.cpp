@@ -1,6 +1,19 @@
 #include "TcpClient.h"
+#include "Metrics.h"
 #include <QDebug>
 
+namespace {
+
+// Socket traffic only; a replayed session bypasses these
+Metrics::Counter &bytesReceived = Metrics::counter(
+    "tem_tcp_received_bytes_total", "Bytes read from the device socket");
+Metrics::Counter &reads =
+    Metrics::counter("tem_tcp_reads_total", "readyRead drains of the socket");
+Metrics::Counter &bytesSent = Metrics::counter(
+    "tem_tcp_sent_bytes_total", "Command bytes written to the device");
+
+} // namespace
+
 TcpClient::TcpClient(QObject *parent) : QObject(parent), m_state(Disconnected) {
   m_socket = new QTcpSocket(this);
   m_timeoutTimer = new QTimer(this);
@@ -43,6 +56,11 @@ void TcpClient::connectToServer(const QString &ip, quint16 port,
 }
 
 void TcpClient::disconnectFromServer() {
+  if (isReplaying()) {
+    m_replayer->stop();
+    setState(Disconnected);
+    return;
+  }
   if (m_socket->state() != QAbstractSocket::UnconnectedState) {
     m_socket->disconnectFromHost();
   } else {
@@ -54,6 +72,10 @@ bool TcpClient::sendData(const QByteArray &data) {
   if (m_state != Connected) {
     return false;
   }
+  if (isReplaying())
+    return true; // the recording already holds the device's answers
+  m_recorder.append(SessionRecording::Sent, data);
+  bytesSent.add(data.size());
   m_socket->write(data);
   return m_socket->flush();
 }
@@ -78,8 +100,46 @@ void TcpClient::onDisconnected() {
 }
 
 void TcpClient::onReadyRead() {
-  QByteArray data = m_socket->readAll();
-  emit dataReceived(data);
+  // One buffer for every read; a receiver that keeps a copy shares it and
+  // only then does the next read allocate
+  m_readBuffer.resize(m_socket->bytesAvailable());
+  const qint64 n = m_socket->read(m_readBuffer.data(), m_readBuffer.size());
+  m_readBuffer.resize(qMax<qint64>(0, n));
+  if (m_readBuffer.isEmpty())
+    return;
+  bytesReceived.add(m_readBuffer.size());
+  reads.add();
+  m_recorder.append(SessionRecording::Received, m_readBuffer);
+  emit dataReceived(m_readBuffer);
+}
+
+bool TcpClient::startRecording(const QString &path, QString *error) {
+  return m_recorder.open(path, error);
+}
+
+void TcpClient::stopRecording() { m_recorder.close(); }
+
+bool TcpClient::startReplay(const QString &path, double speed,
+                            QString *error) {
+  // Drop any live link synchronously so its disconnect cannot end the replay
+  if (isReplaying())
+    m_replayer->stop();
+  m_timeoutTimer->stop();
+  m_socket->abort();
+  setState(Disconnected);
+  if (!m_replayer) {
+    m_replayer = new SessionReplayer(this);
+    connect(m_replayer, &SessionReplayer::dataReceived, this,
+            &TcpClient::dataReceived);
+    connect(m_replayer, &SessionReplayer::finished, this,
+            [this]() { setState(Disconnected); });
+  }
+  if (!m_replayer->open(path, error))
+    return false;
+  qDebug() << "TcpClient replaying" << path << "at" << speed << "x";
+  setState(Connected);
+  m_replayer->start(speed);
+  return true;
 }
 
 void TcpClient::onError(QAbstractSocket::SocketError socketError) {
@@ -1,6 +1,7 @@
 #ifndef TCPCLIENT_H
 #define TCPCLIENT_H
 
+#include "SessionRecording.h"
 #include <QObject>
 #include <QTcpSocket>
 #include <QTimer>
@@ -20,6 +21,18 @@ public:
 
   ConnectionState state() const { return m_state; }
 
+  // Record every chunk read from (and written to) the socket, timestamped
+  bool startRecording(const QString &path, QString *error = nullptr);
+  void stopRecording();
+  bool isRecording() const { return m_recorder.isOpen(); }
+
+  // Play a recorded session instead of a device: Connected, its received
+  // bytes at speed x original timing (0 = as fast as possible), then
+  // Disconnected. Commands sent meanwhile are dropped.
+  bool startReplay(const QString &path, double speed = 1.0,
+                   QString *error = nullptr);
+  bool isReplaying() const { return m_replayer && m_replayer->isRunning(); }
+
 signals:
   void stateChanged(TcpClient::ConnectionState newState);
   void dataReceived(const QByteArray &data);
@@ -38,6 +51,9 @@ private:
   QTcpSocket *m_socket;
   QTimer *m_timeoutTimer;
   ConnectionState m_state;
+  QByteArray m_readBuffer;
+  SessionRecorder m_recorder;
+  SessionReplayer *m_replayer = nullptr;
 };
 
 #endif // TCPCLIENT_H
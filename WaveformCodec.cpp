@@ -0,0 +1,333 @@
+#include "WaveformCodec.h"
+#include <QtEndian>
+#include <QtGlobal>
+#include <cstring>
+#include <limits>
+
+namespace {
+
+const char kMagic0 = 'T';
+const char kMagic1 = 'W';
+const quint8 kVersion = 1;
+const int kHeaderSize = 8; // magic(2) version(1) codec(1) count(4, LE)
+
+inline quint32 floatBits(float f) {
+  quint32 u;
+  memcpy(&u, &f, sizeof(u));
+  return u;
+}
+
+inline float bitsFloat(quint32 u) {
+  float f;
+  memcpy(&f, &u, sizeof(f));
+  return f;
+}
+
+// MSB-first bit packer into a buffer sized for the worst case up front
+class BitWriter {
+public:
+  explicit BitWriter(uchar *dst) : m_dst(dst), m_start(dst) {}
+
+  inline void write(quint32 value, int n) {
+    m_acc = (m_acc << n) | (quint64(value) & ((quint64(1) << n) - 1));
+    m_nbits += n;
+    while (m_nbits >= 8) {
+      m_nbits -= 8;
+      *m_dst++ = uchar(m_acc >> m_nbits);
+    }
+  }
+
+  qint64 finish() {
+    if (m_nbits > 0)
+      *m_dst++ = uchar(m_acc << (8 - m_nbits));
+    m_nbits = 0;
+    return m_dst - m_start;
+  }
+
+private:
+  uchar *m_dst;
+  uchar *m_start;
+  quint64 m_acc = 0;
+  int m_nbits = 0;
+};
+
+class BitReader {
+public:
+  BitReader(const uchar *p, const uchar *end) : m_p(p), m_end(end) {}
+
+  // Past the end it reads zeros and sets overrun(), so a truncated blob
+  // fails instead of decoding as flat data
+  inline quint32 read(int n) {
+    while (m_nbits < n) {
+      if (m_p < m_end) {
+        m_acc = (m_acc << 8) | *m_p++;
+      } else {
+        m_acc <<= 8;
+        m_overrun = true;
+      }
+      m_nbits += 8;
+    }
+    m_nbits -= n;
+    return quint32((m_acc >> m_nbits) & ((quint64(1) << n) - 1));
+  }
+  bool overrun() const { return m_overrun; }
+
+private:
+  const uchar *m_p;
+  const uchar *m_end;
+  quint64 m_acc = 0;
+  int m_nbits = 0;
+  bool m_overrun = false;
+};
+
+// Per value worst case: 2 control bits + 5 + 5 header bits + 32 payload
+qint64 gorillaBound(int count) { return (qint64(count) * 44 + 7) / 8 + 8; }
+
+qint64 gorillaEncode(const float *data, int count, uchar *dst) {
+  BitWriter w(dst);
+  if (count == 0)
+    return w.finish();
+
+  quint32 prev = floatBits(data[0]);
+  w.write(prev, 32);
+  int prevLead = -1;
+  int prevTrail = 0;
+
+  for (int i = 1; i < count; ++i) {
+    const quint32 cur = floatBits(data[i]);
+    const quint32 x = cur ^ prev;
+    prev = cur;
+    if (x == 0) {
+      w.write(0, 1);
+      continue;
+    }
+
+    const int lead = qCountLeadingZeroBits(x);
+    const int trail = qCountTrailingZeroBits(x);
+    if (prevLead >= 0 && lead >= prevLead && trail >= prevTrail) {
+      // Fits in the previous meaningful-bit window
+      w.write(0b10, 2);
+      w.write(x >> prevTrail, 32 - prevLead - prevTrail);
+    } else {
+      const int sig = 32 - lead - trail; // 1..32
+      w.write(0b11, 2);
+      w.write(lead, 5);
+      w.write(sig - 1, 5);
+      w.write(x >> trail, sig);
+      prevLead = lead;
+      prevTrail = trail;
+    }
+  }
+  return w.finish();
+}
+
+bool gorillaDecode(const uchar *src, const uchar *end, int count, float *out) {
+  if (count == 0)
+    return true;
+  BitReader r(src, end);
+
+  quint32 prev = r.read(32);
+  out[0] = bitsFloat(prev);
+  int lead = 0;
+  int trail = 0;
+
+  for (int i = 1; i < count; ++i) {
+    if (r.read(1) == 0) {
+      out[i] = bitsFloat(prev);
+      continue;
+    }
+    if (r.read(1) == 1) {
+      lead = int(r.read(5));
+      const int sig = int(r.read(5)) + 1;
+      trail = 32 - lead - sig;
+      if (trail < 0)
+        return false;
+    }
+    const int sig = 32 - lead - trail;
+    prev ^= r.read(sig) << trail;
+    out[i] = bitsFloat(prev);
+  }
+  return !r.overrun();
+}
+
+// Most values a payload of this size can hold: one bit per repeat after
+// the first 32-bit value, or one varint byte per value
+qint64 maxCount(WaveformCodec::Codec codec, qint64 payloadBytes) {
+  if (codec == WaveformCodec::Gorilla)
+    return payloadBytes < 4 ? 0 : 1 + (payloadBytes - 4) * 8;
+  if (codec == WaveformCodec::DeltaZigzag)
+    return payloadBytes;
+  return -1;
+}
+
+// Up to 5 bytes per 32-bit varint
+qint64 deltaZigzagBound(int count) { return qint64(count) * 5; }
+
+qint64 deltaZigzagEncode(const float *data, int count, uchar *dst) {
+  uchar *p = dst;
+  quint32 prev = 0;
+  for (int i = 0; i < count; ++i) {
+    const quint32 cur = floatBits(data[i]);
+    const qint32 d = qint32(cur - prev);
+    prev = cur;
+    quint32 zz = (quint32(d) << 1) ^ quint32(d >> 31);
+    while (zz >= 0x80) {
+      *p++ = uchar(zz | 0x80);
+      zz >>= 7;
+    }
+    *p++ = uchar(zz);
+  }
+  return p - dst;
+}
+
+bool deltaZigzagDecode(const uchar *src, const uchar *end, int count,
+                       float *out) {
+  quint32 prev = 0;
+  for (int i = 0; i < count; ++i) {
+    quint32 zz = 0;
+    int shift = 0;
+    for (;;) {
+      if (src >= end || shift > 28)
+        return false;
+      const uchar b = *src++;
+      zz |= quint32(b & 0x7F) << shift;
+      if (!(b & 0x80))
+        break;
+      shift += 7;
+    }
+    const quint32 d = (zz >> 1) ^ (0u - (zz & 1));
+    prev += d;
+    out[i] = bitsFloat(prev);
+  }
+  return true;
+}
+
+} // namespace
+
+QVariant WaveformCodec::encode(const float *data, int count, Codec codec) {
+  if (codec == Raw) {
+    return QString::fromLatin1(
+        QByteArray::fromRawData(reinterpret_cast<const char *>(data),
+                                count * int(sizeof(float)))
+            .toBase64());
+  }
+  return compress(data, count, codec);
+}
+
+QVariant WaveformCodec::encode(const float *data, int count, Codec codec,
+                               QByteArray &buffer) {
+  if (codec == Raw)
+    return encode(data, count, codec);
+  compressInto(data, count, codec, buffer);
+  return buffer;
+}
+
+QVector<float> WaveformCodec::decode(const QVariant &column) {
+  QVector<float> out;
+  if (column.typeId() == QMetaType::QByteArray) {
+    const QByteArray bytes = column.toByteArray();
+    if (isCompressedBlob(bytes)) {
+      decompress(bytes, out);
+      return out;
+    }
+  }
+
+  // Legacy: base64 text of native float32
+  const QByteArray raw = QByteArray::fromBase64(column.toByteArray());
+  out.resize(raw.size() / int(sizeof(float)));
+  memcpy(out.data(), raw.constData(), out.size() * sizeof(float));
+  return out;
+}
+
+QVector<float> WaveformCodec::fromBigEndianDoubles(const QByteArray &raw) {
+  QVector<float> out(raw.size() / 8);
+  const uchar *p = reinterpret_cast<const uchar *>(raw.constData());
+  for (int i = 0; i < out.size(); ++i, p += 8) {
+    const quint64 bits = qFromBigEndian<quint64>(p);
+    double d;
+    memcpy(&d, &bits, sizeof(d));
+    out[i] = float(d);
+  }
+  return out;
+}
+
+QByteArray WaveformCodec::compress(const float *data, int count, Codec codec) {
+  QByteArray blob;
+  compressInto(data, count, codec, blob);
+  return blob;
+}
+
+void WaveformCodec::compressInto(const float *data, int count, Codec codec,
+                                 QByteArray &blob) {
+  const qint64 bound =
+      codec == Gorilla ? gorillaBound(count) : deltaZigzagBound(count);
+  // Shrinking resize() keeps the capacity for the next frame
+  blob.resize(kHeaderSize + bound);
+  uchar *p = reinterpret_cast<uchar *>(blob.data());
+  p[0] = kMagic0;
+  p[1] = kMagic1;
+  p[2] = kVersion;
+  p[3] = quint8(codec);
+  qToLittleEndian<quint32>(quint32(count), p + 4);
+
+  const qint64 n = codec == Gorilla
+                       ? gorillaEncode(data, count, p + kHeaderSize)
+                       : deltaZigzagEncode(data, count, p + kHeaderSize);
+  blob.resize(kHeaderSize + n);
+}
+
+bool WaveformCodec::isCompressedBlob(const QByteArray &bytes) {
+  return bytes.size() >= kHeaderSize && bytes[0] == kMagic0 &&
+         bytes[1] == kMagic1 && quint8(bytes[2]) == kVersion;
+}
+
+bool WaveformCodec::decompress(const QByteArray &blob, QVector<float> &out) {
+  if (!isCompressedBlob(blob))
+    return false;
+  const uchar *p = reinterpret_cast<const uchar *>(blob.constData());
+  const uchar *end = p + blob.size();
+  const Codec codec = Codec(p[3]);
+  // The header count is untrusted: check it against the payload before
+  // allocating for it
+  const quint32 header = qFromLittleEndian<quint32>(p + 4);
+  if (header > quint32(std::numeric_limits<int>::max()) ||
+      qint64(header) > maxCount(codec, blob.size() - kHeaderSize)) {
+    out.clear();
+    return false;
+  }
+  const int count = int(header);
+
+  out.resize(count);
+  bool ok = false;
+  if (codec == Gorilla)
+    ok = gorillaDecode(p + kHeaderSize, end, count, out.data());
+  else if (codec == DeltaZigzag)
+    ok = deltaZigzagDecode(p + kHeaderSize, end, count, out.data());
+  if (!ok)
+    out.clear();
+  return ok;
+}
+
+QString WaveformCodec::codecName(Codec codec) {
+  switch (codec) {
+  case Gorilla:
+    return "gorilla";
+  case DeltaZigzag:
+    return "delta-zigzag";
+  case Raw:
+  default:
+    return "raw";
+  }
+}
+
+WaveformCodec::Codec WaveformCodec::codecFromName(const QString &name,
+                                                  Codec fallback) {
+  const QString n = name.trimmed().toLower();
+  if (n == "raw")
+    return Raw;
+  if (n == "gorilla")
+    return Gorilla;
+  if (n == "delta-zigzag" || n == "deltazigzag")
+    return DeltaZigzag;
+  return fallback;
+}
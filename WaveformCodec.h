@@ -0,0 +1,50 @@
+#ifndef WAVEFORMCODEC_H
+#define WAVEFORMCODEC_H
+
+#include <QByteArray>
+#include <QString>
+#include <QVariant>
+#include <QVector>
+
+// Lossless codecs for the float32 waveform columns of Data_Sample.
+//
+// Raw keeps the legacy representation (base64 TEXT of native floats).
+// Compressed codecs store a BLOB: "TW", version, codec id, value count,
+// then the codec payload. Readers accept both, so a project may mix them.
+class WaveformCodec {
+public:
+  enum Codec {
+    Raw = 0,
+    Gorilla = 1,    // XOR of successive bit patterns, Facebook Gorilla style
+    DeltaZigzag = 2 // integer delta of bit patterns, zigzag + varint
+  };
+
+  // Value to bind into a DATA_* column for the given codec
+  static QVariant encode(const float *data, int count, Codec codec);
+  static QVariant encode(const QVector<float> &data, Codec codec) {
+    return encode(data.constData(), data.size(), codec);
+  }
+  // Compressed codecs write into buffer, reusing its capacity when nobody
+  // else holds it; the returned value shares buffer's storage. Raw still
+  // allocates its base64 text.
+  static QVariant encode(const float *data, int count, Codec codec,
+                         QByteArray &buffer);
+
+  // Decode any DATA_* column value (legacy base64 text or codec BLOB)
+  static QVector<float> decode(const QVariant &column);
+
+  // Device / JSON dump representation: big-endian float64, narrowed
+  static QVector<float> fromBigEndianDoubles(const QByteArray &raw);
+
+  static QByteArray compress(const float *data, int count, Codec codec);
+  static void compressInto(const float *data, int count, Codec codec,
+                           QByteArray &blob);
+  // False, with out empty, for a truncated or inconsistent blob
+  static bool decompress(const QByteArray &blob, QVector<float> &out);
+  static bool isCompressedBlob(const QByteArray &bytes);
+
+  static QString codecName(Codec codec);
+  static Codec codecFromName(const QString &name, Codec fallback = Raw);
+};
+
+#endif // WAVEFORMCODEC_H
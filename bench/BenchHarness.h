@@ -0,0 +1,37 @@
+#ifndef BENCHHARNESS_H
+#define BENCHHARNESS_H
+
+#include <QJsonArray>
+#include <QString>
+
+namespace bench {
+
+// Report one measurement as "<name>: <rate> <unit>/s (<items> in <ms> ms)".
+// Every report is also kept for tem_bench --json.
+void report(const QString &name, qint64 items, double seconds,
+            const QString &unit);
+
+// Report a plain figure such as a compression ratio
+void reportValue(const QString &name, double value, const QString &unit);
+
+// Heap allocations made by the calling thread between the two calls; -1
+// where malloc cannot be interposed (only glibc builds count)
+void startAllocationCount();
+qint64 stopAllocationCount();
+
+// Corpus records from DB_js/Data_Sample.json (realistic payload sizes)
+const QJsonArray &sampleCorpus();
+
+void runSampleWriterBench();
+void runWaveformCodecBench();
+void runProjectTreeBench();
+void runJsonImportBench();
+void runProjectArchiveBench();
+void runAcquisitionBench();
+void runPlaybackBench();
+void runTcpIngestBench();
+void runMetricsBench();
+
+} // namespace bench
+
+#endif // BENCHHARNESS_H
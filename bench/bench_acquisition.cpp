@@ -0,0 +1,242 @@
+#include "AcquisitionPipeline.h"
+#include "Backend.h"
+#include "BenchHarness.h"
+#include "DatabaseManager.h"
+#include "FrameScanner.h"
+#include "WaveformCodec.h"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <QVariantList>
+#include <QVector>
+#include <cstring>
+
+namespace bench {
+
+namespace {
+
+const int kRepeat = 20;
+const int kSegment = 1460; // one Ethernet TCP payload per readyRead
+
+// Byte-wise decode of QByteArray::fromBase64 output, the baseline
+QVector<double> decodeBytewise(const QByteArray &raw) {
+  QVector<double> out;
+  out.reserve(raw.size() / 8);
+  for (int i = 0; i + 7 < raw.size(); i += 8) {
+    quint64 bits = 0;
+    for (int b = 0; b < 8; ++b)
+      bits = (bits << 8) | static_cast<quint8>(raw[i + b]);
+    double val;
+    memcpy(&val, &bits, sizeof(double));
+    out.append(val);
+  }
+  return out;
+}
+
+// The corpus as the device sends it: one compact JSON object per line
+QByteArray wireStream() {
+  QByteArray stream;
+  for (const QJsonValue &v : sampleCorpus())
+    stream += QJsonDocument(v.toObject()).toJson(QJsonDocument::Compact) +
+              '\n';
+  return stream;
+}
+
+// Backend's pipeline fed in TCP-sized segments, so every frame goes
+// through the real consumer: Backend::onSampleReceived, then the chart
+// preview once queued events run. Optionally each sample is persisted too,
+// as SurveySequencer does. Counts this thread's heap allocations per frame
+// once the pools are warm; the writer thread's SQLite work is not counted.
+void runSteadyStateAllocations(const QByteArray &stream) {
+  // Backend keeps its journal under AppData; keep the bench's out of the
+  // user's
+  QStandardPaths::setTestModeEnabled(true);
+  DatabaseManager &dbm = DatabaseManager::instance();
+  dbm.createProject(QVariantMap{{"CreateTime", 0}});
+  for (const QString &column : ChannelRegistry::columns())
+    dbm.setColumnCodec(column, WaveformCodec::Gorilla);
+  const int pointId = dbm.createPoint(dbm.createLine(0, "1"), "0");
+
+  Backend backend;
+  AcquisitionPipeline *pipeline = backend.pipeline();
+  bool persist = false;
+  QObject::connect(pipeline, &AcquisitionPipeline::sampleReceived,
+                   [&](const AcquisitionPipeline::Sample &sample) {
+                     if (persist)
+                       pipeline->persist(sample, sample.meta, pointId);
+                   });
+
+  auto feed = [&]() {
+    const qint64 before = pipeline->counters().samples;
+    for (int pos = 0; pos < stream.size(); pos += kSegment) {
+      pipeline->ingest(QByteArray::fromRawData(
+          stream.constData() + pos, qMin<int>(kSegment, stream.size() - pos)));
+      // The preview timer and anything else queued per read
+      QCoreApplication::processEvents();
+    }
+    return pipeline->counters().samples - before;
+  };
+
+  for (bool withPersist : {false, true}) {
+    persist = withPersist;
+    feed(); // warm-up: pools, buffers and the journal segment
+    dbm.flushPendingSamples();
+    startAllocationCount();
+    qint64 frames = 0;
+    for (int r = 0; r < kRepeat; ++r)
+      frames += feed();
+    const qint64 allocations = stopAllocationCount();
+    dbm.flushPendingSamples();
+    if (allocations < 0 || frames == 0)
+      return;
+    reportValue(withPersist ? "acquisition/allocs_per_frame_persist"
+                            : "acquisition/allocs_per_frame",
+                double(allocations) / frames, "allocs");
+  }
+}
+
+} // namespace
+
+void runAcquisitionBench() {
+  const QJsonArray &corpus = sampleCorpus();
+  const QByteArray stream = wireStream();
+
+  // AcquisitionPipeline::ingest fed one TCP segment at a time: framing,
+  // scan and channel decode, as the socket delivers them
+  {
+    QTemporaryDir journalDir;
+    AcquisitionPipeline pipeline(journalDir.path());
+    QElapsedTimer timer;
+    timer.start();
+    for (int r = 0; r < kRepeat; ++r) {
+      for (int pos = 0; pos < stream.size(); pos += kSegment)
+        pipeline.ingest(QByteArray::fromRawData(
+            stream.constData() + pos,
+            qMin<int>(kSegment, stream.size() - pos)));
+    }
+    const double seconds = timer.nsecsElapsed() / 1e9;
+    report("acquisition/ingest", pipeline.counters().bytes >> 20, seconds,
+           "MiB");
+    report("acquisition/ingest_frames", pipeline.counters().frames, seconds,
+           "frames");
+  }
+
+  // Whole-frame JSON parse
+  {
+    const QList<QByteArray> lines = stream.split('\n');
+    QElapsedTimer timer;
+    timer.start();
+    qint64 parsed = 0;
+    for (int r = 0; r < kRepeat; ++r) {
+      for (const QByteArray &line : lines)
+        parsed += QJsonDocument::fromJson(line).isObject();
+    }
+    report("acquisition/json_parse", parsed, timer.nsecsElapsed() / 1e9,
+           "frames");
+  }
+
+  // base64, then the two big-endian decoders
+  QVector<QByteArray> encoded;
+  QVector<QByteArray> raw;
+  qint64 encodedBytes = 0, rawBytes = 0;
+  for (const QJsonValue &v : corpus) {
+    const QJsonObject rec = v.toObject();
+    for (const char *field : {"DATA_RECV", "DATA_SEND", "DATA_SOFF"}) {
+      encoded.append(rec[field].toString().toUtf8());
+      raw.append(QByteArray::fromBase64(encoded.last()));
+      encodedBytes += encoded.last().size();
+      rawBytes += raw.last().size();
+    }
+  }
+  {
+    QElapsedTimer timer;
+    timer.start();
+    qint64 sink = 0;
+    for (int r = 0; r < kRepeat; ++r) {
+      for (const QByteArray &b : std::as_const(encoded))
+        sink += QByteArray::fromBase64(b).size();
+    }
+    report("acquisition/base64_decode", encodedBytes * kRepeat >> 20,
+           timer.nsecsElapsed() / 1e9, "MiB");
+    Q_UNUSED(sink)
+  }
+  {
+    QElapsedTimer timer;
+    timer.start();
+    qint64 values = 0;
+    for (int r = 0; r < kRepeat; ++r) {
+      for (const QByteArray &b : std::as_const(raw))
+        values += decodeBytewise(b).size();
+    }
+    report("acquisition/be_decode_backend", values,
+           timer.nsecsElapsed() / 1e9, "values");
+    timer.restart();
+    values = 0;
+    for (int r = 0; r < kRepeat; ++r) {
+      for (const QByteArray &b : std::as_const(raw))
+        values += WaveformCodec::fromBigEndianDoubles(b).size();
+    }
+    report("acquisition/be_decode_codec", values, timer.nsecsElapsed() / 1e9,
+           "values");
+  }
+
+  // AcquisitionPipeline's sample path: in-place scan, then base64 straight
+  // to doubles in reused buffers, against the parse + fromBase64 above
+  {
+    const QList<QByteArray> lines = stream.split('\n');
+    FrameScanner scanner;
+    QVector<double> channel;
+    QElapsedTimer timer;
+    timer.start();
+    qint64 values = 0;
+    for (int r = 0; r < kRepeat; ++r) {
+      for (const QByteArray &line : lines) {
+        if (!scanner.scan(line))
+          continue;
+        for (const ChannelRegistry::Channel &c : ChannelRegistry::channels()) {
+          FrameScanner::decodeChannel(scanner.value(c.wireField), c, channel);
+          values += channel.size();
+        }
+      }
+    }
+    report("acquisition/scan_decode_pooled", values,
+           timer.nsecsElapsed() / 1e9, "values");
+  }
+
+  // savePointData: double -> float32 plus the column codec
+  QTemporaryDir dir;
+  DatabaseManager &dbm = DatabaseManager::instance();
+  dbm.initialize(dir.filePath("acquisition.db"));
+  {
+    QVector<QVector<double>> channels;
+    QVector<QString> columns;
+    for (int i = 0; i < raw.size(); ++i) {
+      channels.append(decodeBytewise(raw[i]));
+      columns.append(i % 3 == 0   ? "DATA_RECV"
+                     : i % 3 == 1 ? "DATA_SEND"
+                                  : "DATA_SOFF");
+    }
+    QElapsedTimer timer;
+    timer.start();
+    qint64 values = 0;
+    for (int r = 0; r < kRepeat; ++r) {
+      for (int i = 0; i < channels.size(); ++i) {
+        QVector<float> f;
+        f.reserve(channels[i].size());
+        for (double d : std::as_const(channels[i]))
+          f.append(static_cast<float>(d));
+        WaveformCodec::encode(f, dbm.columnCodec(columns[i]));
+        values += f.size();
+      }
+    }
+    report("acquisition/save_convert_encode", values,
+           timer.nsecsElapsed() / 1e9, "values");
+  }
+
+  runSteadyStateAllocations(stream);
+}
+
+} // namespace bench
@@ -0,0 +1,59 @@
+#include "BenchHarness.h"
+#include <cstddef>
+
+// Counts malloc-family calls of one thread. glibc lets the executable
+// interpose malloc, which catches QArrayData and operator new alike.
+
+#if defined(__GLIBC__)
+
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t count, size_t size);
+extern "C" void *__libc_realloc(void *ptr, size_t size);
+
+namespace {
+thread_local bool t_counting = false;
+thread_local qint64 t_allocations = 0;
+} // namespace
+
+extern "C" void *malloc(size_t size) {
+  if (t_counting)
+    ++t_allocations;
+  return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t count, size_t size) {
+  if (t_counting)
+    ++t_allocations;
+  return __libc_calloc(count, size);
+}
+
+extern "C" void *realloc(void *ptr, size_t size) {
+  if (t_counting)
+    ++t_allocations;
+  return __libc_realloc(ptr, size);
+}
+
+namespace bench {
+
+void startAllocationCount() {
+  t_allocations = 0;
+  t_counting = true;
+}
+
+qint64 stopAllocationCount() {
+  t_counting = false;
+  return t_allocations;
+}
+
+} // namespace bench
+
+#else
+
+namespace bench {
+
+void startAllocationCount() {}
+qint64 stopAllocationCount() { return -1; }
+
+} // namespace bench
+
+#endif
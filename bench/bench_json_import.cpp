@@ -0,0 +1,74 @@
+#include "BenchHarness.h"
+#include "ChannelRegistry.h"
+#include "DatabaseManager.h"
+#include "JsonDumpImporter.h"
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTemporaryDir>
+
+namespace bench {
+
+namespace {
+
+const int kRecords = 4000; // ~130 MB of Data_Sample dump
+
+// Data_Sample.json blown up to kRecords rows with fresh IDs
+qint64 writeSampleDump(const QString &path) {
+  const QJsonArray &corpus = sampleCorpus();
+  QFile file(path);
+  file.open(QIODevice::WriteOnly);
+  file.write("[\n");
+  for (int i = 0; i < kRecords; ++i) {
+    QJsonObject rec = corpus.at(i % corpus.size()).toObject();
+    rec["ID"] = i + 1;
+    if (i > 0)
+      file.write(",\n");
+    file.write(QJsonDocument(rec).toJson(QJsonDocument::Compact));
+  }
+  file.write("\n]\n");
+  return file.size();
+}
+
+} // namespace
+
+void runJsonImportBench() {
+  QTemporaryDir dir;
+  const QString dumpPath = dir.filePath("Data_Sample.json");
+  const qint64 bytes = writeSampleDump(dumpPath);
+
+  // The old way: whole file into one QJsonDocument, no inserts at all
+  QElapsedTimer timer;
+  timer.start();
+  {
+    QFile file(dumpPath);
+    file.open(QIODevice::ReadOnly);
+    QJsonDocument doc = QJsonDocument::fromJson(file.readAll());
+    Q_UNUSED(doc)
+  }
+  report("jsonImport/readAll_parse_only", bytes >> 20,
+         timer.nsecsElapsed() / 1e9, "MiB");
+
+  DatabaseManager &dbm = DatabaseManager::instance();
+  for (WaveformCodec::Codec codec :
+       {WaveformCodec::Raw, WaveformCodec::Gorilla}) {
+    const QString name = WaveformCodec::codecName(codec);
+    const QString dbPath = dir.filePath("import_" + name + ".db");
+    dbm.initialize(dbPath);
+
+    JsonDumpImporter importer;
+    QHash<QString, WaveformCodec::Codec> codecs;
+    for (const QString &column : ChannelRegistry::columns())
+      codecs.insert(column, codec);
+    importer.setColumnCodecs(codecs);
+    timer.restart();
+    importer.importFile(dumpPath, "Data_Sample", dbPath);
+    const double seconds = timer.nsecsElapsed() / 1e9;
+    report("jsonImport/stream_" + name, bytes >> 20, seconds, "MiB");
+    report("jsonImport/stream_" + name + "_rows", importer.rowsImported(),
+           seconds, "rows");
+  }
+}
+
+} // namespace bench
@@ -0,0 +1,158 @@
+#include "BenchHarness.h"
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QFile>
+#include <QHash>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QPair>
+#include <QSysInfo>
+#include <QTextStream>
+#include <functional>
+
+namespace bench {
+
+namespace {
+
+// Every figure of this run, for --json and --baseline
+QJsonArray &results() {
+  static QJsonArray r;
+  return r;
+}
+
+} // namespace
+
+void report(const QString &name, qint64 items, double seconds,
+            const QString &unit) {
+  QTextStream out(stdout);
+  double rate = seconds > 0.0 ? items / seconds : 0.0;
+  out << name << ": " << QString::number(rate, 'f', 1) << " " << unit
+      << "/s (" << items << " in " << QString::number(seconds * 1000.0, 'f', 2)
+      << " ms)\n";
+  results().append(QJsonObject{{"name", name},
+                               {"value", rate},
+                               {"unit", unit + "/s"},
+                               {"items", items},
+                               {"ms", seconds * 1000.0}});
+}
+
+void reportValue(const QString &name, double value, const QString &unit) {
+  QTextStream out(stdout);
+  out << name << ": " << QString::number(value, 'f', 3) << " " << unit << "\n";
+  results().append(
+      QJsonObject{{"name", name}, {"value", value}, {"unit", unit}});
+}
+
+const QJsonArray &sampleCorpus() {
+  static QJsonArray corpus = [] {
+    QFile file(QStringLiteral(TEM_SOURCE_DIR "/DB_js/Data_Sample.json"));
+    if (!file.open(QIODevice::ReadOnly))
+      qFatal("Cannot open sample corpus: %s", qPrintable(file.fileName()));
+    return QJsonDocument::fromJson(file.readAll()).array();
+  }();
+  return corpus;
+}
+
+} // namespace bench
+
+namespace {
+
+bool writeJson(const QString &path) {
+  QJsonObject doc{
+      {"timestamp", QDateTime::currentDateTimeUtc().toString(Qt::ISODate)},
+      {"qt", qVersion()},
+      {"cpu", QSysInfo::currentCpuArchitecture()},
+      {"os", QSysInfo::prettyProductName()},
+      {"host", QSysInfo::machineHostName()},
+      {"results", bench::results()}};
+  QFile file(path);
+  if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+    qWarning("Cannot write %s", qPrintable(path));
+    return false;
+  }
+  file.write(QJsonDocument(doc).toJson());
+  return true;
+}
+
+// Rates ("<unit>/s") that fell more than tolerance below the baseline run.
+// Plain values (ratios, latencies) are listed by the JSON but not judged.
+int compareWithBaseline(const QString &path, double tolerance) {
+  QFile file(path);
+  if (!file.open(QIODevice::ReadOnly)) {
+    qWarning("Cannot read baseline %s", qPrintable(path));
+    return -1;
+  }
+  QHash<QString, double> before;
+  const QJsonArray old =
+      QJsonDocument::fromJson(file.readAll()).object()["results"].toArray();
+  for (const QJsonValue &v : old) {
+    const QJsonObject r = v.toObject();
+    if (r["unit"].toString().endsWith("/s"))
+      before.insert(r["name"].toString(), r["value"].toDouble());
+  }
+
+  QTextStream out(stdout);
+  int regressions = 0;
+  for (const QJsonValue &v : std::as_const(bench::results())) {
+    const QJsonObject r = v.toObject();
+    const QString name = r["name"].toString();
+    if (!before.contains(name) || before[name] <= 0.0)
+      continue;
+    const double change = r["value"].toDouble() / before[name] - 1.0;
+    if (change < -tolerance) {
+      out << "REGRESSION " << name << ": "
+          << QString::number(change * 100.0, 'f', 1) << "%\n";
+      ++regressions;
+    }
+  }
+  out << regressions << " regression(s) against " << path << "\n";
+  return regressions;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  QCoreApplication app(argc, argv);
+  app.setApplicationName("tem_bench");
+
+  QCommandLineParser parser;
+  parser.addHelpOption();
+  parser.addOption({"json", "Write results as JSON to <file>.", "file"});
+  parser.addOption(
+      {"filter", "Run only groups whose name contains <text>.", "text"});
+  parser.addOption({"baseline",
+                    "Compare rates with an earlier --json file; exit code 1 "
+                    "on regression.",
+                    "file"});
+  parser.addOption({"tolerance", "Allowed slowdown against the baseline.",
+                    "fraction", "0.10"});
+  parser.process(app);
+
+  const QList<QPair<QString, std::function<void()>>> groups = {
+      {"sampleWriter", bench::runSampleWriterBench},
+      {"waveformCodec", bench::runWaveformCodecBench},
+      {"projectTree", bench::runProjectTreeBench},
+      {"jsonImport", bench::runJsonImportBench},
+      {"projectArchive", bench::runProjectArchiveBench},
+      {"acquisition", bench::runAcquisitionBench},
+      {"playback", bench::runPlaybackBench},
+      {"tcpIngest", bench::runTcpIngestBench},
+      {"metrics", bench::runMetricsBench},
+  };
+  const QString filter = parser.value("filter");
+  for (const auto &group : groups) {
+    if (filter.isEmpty() || group.first.contains(filter, Qt::CaseInsensitive))
+      group.second();
+  }
+
+  if (parser.isSet("json") && !writeJson(parser.value("json")))
+    return 2;
+  if (parser.isSet("baseline")) {
+    const int regressions = compareWithBaseline(
+        parser.value("baseline"), parser.value("tolerance").toDouble());
+    if (regressions != 0)
+      return regressions < 0 ? 2 : 1;
+  }
+  return 0;
+}
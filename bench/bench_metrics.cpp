@@ -0,0 +1,57 @@
+#include "BenchHarness.h"
+#include "Metrics.h"
+#include <QElapsedTimer>
+#include <thread>
+#include <vector>
+
+namespace bench {
+
+namespace {
+
+const qint64 kOps = 20000000;
+const int kThreads = 4;
+
+// Operations per second of f, run on threads threads at once
+template <typename F> void measure(const QString &name, int threads, F f) {
+  QElapsedTimer timer;
+  timer.start();
+  std::vector<std::thread> pool;
+  for (int t = 0; t < threads; ++t)
+    pool.emplace_back([&f]() {
+      for (qint64 i = 0; i < kOps; ++i)
+        f(i);
+    });
+  for (std::thread &t : pool)
+    t.join();
+  report(name, kOps * threads, timer.nsecsElapsed() / 1e9, "ops");
+}
+
+} // namespace
+
+// What the hot paths pay for always-on metrics
+void runMetricsBench() {
+  Metrics::Counter &counter = Metrics::counter("tem_bench_counter_total");
+  Metrics::Histogram &histogram =
+      Metrics::histogram("tem_bench_histogram_seconds", "", 1e-9);
+
+  measure("metrics/counter_add", 1, [&](qint64) { counter.add(); });
+  measure("metrics/counter_add_4_threads", kThreads,
+          [&](qint64) { counter.add(); });
+  measure("metrics/histogram_record", 1,
+          [&](qint64 i) { histogram.record(i & 0xfffff); });
+  measure("metrics/histogram_record_4_threads", kThreads,
+          [&](qint64 i) { histogram.record(i & 0xfffff); });
+  measure("metrics/scoped_timer", 1,
+          [&](qint64) { Metrics::ScopedTimer t(histogram); });
+
+  QElapsedTimer timer;
+  timer.start();
+  qint64 bytes = 0;
+  for (int i = 0; i < 1000; ++i)
+    bytes += Metrics::prometheusText().size();
+  report("metrics/prometheus_text", 1000, timer.nsecsElapsed() / 1e9,
+         "scrapes");
+  Q_UNUSED(bytes)
+}
+
+} // namespace bench
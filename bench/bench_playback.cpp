@@ -0,0 +1,152 @@
+#include "BatchExporter.h"
+#include "BenchHarness.h"
+#include "ChannelRegistry.h"
+#include "DatabaseManager.h"
+#include "MinMaxDecimator.h"
+#include "PlaybackBackend.h"
+#include "WaveformCodec.h"
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <QRandomGenerator>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QTemporaryDir>
+
+namespace bench {
+
+namespace {
+
+const int kPoints = 300;
+const int kShots = 3;
+const int kLoads = 200;
+const int kTicks = 200; // playback ticks per sweep
+
+void fillProject(const QString &dbPath) {
+  const QJsonArray &corpus = sampleCorpus();
+  QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "bench_playback_fill");
+  db.setDatabaseName(dbPath);
+  db.open();
+  db.transaction();
+  QSqlQuery q(db);
+  q.exec("INSERT INTO Data_Line (ID, NAME, TYPE, USE) VALUES (1, 1.0, 0, 1)");
+  QSqlQuery point(db);
+  point.prepare("INSERT INTO Data_Point (ID, Data_LineID, NAME, TYPE, USE) "
+                "VALUES (?, 1, ?, 0, 1)");
+  // Every registry column, so loads decode what a real project holds
+  const QStringList &columns = ChannelRegistry::columns();
+  QSqlQuery sample(db);
+  sample.prepare(QString("INSERT INTO Data_Sample (Data_PointID, SendFs, "
+                         "RecvFs, SampleOffFs, StartTime, %1) "
+                         "VALUES (?, 25.0, ?, ?, ?%2)")
+                     .arg(columns.join(", "),
+                          QString(", ?").repeated(columns.size())));
+  int row = 0;
+  for (int p = 1; p <= kPoints; ++p) {
+    point.addBindValue(p);
+    point.addBindValue(double(p));
+    point.exec();
+    for (int s = 0; s < kShots; ++s, ++row) {
+      const QJsonObject rec = corpus.at(row % corpus.size()).toObject();
+      sample.addBindValue(p);
+      sample.addBindValue(rec["RecvFs"].toDouble(625000.0));
+      sample.addBindValue(rec["SampleOffFs"].toDouble(2000000.0));
+      sample.addBindValue(qint64(1700000000000) + row * 1000);
+      for (const QString &column : columns) {
+        const QVector<float> f = WaveformCodec::fromBigEndianDoubles(
+            QByteArray::fromBase64(rec[column].toString().toLatin1()));
+        sample.addBindValue(WaveformCodec::encode(f, WaveformCodec::Gorilla));
+      }
+      sample.exec();
+    }
+  }
+  db.commit();
+  db.close();
+}
+
+} // namespace
+
+void runPlaybackBench() {
+  QTemporaryDir dir;
+  const QString dbPath = dir.filePath("playback.db");
+  DatabaseManager::instance().initialize(dbPath);
+  fillProject(dbPath);
+
+  QVector<int> ids;
+  for (int i = 0; i < kLoads; ++i)
+    ids.append(1 + QRandomGenerator::global()->bounded(kPoints));
+
+  // loadPointData: the load pool's read of a point's newest sample
+  PlaybackBackend::PointWaveforms w;
+  QElapsedTimer timer;
+  timer.start();
+  int loaded = 0;
+  for (int id : std::as_const(ids))
+    loaded += PlaybackBackend::fetchWaveforms(dbPath, false, id, w);
+  report("playback/loadPointData", loaded, timer.nsecsElapsed() / 1e9,
+         "points");
+  const QVector<float> recv = w.channels.value(ChannelRegistry::Recv);
+  const QVector<float> send = w.channels.value(ChannelRegistry::Send);
+  const QVector<float> off = w.channels.value(ChannelRegistry::Off);
+
+  // seek + update*Series: reveal the record tick by tick, as playback does
+  MinMaxDecimator recvWindow(MinMaxDecimator::Magnitude);
+  MinMaxDecimator sendWindow(MinMaxDecimator::Value);
+  MinMaxDecimator offWindow(MinMaxDecimator::Magnitude);
+  recvWindow.setSource(recv);
+  sendWindow.setSource(send);
+  offWindow.setSource(off);
+  const int kSweeps = 50;
+  qint64 pointsOut = 0;
+  timer.restart();
+  for (int s = 0; s < kSweeps; ++s) {
+    for (int t = 1; t <= kTicks; ++t) {
+      recvWindow.setLength(int(qint64(recv.size()) * t / kTicks));
+      sendWindow.setLength(int(qint64(send.size()) * t / kTicks));
+      offWindow.setLength(int(qint64(off.size()) * t / kTicks));
+      pointsOut += recvWindow.points(1.0).size() +
+                   sendWindow.points(1.0).size() +
+                   offWindow.points(1.0).size();
+    }
+    recvWindow.setLength(0);
+    sendWindow.setLength(0);
+    offWindow.setLength(0);
+  }
+  report("playback/seek_forward", qint64(kSweeps) * kTicks,
+         timer.nsecsElapsed() / 1e9, "ticks");
+
+  // Random seeks: every backwards jump rebuilds the window
+  timer.restart();
+  for (int i = 0; i < kSweeps * kTicks; ++i) {
+    const double f = QRandomGenerator::global()->generateDouble();
+    recvWindow.setLength(int(recv.size() * f));
+    sendWindow.setLength(int(send.size() * f));
+    offWindow.setLength(int(off.size() * f));
+    pointsOut += recvWindow.points(1.0).size() +
+                 sendWindow.points(1.0).size() + offWindow.points(1.0).size();
+  }
+  report("playback/seek_random", qint64(kSweeps) * kTicks,
+         timer.nsecsElapsed() / 1e9, "seeks");
+  Q_UNUSED(pointsOut)
+
+  // exportCsv (one point) and a full project export in every format
+  BatchExporter exporter;
+  exporter.setFormats(BatchExporter::Csv);
+  timer.restart();
+  const int kExports = 20;
+  for (int i = 0; i < kExports; ++i)
+    exporter.exportPoint(dbPath, ids[i], dir.filePath("csv"));
+  report("playback/exportCsv_point", kExports, timer.nsecsElapsed() / 1e9,
+         "points");
+
+  exporter.setFormats(BatchExporter::Csv | BatchExporter::RawBinary |
+                      BatchExporter::Npy | BatchExporter::GatedXyz);
+  timer.restart();
+  exporter.exportProject(dbPath, dir.filePath("all"));
+  const double seconds = timer.nsecsElapsed() / 1e9;
+  report("playback/export_project_samples", exporter.samplesExported(),
+         seconds, "samples");
+  report("playback/export_project_bytes", exporter.bytesWritten() >> 20,
+         seconds, "MiB");
+}
+
+} // namespace bench
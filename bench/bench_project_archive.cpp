@@ -0,0 +1,164 @@
+#include "BenchHarness.h"
+#include "ChannelRegistry.h"
+#include "DatabaseManager.h"
+#include "ProjectArchive.h"
+#include "WaveformCodec.h"
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonObject>
+#include <QRandomGenerator>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QTemporaryDir>
+
+#if defined(Q_OS_UNIX)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace bench {
+
+namespace {
+
+const int kPoints = 2000;
+const int kLoads = 200;
+
+// Best effort: drop the file from the page cache so the next read is cold
+void evictFromCache(const QString &path) {
+#if defined(Q_OS_UNIX)
+  const int fd = ::open(QFile::encodeName(path).constData(), O_RDONLY);
+  if (fd >= 0) {
+    ::fdatasync(fd);
+#if defined(POSIX_FADV_DONTNEED)
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+#endif
+    ::close(fd);
+  }
+#else
+  Q_UNUSED(path)
+#endif
+}
+
+void fillProject(const QString &dbPath) {
+  const QJsonArray &corpus = sampleCorpus();
+  QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "bench_archive_fill");
+  db.setDatabaseName(dbPath);
+  db.open();
+  db.transaction();
+  QSqlQuery q(db);
+  q.exec("INSERT INTO Data_Line (ID, NAME, TYPE, USE) VALUES (1, 1.0, 0, 1)");
+  QSqlQuery point(db);
+  point.prepare("INSERT INTO Data_Point (ID, Data_LineID, NAME, TYPE, USE) "
+                "VALUES (?, 1, ?, 0, 1)");
+  const QStringList &columns = ChannelRegistry::columns();
+  QSqlQuery sample(db);
+  sample.prepare(QString("INSERT INTO Data_Sample (Data_PointID, SendFs, %1) "
+                         "VALUES (?, 25.0%2)")
+                     .arg(columns.join(", "),
+                          QString(", ?").repeated(columns.size())));
+  for (int p = 1; p <= kPoints; ++p) {
+    point.addBindValue(p);
+    point.addBindValue(double(p));
+    point.exec();
+
+    const QJsonObject rec = corpus.at(p % corpus.size()).toObject();
+    sample.addBindValue(p);
+    for (const QString &column : columns) {
+      const QVector<float> f = WaveformCodec::fromBigEndianDoubles(
+          QByteArray::fromBase64(rec[column].toString().toLatin1()));
+      sample.addBindValue(WaveformCodec::encode(f, WaveformCodec::Gorilla));
+    }
+    sample.exec();
+  }
+  db.commit();
+  db.close();
+}
+
+// PlaybackBackend::loadPointData's SQL path
+qint64 loadFromDatabase(const QString &dbPath, const QVector<int> &ids) {
+  qint64 values = 0;
+  {
+    QSqlDatabase db =
+        QSqlDatabase::addDatabase("QSQLITE", "bench_archive_sqlite");
+    db.setDatabaseName(dbPath);
+    db.open();
+    QSqlQuery q(db);
+    const QStringList &columns = ChannelRegistry::columns();
+    q.prepare(QString("SELECT SendFs, %1 FROM Data_Sample WHERE "
+                      "Data_PointID = ? ORDER BY ID DESC LIMIT 1")
+                  .arg(columns.join(", ")));
+    for (int id : ids) {
+      q.addBindValue(id);
+      if (q.exec() && q.next()) {
+        for (int c = 1; c <= columns.size(); ++c)
+          values += WaveformCodec::decode(q.value(c)).size();
+      }
+    }
+  }
+  QSqlDatabase::removeDatabase("bench_archive_sqlite");
+  return values;
+}
+
+qint64 loadFromArchive(ProjectArchive &archive, const QVector<int> &ids) {
+  qint64 values = 0;
+  for (int id : ids) {
+    const ProjectArchive::SampleEntry *s = archive.latestSample(id);
+    if (!s)
+      continue;
+    for (int c = 0; c < ChannelRegistry::count(); ++c) {
+      int count = 0;
+      const float *data = archive.channel(*s, c, &count);
+      // Same copy PlaybackBackend makes into its buffers
+      QVector<float> column(data, data + count);
+      values += column.size();
+    }
+  }
+  return values;
+}
+
+} // namespace
+
+void runProjectArchiveBench() {
+  QTemporaryDir dir;
+  const QString dbPath = dir.filePath("archive_src.db");
+  const QString archivePath = dir.filePath("archive.tema");
+
+  DatabaseManager::instance().initialize(dbPath);
+  fillProject(dbPath);
+
+  QElapsedTimer timer;
+  timer.start();
+  ProjectArchive::exportDatabase(DatabaseManager::instance().database(),
+                                 archivePath);
+  report("archive/export", kPoints, timer.nsecsElapsed() / 1e9, "points");
+  reportValue("archive/size_vs_db",
+              double(QFile(archivePath).size()) / QFile(dbPath).size(), "x");
+
+  QVector<int> ids;
+  for (int i = 0; i < kLoads; ++i)
+    ids.append(1 + QRandomGenerator::global()->bounded(kPoints));
+
+  evictFromCache(dbPath);
+  timer.restart();
+  loadFromDatabase(dbPath, ids);
+  report("loadPoint/sqlite_cold", kLoads, timer.nsecsElapsed() / 1e9,
+         "points");
+  timer.restart();
+  loadFromDatabase(dbPath, ids);
+  report("loadPoint/sqlite_warm", kLoads, timer.nsecsElapsed() / 1e9,
+         "points");
+
+  evictFromCache(archivePath);
+  timer.restart();
+  ProjectArchive archive;
+  archive.open(archivePath);
+  loadFromArchive(archive, ids);
+  report("loadPoint/archive_cold", kLoads, timer.nsecsElapsed() / 1e9,
+         "points");
+  timer.restart();
+  loadFromArchive(archive, ids);
+  report("loadPoint/archive_warm", kLoads, timer.nsecsElapsed() / 1e9,
+         "points");
+}
+
+} // namespace bench
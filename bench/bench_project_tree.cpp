@@ -0,0 +1,65 @@
+#include "BenchHarness.h"
+#include "DatabaseManager.h"
+#include <QElapsedTimer>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QTemporaryDir>
+
+namespace bench {
+
+void runProjectTreeBench() {
+  const int kLines = 500;
+  const int kPointsPerLine = 200;
+
+  QTemporaryDir dir;
+  const QString dbPath = dir.filePath("tree.db");
+
+  // Creates the schema (and the v1 indexes) on an empty file
+  DatabaseManager &dbm = DatabaseManager::instance();
+  dbm.initialize(dbPath);
+
+  {
+    QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "bench_tree_fill");
+    db.setDatabaseName(dbPath);
+    db.open();
+    db.transaction();
+    QSqlQuery line(db);
+    line.prepare("INSERT INTO Data_Line (ID, NAME, TYPE, USE) "
+                 "VALUES (?, ?, 0, 1)");
+    QSqlQuery point(db);
+    point.prepare("INSERT INTO Data_Point (Data_LineID, NAME, TYPE, USE) "
+                  "VALUES (?, ?, 0, 1)");
+    // Interleave lines so points of one line are not stored contiguously
+    for (int l = 1; l <= kLines; ++l) {
+      line.addBindValue(l);
+      line.addBindValue(double(l));
+      line.exec();
+    }
+    for (int p = 0; p < kPointsPerLine; ++p) {
+      for (int l = 1; l <= kLines; ++l) {
+        point.addBindValue(l);
+        point.addBindValue(double(p * 2));
+        point.exec();
+      }
+    }
+    db.commit();
+    db.close();
+  }
+  QSqlDatabase::removeDatabase("bench_tree_fill");
+
+  // Cold: first call prepares the statement
+  QElapsedTimer timer;
+  timer.start();
+  QVariantList tree = dbm.getProjectTree();
+  report("getProjectTree/500x200_cold", kLines * kPointsPerLine,
+         timer.nsecsElapsed() / 1e9, "points");
+
+  const int kRepeat = 5;
+  timer.restart();
+  for (int i = 0; i < kRepeat; ++i)
+    tree = dbm.getProjectTree();
+  report("getProjectTree/500x200_warm", qint64(kLines) * kPointsPerLine * kRepeat,
+         timer.nsecsElapsed() / 1e9, "points");
+}
+
+} // namespace bench
@@ -0,0 +1,95 @@
+#include "BenchHarness.h"
+#include "DatabaseManager.h"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QTemporaryDir>
+
+namespace bench {
+
+namespace {
+
+const int kRows = 500;
+
+// The pre-writer path: one autocommit INSERT (and fsync) per row
+double runAutocommitBaseline(const QString &dbPath) {
+  const QJsonArray &corpus = sampleCorpus();
+  double seconds = 0.0;
+  {
+    QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "bench_baseline");
+    db.setDatabaseName(dbPath);
+    db.open();
+    QSqlQuery q(db);
+    q.exec("CREATE TABLE Data_Sample (ID INTEGER PRIMARY KEY AUTOINCREMENT, "
+           "Data_PointID INTEGER, DATA_RECV TEXT, DATA_SEND TEXT, "
+           "DATA_SOFF TEXT, StartTime INTEGER)");
+    q.prepare("INSERT INTO Data_Sample (Data_PointID, DATA_RECV, DATA_SEND, "
+              "DATA_SOFF, StartTime) VALUES (?, ?, ?, ?, ?)");
+
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < kRows; ++i) {
+      QJsonObject rec = corpus.at(i % corpus.size()).toObject();
+      q.addBindValue(rec["Data_PointID"].toInt());
+      q.addBindValue(rec["DATA_RECV"].toString());
+      q.addBindValue(rec["DATA_SEND"].toString());
+      q.addBindValue(rec["DATA_SOFF"].toString());
+      q.addBindValue(rec["StartTime"].toVariant());
+      q.exec();
+    }
+    seconds = timer.nsecsElapsed() / 1e9;
+    db.close();
+  }
+  QSqlDatabase::removeDatabase("bench_baseline");
+  return seconds;
+}
+
+} // namespace
+
+void runSampleWriterBench() {
+  QTemporaryDir dir;
+  const QJsonArray &corpus = sampleCorpus();
+
+  report("saveSample/autocommit_baseline", kRows,
+         runAutocommitBaseline(dir.filePath("baseline.db")), "rows");
+
+  DatabaseManager &dbm = DatabaseManager::instance();
+  dbm.initialize(dir.filePath("writer.db"));
+  dbm.flushPendingSamples(); // let the writer open its connection
+
+  int committed = 0;
+  QObject::connect(&dbm, &DatabaseManager::dataSaved,
+                   [&committed](int) { ++committed; });
+
+  const QVector<ChannelRegistry::Channel> &registry =
+      ChannelRegistry::channels();
+  QElapsedTimer timer;
+  timer.start();
+  for (int i = 0; i < kRows; ++i) {
+    QJsonObject rec = corpus.at(i % corpus.size()).toObject();
+    ChannelArray<QVariant> columns(registry.size());
+    ChannelArray<int> rates(registry.size());
+    for (int c = 0; c < registry.size(); ++c) {
+      columns[c] = rec[QLatin1String(registry[c].column)].toString();
+      rates[c] = registry[c].rateField
+                     ? rec[QLatin1String(registry[c].rateField)].toInt()
+                     : 0;
+    }
+    dbm.saveSample(rec["Data_PointID"].toInt(), rec.toVariantMap(), columns,
+                   rates);
+  }
+  double enqueueSeconds = timer.nsecsElapsed() / 1e9;
+
+  dbm.flushPendingSamples();
+  while (committed < kRows)
+    QCoreApplication::processEvents(QEventLoop::AllEvents, 10);
+  double totalSeconds = timer.nsecsElapsed() / 1e9;
+
+  // Caller-visible cost (what the GUI thread pays) vs. end-to-end commit
+  report("saveSample/write_behind_enqueue", kRows, enqueueSeconds, "rows");
+  report("saveSample/write_behind_commit", kRows, totalSeconds, "rows");
+}
+
+} // namespace bench
@@ -0,0 +1,183 @@
+#include "BenchHarness.h"
+#include "DeviceSimulator.h"
+#include "FrameScanner.h"
+#include "TcpClient.h"
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QTemporaryDir>
+#include <QTimer>
+#include <QVector>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+
+namespace bench {
+
+namespace {
+
+const int kRunMs = 3000;
+
+qint64 wallClockUs() {
+  using namespace std::chrono;
+  return duration_cast<microseconds>(system_clock::now().time_since_epoch())
+      .count();
+}
+
+// TcpClient plus the framing, scanning and pooled decode of
+// AcquisitionPipeline::ingest
+struct IngestClient {
+  TcpClient tcp;
+  QByteArray buffer;
+  FrameScanner scanner;
+  QVector<double> recv, send, off;
+  qint64 frames = 0;
+  qint64 bytes = 0;
+  qint64 rejected = 0;
+  QVector<qint64> latencyUs;
+
+  void onData(const QByteArray &data) {
+    bytes += data.size();
+    buffer.append(data);
+    qsizetype start = 0;
+    qsizetype newlineIdx;
+    while ((newlineIdx = buffer.indexOf('\n', start)) != -1) {
+      const QByteArrayView frame =
+          QByteArrayView(buffer).sliced(start, newlineIdx - start).trimmed();
+      start = newlineIdx + 1;
+      if (frame.isEmpty())
+        continue;
+      if (!scanner.scan(frame)) {
+        ++rejected;
+        continue;
+      }
+      if (!scanner.contains("DATA_RECV"))
+        continue;
+      FrameScanner::decodeBigEndianDoubles(scanner.value("DATA_RECV"), recv);
+      FrameScanner::decodeBigEndianDoubles(scanner.value("DATA_SEND"), send);
+      FrameScanner::decodeBigEndianDoubles(scanner.value("DATA_SOFF"), off);
+      if (recv.isEmpty() || send.isEmpty() || off.isEmpty()) {
+        ++rejected;
+        continue;
+      }
+      latencyUs.append(wallClockUs() -
+                       qint64(scanner.toDouble("SimSentUs", 0)));
+      ++frames;
+    }
+    buffer.remove(0, start);
+  }
+};
+
+void reportRun(const QString &name,
+               const std::vector<std::unique_ptr<IngestClient>> &clients,
+               double seconds, bool withLatency) {
+  qint64 frames = 0, bytes = 0, rejected = 0;
+  QVector<qint64> latency;
+  for (const auto &c : clients) {
+    frames += c->frames;
+    bytes += c->bytes;
+    rejected += c->rejected;
+    latency += c->latencyUs;
+  }
+  report(name + "/frames", frames, seconds, "frames");
+  report(name + "/bytes", bytes / (1024 * 1024), seconds, "MiB");
+  if (withLatency && !latency.isEmpty()) {
+    std::sort(latency.begin(), latency.end());
+    reportValue(name + "/latency_p50", latency[latency.size() / 2] / 1000.0,
+                "ms");
+    reportValue(name + "/latency_p99",
+                latency[qMin(latency.size() - 1, latency.size() * 99 / 100)] /
+                    1000.0,
+                "ms");
+  }
+  if (rejected > 0)
+    reportValue(name + "/rejected", double(rejected), "frames");
+}
+
+// recordPath: also capture the first client's session for runReplay
+void runScenario(const QString &name, const DeviceSimulator::Config &config,
+                 int devices, int clientsPerDevice,
+                 const QString &recordPath = QString()) {
+  QList<std::shared_ptr<DeviceSimulator>> sims;
+  std::vector<std::unique_ptr<IngestClient>> clients;
+  for (int d = 0; d < devices; ++d) {
+    auto sim = std::make_shared<DeviceSimulator>(config);
+    if (!sim->listen(0, QHostAddress::LocalHost))
+      return;
+    for (int c = 0; c < clientsPerDevice; ++c) {
+      auto client = std::make_unique<IngestClient>();
+      IngestClient *raw = client.get();
+      QObject::connect(&raw->tcp, &TcpClient::dataReceived,
+                       [raw](const QByteArray &data) { raw->onData(data); });
+      QObject::connect(&raw->tcp, &TcpClient::stateChanged,
+                       [raw](TcpClient::ConnectionState state) {
+                         if (state == TcpClient::Connected)
+                           raw->tcp.sendData("START_COLLECT\n");
+                       });
+      if (clients.empty() && !recordPath.isEmpty())
+        raw->tcp.startRecording(recordPath);
+      raw->tcp.connectToServer("127.0.0.1", sim->port());
+      clients.push_back(std::move(client));
+    }
+    sims.append(sim);
+  }
+
+  QEventLoop loop;
+  QElapsedTimer timer;
+  timer.start();
+  QTimer::singleShot(kRunMs, &loop, &QEventLoop::quit);
+  loop.exec();
+  reportRun(name, clients, timer.nsecsElapsed() / 1e9, true);
+}
+
+// The captured session through TcpClient's replay source at full speed:
+// the same ingest work with no socket in the way
+void runReplay(const QString &name, const QString &path) {
+  std::vector<std::unique_ptr<IngestClient>> clients;
+  clients.push_back(std::make_unique<IngestClient>());
+  IngestClient *raw = clients.back().get();
+  QObject::connect(&raw->tcp, &TcpClient::dataReceived,
+                   [raw](const QByteArray &data) { raw->onData(data); });
+
+  QEventLoop loop;
+  QObject::connect(&raw->tcp, &TcpClient::stateChanged, &loop,
+                   [&loop](TcpClient::ConnectionState state) {
+                     if (state == TcpClient::Disconnected)
+                       loop.quit();
+                   });
+  QElapsedTimer timer;
+  timer.start();
+  if (!raw->tcp.startReplay(path, 0.0))
+    return;
+  loop.exec();
+  // Sent times are from the capture, so latency means nothing here
+  reportRun(name, clients, timer.nsecsElapsed() / 1e9, false);
+}
+
+} // namespace
+
+// Sustained ingest from tem_device_sim's generator over localhost
+void runTcpIngestBench() {
+  DeviceSimulator::Config config;
+  config.continuous = true;
+  config.fps = 2000;
+
+  QTemporaryDir dir;
+  const QString capture = dir.filePath("field_frames.temsession");
+  runScenario("tcp/field_frames", config, 1, 1, capture);
+  runReplay("tcp/replay_field_frames", capture);
+  runScenario("tcp/four_devices", config, 4, 1);
+
+  DeviceSimulator::Config large = config;
+  large.recvLen = 65536;
+  large.sendLen = 16384;
+  large.offLen = 16384;
+  large.fps = 200;
+  runScenario("tcp/large_frames", large, 1, 1);
+
+  DeviceSimulator::Config faulty = config;
+  faulty.fragmentBytes = 64;
+  faulty.malformedRate = 0.01;
+  runScenario("tcp/fragmented_malformed", faulty, 1, 1);
+}
+
+} // namespace bench
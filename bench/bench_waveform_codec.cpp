@@ -0,0 +1,85 @@
+#include "BenchHarness.h"
+#include "WaveformCodec.h"
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <QVector>
+#include <cstring>
+
+namespace bench {
+
+namespace {
+
+// Corpus channels are big-endian doubles; the save path stores float32
+QVector<float> corpusChannel(const QJsonObject &rec, const char *field) {
+  const QByteArray raw = QByteArray::fromBase64(rec[field].toString().toUtf8());
+  QVector<float> out;
+  out.reserve(raw.size() / 8);
+  for (int i = 0; i + 7 < raw.size(); i += 8) {
+    quint64 bits = 0;
+    for (int b = 0; b < 8; ++b)
+      bits = (bits << 8) | static_cast<quint8>(raw[i + b]);
+    double v;
+    memcpy(&v, &bits, sizeof(v));
+    out.append(static_cast<float>(v));
+  }
+  return out;
+}
+
+} // namespace
+
+void runWaveformCodecBench() {
+  const QJsonArray &corpus = sampleCorpus();
+  const int kRepeat = 20;
+
+  for (const char *field : {"DATA_RECV", "DATA_SEND", "DATA_SOFF"}) {
+    QVector<QVector<float>> channels;
+    qint64 rawBytes = 0;
+    for (const QJsonValue &v : corpus) {
+      channels.append(corpusChannel(v.toObject(), field));
+      rawBytes += channels.last().size() * qint64(sizeof(float));
+    }
+
+    for (WaveformCodec::Codec codec :
+         {WaveformCodec::Gorilla, WaveformCodec::DeltaZigzag}) {
+      const QString name =
+          QString("codec/%1/%2").arg(WaveformCodec::codecName(codec), field);
+
+      QVector<QByteArray> blobs(channels.size());
+      qint64 packedBytes = 0;
+      QElapsedTimer timer;
+      timer.start();
+      for (int r = 0; r < kRepeat; ++r) {
+        packedBytes = 0;
+        for (int i = 0; i < channels.size(); ++i) {
+          blobs[i] = WaveformCodec::compress(channels[i].constData(),
+                                             channels[i].size(), codec);
+          packedBytes += blobs[i].size();
+        }
+      }
+      const double encodeSeconds = timer.nsecsElapsed() / 1e9;
+
+      QVector<float> out;
+      bool lossless = true;
+      timer.restart();
+      for (int r = 0; r < kRepeat; ++r) {
+        for (int i = 0; i < blobs.size(); ++i) {
+          WaveformCodec::decompress(blobs[i], out);
+          if (r == 0 && out != channels[i])
+            lossless = false;
+        }
+      }
+      const double decodeSeconds = timer.nsecsElapsed() / 1e9;
+
+      reportValue(name + "/ratio",
+                  packedBytes > 0 ? double(rawBytes) / packedBytes : 0.0,
+                  "x");
+      report(name + "/encode", rawBytes * kRepeat / (1024 * 1024),
+             encodeSeconds, "MiB");
+      report(name + "/decode", rawBytes * kRepeat / (1024 * 1024),
+             decodeSeconds, "MiB");
+      reportValue(name + "/lossless", lossless ? 1.0 : 0.0, "bool");
+    }
+  }
+}
+
+} // namespace bench
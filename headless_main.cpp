@@ -0,0 +1,4 @@
+#include "HeadlessRunner.h"
+
+// TEM_Headless: the acquisition pipeline alone, linked without any UI module
+int main(int argc, char *argv[]) { return runHeadless(argc, argv); }
@@ -1,13 +1,30 @@
 #include "Backend.h"
+#include "HeadlessRunner.h"
+#include "LineProfile.h"
+#include "MetricsExporter.h"
 #include "PlaybackBackend.h"
+#include "StartupTimeline.h"
 #include <QApplication>
 #include <QQmlApplicationEngine>
 #include <QQmlContext>
+#include <QQuickWindow>
+#include <QTimer>
+#include <QtQml/qqmlextensionplugin.h>
 
 #include <QDebug>
-#include <QDirIterator>
+#include <cstring>
+
+// The BS module is a static QML library compiled ahead of time
+Q_IMPORT_QML_PLUGIN(BSPlugin)
 
 int main(int argc, char *argv[]) {
+  StartupTimeline::start();
+  // Unattended runs never build the QApplication or the QML engine
+  for (int i = 1; i < argc; ++i) {
+    if (std::strcmp(argv[i], "--headless") == 0)
+      return runHeadless(argc, argv);
+  }
+
   // Enable High DPI Support
   QApplication::setHighDpiScaleFactorRoundingPolicy(
       Qt::HighDpiScaleFactorRoundingPolicy::PassThrough);
@@ -15,18 +32,28 @@ int main(int argc, char *argv[]) {
   QApplication app(argc, argv);
   app.setOrganizationName("TEM Systems");
   app.setApplicationName("TEM_Acquisition");
+  StartupTimeline::mark("application");
 
   QQmlApplicationEngine engine;
 
-  // Print all QRC resources
-  QDirIterator it(":", QDirIterator::Subdirectories);
-  while (it.hasNext()) {
-    qDebug() << it.next();
-  }
-
+  // Cheap: the default project is opened after the first frame
   Backend backend;
+  StartupTimeline::mark("backend");
+
+  // Optional local metrics export for soak tests and field diagnostics
+  MetricsExporter metrics;
+  const QString metricsFile = qEnvironmentVariable("TEM_METRICS_FILE");
+  if (!metricsFile.isEmpty())
+    metrics.setTextFile(metricsFile);
+  const quint16 metricsPort =
+      quint16(qEnvironmentVariableIntValue("TEM_METRICS_PORT"));
+  QString metricsError;
+  if (metricsPort > 0 && !metrics.listen(metricsPort, &metricsError))
+    qWarning() << "Metrics endpoint:" << metricsError;
 
   qmlRegisterType<PlaybackBackend>("TEM.System", 1, 0, "PlaybackBackend");
+  // Owned by the engine
+  engine.addImageProvider("lineprofile", new LineProfileImageProvider);
 
   // Inject backend into QML root context
   engine.rootContext()->setContextProperty("cppBackend", &backend);
@@ -45,6 +72,28 @@ int main(int argc, char *argv[]) {
       Qt::QueuedConnection);
 
   engine.load(url);
+  StartupTimeline::mark("qml loaded");
+
+  // Window first, then the database: open the default project once the
+  // first frame is on screen
+  if (auto *window =
+          qobject_cast<QQuickWindow *>(engine.rootObjects().value(0))) {
+    QObject::connect(
+        window, &QQuickWindow::frameSwapped, &backend,
+        [&backend]() {
+          StartupTimeline::firstFrame();
+          // Let the frame reach the screen before blocking on SQLite
+          QTimer::singleShot(0, &backend, [&backend]() {
+            backend.initializeStorage();
+            StartupTimeline::interactive();
+          });
+        },
+        static_cast<Qt::ConnectionType>(Qt::QueuedConnection |
+                                        Qt::SingleShotConnection));
+  } else {
+    backend.initializeStorage();
+    StartupTimeline::interactive();
+  }
 
   return app.exec();
 }
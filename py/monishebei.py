@@ -18,9 +18,15 @@ PARAMS = {
     "sample_rate": 51200,
     "stack_count": 16,
     "sample_time": 2048,
-    "custom": ""
+    "custom": "",
+    "transfer": "full",       # full / preview / on_demand
+    "preview_points": 2000    # 预览帧每个通道的点数（min/max 对）
 }
 
+# 按需传输模式下保留的最近记录，供 GET_FRAME 取完整数据
+HELD_FRAMES = {}
+MAX_HELD_FRAMES = 256
+
 # ==================== 生成模拟数据核心函数 ====================
 def generate_sim_binary_data(length=655, data_type="recv"):
     """生成模拟的二进制波形数据（big-endian IEEE 754 doubles）
@@ -102,6 +108,42 @@ def generate_sim_db_record():
     
     return record
 
+def decimate_base64(b64, points):
+    """min/max 抽稀：每个桶保留最小值和最大值（按出现顺序），返回 (Base64, 点数)"""
+    raw = base64.b64decode(b64)
+    n = len(raw) // 8
+    values = struct.unpack('>%dd' % n, raw)
+    buckets = max(1, points // 2)
+    if n <= 2 * buckets:
+        return b64, n
+    out = []
+    for b in range(buckets):
+        begin = b * n // buckets
+        end = (b + 1) * n // buckets
+        chunk = values[begin:end]
+        lo = min(range(len(chunk)), key=chunk.__getitem__)
+        hi = max(range(len(chunk)), key=chunk.__getitem__)
+        out.extend(chunk[i] for i in sorted((lo, hi)))
+    return encode_base64_safe(struct.pack('>%dd' % len(out), *out)), len(out)
+
+def make_preview_record(record):
+    """预览帧：门控通道（DATA_RECV*）完整发送，DATA_SEND/DATA_SOFF 抽稀，
+    采样率字段按抽稀后的点数折算，ID 与完整帧相同"""
+    preview = dict(record)
+    preview["PREVIEW"] = 1
+    for field, rate_field in (("DATA_SEND", "SampleSendFs"), ("DATA_SOFF", "SampleOffFs")):
+        length = len(base64.b64decode(record[field])) // 8
+        data, points = decimate_base64(record[field], PARAMS["preview_points"])
+        preview[field] = data
+        preview[rate_field] = record[rate_field] * points / max(1, length)
+    return preview
+
+def hold_frame(record):
+    """保存完整记录，等待 GET_FRAME"""
+    HELD_FRAMES[record["ID"]] = record
+    while len(HELD_FRAMES) > MAX_HELD_FRAMES:
+        del HELD_FRAMES[next(iter(HELD_FRAMES))]
+
 # ==================== TCP通信处理 ====================
 def handle_client_connection(conn, addr):
     """处理与客户端的单个连接"""
@@ -109,66 +151,102 @@ def handle_client_connection(conn, addr):
     global CURRENT_POINT_ID
     
     try:
+        buffer = ""
         while True:
-            # 接收客户端指令
-            data = conn.recv(1024).decode('utf-8').strip()
-            if not data:
+            # 接收客户端指令（按换行分隔，一次可能收到多条）
+            chunk = conn.recv(1024).decode('utf-8')
+            if not chunk:
                 break
+            buffer += chunk
+            while "\n" in buffer:
+                line, buffer = buffer.split("\n", 1)
+                data = line.strip()
+                if not data:
+                    continue
+
+                print(f"[模拟设备] 收到指令：{data}")
+
+                if data == "START_COLLECT":
+                    # 模拟采集过程：分3次发送数据（模拟采集次数=3）
+                    print("[模拟设备] 开始采集...")
+                    transfer = PARAMS["transfer"]
+                    fulls = []
+                    for i in range(3):
+                        time.sleep(0.3)  # 模拟采集间隔
+                        record = generate_sim_db_record()
+                        if transfer == "full":
+                            # 发送JSON格式数据
+                            conn.sendall((json.dumps(record) + '\n').encode('utf-8'))
+                            continue
+                        # 先发预览帧，供界面立即显示
+                        preview = make_preview_record(record)
+                        conn.sendall((json.dumps(preview) + '\n').encode('utf-8'))
+                        if transfer == "preview":
+                            fulls.append(record)
+                        else:
+                            hold_frame(record)
+                    # 完整数据在所有预览之后发送（低优先级）
+                    for record in fulls:
+                        conn.sendall((json.dumps(record) + '\n').encode('utf-8'))
+                    print("[模拟设备] 采集完成")
             
-            print(f"[模拟设备] 收到指令：{data}")
-            
-            if data == "START_COLLECT":
-                # 模拟采集过程：分3次发送数据（模拟采集次数=3）
-                print("[模拟设备] 开始采集...")
-                for i in range(3):
-                    time.sleep(0.3)  # 模拟采集间隔
-                    record = generate_sim_db_record()
-                    # 发送JSON格式数据
-                    conn.sendall((json.dumps(record) + '\n').encode('utf-8'))
-                print("[模拟设备] 采集完成")
-            
-            elif data == "NEXT_POINT":
-                # 切换到下一个测点
-                print(f"[模拟设备] 切换到测点：{CURRENT_POINT_ID}")
-                response = {"status": "success", "next_point": CURRENT_POINT_ID}
-                conn.sendall((json.dumps(response) + '\n').encode('utf-8'))
+                elif data == "NEXT_POINT":
+                    # 切换到下一个测点
+                    print(f"[模拟设备] 切换到测点：{CURRENT_POINT_ID}")
+                    response = {"status": "success", "next_point": CURRENT_POINT_ID}
+                    conn.sendall((json.dumps(response) + '\n').encode('utf-8'))
             
-            elif data == "RESET_POINT":
-                # 重置测点编号
-                CURRENT_POINT_ID = 1
-                print("[模拟设备] 测点已重置为1")
-                response = {"status": "success", "reset_point": 1}
-                conn.sendall((json.dumps(response) + '\n').encode('utf-8'))
+                elif data == "RESET_POINT":
+                    # 重置测点编号
+                    CURRENT_POINT_ID = 1
+                    print("[模拟设备] 测点已重置为1")
+                    response = {"status": "success", "reset_point": 1}
+                    conn.sendall((json.dumps(response) + '\n').encode('utf-8'))
             
-            elif data == "GET_STATUS":
-                # 返回设备状态
-                status = {
-                    "status": "connected",
-                    "current_point": CURRENT_POINT_ID,
-                    "battery_voltage": round(random.uniform(11.8, 12.5), 2),
-                    "temperature": round(random.uniform(25, 35), 1),
-                    "params": PARAMS
-                }
-                conn.sendall((json.dumps(status) + '\n').encode('utf-8'))
+                elif data == "GET_STATUS":
+                    # 返回设备状态
+                    status = {
+                        "status": "connected",
+                        "current_point": CURRENT_POINT_ID,
+                        "battery_voltage": round(random.uniform(11.8, 12.5), 2),
+                        "temperature": round(random.uniform(25, 35), 1),
+                        "params": PARAMS
+                    }
+                    conn.sendall((json.dumps(status) + '\n').encode('utf-8'))
             
-            elif data.startswith("SET_PARAMS:"):
-                # 更新参数
-                try:
-                    params_data = json.loads(data.split(":", 1)[1])
-                    if "send_current" in params_data: PARAMS["send_current"] = params_data["send_current"]
-                    if "sample_rate" in params_data: PARAMS["sample_rate"] = params_data["sample_rate"]
-                    if "stack_count" in params_data: PARAMS["stack_count"] = params_data["stack_count"]
-                    if "sample_time" in params_data: PARAMS["sample_time"] = params_data["sample_time"]
-                    if "custom" in params_data: PARAMS["custom"] = params_data["custom"]
-                    print(f"[模拟设备] 参数已更新: {PARAMS}")
-                    conn.sendall(b'{"status": "success", "msg": "params_updated"}\n')
-                except Exception as e:
-                    print(f"[模拟设备] 参数解析失败: {e}")
-                    conn.sendall(b'{"error": "parse_failed"}\n')
+                elif data.startswith("SET_PARAMS:"):
+                    # 更新参数
+                    try:
+                        params_data = json.loads(data.split(":", 1)[1])
+                        if "send_current" in params_data: PARAMS["send_current"] = params_data["send_current"]
+                        if "sample_rate" in params_data: PARAMS["sample_rate"] = params_data["sample_rate"]
+                        if "stack_count" in params_data: PARAMS["stack_count"] = params_data["stack_count"]
+                        if "sample_time" in params_data: PARAMS["sample_time"] = params_data["sample_time"]
+                        if "custom" in params_data: PARAMS["custom"] = params_data["custom"]
+                        if "transfer" in params_data: PARAMS["transfer"] = params_data["transfer"]
+                        if "preview_points" in params_data: PARAMS["preview_points"] = int(params_data["preview_points"])
+                        print(f"[模拟设备] 参数已更新: {PARAMS}")
+                        conn.sendall(b'{"status": "success", "msg": "params_updated"}\n')
+                    except Exception as e:
+                        print(f"[模拟设备] 参数解析失败: {e}")
+                        conn.sendall(b'{"error": "parse_failed"}\n')
             
-            else:
-                # 未知指令
-                conn.sendall(b'{"error": "unknown_command"}\n')
+                elif data.startswith("GET_FRAME:"):
+                    # 按需传输：发送预览帧对应的完整记录
+                    try:
+                        frame_id = int(data.split(":", 1)[1])
+                    except ValueError:
+                        frame_id = -1
+                    record = HELD_FRAMES.get(frame_id)
+                    if record is None:
+                        response = {"error": "frame_unavailable", "ID": frame_id}
+                    else:
+                        response = record
+                    conn.sendall((json.dumps(response) + '\n').encode('utf-8'))
+
+                else:
+                    # 未知指令
+                    conn.sendall(b'{"error": "unknown_command"}\n')
     
     except Exception as e:
         print(f"[模拟设备] 连接异常：{e}")
@@ -185,7 +263,7 @@ def start_sim_device():
         print(f"========================================")
         print(f"  瞬变电磁模拟设备已启动")
         print(f"  监听地址：{HOST}:{PORT}")
-        print(f"  支持指令：START_COLLECT, NEXT_POINT, RESET_POINT, GET_STATUS")
+        print(f"  支持指令：START_COLLECT, NEXT_POINT, RESET_POINT, GET_STATUS, GET_FRAME")
         print(f"========================================")
         
         while True:
@@ -0,0 +1,114 @@
+"""
+TEM 同步服务器（本地替身）
+
+接收 SyncEngine 上传的样本批次，存入本地 SQLite，便于联调和测试。
+请求体为 qCompress 格式：4 字节大端长度 + zlib 流，内容为 JSON：
+    {"format": 2, "endpoint": ..., "firstId": n, "lastId": m, "samples": [...]}
+format 2 起每个样本带 ChannelRegistry 的全部波形列（含 DATA_RECV_LEN、
+DATA_RECV_POS）；样本按原样存储，不解析。
+
+用法：
+    python sync_server.py --port 8090 --db sync_server.db
+    python sync_server.py --fail-rate 0.3     # 随机拒绝 30% 的批次，测试断点续传
+客户端端点：http://127.0.0.1:8090/samples
+"""
+import argparse
+import json
+import random
+import sqlite3
+import struct
+import threading
+import zlib
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+DB_LOCK = threading.Lock()
+
+
+def open_db(path):
+    conn = sqlite3.connect(path, check_same_thread=False)
+    conn.execute("PRAGMA journal_mode = WAL")
+    conn.execute(
+        "CREATE TABLE IF NOT EXISTS Sample ("
+        "Endpoint TEXT, ID INTEGER, Body TEXT, ReceivedAt REAL DEFAULT (julianday('now')), "
+        "PRIMARY KEY (Endpoint, ID))"
+    )
+    conn.commit()
+    return conn
+
+
+def qcompress_decode(body):
+    if len(body) < 4:
+        raise ValueError("short body")
+    (expected,) = struct.unpack(">I", body[:4])
+    data = zlib.decompress(body[4:])
+    if len(data) != expected:
+        raise ValueError("length mismatch")
+    return data
+
+
+class SyncHandler(BaseHTTPRequestHandler):
+    server_version = "TEMSync/1.0"
+
+    def do_POST(self):
+        if self.path.rstrip("/") != "/samples":
+            self.send_error(404)
+            return
+        length = int(self.headers.get("Content-Length", 0))
+        body = self.rfile.read(length)
+
+        if random.random() < self.server.fail_rate:
+            self.send_error(503, "simulated failure")
+            return
+
+        try:
+            if self.headers.get("X-TEM-Encoding") == "qcompress":
+                body = qcompress_decode(body)
+            batch = json.loads(body)
+        except (ValueError, zlib.error) as e:
+            self.send_error(400, str(e))
+            return
+
+        endpoint = batch.get("endpoint", "")
+        rows = [(endpoint, s["ID"], json.dumps(s)) for s in batch.get("samples", [])]
+        with DB_LOCK:
+            # 重复上传（断点续传后重发）直接覆盖，保持幂等
+            self.server.db.executemany(
+                "INSERT OR REPLACE INTO Sample (Endpoint, ID, Body) VALUES (?, ?, ?)", rows
+            )
+            self.server.db.commit()
+
+        reply = json.dumps({"ok": True, "received": len(rows),
+                            "firstId": batch.get("firstId"),
+                            "lastId": batch.get("lastId")}).encode()
+        self.send_response(200)
+        self.send_header("Content-Type", "application/json")
+        self.send_header("Content-Length", str(len(reply)))
+        self.end_headers()
+        self.wfile.write(reply)
+        print(f"批次 {batch.get('firstId')}-{batch.get('lastId')}: {len(rows)} 条, "
+              f"{length} 字节")
+
+    def log_message(self, fmt, *args):
+        pass
+
+
+def main():
+    parser = argparse.ArgumentParser(description="TEM 同步服务器（本地替身）")
+    parser.add_argument("--host", default="127.0.0.1")
+    parser.add_argument("--port", type=int, default=8090)
+    parser.add_argument("--db", default="sync_server.db")
+    parser.add_argument("--fail-rate", type=float, default=0.0)
+    args = parser.parse_args()
+
+    server = ThreadingHTTPServer((args.host, args.port), SyncHandler)
+    server.db = open_db(args.db)
+    server.fail_rate = args.fail_rate
+    print("========================================")
+    print(f"  同步服务器已启动：http://{args.host}:{args.port}/samples")
+    print(f"  数据库：{args.db}  失败率：{args.fail_rate}")
+    print("========================================")
+    server.serve_forever()
+
+
+if __name__ == "__main__":
+    main()
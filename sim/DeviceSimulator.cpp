@@ -0,0 +1,461 @@
+#include "DeviceSimulator.h"
+#include <QDateTime>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTimer>
+#include <QtEndian>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+const int kVariants = 8;
+const qint64 kMaxBacklog = 32 * 1024 * 1024; // unsent bytes per client
+const int kMaxBurst = 1000;                  // frames per timer tick
+const qint64 kFullBacklog = 64 * 1024; // unsent bytes below which a queued
+                                       // full frame may go out
+const int kMaxHeld = 256;              // frames GET_FRAME can still fetch
+const double kPi = 3.14159265358979323846;
+
+enum Channel { Recv, Send, Off };
+
+// Same shapes and ranges as py/monishebei.py
+double sampleValue(Channel channel, double t, QRandomGenerator &rng) {
+  auto noise = [&rng](double amp) {
+    return (rng.generateDouble() * 2 - 1) * amp;
+  };
+  switch (channel) {
+  case Recv:
+    return 10.0 * std::exp(-3.0 * t) * std::sin(2 * kPi * 5 * t) + noise(0.3);
+  case Send:
+    if (t < 0.45)
+      return 38.0 + noise(1.0);
+    if (t < 0.55)
+      return 38.0 * (1 - (t - 0.45) / 0.1) * 2 - 38.0 + noise(2.0);
+    return -38.0 + noise(1.0);
+  case Off:
+    return 38.0 * std::exp(-8.0 * t) -
+           77.0 * (1 - std::exp(-2.0 * t)) * std::exp(-5.0 * t) + noise(2.0);
+  }
+  return 0.0;
+}
+
+// Base64 of big-endian float64, the device's wire format
+QByteArray synthesize(Channel channel, int length, QRandomGenerator &rng) {
+  QByteArray raw(length * 8, Qt::Uninitialized);
+  uchar *p = reinterpret_cast<uchar *>(raw.data());
+  for (int i = 0; i < length; ++i) {
+    const double v = sampleValue(channel, double(i) / length, rng);
+    quint64 bits;
+    memcpy(&bits, &v, sizeof(bits));
+    qToBigEndian(bits, p + i * 8);
+  }
+  return raw.toBase64();
+}
+
+// Min and max of each of points / 2 buckets, in the order they occur, as
+// base64 big-endian float64 again; values that fit are returned as is
+QByteArray decimate(const QByteArray &base64, int points, int *length) {
+  const QByteArray raw = QByteArray::fromBase64(base64);
+  const uchar *p = reinterpret_cast<const uchar *>(raw.constData());
+  const int n = int(raw.size() / 8);
+  auto value = [p](int i) {
+    const quint64 bits = qFromBigEndian<quint64>(p + i * 8);
+    double v;
+    memcpy(&v, &bits, sizeof(v));
+    return v;
+  };
+  const int buckets = qMax(1, points / 2);
+  if (n <= 2 * buckets) {
+    *length = n;
+    return base64;
+  }
+  QByteArray out(buckets * 2 * 8, Qt::Uninitialized);
+  uchar *o = reinterpret_cast<uchar *>(out.data());
+  for (int b = 0; b < buckets; ++b) {
+    const int begin = int(qint64(b) * n / buckets);
+    const int end = int(qint64(b + 1) * n / buckets);
+    int lo = begin, hi = begin;
+    for (int i = begin + 1; i < end; ++i) {
+      if (value(i) < value(lo))
+        lo = i;
+      if (value(i) > value(hi))
+        hi = i;
+    }
+    const double first = value(qMin(lo, hi));
+    const double second = value(qMax(lo, hi));
+    quint64 bits;
+    memcpy(&bits, &first, sizeof(bits));
+    qToBigEndian(bits, o + b * 16);
+    memcpy(&bits, &second, sizeof(bits));
+    qToBigEndian(bits, o + b * 16 + 8);
+  }
+  *length = buckets * 2;
+  return out.toBase64();
+}
+
+const char *transferName(DeviceSimulator::Transfer transfer) {
+  switch (transfer) {
+  case DeviceSimulator::Preview:
+    return "preview";
+  case DeviceSimulator::OnDemand:
+    return "on_demand";
+  default:
+    return "full";
+  }
+}
+
+qint64 wallClockUs() {
+  using namespace std::chrono;
+  return duration_cast<microseconds>(system_clock::now().time_since_epoch())
+      .count();
+}
+
+} // namespace
+
+struct DeviceSimulator::Session {
+  QTcpSocket *socket;
+  QTimer *timer;
+  QString peer;
+  QByteArray commands;
+  QElapsedTimer clock;
+  qint64 sent = 0;       // frames sent since this collect started
+  int remaining = 0;     // frames left in this collect, -1 = continuous
+  qint64 connFrames = 0; // frames sent over this connection
+  QList<Frame> fulls;    // Preview: previewed, not yet sent in full
+};
+
+DeviceSimulator::DeviceSimulator(const Config &config, QObject *parent)
+    : QObject(parent), m_config(config), m_server(new QTcpServer(this)),
+      m_rng(config.seed) {
+  for (int v = 0; v < kVariants; ++v) {
+    m_recv.append(synthesize(Recv, m_config.recvLen, m_rng));
+    m_send.append(synthesize(Send, m_config.sendLen, m_rng));
+    m_off.append(synthesize(Off, m_config.offLen, m_rng));
+  }
+  m_recvAux = synthesize(Recv, 100, m_rng);
+  buildPreviews();
+  connect(m_server, &QTcpServer::newConnection, this,
+          &DeviceSimulator::onNewConnection);
+}
+
+DeviceSimulator::~DeviceSimulator() {
+  const auto sessions = m_sessions.values();
+  for (Session *s : sessions)
+    delete s;
+}
+
+bool DeviceSimulator::listen(quint16 port, const QHostAddress &address) {
+  if (!m_server->listen(address, port)) {
+    qWarning() << "DeviceSimulator: listen on" << port
+               << "failed:" << m_server->errorString();
+    return false;
+  }
+  return true;
+}
+
+quint16 DeviceSimulator::port() const { return m_server->serverPort(); }
+
+void DeviceSimulator::onNewConnection() {
+  while (QTcpSocket *socket = m_server->nextPendingConnection()) {
+    // Fragments should leave as separate segments, not be coalesced
+    socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+
+    Session *s = new Session;
+    s->socket = socket;
+    s->timer = new QTimer(socket);
+    s->timer->setTimerType(Qt::PreciseTimer);
+    s->peer = QString("%1:%2")
+                  .arg(socket->peerAddress().toString())
+                  .arg(socket->peerPort());
+    m_sessions.insert(socket, s);
+    ++m_stats.sessions;
+
+    connect(socket, &QTcpSocket::readyRead, this,
+            [this, s]() { onReadyRead(s); });
+    connect(socket, &QTcpSocket::disconnected, this, [this, socket]() {
+      if (Session *s = m_sessions.value(socket))
+        closeSession(s);
+    });
+    connect(s->timer, &QTimer::timeout, this, [this, s]() { onTick(s); });
+    emit sessionOpened(s->peer);
+  }
+}
+
+void DeviceSimulator::onReadyRead(Session *s) {
+  s->commands.append(s->socket->readAll());
+  int newlineIdx;
+  while ((newlineIdx = s->commands.indexOf('\n')) != -1) {
+    const QByteArray line = s->commands.left(newlineIdx).trimmed();
+    s->commands.remove(0, newlineIdx + 1);
+    if (!line.isEmpty())
+      handleCommand(s, line);
+  }
+}
+
+void DeviceSimulator::handleCommand(Session *s, const QByteArray &line) {
+  if (line == "START_COLLECT") {
+    startCollect(s);
+  } else if (line == "STOP_COLLECT") {
+    // Frames already previewed still go out in full
+    if (s->fulls.isEmpty())
+      stopCollect(s);
+    else
+      s->remaining = 0;
+    reply(s, R"({"status": "success", "msg": "collect_stopped"})");
+  } else if (line == "NEXT_POINT") {
+    ++m_pointId;
+    reply(s, QByteArray(R"({"status": "success", "next_point": )") +
+                 QByteArray::number(m_pointId) + "}");
+  } else if (line == "RESET_POINT") {
+    m_pointId = 1;
+    reply(s, R"({"status": "success", "reset_point": 1})");
+  } else if (line == "GET_STATUS") {
+    const QLatin1String transfer(transferName(m_config.transfer));
+    QJsonObject params{{"send_current", m_sendCurrent},
+                       {"sample_rate", m_config.recvFs},
+                       {"stack_count", m_stackParam},
+                       {"sample_time", m_sampleTime},
+                       {"transfer", transfer},
+                       {"preview_points", m_config.previewPoints}};
+    const double battery = 11.8 + m_rng.generateDouble() * 0.7;
+    const double temperature = 25.0 + m_rng.generateDouble() * 10.0;
+    QJsonObject status{{"status", "connected"},
+                       {"current_point", m_pointId},
+                       {"battery_voltage", std::round(battery * 100) / 100},
+                       {"temperature", std::round(temperature * 10) / 10},
+                       {"params", params}};
+    reply(s, QJsonDocument(status).toJson(QJsonDocument::Compact));
+  } else if (line.startsWith("SET_PARAMS:")) {
+    const QJsonDocument doc = QJsonDocument::fromJson(line.mid(11));
+    if (!doc.isObject()) {
+      reply(s, R"({"error": "parse_failed"})");
+      return;
+    }
+    const QJsonObject p = doc.object();
+    m_sendCurrent = p.value("send_current").toDouble(m_sendCurrent);
+    m_config.recvFs = p.value("sample_rate").toDouble(m_config.recvFs);
+    m_stackParam = p.value("stack_count").toInt(m_stackParam);
+    m_sampleTime = p.value("sample_time").toInt(m_sampleTime);
+    if (p.contains("transfer")) {
+      const QString mode = p.value("transfer").toString();
+      m_config.transfer = mode == "preview"     ? Preview
+                          : mode == "on_demand" ? OnDemand
+                                                : Full;
+    }
+    const int points = p.value("preview_points").toInt(m_config.previewPoints);
+    if (points != m_config.previewPoints) {
+      m_config.previewPoints = points;
+      buildPreviews();
+    }
+    reply(s, R"({"status": "success", "msg": "params_updated"})");
+  } else if (line.startsWith("GET_FRAME:")) {
+    sendHeldFrame(s, line.mid(10).toLongLong());
+  } else {
+    reply(s, R"({"error": "unknown_command"})");
+  }
+}
+
+void DeviceSimulator::startCollect(Session *s) {
+  s->sent = 0;
+  s->remaining = m_config.continuous ? -1 : qMax(1, m_config.stackCount);
+  s->clock.start();
+  const double fps = qMax(0.001, m_config.fps);
+  s->timer->start(qMax(1, int(1000.0 / fps)));
+}
+
+void DeviceSimulator::stopCollect(Session *s) {
+  s->timer->stop();
+  s->remaining = 0;
+}
+
+void DeviceSimulator::onTick(Session *s) {
+  // Frames owed by now; several go out per tick above 1 kHz
+  const qint64 due = qint64(s->clock.nsecsElapsed() / 1e9 * m_config.fps);
+  if (due - s->sent > qMax<qint64>(1, qint64(m_config.fps))) {
+    // More than a second behind: drop the backlog instead of bursting it
+    s->sent = due - 1;
+  }
+  int burst = 0;
+  while (s->sent < due && s->remaining != 0 && burst < kMaxBurst) {
+    if (s->socket->bytesToWrite() > kMaxBacklog) {
+      ++m_stats.stalls;
+      return;
+    }
+    const Frame frame = nextFrame();
+    const bool preview = m_config.transfer != Full;
+    if (!sendFrame(s, buildFrame(frame, preview)))
+      return; // session closed by an injected disconnect
+    if (m_config.transfer == Preview) {
+      s->fulls.append(frame);
+    } else if (m_config.transfer == OnDemand) {
+      if (m_held.size() >= kMaxHeld)
+        m_held.removeFirst();
+      m_held.append(frame);
+    }
+    ++s->sent;
+    ++burst;
+    if (s->remaining > 0)
+      --s->remaining;
+  }
+  // Full frames of the previews yield to them, and go out while the link
+  // has room
+  while (!s->fulls.isEmpty() && s->socket->bytesToWrite() < kFullBacklog) {
+    if (!sendFrame(s, buildFrame(s->fulls.takeFirst(), false)))
+      return;
+  }
+  if (s->remaining == 0 && s->fulls.isEmpty())
+    stopCollect(s);
+}
+
+void DeviceSimulator::sendHeldFrame(Session *s, qint64 id) {
+  for (const Frame &frame : std::as_const(m_held)) {
+    if (frame.id == id) {
+      sendFrame(s, buildFrame(frame, false));
+      return;
+    }
+  }
+  reply(s, QByteArray(R"({"error": "frame_unavailable", "ID": )") +
+               QByteArray::number(id) + "}");
+}
+
+bool DeviceSimulator::sendFrame(Session *s, const QByteArray &built) {
+  QByteArray frame = built;
+  if (m_config.malformedRate > 0 &&
+      m_rng.generateDouble() < m_config.malformedRate) {
+    frame = corrupt(frame);
+    ++m_stats.malformed;
+  }
+
+  ++s->connFrames;
+  const bool drop =
+      (m_config.disconnectAfter > 0 &&
+       s->connFrames >= m_config.disconnectAfter) ||
+      (m_config.disconnectRate > 0 &&
+       m_rng.generateDouble() < m_config.disconnectRate);
+  if (drop) {
+    // Cut the connection mid-frame, as a device losing power would
+    QTcpSocket *socket = s->socket;
+    writeBytes(s, frame.left(frame.size() / 2));
+    socket->flush();
+    ++m_stats.disconnects;
+    socket->abort(); // may already close the session via disconnected()
+    if (Session *open = m_sessions.value(socket))
+      closeSession(open);
+    return false;
+  }
+
+  writeBytes(s, frame);
+  ++m_stats.frames;
+  m_stats.bytes += frame.size();
+  return true;
+}
+
+void DeviceSimulator::writeBytes(Session *s, const QByteArray &bytes) {
+  if (m_config.fragmentBytes <= 0) {
+    s->socket->write(bytes);
+    return;
+  }
+  // Random-sized pieces, each pushed to the kernel on its own
+  qsizetype pos = 0;
+  while (pos < bytes.size()) {
+    const qsizetype n =
+        qMin<qsizetype>(bytes.size() - pos,
+                        1 + m_rng.bounded(m_config.fragmentBytes));
+    s->socket->write(bytes.constData() + pos, n);
+    s->socket->flush();
+    pos += n;
+  }
+}
+
+void DeviceSimulator::reply(Session *s, const QByteArray &json) {
+  s->socket->write(json + '\n');
+}
+
+void DeviceSimulator::closeSession(Session *s) {
+  m_sessions.remove(s->socket);
+  --m_stats.sessions;
+  s->timer->stop();
+  s->timer->disconnect(this);
+  s->socket->disconnect(this);
+  emit sessionClosed(s->peer);
+  s->socket->deleteLater();
+  delete s;
+}
+
+DeviceSimulator::Frame DeviceSimulator::nextFrame() {
+  const Frame frame{m_sampleId++, m_variant, m_pointId,
+                    QDateTime::currentMSecsSinceEpoch()};
+  m_variant = (m_variant + 1) % kVariants;
+  return frame;
+}
+
+QByteArray DeviceSimulator::buildFrame(const Frame &frame, bool preview) {
+  const int v = frame.variant;
+  const QByteArray &send = preview ? m_sendPreview[v] : m_send[v];
+  const QByteArray &off = preview ? m_offPreview[v] : m_off[v];
+  // A decimated channel's rate is that of the values it carries
+  const double sendFs =
+      preview ? m_config.offFs * m_sendPreviewLen / qMax(1, m_config.sendLen)
+              : m_config.offFs;
+  const double offFs =
+      preview ? m_config.offFs * m_offPreviewLen / qMax(1, m_config.offLen)
+              : m_config.offFs;
+
+  // Field set of generate_sim_db_record(), plus the send time for latency
+  QByteArray f;
+  f.reserve(m_recv[v].size() + send.size() + off.size() +
+            2 * m_recvAux.size() + 512);
+  f += "{\"SimSentUs\":" + QByteArray::number(wallClockUs());
+  f += ",\"ID\":" + QByteArray::number(frame.id);
+  if (preview)
+    f += ",\"PREVIEW\":1";
+  f += ",\"Data_PointID\":" + QByteArray::number(frame.pointId);
+  f += ",\"DeviceType\":1,\"NOTE\":null,\"PERIOD\":500,\"TYPE\":1,\"USE\":1";
+  f += ",\"RecvFs\":" + QByteArray::number(m_config.recvFs, 'f', 1);
+  f += ",\"SampleOffFs\":" + QByteArray::number(offFs, 'f', 1);
+  f += ",\"SampleSendFs\":" + QByteArray::number(sendFs, 'f', 1);
+  f += ",\"SendFs\":" + QByteArray::number(m_config.sendFs, 'f', 1);
+  f += ",\"SendCurrent\":" + QByteArray::number(m_sendCurrent);
+  f += ",\"StackCount\":" + QByteArray::number(m_stackParam);
+  f += ",\"StartTime\":" + QByteArray::number(frame.startTime);
+  f += ",\"DATA_RECV_LEN\":\"" + m_recvAux + '"';
+  f += ",\"DATA_RECV_POS\":\"" + m_recvAux + '"';
+  f += ",\"DATA_RECV\":\"" + m_recv[v] + '"';
+  f += ",\"DATA_SEND\":\"" + send + '"';
+  f += ",\"DATA_SOFF\":\"" + off + "\"}\n";
+  return f;
+}
+
+void DeviceSimulator::buildPreviews() {
+  // DATA_RECV and its gate channels are short and go out whole
+  m_sendPreview.clear();
+  m_offPreview.clear();
+  for (int v = 0; v < kVariants; ++v) {
+    m_sendPreview.append(
+        decimate(m_send[v], m_config.previewPoints, &m_sendPreviewLen));
+    m_offPreview.append(
+        decimate(m_off[v], m_config.previewPoints, &m_offPreviewLen));
+  }
+}
+
+QByteArray DeviceSimulator::corrupt(const QByteArray &frame) {
+  switch (m_rng.bounded(3)) {
+  case 0: // truncated: the line ends mid-object
+    return frame.left(1 + m_rng.bounded(int(frame.size() - 2))) + '\n';
+  case 1: { // invalid base64 inside an otherwise well-formed object
+    QByteArray bad = frame;
+    const int at = bad.indexOf("\"DATA_RECV\":\"") + 13;
+    for (int i = 0; i < 16 && at + i < bad.size() - 2; ++i)
+      bad[at + i] = '#';
+    return bad;
+  }
+  default: // line noise
+    return QByteArray("\x01\x02garbage{{\"\n", 13) + frame;
+  }
+}
@@ -0,0 +1,124 @@
+#ifndef DEVICESIMULATOR_H
+#define DEVICESIMULATOR_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QHostAddress>
+#include <QObject>
+#include <QRandomGenerator>
+#include <QVector>
+
+class QTcpServer;
+class QTcpSocket;
+
+// One simulated TEM receiver speaking the py/monishebei.py protocol:
+// newline-terminated commands in, newline-delimited JSON frames out.
+//
+// Waveforms are synthesised once per variant at construction and kept as
+// ready-to-send base64, so a frame is just a few appends and the simulator
+// can push far more data than the client can take. Faults (malformed
+// frames, TCP fragmentation, dropped connections) are injected on the
+// send path so the client's framing and recovery can be exercised.
+//
+// Preview transfer ("transfer" in SET_PARAMS): each frame goes out first
+// with DATA_SEND and DATA_SOFF min/max-decimated to previewPoints values,
+// then in full once the link has room (Preview), or only on
+// GET_FRAME:<id> for one of the last frames (OnDemand).
+class DeviceSimulator : public QObject {
+  Q_OBJECT
+public:
+  enum Transfer { Full, Preview, OnDemand };
+
+  struct Config {
+    int recvLen = 655;
+    int sendLen = 500;
+    int offLen = 500;
+    double recvFs = 51200.0;
+    double sendFs = 25.0;
+    double offFs = 2000000.0;
+    double fps = 3.33;   // frame rate while collecting
+    int stackCount = 3;  // frames per START_COLLECT
+    bool continuous = false; // stream until STOP_COLLECT instead
+    Transfer transfer = Full;
+    int previewPoints = 2000; // values per decimated preview channel
+    double malformedRate = 0.0;  // probability per frame
+    int fragmentBytes = 0;       // max bytes per write, 0 = whole frames
+    int disconnectAfter = 0;     // frames per connection, 0 = never
+    double disconnectRate = 0.0; // probability per frame
+    quint32 seed = 1;
+  };
+
+  struct Stats {
+    qint64 frames = 0;
+    qint64 bytes = 0;
+    qint64 malformed = 0;
+    qint64 disconnects = 0;
+    qint64 stalls = 0; // ticks skipped because the client fell behind
+    int sessions = 0;
+  };
+
+  explicit DeviceSimulator(const Config &config, QObject *parent = nullptr);
+  ~DeviceSimulator();
+
+  bool listen(quint16 port, const QHostAddress &address = QHostAddress::Any);
+  quint16 port() const;
+  const Stats &stats() const { return m_stats; }
+
+signals:
+  void sessionOpened(const QString &peer);
+  void sessionClosed(const QString &peer);
+
+private:
+  struct Session;
+  // What a frame is built from, kept for sending it again in full
+  struct Frame {
+    qint64 id;
+    int variant;
+    int pointId;
+    qint64 startTime;
+  };
+
+  void onNewConnection();
+  void onReadyRead(Session *s);
+  void handleCommand(Session *s, const QByteArray &line);
+  void startCollect(Session *s);
+  void stopCollect(Session *s);
+  void onTick(Session *s);
+  bool sendFrame(Session *s, const QByteArray &frame);
+  void sendHeldFrame(Session *s, qint64 id);
+  void writeBytes(Session *s, const QByteArray &bytes);
+  void reply(Session *s, const QByteArray &json);
+  void closeSession(Session *s);
+
+  Frame nextFrame();
+  QByteArray buildFrame(const Frame &frame, bool preview);
+  void buildPreviews();
+  QByteArray corrupt(const QByteArray &frame);
+
+  Config m_config;
+  QTcpServer *m_server;
+  QHash<QTcpSocket *, Session *> m_sessions;
+  QRandomGenerator m_rng;
+  Stats m_stats;
+
+  // Pre-encoded channel variants, rotated per frame
+  QVector<QByteArray> m_recv;
+  QVector<QByteArray> m_send;
+  QVector<QByteArray> m_off;
+  QByteArray m_recvAux; // DATA_RECV_LEN / DATA_RECV_POS
+  // Decimated DATA_SEND / DATA_SOFF per variant, and their lengths
+  QVector<QByteArray> m_sendPreview;
+  QVector<QByteArray> m_offPreview;
+  int m_sendPreviewLen = 0;
+  int m_offPreviewLen = 0;
+  int m_variant = 0;
+  QList<Frame> m_held; // OnDemand: latest frames, for GET_FRAME
+
+  int m_pointId = 1;
+  qint64 m_sampleId = 1;
+  double m_sendCurrent = 10.0;
+  int m_stackParam = 16;
+  int m_sampleTime = 2048;
+};
+
+#endif // DEVICESIMULATOR_H
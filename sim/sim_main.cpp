@@ -0,0 +1,130 @@
+#include "DeviceSimulator.h"
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <QTimer>
+
+// tem_device_sim: load generator for TcpClient/Backend on localhost.
+//
+//   tem_device_sim --fps 200 --continuous --instances 4
+//   tem_device_sim --recv-len 65536 --fragment 7 --malformed-rate 0.01
+//   tem_device_sim --off-len 200000 --transfer preview
+//
+// Instance i listens on port + i. One stats line per second on stdout.
+int main(int argc, char *argv[]) {
+  QCoreApplication app(argc, argv);
+  app.setApplicationName("tem_device_sim");
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription("High-rate TEM device simulator");
+  parser.addHelpOption();
+  auto option = [&parser](const QString &name, const QString &help,
+                          const QString &value, const QString &def) {
+    parser.addOption(QCommandLineOption(name, help, value, def));
+  };
+  option("port", "First listening port.", "port", "8888");
+  option("instances", "Simulated devices (consecutive ports).", "n", "1");
+  option("recv-len", "Samples per DATA_RECV.", "n", "655");
+  option("send-len", "Samples per DATA_SEND.", "n", "500");
+  option("off-len", "Samples per DATA_SOFF.", "n", "500");
+  option("recv-fs", "RecvFs reported in frames (Hz).", "hz", "51200");
+  option("send-fs", "SendFs reported in frames (Hz).", "hz", "25");
+  option("off-fs", "SampleOffFs reported in frames (Hz).", "hz", "2000000");
+  option("fps", "Frames per second while collecting.", "rate", "3.33");
+  option("stack", "Frames per START_COLLECT.", "n", "3");
+  option("transfer", "full, preview or on_demand (clients may change it).",
+         "mode", "full");
+  option("preview-points", "Values per decimated preview channel.", "n",
+         "2000");
+  option("malformed-rate", "Probability a frame is corrupted.", "p", "0");
+  option("fragment", "Split writes into pieces of at most this many bytes.",
+         "bytes", "0");
+  option("disconnect-after", "Drop each connection after this many frames.",
+         "n", "0");
+  option("disconnect-rate", "Probability of dropping the connection per "
+                            "frame.",
+         "p", "0");
+  option("seed", "Random seed for waveforms and faults.", "n", "1");
+  parser.addOption(QCommandLineOption(
+      "continuous", "Stream frames from START_COLLECT until STOP_COLLECT."));
+  parser.process(app);
+
+  DeviceSimulator::Config config;
+  config.recvLen = parser.value("recv-len").toInt();
+  config.sendLen = parser.value("send-len").toInt();
+  config.offLen = parser.value("off-len").toInt();
+  config.recvFs = parser.value("recv-fs").toDouble();
+  config.sendFs = parser.value("send-fs").toDouble();
+  config.offFs = parser.value("off-fs").toDouble();
+  config.fps = parser.value("fps").toDouble();
+  config.stackCount = parser.value("stack").toInt();
+  config.continuous = parser.isSet("continuous");
+  const QString transfer = parser.value("transfer");
+  config.transfer = transfer == "preview"     ? DeviceSimulator::Preview
+                    : transfer == "on_demand" ? DeviceSimulator::OnDemand
+                                              : DeviceSimulator::Full;
+  config.previewPoints = parser.value("preview-points").toInt();
+  config.malformedRate = parser.value("malformed-rate").toDouble();
+  config.fragmentBytes = parser.value("fragment").toInt();
+  config.disconnectAfter = parser.value("disconnect-after").toInt();
+  config.disconnectRate = parser.value("disconnect-rate").toDouble();
+  config.seed = parser.value("seed").toUInt();
+
+  const quint16 port = quint16(parser.value("port").toUInt());
+  const int instances = qMax(1, parser.value("instances").toInt());
+  QTextStream out(stdout);
+
+  QList<DeviceSimulator *> devices;
+  for (int i = 0; i < instances; ++i) {
+    DeviceSimulator::Config c = config;
+    c.seed = config.seed + quint32(i);
+    DeviceSimulator *device = new DeviceSimulator(c, &app);
+    if (!device->listen(quint16(port + i)))
+      return 1;
+    QObject::connect(device, &DeviceSimulator::sessionOpened,
+                     [&out, i](const QString &peer) {
+                       out << "[" << i << "] connected " << peer << Qt::endl;
+                     });
+    QObject::connect(device, &DeviceSimulator::sessionClosed,
+                     [&out, i](const QString &peer) {
+                       out << "[" << i << "] closed " << peer << Qt::endl;
+                     });
+    devices.append(device);
+  }
+  out << "tem_device_sim: " << instances << " device(s) on ports " << port
+      << "-" << (port + instances - 1) << Qt::endl;
+
+  // Throughput over the last second, totals since start
+  QElapsedTimer clock;
+  clock.start();
+  qint64 lastFrames = 0, lastBytes = 0, lastNs = 0;
+  QTimer statsTimer;
+  QObject::connect(&statsTimer, &QTimer::timeout, [&]() {
+    DeviceSimulator::Stats total;
+    for (const DeviceSimulator *d : devices) {
+      const DeviceSimulator::Stats &s = d->stats();
+      total.frames += s.frames;
+      total.bytes += s.bytes;
+      total.malformed += s.malformed;
+      total.disconnects += s.disconnects;
+      total.stalls += s.stalls;
+      total.sessions += s.sessions;
+    }
+    const qint64 ns = clock.nsecsElapsed();
+    const double seconds = (ns - lastNs) / 1e9;
+    out << "clients " << total.sessions << "  "
+        << QString::number((total.frames - lastFrames) / seconds, 'f', 1)
+        << " frames/s  "
+        << QString::number((total.bytes - lastBytes) / seconds / 1e6, 'f', 2)
+        << " MB/s  total " << total.frames << " frames, " << total.malformed
+        << " malformed, " << total.disconnects << " dropped, " << total.stalls
+        << " stalls" << Qt::endl;
+    lastFrames = total.frames;
+    lastBytes = total.bytes;
+    lastNs = ns;
+  });
+  statsTimer.start(1000);
+
+  return app.exec();
+}